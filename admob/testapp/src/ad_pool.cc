@@ -0,0 +1,369 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ad_pool.h"  // NOLINT
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+
+#include "firebase/admob.h"
+#include "firebase/admob/interstitial_ad.h"
+#include "firebase/admob/rewarded_video.h"
+#include "firebase/admob/types.h"
+#include "firebase/future.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+
+namespace admob = ::firebase::admob;
+
+namespace admob_testapp {
+
+namespace {
+
+// How often the background thread checks the pool's ads.
+const int kPollIntervalMs = 100;
+
+class InterstitialPreloadedAd : public PreloadedAd {
+ public:
+  InterstitialPreloadedAd(admob::AdParent parent, const char* ad_unit,
+                          admob::InterstitialAd::Listener* listener)
+      : parent_(parent), ad_unit_(ad_unit), listener_(listener) {}
+
+  firebase::Future<void> Initialize() override {
+    ad_.Initialize(parent_, ad_unit_.c_str());
+    return ad_.InitializeLastResult();
+  }
+  firebase::Future<void> LoadAd(const admob::AdRequest& request) override {
+    if (listener_) ad_.SetListener(listener_);
+    ad_.LoadAd(request);
+    return ad_.LoadAdLastResult();
+  }
+  firebase::Future<void> Show() override {
+    ad_.Show();
+    return ad_.ShowLastResult();
+  }
+  bool hidden() const override {
+    return ad_.presentation_state() ==
+           admob::InterstitialAd::kPresentationStateHidden;
+  }
+  bool reusable() const override { return false; }
+
+ private:
+  admob::InterstitialAd ad_;
+  admob::AdParent parent_;
+  std::string ad_unit_;
+  admob::InterstitialAd::Listener* listener_;
+};
+
+class RewardedVideoPreloadedAd : public PreloadedAd {
+ public:
+  RewardedVideoPreloadedAd(admob::AdParent parent, const char* ad_unit,
+                           admob::rewarded_video::Listener* listener)
+      : parent_(parent), ad_unit_(ad_unit), listener_(listener) {}
+  ~RewardedVideoPreloadedAd() override { admob::rewarded_video::Destroy(); }
+
+  firebase::Future<void> Initialize() override {
+    admob::rewarded_video::Initialize();
+    return admob::rewarded_video::InitializeLastResult();
+  }
+  firebase::Future<void> LoadAd(const admob::AdRequest& request) override {
+    if (listener_) admob::rewarded_video::SetListener(listener_);
+    admob::rewarded_video::LoadAd(ad_unit_.c_str(), request);
+    return admob::rewarded_video::LoadAdLastResult();
+  }
+  firebase::Future<void> Show() override {
+    admob::rewarded_video::Show(parent_);
+    return admob::rewarded_video::ShowLastResult();
+  }
+  bool hidden() const override {
+    return admob::rewarded_video::presentation_state() ==
+           admob::rewarded_video::kPresentationStateHidden;
+  }
+  bool reusable() const override { return true; }
+
+ private:
+  admob::AdParent parent_;
+  std::string ad_unit_;
+  admob::rewarded_video::Listener* listener_;
+};
+
+}  // namespace
+
+PreloadedAd* NewInterstitialAd(admob::AdParent parent, const char* ad_unit,
+                               admob::InterstitialAd::Listener* listener) {
+  return new InterstitialPreloadedAd(parent, ad_unit, listener);
+}
+
+PreloadedAd* NewRewardedVideoAd(admob::AdParent parent, const char* ad_unit,
+                                admob::rewarded_video::Listener* listener) {
+  return new RewardedVideoPreloadedAd(parent, ad_unit, listener);
+}
+
+AdPool::AdPool(const char* name, const Factory& factory,
+               const AdRequestCache* requests, const AdPoolOptions& options)
+    : name_(name),
+      factory_(factory),
+      requests_(requests),
+      options_(options),
+      running_(false),
+      stopping_(false),
+      update_requested_(false),
+      retry_at_us_(0),
+      retry_ms_(options.initial_retry_ms) {}
+
+AdPool::~AdPool() { Stop(); }
+
+void AdPool::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_) return;
+  running_ = true;
+  stopping_ = false;
+  app_framework::RunOnBackgroundThread(RunThread, this);
+}
+
+void AdPool::Stop() {
+  std::vector<std::unique_ptr<Slot>> slots;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopping_ = true;
+    condition_.notify_all();
+    while (running_) condition_.wait(lock);
+    slots.swap(slots_);
+  }
+  // Delete the ads outside the lock, detaching the completion callbacks of
+  // pending loads first as they would write to the deleted slots.
+  for (size_t i = 0; i < slots.size(); ++i) {
+    slots[i]->future.OnCompletion([](const firebase::Future<void>&) {});
+  }
+  slots.clear();
+}
+
+bool AdPool::ready() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    if (slots_[i]->state == kSlotReady) return true;
+  }
+  return false;
+}
+
+bool AdPool::WaitForReady(int timeout_ms) {
+  ready_events_.WaitUntil([this]() { return ready(); }, timeout_ms);
+  return ready();
+}
+
+firebase::Future<void> AdPool::Show() {
+  Slot* slot = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      if (slots_[i]->state == kSlotReady &&
+          (!slot || slots_[i]->loaded_us < slot->loaded_us)) {
+        slot = slots_[i].get();
+      }
+    }
+    if (!slot) {
+      stats_.misses++;
+      return firebase::Future<void>();
+    }
+    // The background thread leaves the slot alone until it's kSlotShowing.
+    slot->state = kSlotShowRequested;
+    stats_.shows++;
+  }
+  firebase::Future<void> future = slot->ad->Show();
+  std::lock_guard<std::mutex> lock(mutex_);
+  slot->future = future;
+  slot->state = kSlotShowing;
+  return future;
+}
+
+bool AdPool::showing() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    if (slots_[i]->state == kSlotShowRequested ||
+        slots_[i]->state == kSlotShowing) {
+      return true;
+    }
+  }
+  return false;
+}
+
+AdPoolStats AdPool::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void AdPool::LogStats() const {
+  AdPoolStats counters = stats();
+  LogMessage(
+      "%s ad pool: %d requests, %d fills, %d failures (%.0f%% fill rate), "
+      "%d expired, %d shows, %d misses.",
+      name_.c_str(), counters.requests, counters.fills, counters.failures,
+      counters.fill_rate() * 100.0, counters.expired, counters.shows,
+      counters.misses);
+  if (load_latency_.count() > 0) {
+    LogMessage("  Load latency p50 %.1f ms, p99 %.1f ms.",
+               load_latency_.Percentile(50.0) / 1000.0,
+               load_latency_.Percentile(99.0) / 1000.0);
+  }
+}
+
+void* AdPool::RunThread(void* data) {
+  static_cast<AdPool*>(data)->Run();
+  return nullptr;
+}
+
+void AdPool::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    Update(&lock);
+    condition_.wait_for(lock, std::chrono::milliseconds(kPollIntervalMs),
+                        [this]() { return stopping_ || update_requested_; });
+    update_requested_ = false;
+  }
+  running_ = false;
+  condition_.notify_all();
+}
+
+void AdPool::Update(std::unique_lock<std::mutex>* lock) {
+  int64_t now_us = GetMonotonicTimeInMicroseconds();
+  for (size_t i = 0; i < slots_.size();) {
+    Slot* slot = slots_[i].get();
+    // Show() sets the future of a slot it's showing, so only read it in the
+    // states this thread owns.
+    bool pending = slot->state != kSlotShowRequested &&
+                   slot->future.status() == firebase::kFutureStatusPending;
+    switch (slot->state) {
+      case kSlotInitializing:
+        if (pending) break;
+        if (slot->future.error() != admob::kAdMobErrorNone) {
+          LogMessage("ERROR: %s ad failed to initialize: %d, `%s`",
+                     name_.c_str(), slot->future.error(),
+                     slot->future.error_message());
+          stats_.failures++;
+          RemoveSlot(i, true, lock);
+          continue;
+        }
+        LoadAd(slot, lock);
+        break;
+      case kSlotLoading:
+        // Wait for the completion callback, which timestamps the load. An
+        // invalid Future never calls back.
+        if (slot->loaded_us == 0 &&
+            slot->future.status() != firebase::kFutureStatusInvalid) {
+          break;
+        }
+        if (slot->loaded_us == 0) slot->loaded_us = now_us;
+        load_latency_.Record(slot->loaded_us - slot->load_start_us);
+        if (slot->future.error() != admob::kAdMobErrorNone) {
+          LogMessage("%s ad failed to load: %d, `%s`", name_.c_str(),
+                     slot->future.error(), slot->future.error_message());
+          stats_.failures++;
+          RemoveSlot(i, true, lock);
+          continue;
+        }
+        stats_.fills++;
+        retry_ms_ = options_.initial_retry_ms;
+        slot->state = kSlotReady;
+        ready_events_.Signal();
+        break;
+      case kSlotReady:
+        if (now_us - slot->loaded_us > options_.max_age_ms * 1000LL) {
+          stats_.expired++;
+          RemoveSlot(i, false, lock);
+          continue;
+        }
+        break;
+      case kSlotShowRequested:
+        break;
+      case kSlotShowing: {
+        if (pending) break;
+        lock->unlock();
+        bool hidden = slot->ad->hidden();
+        lock->lock();
+        if (!hidden) break;
+        if (slot->ad->reusable()) {
+          LoadAd(slot, lock);
+        } else {
+          RemoveSlot(i, false, lock);
+          continue;
+        }
+        break;
+      }
+    }
+    ++i;
+  }
+
+  // Refill the pool.
+  while (slots_.size() < options_.size && !stopping_ &&
+         GetMonotonicTimeInMicroseconds() >= retry_at_us_) {
+    lock->unlock();
+    std::unique_ptr<Slot> slot(new Slot);
+    slot->ad.reset(factory_());
+    slot->state = kSlotInitializing;
+    slot->future = slot->ad->Initialize();
+    slot->load_start_us = 0;
+    slot->loaded_us = 0;
+    lock->lock();
+    slots_.push_back(std::move(slot));
+  }
+}
+
+void AdPool::LoadAd(Slot* slot, std::unique_lock<std::mutex>* lock) {
+  stats_.requests++;
+  slot->state = kSlotLoading;
+  slot->load_start_us = GetMonotonicTimeInMicroseconds();
+  slot->loaded_us = 0;
+  lock->unlock();
+  // Hold the request until LoadAd() returns, in case the targeting changes.
+  std::shared_ptr<const PrebuiltAdRequest> request = requests_->request();
+  firebase::Future<void> future = slot->ad->LoadAd(request->request());
+  // Registered without holding mutex_, as a Future that has already
+  // completed runs the callback immediately.
+  future.OnCompletion([this, slot](const firebase::Future<void>&) {
+    int64_t now_us = GetMonotonicTimeInMicroseconds();
+    std::lock_guard<std::mutex> callback_lock(mutex_);
+    slot->loaded_us = now_us;
+    update_requested_ = true;
+    condition_.notify_all();
+  });
+  lock->lock();
+  slot->future = future;
+}
+
+void AdPool::RemoveSlot(size_t index, bool failed,
+                        std::unique_lock<std::mutex>* lock) {
+  std::unique_ptr<Slot> slot = std::move(slots_[index]);
+  slots_.erase(slots_.begin() + index);
+  if (failed) {
+    retry_at_us_ = GetMonotonicTimeInMicroseconds() + retry_ms_ * 1000LL;
+    retry_ms_ = std::min(retry_ms_ * 2, options_.max_retry_ms);
+  }
+  lock->unlock();
+  slot.reset();
+  lock->lock();
+}
+
+}  // namespace admob_testapp
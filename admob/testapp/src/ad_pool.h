@@ -0,0 +1,215 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_AD_POOL_H_  // NOLINT
+#define FIREBASE_TESTAPP_AD_POOL_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>  // NOLINT
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "firebase/admob.h"
+#include "firebase/admob/interstitial_ad.h"
+#include "firebase/admob/rewarded_video.h"
+#include "firebase/admob/types.h"
+#include "firebase/future.h"
+
+// Thin OS abstraction layer.
+#include "ad_request_cache.h"  // NOLINT
+#include "future_wait.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+namespace admob_testapp {
+
+// A full screen ad that an AdPool can load and show, wrapping the different
+// APIs of InterstitialAd and rewarded_video.
+class PreloadedAd {
+ public:
+  virtual ~PreloadedAd() {}
+
+  virtual firebase::Future<void> Initialize() = 0;
+  virtual firebase::Future<void> LoadAd(
+      const firebase::admob::AdRequest& request) = 0;
+  virtual firebase::Future<void> Show() = 0;
+  // Whether the ad isn't on screen.
+  virtual bool hidden() const = 0;
+  // Whether another ad can be loaded once this one has been shown.
+  // InterstitialAds can only be shown once.
+  virtual bool reusable() const = 0;
+};
+
+// Create an InterstitialAd for `ad_unit`, reporting changes to `listener` if
+// it's non-null.
+PreloadedAd* NewInterstitialAd(
+    firebase::admob::AdParent parent, const char* ad_unit,
+    firebase::admob::InterstitialAd::Listener* listener);
+
+// Wrap the rewarded_video singleton, initializing it for `ad_unit`. Only one
+// can exist at a time, and it calls rewarded_video::Destroy() when deleted.
+PreloadedAd* NewRewardedVideoAd(
+    firebase::admob::AdParent parent, const char* ad_unit,
+    firebase::admob::rewarded_video::Listener* listener);
+
+// Configuration of an AdPool.
+struct AdPoolOptions {
+  AdPoolOptions()
+      : size(1),
+        max_age_ms(55 * 60 * 1000),
+        initial_retry_ms(5000),
+        max_retry_ms(5 * 60 * 1000) {}
+
+  // Ads kept loaded. Must be 1 for rewarded videos.
+  size_t size;
+  // Age after which a loaded ad is discarded and replaced. AdMob doesn't
+  // serve impressions for ads loaded more than an hour before.
+  int max_age_ms;
+  // Delay before retrying after an ad fails to initialize or load, doubled
+  // after each consecutive failure up to max_retry_ms.
+  int initial_retry_ms;
+  int max_retry_ms;
+};
+
+// Counters of an AdPool.
+struct AdPoolStats {
+  AdPoolStats()
+      : requests(0), fills(0), failures(0), expired(0), shows(0), misses(0) {}
+
+  // Fraction of completed loads that returned an ad, 0 if none completed.
+  double fill_rate() const {
+    return fills + failures > 0 ? static_cast<double>(fills) /
+                                      (fills + failures)
+                                : 0.0;
+  }
+
+  // LoadAd() calls.
+  int requests;
+  // Loads that returned an ad.
+  int fills;
+  // Loads that failed, including ads that failed to initialize.
+  int failures;
+  // Loaded ads discarded because they were older than max_age_ms.
+  int expired;
+  int shows;
+  // Show() calls made while no ad was ready.
+  int misses;
+};
+
+// Keeps `size` full screen ads of an ad unit loaded, so the app can show one
+// as soon as it wants to rather than waiting for LoadAd().
+//
+// A background thread initializes and loads the ads, replaces ads that
+// expire and, once an ad has been shown and closed, loads the next one. The
+// pool never calls the SDK while holding its lock, so SDK calls that are
+// handed to the main thread can't deadlock with the app calling Show().
+class AdPool {
+ public:
+  typedef std::function<PreloadedAd*()> Factory;
+
+  // `factory` creates each ad. Each load uses the current request of
+  // `requests`, so a change of targeting applies from the next ad loaded.
+  // `requests` must outlive the pool and have a request before Start().
+  AdPool(const char* name, const Factory& factory,
+         const AdRequestCache* requests, const AdPoolOptions& options);
+  ~AdPool();
+
+  // Start loading ads in the background.
+  void Start();
+  // Stop the background thread and delete the pool's ads. Must be called
+  // before admob::Terminate().
+  void Stop();
+
+  // Whether an ad is loaded and can be shown.
+  bool ready() const;
+  // Wait up to `timeout_ms` for ready(), processing platform events
+  // meanwhile. Returns ready().
+  bool WaitForReady(int timeout_ms);
+  // Show the oldest loaded ad, returning the result of its Show(), or an
+  // invalid Future if no ad was ready.
+  firebase::Future<void> Show();
+  // Whether an ad shown by Show() is still on screen.
+  bool showing() const;
+
+  const char* name() const { return name_.c_str(); }
+  AdPoolStats stats() const;
+  // Time taken by each completed LoadAd().
+  const app_framework::LatencyHistogram& load_latency() const {
+    return load_latency_;
+  }
+  // Log the counters, fill rate and load latency.
+  void LogStats() const;
+
+ private:
+  enum SlotState {
+    kSlotInitializing = 0,
+    kSlotLoading,
+    kSlotReady,
+    // Show() is calling the SDK.
+    kSlotShowRequested,
+    kSlotShowing,
+  };
+
+  struct Slot {
+    std::unique_ptr<PreloadedAd> ad;
+    SlotState state;
+    // The pending Initialize(), LoadAd() or Show().
+    firebase::Future<void> future;
+    int64_t load_start_us;
+    // When the pending LoadAd() completed, 0 until its completion callback
+    // runs.
+    int64_t loaded_us;
+  };
+
+  AdPool(const AdPool&) = delete;
+  AdPool& operator=(const AdPool&) = delete;
+
+  static void* RunThread(void* data);
+  void Run();
+  // Advance each slot and refill the pool. Unlocks `lock` around SDK calls.
+  void Update(std::unique_lock<std::mutex>* lock);
+  void LoadAd(Slot* slot, std::unique_lock<std::mutex>* lock);
+  // Delete the slot at `index`, retrying after a delay if it failed.
+  void RemoveSlot(size_t index, bool failed,
+                  std::unique_lock<std::mutex>* lock);
+
+  std::string name_;
+  Factory factory_;
+  const AdRequestCache* requests_;
+  AdPoolOptions options_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  bool running_;
+  bool stopping_;
+  // Set by a load's completion callback to wake the background thread.
+  bool update_requested_;
+  // Only added and removed by the background thread, Show() only changes the
+  // state of a ready slot.
+  std::vector<std::unique_ptr<Slot>> slots_;
+  int64_t retry_at_us_;
+  int retry_ms_;
+  AdPoolStats stats_;
+  app_framework::LatencyHistogram load_latency_;
+  // Signaled when an ad becomes ready, to wake WaitForReady().
+  app_framework::EventCounter ready_events_;
+};
+
+}  // namespace admob_testapp
+
+#endif  // FIREBASE_TESTAPP_AD_POOL_H_  // NOLINT
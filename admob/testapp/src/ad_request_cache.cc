@@ -0,0 +1,153 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ad_request_cache.h"  // NOLINT
+
+#include <algorithm>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "firebase/admob/types.h"
+
+namespace admob = ::firebase::admob;
+
+namespace admob_testapp {
+
+namespace {
+
+bool IsLeapYear(int year) {
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+bool IsValidBirthday(int day, int month, int year) {
+  static const int kDaysInMonth[] = {31, 28, 31, 30, 31, 30,
+                                     31, 31, 30, 31, 30, 31};
+  if (day == 0 && month == 0 && year == 0) return true;
+  if (year < 1900 || month < 1 || month > 12 || day < 1) return false;
+  int days = kDaysInMonth[month - 1] + (month == 2 && IsLeapYear(year));
+  return day <= days;
+}
+
+void SetError(std::string* error, const std::string& message) {
+  if (error) *error = message;
+}
+
+}  // namespace
+
+bool AdTargeting::operator==(const AdTargeting& other) const {
+  return gender == other.gender &&
+         child_directed_treatment == other.child_directed_treatment &&
+         birthday_day == other.birthday_day &&
+         birthday_month == other.birthday_month &&
+         birthday_year == other.birthday_year && keywords == other.keywords &&
+         extras == other.extras && test_device_ids == other.test_device_ids;
+}
+
+PrebuiltAdRequest::PrebuiltAdRequest(const AdTargeting& targeting)
+    : targeting_(targeting) {
+  for (size_t i = 0; i < targeting_.keywords.size(); ++i) {
+    keywords_.push_back(targeting_.keywords[i].c_str());
+  }
+  for (size_t i = 0; i < targeting_.extras.size(); ++i) {
+    admob::KeyValuePair extra;
+    extra.key = targeting_.extras[i].first.c_str();
+    extra.value = targeting_.extras[i].second.c_str();
+    extras_.push_back(extra);
+  }
+  for (size_t i = 0; i < targeting_.test_device_ids.size(); ++i) {
+    test_device_ids_.push_back(targeting_.test_device_ids[i].c_str());
+  }
+
+  request_.gender = targeting_.gender;
+  request_.tagged_for_child_directed_treatment =
+      targeting_.child_directed_treatment;
+  request_.birthday_day = targeting_.birthday_day;
+  request_.birthday_month = targeting_.birthday_month;
+  request_.birthday_year = targeting_.birthday_year;
+  request_.keyword_count = static_cast<unsigned int>(keywords_.size());
+  request_.keywords = keywords_.empty() ? nullptr : keywords_.data();
+  request_.extras_count = static_cast<unsigned int>(extras_.size());
+  request_.extras = extras_.empty() ? nullptr : extras_.data();
+  request_.test_device_id_count =
+      static_cast<unsigned int>(test_device_ids_.size());
+  request_.test_device_ids =
+      test_device_ids_.empty() ? nullptr : test_device_ids_.data();
+}
+
+std::shared_ptr<const PrebuiltAdRequest> PrebuiltAdRequest::Build(
+    const AdTargeting& targeting, std::string* error) {
+  if (!IsValidBirthday(targeting.birthday_day, targeting.birthday_month,
+                       targeting.birthday_year)) {
+    SetError(error, "Invalid birthday");
+    return nullptr;
+  }
+  AdTargeting validated = targeting;
+  validated.keywords.clear();
+  for (size_t i = 0; i < targeting.keywords.size(); ++i) {
+    const std::string& keyword = targeting.keywords[i];
+    if (keyword.empty()) {
+      SetError(error, "Empty keyword");
+      return nullptr;
+    }
+    if (std::find(validated.keywords.begin(), validated.keywords.end(),
+                  keyword) == validated.keywords.end()) {
+      validated.keywords.push_back(keyword);
+    }
+  }
+  for (size_t i = 0; i < targeting.extras.size(); ++i) {
+    if (targeting.extras[i].first.empty()) {
+      SetError(error, "Empty extra key");
+      return nullptr;
+    }
+  }
+  for (size_t i = 0; i < targeting.test_device_ids.size(); ++i) {
+    if (targeting.test_device_ids[i].empty()) {
+      SetError(error, "Empty test device ID");
+      return nullptr;
+    }
+  }
+  return std::shared_ptr<const PrebuiltAdRequest>(
+      new PrebuiltAdRequest(validated));
+}
+
+bool AdRequestCache::SetTargeting(const AdTargeting& targeting,
+                                  std::string* error) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (request_ && targeting_ == targeting) return true;
+  }
+  // Build outside the lock, so request() never waits for a build.
+  std::shared_ptr<const PrebuiltAdRequest> request =
+      PrebuiltAdRequest::Build(targeting, error);
+  if (!request) return false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  targeting_ = targeting;
+  request_ = request;
+  builds_++;
+  return true;
+}
+
+std::shared_ptr<const PrebuiltAdRequest> AdRequestCache::request() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return request_;
+}
+
+int AdRequestCache::builds() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return builds_;
+}
+
+}  // namespace admob_testapp
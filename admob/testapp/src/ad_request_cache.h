@@ -0,0 +1,115 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_AD_REQUEST_CACHE_H_  // NOLINT
+#define FIREBASE_TESTAPP_AD_REQUEST_CACHE_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "firebase/admob/types.h"
+
+namespace admob_testapp {
+
+// Targeting information of ad requests, typically derived from the user's
+// profile. Unlike an AdRequest it owns its strings.
+struct AdTargeting {
+  AdTargeting()
+      : gender(firebase::admob::kGenderUnknown),
+        child_directed_treatment(
+            firebase::admob::kChildDirectedTreatmentStateUnknown),
+        birthday_day(0),
+        birthday_month(0),
+        birthday_year(0) {}
+
+  bool operator==(const AdTargeting& other) const;
+  bool operator!=(const AdTargeting& other) const { return !(*this == other); }
+
+  firebase::admob::Gender gender;
+  firebase::admob::ChildDirectedTreatmentState child_directed_treatment;
+  // All 0 if the birthday is unknown. Months are indexed from one.
+  int birthday_day;
+  int birthday_month;
+  int birthday_year;
+  std::vector<std::string> keywords;
+  std::vector<std::pair<std::string, std::string>> extras;
+  std::vector<std::string> test_device_ids;
+};
+
+// An AdRequest built once from an AdTargeting, together with the arrays and
+// strings it points at. It's immutable, so one instance can be shared by any
+// number of LoadAd() calls, on any thread.
+class PrebuiltAdRequest {
+ public:
+  // Validate `targeting` and build its AdRequest. Returns nullptr, setting
+  // `error` if it's non-null, when a field is invalid: a birthday that isn't
+  // a date or is partially set, or an empty keyword, extra key or test device
+  // ID. Duplicate keywords are dropped.
+  static std::shared_ptr<const PrebuiltAdRequest> Build(
+      const AdTargeting& targeting, std::string* error = nullptr);
+
+  const firebase::admob::AdRequest& request() const { return request_; }
+  const AdTargeting& targeting() const { return targeting_; }
+
+ private:
+  explicit PrebuiltAdRequest(const AdTargeting& targeting);
+
+  PrebuiltAdRequest(const PrebuiltAdRequest&) = delete;
+  PrebuiltAdRequest& operator=(const PrebuiltAdRequest&) = delete;
+
+  AdTargeting targeting_;
+  // Point into targeting_.
+  std::vector<const char*> keywords_;
+  std::vector<firebase::admob::KeyValuePair> extras_;
+  std::vector<const char*> test_device_ids_;
+  firebase::admob::AdRequest request_;
+};
+
+// Holds the PrebuiltAdRequest for the current targeting, rebuilding it only
+// when the targeting changes. Callers keep the shared_ptr returned by
+// request() for as long as they use the AdRequest, so a change of targeting
+// never invalidates a request being loaded.
+class AdRequestCache {
+ public:
+  AdRequestCache() : builds_(0) {}
+
+  // Use `targeting` for the following requests. Returns false, keeping the
+  // current request, if it's invalid, see PrebuiltAdRequest::Build(). Setting
+  // the current targeting again does nothing.
+  bool SetTargeting(const AdTargeting& targeting,
+                    std::string* error = nullptr);
+
+  // The request for the current targeting, nullptr until SetTargeting()
+  // succeeds.
+  std::shared_ptr<const PrebuiltAdRequest> request() const;
+
+  // Number of requests built.
+  int builds() const;
+
+ private:
+  mutable std::mutex mutex_;
+  // As passed to SetTargeting(), before duplicate keywords were dropped.
+  AdTargeting targeting_;
+  std::shared_ptr<const PrebuiltAdRequest> request_;
+  int builds_;
+};
+
+}  // namespace admob_testapp
+
+#endif  // FIREBASE_TESTAPP_AD_REQUEST_CACHE_H_  // NOLINT
@@ -12,6 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stddef.h>
+
+#include <string>
+#include <utility>
+
 #include "firebase/admob.h"
 #include "firebase/admob/banner_view.h"
 #include "firebase/admob/interstitial_ad.h"
@@ -21,7 +26,16 @@
 #include "firebase/future.h"
 
 // Thin OS abstraction layer.
+#include "ad_pool.h"  // NOLINT
+#include "ad_request_cache.h"  // NOLINT
+#include "future_wait.h"  // NOLINT
 #include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetWindowContext;
+using app_framework::LogMessage;
+using app_framework::ProcessEvents;
+using app_framework::WaitForFuture;
 
 // A simple listener that logs changes to a BannerView.
 class LoggingBannerViewListener : public firebase::admob::BannerView::Listener {
@@ -107,12 +121,11 @@ static const int kBirthdayDay = 10;
 static const int kBirthdayMonth = 11;
 static const int kBirthdayYear = 1976;
 
+// Time allowed for a preloaded ad to become ready before it's shown.
+static const int kAdReadyTimeoutMs = 30000;
+
 static void WaitForFutureCompletion(firebase::FutureBase future) {
-  while (!ProcessEvents(1000)) {
-    if (future.status() != firebase::kFutureStatusPending) {
-      break;
-    }
-  }
+  WaitForFuture(future);
 
   if (future.error() != firebase::admob::kAdMobErrorNone) {
     LogMessage("ERROR: Action failed with error code %d and message \"%s\".",
@@ -126,7 +139,8 @@ extern "C" int common_main(int argc, const char* argv[]) {
   LogMessage("Initializing the AdMob library.");
 
 #if defined(__ANDROID__)
-  app = ::firebase::App::Create(GetJniEnv(), GetActivity());
+  app = ::firebase::App::Create(app_framework::GetJniEnv(),
+                                app_framework::GetActivity());
 #else
   app = ::firebase::App::Create();
 #endif  // defined(__ANDROID__)
@@ -137,33 +151,39 @@ extern "C" int common_main(int argc, const char* argv[]) {
   LogMessage("Initializing the AdMob with Firebase API.");
   firebase::admob::Initialize(*app, kAdMobAppID);
 
-  firebase::admob::AdRequest request;
+  // The targeting information of every ad request. The AdRequest is built
+  // from it once and shared by every LoadAd() call, rather than being
+  // assembled for each request.
+  admob_testapp::AdTargeting targeting;
   // If the app is aware of the user's gender, it can be added to the targeting
   // information. Otherwise, "unknown" should be used.
-  request.gender = firebase::admob::kGenderUnknown;
+  targeting.gender = firebase::admob::kGenderUnknown;
 
   // This value allows publishers to specify whether they would like the request
   // to be treated as child-directed for purposes of the Children’s Online
   // Privacy Protection Act (COPPA).
   // See http://business.ftc.gov/privacy-and-security/childrens-privacy.
-  request.tagged_for_child_directed_treatment =
+  targeting.child_directed_treatment =
       firebase::admob::kChildDirectedTreatmentStateTagged;
 
   // The user's birthday, if known. Note that months are indexed from one.
-  request.birthday_day = kBirthdayDay;
-  request.birthday_month = kBirthdayMonth;
-  request.birthday_year = kBirthdayYear;
+  targeting.birthday_day = kBirthdayDay;
+  targeting.birthday_month = kBirthdayMonth;
+  targeting.birthday_year = kBirthdayYear;
 
   // Additional keywords to be used in targeting.
-  request.keyword_count = sizeof(kKeywords) / sizeof(kKeywords[0]);
-  request.keywords = kKeywords;
+  targeting.keywords.assign(
+      kKeywords, kKeywords + sizeof(kKeywords) / sizeof(kKeywords[0]));
 
   // "Extra" key value pairs can be added to the request as well. Typically
   // these are used when testing new features.
   static const firebase::admob::KeyValuePair kRequestExtras[] = {
       {"the_name_of_an_extra", "the_value_for_that_extra"}};
-  request.extras_count = sizeof(kRequestExtras) / sizeof(kRequestExtras[0]);
-  request.extras = kRequestExtras;
+  for (size_t i = 0; i < sizeof(kRequestExtras) / sizeof(kRequestExtras[0]);
+       ++i) {
+    targeting.extras.push_back(
+        std::make_pair(kRequestExtras[i].key, kRequestExtras[i].value));
+  }
 
   // This example uses ad units that are specially configured to return test ads
   // for every request. When using your own ad unit IDs, however, it's important
@@ -173,9 +193,40 @@ extern "C" int common_main(int argc, const char* argv[]) {
   //
   // Device IDs can be obtained by checking the logcat or the Xcode log while
   // debugging. They appear as a long string of hex characters.
-  request.test_device_id_count =
-      sizeof(kTestDeviceIDs) / sizeof(kTestDeviceIDs[0]);
-  request.test_device_ids = kTestDeviceIDs;
+  targeting.test_device_ids.assign(
+      kTestDeviceIDs,
+      kTestDeviceIDs + sizeof(kTestDeviceIDs) / sizeof(kTestDeviceIDs[0]));
+
+  admob_testapp::AdRequestCache requests;
+  std::string targeting_error;
+  if (!requests.SetTargeting(targeting, &targeting_error)) {
+    LogMessage("ERROR: Invalid ad targeting: %s", targeting_error.c_str());
+    return 1;
+  }
+
+  // Preload an interstitial and a rewarded video in the background while the
+  // banner is being tested, so they can be shown without waiting for LoadAd().
+  // Each pool loads the next ad once the previous one has been shown.
+  LoggingInterstitialAdListener interstitial_listener;
+  LoggingRewardedVideoListener rewarded_listener;
+  admob_testapp::AdPoolOptions pool_options;
+  admob_testapp::AdPool interstitial_pool(
+      "Interstitial",
+      [&interstitial_listener]() {
+        return admob_testapp::NewInterstitialAd(
+            GetWindowContext(), kInterstitialAdUnit, &interstitial_listener);
+      },
+      &requests, pool_options);
+  admob_testapp::AdPool rewarded_pool(
+      "Rewarded video",
+      [&rewarded_listener]() {
+        return admob_testapp::NewRewardedVideoAd(
+            GetWindowContext(), kRewardedVideoAdUnit, &rewarded_listener);
+      },
+      &requests, pool_options);
+  LogMessage("Preloading interstitial and rewarded video ads.");
+  interstitial_pool.Start();
+  rewarded_pool.Start();
 
   // Create an ad size for the BannerView.
   firebase::admob::AdSize banner_ad_size;
@@ -195,7 +246,7 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
   // Load the banner ad.
   LogMessage("Loading a banner ad.");
-  banner->LoadAd(request);
+  banner->LoadAd(requests.request()->request());
 
   WaitForFutureCompletion(banner->LoadAdLastResult());
 
@@ -274,61 +325,35 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
   WaitForFutureCompletion(banner->HideLastResult());
 
-  // Create and test InterstitialAd.
-  LogMessage("Creating the InterstitialAd.");
-  firebase::admob::InterstitialAd* interstitial =
-      new firebase::admob::InterstitialAd();
-  interstitial->Initialize(GetWindowContext(), kInterstitialAdUnit);
-
-  WaitForFutureCompletion(interstitial->InitializeLastResult());
-
-  // Set the listener.
-  LoggingInterstitialAdListener interstitial_listener;
-  interstitial->SetListener(&interstitial_listener);
-
-  // When the InterstitialAd is initialized, load an ad.
-  LogMessage("Loading an interstitial ad.");
-  interstitial->LoadAd(request);
-
-  WaitForFutureCompletion(interstitial->LoadAdLastResult());
-
-  // When the InterstitialAd has loaded an ad, show it.
-  LogMessage("Showing the interstitial ad.");
-  interstitial->Show();
-
-  WaitForFutureCompletion(interstitial->ShowLastResult());
-
-  // Wait for the user to close the interstitial.
-  while (interstitial->presentation_state() !=
-         firebase::admob::InterstitialAd::PresentationState::
-             kPresentationStateHidden) {
-    ProcessEvents(1000);
+  // Show an InterstitialAd from the pool.
+  LogMessage("Showing a preloaded interstitial ad.");
+  int64_t show_start_us = app_framework::GetMonotonicTimeInMicroseconds();
+  if (interstitial_pool.WaitForReady(kAdReadyTimeoutMs)) {
+    WaitForFutureCompletion(interstitial_pool.Show());
+    LogMessage("Interstitial ad shown after %.1f ms.",
+               (app_framework::GetMonotonicTimeInMicroseconds() -
+                show_start_us) /
+                   1000.0);
+
+    // Wait for the user to close the interstitial.
+    while (interstitial_pool.showing()) {
+      ProcessEvents(1000);
+    }
+  } else {
+    LogMessage("ERROR: No interstitial ad was loaded.");
   }
 
-  // Start up rewarded video ads and associated mediation adapters.
-  LogMessage("Initializing rewarded video.");
+  // Show a rewarded video from the pool. If the user watches all the way
+  // through, the LoggingRewardedVideoListener will log a reward!
   namespace rewarded_video = firebase::admob::rewarded_video;
-  rewarded_video::Initialize();
-
-  WaitForFutureCompletion(rewarded_video::InitializeLastResult());
-
-  LogMessage("Setting rewarded video listener.");
-  LoggingRewardedVideoListener rewarded_listener;
-  rewarded_video::SetListener(&rewarded_listener);
-
-  LogMessage("Loading a rewarded video ad.");
-  rewarded_video::LoadAd(kRewardedVideoAdUnit, request);
-
-  WaitForFutureCompletion(rewarded_video::LoadAdLastResult());
-
-  // If an ad has loaded, show it. If the user watches all the way through, the
-  // LoggingRewardedVideoListener will log a reward!
-  if (rewarded_video::LoadAdLastResult().error() ==
-      firebase::admob::kAdMobErrorNone) {
-    LogMessage("Showing a rewarded video ad.");
-    rewarded_video::Show(GetWindowContext());
-
-    WaitForFutureCompletion(rewarded_video::ShowLastResult());
+  LogMessage("Showing a preloaded rewarded video ad.");
+  show_start_us = app_framework::GetMonotonicTimeInMicroseconds();
+  if (rewarded_pool.WaitForReady(kAdReadyTimeoutMs)) {
+    WaitForFutureCompletion(rewarded_pool.Show());
+    LogMessage("Rewarded video ad shown after %.1f ms.",
+               (app_framework::GetMonotonicTimeInMicroseconds() -
+                show_start_us) /
+                   1000.0);
 
     // Normally Pause and Resume would be called in response to the app pausing
     // or losing focus. This is just a test.
@@ -341,6 +366,8 @@ extern "C" int common_main(int argc, const char* argv[]) {
     rewarded_video::Resume();
 
     WaitForFutureCompletion(rewarded_video::ResumeLastResult());
+  } else {
+    LogMessage("ERROR: No rewarded video ad was loaded.");
   }
 
   LogMessage("Done!");
@@ -349,9 +376,13 @@ extern "C" int common_main(int argc, const char* argv[]) {
   while (!ProcessEvents(1000)) {
   }
 
+  interstitial_pool.Stop();
+  rewarded_pool.Stop();
+  interstitial_pool.LogStats();
+  rewarded_pool.LogStats();
+  LogMessage("Built %d ad request(s).", requests.builds());
+
   delete banner;
-  delete interstitial;
-  rewarded_video::Destroy();
   firebase::admob::Terminate();
   delete app;
 
@@ -19,7 +19,29 @@
 #include "firebase/app.h"
 
 // Thin OS abstraction layer.
+#include "event_queue.h"  // NOLINT
+#include "event_schema.h"  // NOLINT
+#include "future_wait.h"  // NOLINT
 #include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::LogMessage;
+using app_framework::ProcessEvents;
+using app_framework::WaitForFuture;
+using analytics_testapp::EventParameter;
+using analytics_testapp::EventQueue;
+using analytics_testapp::NameId;
+using analytics_testapp::ParameterName;
+
+// Events with parameters logged by the testapp. A typo that makes Analytics
+// drop an event, such as an invalid character in a name, fails to compile.
+ANALYTICS_EVENT_SCHEMA(kLevelUpEvent, "level_up",
+                       ParameterName<int64_t>("level"),
+                       ParameterName<const char*>("character"),
+                       ParameterName<double>("hit_accuracy"));
+
+// Number of events logged through the EventQueue in a single burst.
+const int kEventBurstSize = 1000;
 
 // Execute all methods of the C++ Analytics API.
 extern "C" int common_main(int argc, const char* argv[]) {
@@ -28,7 +50,8 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
   LogMessage("Initialize the Analytics library");
 #if defined(__ANDROID__)
-  app = ::firebase::App::Create(GetJniEnv(), GetActivity());
+  app = ::firebase::App::Create(app_framework::GetJniEnv(),
+                                app_framework::GetActivity());
 #else
   app = ::firebase::App::Create();
 #endif  // defined(__ANDROID__)
@@ -47,9 +70,7 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
   LogMessage("Get App Instance ID...");
   auto future_result = analytics::GetAnalyticsInstanceId();
-  while (future_result.status() == firebase::kFutureStatusPending) {
-    if (ProcessEvents(1000)) break;
-  }
+  WaitForFuture(future_result);
   if (future_result.status() == firebase::kFutureStatusComplete) {
     LogMessage("Analytics Instance ID %s", future_result.result()->c_str());
   } else {
@@ -85,17 +106,76 @@ extern "C" int common_main(int argc, const char* argv[]) {
   analytics::LogEvent(analytics::kEventJoinGroup, analytics::kParameterGroupID,
                       "spoon_welders");
 
-  // Log an event with multiple parameters.
+  // Log an event with multiple parameters, declared by a schema.
   LogMessage("Log level up event.");
+  kLevelUpEvent.Log(5, "mrspoon", 3.14);
+
+  // Log a burst of events through the queue, which dispatches them on a
+  // worker thread so the thread logging them isn't blocked by the SDK.
+  LogMessage("Log %d events through the event queue.", kEventBurstSize);
   {
-    const analytics::Parameter kLevelUpParameters[] = {
-        analytics::Parameter(analytics::kParameterLevel, 5),
-        analytics::Parameter(analytics::kParameterCharacter, "mrspoon"),
-        analytics::Parameter("hit_accuracy", 3.14f),
-    };
-    analytics::LogEvent(
-        analytics::kEventLevelUp, kLevelUpParameters,
-        sizeof(kLevelUpParameters) / sizeof(kLevelUpParameters[0]));
+    // Sized to hold the whole burst, smaller queues drop what doesn't fit.
+    EventQueue queue(kEventBurstSize);
+    const NameId kLogin = queue.Intern(analytics::kEventLogin);
+    const NameId kProgress = queue.Intern("progress");
+    const NameId kPercent = queue.Intern("percent");
+    const NameId kPostScore = queue.Intern(analytics::kEventPostScore);
+    const NameId kScore = queue.Intern(analytics::kParameterScore);
+    const NameId kLevelUp = queue.Intern(analytics::kEventLevelUp);
+    const NameId kLevel = queue.Intern(analytics::kParameterLevel);
+    const NameId kCharacter = queue.Intern(analytics::kParameterCharacter);
+    const NameId kHitAccuracy = queue.Intern("hit_accuracy");
+
+    int64_t start_us = app_framework::GetMonotonicTimeInMicroseconds();
+    for (int i = 0; i < kEventBurstSize; ++i) {
+      switch (i % 4) {
+        case 0:
+          queue.LogEvent(kLogin);
+          break;
+        case 1: {
+          const double percent = static_cast<double>(i) / kEventBurstSize;
+          const EventParameter kProgressParameters[] = {
+              EventParameter(kPercent, percent),
+          };
+          queue.LogEvent(kProgress, kProgressParameters, 1);
+          break;
+        }
+        case 2: {
+          const EventParameter kPostScoreParameters[] = {
+              EventParameter(kScore, i),
+          };
+          queue.LogEvent(kPostScore, kPostScoreParameters, 1);
+          break;
+        }
+        case 3: {
+          const EventParameter kLevelUpParameters[] = {
+              EventParameter(kLevel, i / 4),
+              EventParameter(kCharacter, "mrspoon"),
+              EventParameter(kHitAccuracy, 3.14),
+          };
+          queue.LogEvent(
+              kLevelUp, kLevelUpParameters,
+              sizeof(kLevelUpParameters) / sizeof(kLevelUpParameters[0]));
+          break;
+        }
+      }
+    }
+    int64_t enqueue_us =
+        app_framework::GetMonotonicTimeInMicroseconds() - start_us;
+    queue.Flush();
+    int64_t flush_us =
+        app_framework::GetMonotonicTimeInMicroseconds() - start_us;
+
+    analytics_testapp::EventQueueStats stats = queue.stats();
+    LogMessage("Queued %lld events in %.1f us (%.2f us per event), "
+               "dispatched in %.1f ms.",
+               static_cast<long long>(stats.queued),  // NOLINT
+               static_cast<double>(enqueue_us),
+               enqueue_us / static_cast<double>(kEventBurstSize),
+               flush_us / 1000.0);
+    LogMessage("Dropped %lld events, most queued at once %lld.",
+               static_cast<long long>(stats.dropped),  // NOLINT
+               static_cast<long long>(stats.max_depth));  // NOLINT
   }
 
   LogMessage("Complete");
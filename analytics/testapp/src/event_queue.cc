@@ -0,0 +1,265 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "event_queue.h"  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "firebase/analytics.h"
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+
+namespace analytics = ::firebase::analytics;
+
+namespace analytics_testapp {
+
+namespace {
+
+// Most names that can be interned.
+const int kMaxNames = 256;
+
+// How long the worker waits for more events once the queue is empty, which
+// also batches the events it dispatches at a time.
+const int kDispatchIntervalMs = 50;
+
+}  // namespace
+
+EventQueue::EventQueue(size_t slot_count)
+    : enqueue_position_(0),
+      dequeue_position_(0),
+      dispatched_count_(0),
+      names_(new std::string[kMaxNames]),
+      name_count_(0),
+      dropped_(0),
+      max_depth_(0),
+      dispatched_position_(0),
+      running_(true),
+      stopping_(false) {
+  size_t capacity = 1;
+  while (capacity < slot_count) capacity <<= 1;
+  slots_.reset(new EventSlot[capacity]);
+  slot_mask_ = capacity - 1;
+  for (size_t i = 0; i < capacity; ++i) slots_[i].sequence = i;
+  app_framework::RunOnBackgroundThread(RunThread, this);
+}
+
+EventQueue::~EventQueue() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  stopping_ = true;
+  condition_.notify_all();
+  while (running_) condition_.wait(lock);
+}
+
+NameId EventQueue::Intern(const char* name) {
+  std::lock_guard<std::mutex> lock(names_mutex_);
+  int count = name_count_.load(std::memory_order_relaxed);
+  for (int i = 0; i < count; ++i) {
+    if (names_[i] == name) return i;
+  }
+  if (count == kMaxNames) return -1;
+  names_[count] = name;
+  name_count_.store(count + 1, std::memory_order_release);
+  return count;
+}
+
+const char* EventQueue::name(NameId id) const {
+  return id >= 0 && id < name_count_.load(std::memory_order_acquire)
+             ? names_[id].c_str()
+             : nullptr;
+}
+
+bool EventQueue::LogEvent(NameId event, const EventParameter* parameters,
+                          size_t parameter_count) {
+  int name_count = name_count_.load(std::memory_order_acquire);
+  bool valid = event >= 0 && event < name_count &&
+               parameter_count <= kMaxEventParameters;
+  for (size_t i = 0; valid && i < parameter_count; ++i) {
+    valid = parameters[i].name >= 0 && parameters[i].name < name_count;
+  }
+  if (!valid) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // Claim a slot, as AsyncLogger::Append() does, but drop the event rather
+  // than wait when the queue is full.
+  size_t position = enqueue_position_.load(std::memory_order_relaxed);
+  EventSlot* slot;
+  while (true) {
+    slot = &slots_[position & slot_mask_];
+    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    intptr_t difference =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+    if (difference == 0) {
+      if (enqueue_position_.compare_exchange_weak(position, position + 1,
+                                                  std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      position = enqueue_position_.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->event = event;
+  slot->parameter_count = static_cast<uint16_t>(parameter_count);
+  size_t string_bytes = 0;
+  for (size_t i = 0; i < parameter_count; ++i) {
+    const EventParameter& parameter = parameters[i];
+    QueuedParameter& queued = slot->parameters[i];
+    queued.name = parameter.name;
+    queued.type = parameter.type;
+    switch (parameter.type) {
+      case EventParameter::kTypeInteger:
+        queued.integer_value = parameter.integer_value;
+        break;
+      case EventParameter::kTypeDouble:
+        queued.double_value = parameter.double_value;
+        break;
+      case EventParameter::kTypeString: {
+        // Truncate values that don't fit, keeping room for the terminator of
+        // each remaining string.
+        const char* value =
+            parameter.string_value ? parameter.string_value : "";
+        size_t available = kMaxEventStringBytes - string_bytes -
+                           (parameter_count - i);
+        size_t length = std::min(strlen(value),
+                                 std::min(kMaxParameterStringLength,
+                                          available));
+        queued.string_offset = static_cast<uint16_t>(string_bytes);
+        memcpy(slot->strings + string_bytes, value, length);
+        slot->strings[string_bytes + length] = '\0';
+        string_bytes += length + 1;
+        break;
+      }
+    }
+  }
+  slot->sequence.store(position + 1, std::memory_order_release);
+
+  // With several producers the worker may already have dispatched slots
+  // enqueued after this one, in which case the queue is empty as far as this
+  // event is concerned.
+  uint64_t end = static_cast<uint64_t>(position) + 1;
+  uint64_t dispatched = dispatched_count_.load(std::memory_order_relaxed);
+  uint64_t depth = dispatched < end ? end - dispatched : 0;
+  // Wake the worker early when a burst half fills the queue. Notifying
+  // without the lock can miss a worker about to wait, which then only
+  // dispatches after kDispatchIntervalMs.
+  if (depth == (slot_mask_ + 1) / 2) condition_.notify_one();
+  uint64_t max_depth = max_depth_.load(std::memory_order_relaxed);
+  while (depth > max_depth &&
+         !max_depth_.compare_exchange_weak(max_depth, depth,
+                                           std::memory_order_relaxed)) {
+  }
+  return true;
+}
+
+void EventQueue::Flush() {
+  size_t target = enqueue_position_.load(std::memory_order_acquire);
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_.notify_all();
+  condition_.wait(lock, [this, target] {
+    return dispatched_position_ >= target || !running_;
+  });
+}
+
+EventQueueStats EventQueue::stats() const {
+  EventQueueStats stats;
+  stats.queued = enqueue_position_.load(std::memory_order_relaxed);
+  stats.dropped = dropped_.load(std::memory_order_relaxed);
+  stats.dispatched = dispatched_count_.load(std::memory_order_relaxed);
+  stats.max_depth = max_depth_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void* EventQueue::RunThread(void* data) {
+  static_cast<EventQueue*>(data)->Run();
+  return nullptr;
+}
+
+void EventQueue::Run() {
+  std::vector<analytics::Parameter> parameters;
+  parameters.reserve(kMaxEventParameters);
+  while (true) {
+    while (true) {
+      EventSlot& slot = slots_[dequeue_position_ & slot_mask_];
+      if (slot.sequence.load(std::memory_order_acquire) !=
+          dequeue_position_ + 1) {
+        break;
+      }
+      Dispatch(slot, &parameters);
+      slot.sequence.store(dequeue_position_ + slot_mask_ + 1,
+                          std::memory_order_release);
+      dequeue_position_++;
+      dispatched_count_.store(dequeue_position_, std::memory_order_relaxed);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (dispatched_position_ != dequeue_position_) {
+      dispatched_position_ = dequeue_position_;
+      condition_.notify_all();
+    }
+    // Exit once stopped and every claimed slot has been dispatched.
+    if (stopping_ && enqueue_position_.load(std::memory_order_acquire) ==
+                         dequeue_position_) {
+      running_ = false;
+      condition_.notify_all();
+      return;
+    }
+    condition_.wait_for(lock, std::chrono::milliseconds(kDispatchIntervalMs));
+  }
+}
+
+void EventQueue::Dispatch(const EventSlot& slot,
+                          std::vector<analytics::Parameter>* parameters) {
+  parameters->clear();
+  for (uint16_t i = 0; i < slot.parameter_count; ++i) {
+    const QueuedParameter& queued = slot.parameters[i];
+    const char* parameter_name = names_[queued.name].c_str();
+    switch (queued.type) {
+      case EventParameter::kTypeInteger:
+        parameters->push_back(
+            analytics::Parameter(parameter_name, queued.integer_value));
+        break;
+      case EventParameter::kTypeDouble:
+        parameters->push_back(
+            analytics::Parameter(parameter_name, queued.double_value));
+        break;
+      case EventParameter::kTypeString:
+        parameters->push_back(analytics::Parameter(
+            parameter_name, slot.strings + queued.string_offset));
+        break;
+    }
+  }
+  const char* event_name = names_[slot.event].c_str();
+  if (parameters->empty()) {
+    analytics::LogEvent(event_name);
+  } else {
+    analytics::LogEvent(event_name, parameters->data(), parameters->size());
+  }
+}
+
+}  // namespace analytics_testapp
@@ -0,0 +1,193 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_EVENT_QUEUE_H_  // NOLINT
+#define FIREBASE_TESTAPP_EVENT_QUEUE_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "firebase/analytics.h"
+
+namespace analytics_testapp {
+
+// Handle of an event or parameter name interned by EventQueue::Intern().
+typedef int NameId;
+
+// Most parameters an event can have, Analytics' own limit.
+const size_t kMaxEventParameters = 25;
+// Longest string parameter value Analytics accepts, longer values are
+// truncated.
+const size_t kMaxParameterStringLength = 100;
+// Space for the string parameter values of a queued event.
+const size_t kMaxEventStringBytes = 512;
+
+// A parameter of a queued event. String values are copied when the event is
+// queued, so they only have to be valid during EventQueue::LogEvent().
+struct EventParameter {
+  enum Type {
+    kTypeInteger = 0,
+    kTypeDouble,
+    kTypeString,
+  };
+
+  EventParameter(NameId parameter_name, int64_t value)
+      : name(parameter_name),
+        type(kTypeInteger),
+        integer_value(value),
+        double_value(0.0),
+        string_value(nullptr) {}
+  EventParameter(NameId parameter_name, int value)
+      : name(parameter_name),
+        type(kTypeInteger),
+        integer_value(value),
+        double_value(0.0),
+        string_value(nullptr) {}
+  EventParameter(NameId parameter_name, double value)
+      : name(parameter_name),
+        type(kTypeDouble),
+        integer_value(0),
+        double_value(value),
+        string_value(nullptr) {}
+  EventParameter(NameId parameter_name, const char* value)
+      : name(parameter_name),
+        type(kTypeString),
+        integer_value(0),
+        double_value(0.0),
+        string_value(value) {}
+
+  NameId name;
+  Type type;
+  int64_t integer_value;
+  double double_value;
+  const char* string_value;
+};
+
+// Counters of an EventQueue.
+struct EventQueueStats {
+  EventQueueStats()
+      : queued(0), dropped(0), dispatched(0), max_depth(0) {}
+
+  // Events accepted by LogEvent().
+  uint64_t queued;
+  // Events rejected by LogEvent() because the queue was full or the event
+  // was invalid.
+  uint64_t dropped;
+  // Events passed to analytics::LogEvent().
+  uint64_t dispatched;
+  // Most events waiting at once.
+  uint64_t max_depth;
+};
+
+// Queues Analytics events in a fixed-size ring buffer drained by a worker
+// thread, so the threads logging them only pay for copying the event into a
+// slot: no SDK call, no lock and no allocation. The worker dispatches
+// periodically, or as soon as the queue is half full.
+//
+// Event and parameter names are interned once, at startup, and referred to
+// by handle. Each slot has room for kMaxEventParameters parameters and
+// kMaxEventStringBytes of string values, so the queue's memory is fixed when
+// it's created. When a burst fills it, events are dropped and counted rather
+// than blocking the caller.
+class EventQueue {
+ public:
+  // `slot_count` is rounded up to a power of two.
+  explicit EventQueue(size_t slot_count = 256);
+  // Dispatches every queued event before returning.
+  ~EventQueue();
+
+  // Intern `name`, returning its handle, or -1 if too many names have been
+  // interned. Interning a name twice returns the same handle. Call while
+  // setting up, it takes a lock.
+  NameId Intern(const char* name);
+  const char* name(NameId id) const;
+
+  // Queue an event, from any thread. Returns false if it was dropped.
+  bool LogEvent(NameId event) { return LogEvent(event, nullptr, 0); }
+  bool LogEvent(NameId event, const EventParameter* parameters,
+                size_t parameter_count);
+
+  // Block until every event queued before the call has been dispatched.
+  void Flush();
+
+  EventQueueStats stats() const;
+
+ private:
+  struct QueuedParameter {
+    NameId name;
+    EventParameter::Type type;
+    // Index in the slot's strings of a string value.
+    uint16_t string_offset;
+    union {
+      int64_t integer_value;
+      double double_value;
+    };
+  };
+
+  struct EventSlot {
+    // Position in the queue this slot can be written at (when equal to the
+    // enqueue position) or read at (when equal to the dequeue position + 1),
+    // as in async_log.cc.
+    std::atomic<size_t> sequence;
+    NameId event;
+    uint16_t parameter_count;
+    QueuedParameter parameters[kMaxEventParameters];
+    char strings[kMaxEventStringBytes];
+  };
+
+  EventQueue(const EventQueue&) = delete;
+  EventQueue& operator=(const EventQueue&) = delete;
+
+  static void* RunThread(void* data);
+  void Run();
+  // Pass the event in `slot` to analytics::LogEvent(), building its
+  // parameters in `parameters`.
+  void Dispatch(const EventSlot& slot,
+                std::vector<firebase::analytics::Parameter>* parameters);
+
+  std::unique_ptr<EventSlot[]> slots_;
+  size_t slot_mask_;
+  std::atomic<size_t> enqueue_position_;
+  // Only accessed by the worker thread.
+  size_t dequeue_position_;
+  // Copy of dequeue_position_ read by producers to track the queue's depth.
+  std::atomic<size_t> dispatched_count_;
+
+  // Interned names. Entries below name_count_ are never modified, so the
+  // worker reads them without the lock.
+  std::unique_ptr<std::string[]> names_;
+  std::atomic<int> name_count_;
+  std::mutex names_mutex_;
+
+  std::atomic<uint64_t> dropped_;
+  std::atomic<uint64_t> max_depth_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  // Guarded by mutex_.
+  size_t dispatched_position_;
+  bool running_;
+  bool stopping_;
+};
+
+}  // namespace analytics_testapp
+
+#endif  // FIREBASE_TESTAPP_EVENT_QUEUE_H_  // NOLINT
@@ -0,0 +1,223 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_EVENT_SCHEMA_H_  // NOLINT
+#define FIREBASE_TESTAPP_EVENT_SCHEMA_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "firebase/analytics.h"
+
+namespace analytics_testapp {
+
+// Analytics' limits on event and parameter names. Events that break them are
+// dropped by the SDK, only reporting an error in the device log.
+const size_t kMaxEventNameLength = 40;
+const size_t kMaxParameterNameLength = 40;
+const size_t kMaxSchemaParameters = 25;
+
+namespace schema_internal {
+
+// Recursive, as C++11 constexpr functions can't loop.
+
+constexpr bool IsAlpha(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr bool IsNameCharacter(char c) {
+  return IsAlpha(c) || (c >= '0' && c <= '9') || c == '_';
+}
+
+constexpr size_t Length(const char* text) {
+  return *text ? 1 + Length(text + 1) : 0;
+}
+
+constexpr bool HasPrefix(const char* text, const char* prefix) {
+  return !*prefix || (*text == *prefix && HasPrefix(text + 1, prefix + 1));
+}
+
+constexpr bool HasOnlyNameCharacters(const char* text) {
+  return !*text || (IsNameCharacter(*text) && HasOnlyNameCharacters(text + 1));
+}
+
+constexpr bool Equal(const char* a, const char* b) {
+  return *a == *b && (!*a || Equal(a + 1, b + 1));
+}
+
+// A list of indices, to expand a parameter pack alongside the schema's
+// parameter names.
+template <size_t... Indices>
+struct IndexSequence {};
+
+template <size_t Count, size_t... Indices>
+struct MakeIndexSequence
+    : MakeIndexSequence<Count - 1, Count - 1, Indices...> {};
+
+template <size_t... Indices>
+struct MakeIndexSequence<0, Indices...> {
+  typedef IndexSequence<Indices...> Type;
+};
+
+}  // namespace schema_internal
+
+// Whether `name` is a valid event or parameter name: it starts with a
+// letter, only has letters, digits and underscores, is at most `max_length`
+// characters long and doesn't use a prefix reserved by Analytics.
+constexpr bool IsValidAnalyticsName(const char* name, size_t max_length) {
+  return schema_internal::IsAlpha(name[0]) &&
+         schema_internal::HasOnlyNameCharacters(name) &&
+         schema_internal::Length(name) <= max_length &&
+         !schema_internal::HasPrefix(name, "firebase_") &&
+         !schema_internal::HasPrefix(name, "google_") &&
+         !schema_internal::HasPrefix(name, "ga_");
+}
+
+// The C++ type of a parameter's value. Specialized for each type Analytics
+// accepts, so declaring a parameter of any other type fails to compile.
+template <typename T>
+struct ParameterType;
+
+template <>
+struct ParameterType<int64_t> {
+  typedef int64_t Argument;
+};
+
+template <>
+struct ParameterType<double> {
+  typedef double Argument;
+};
+
+template <>
+struct ParameterType<const char*> {
+  typedef const char* Argument;
+};
+
+// Name of a parameter of type T, see MakeEventSchema().
+template <typename T>
+struct ParameterName {
+  constexpr explicit ParameterName(const char* parameter_name)
+      : name(parameter_name) {}
+
+  const char* name;
+};
+
+// An event's name and the names and types of its parameters, declared once
+// with ANALYTICS_EVENT_SCHEMA() and checked against Analytics' limits when
+// compiled. Log() takes the parameter values in order and passes them to
+// analytics::LogEvent() in a parameter block built on the stack from the
+// schema's names, so logging an event copies no strings:
+//
+//   ANALYTICS_EVENT_SCHEMA(kPostScoreEvent, "post_score",
+//                          ParameterName<int64_t>("score"),
+//                          ParameterName<const char*>("level_name"));
+//
+//   kPostScoreEvent.Log(42, "spoon_forest");
+template <typename... Types>
+class EventSchema {
+ public:
+  static const size_t kParameterCount = sizeof...(Types);
+  static_assert(kParameterCount <= kMaxSchemaParameters,
+                "Analytics events have at most 25 parameters.");
+
+  // The names must outlive the schema, use string literals.
+  template <typename... Names>
+  constexpr explicit EventSchema(const char* name, Names... parameter_names)
+      : name_(name), parameter_names_{parameter_names..., nullptr} {}
+
+  constexpr const char* name() const { return name_; }
+  constexpr const char* parameter_name(size_t index) const {
+    return parameter_names_[index];
+  }
+
+  constexpr bool has_valid_name() const {
+    return IsValidAnalyticsName(name_, kMaxEventNameLength);
+  }
+  constexpr bool has_valid_parameter_names() const {
+    return ParameterNamesValidFrom(0);
+  }
+  constexpr bool has_unique_parameter_names() const {
+    return ParameterNamesUniqueFrom(0, 1);
+  }
+
+  void Log(typename ParameterType<Types>::Argument... values) const {
+    LogParameters(
+        typename schema_internal::MakeIndexSequence<kParameterCount>::Type(),
+        values...);
+  }
+
+ private:
+  constexpr bool ParameterNamesValidFrom(size_t index) const {
+    return index == kParameterCount ||
+           (IsValidAnalyticsName(parameter_names_[index],
+                                 kMaxParameterNameLength) &&
+            ParameterNamesValidFrom(index + 1));
+  }
+
+  // Compare each pair of names (i, j) with i < j.
+  constexpr bool ParameterNamesUniqueFrom(size_t i, size_t j) const {
+    return i + 1 >= kParameterCount ||
+           (j == kParameterCount
+                ? ParameterNamesUniqueFrom(i + 1, i + 2)
+                : !schema_internal::Equal(parameter_names_[i],
+                                          parameter_names_[j]) &&
+                      ParameterNamesUniqueFrom(i, j + 1));
+  }
+
+  void LogParameters(schema_internal::IndexSequence<>) const {
+    firebase::analytics::LogEvent(name_);
+  }
+
+  template <size_t... Indices, typename... Values>
+  void LogParameters(schema_internal::IndexSequence<Indices...>,
+                     Values... values) const {
+    const firebase::analytics::Parameter parameters[] = {
+        firebase::analytics::Parameter(parameter_names_[Indices], values)...,
+    };
+    firebase::analytics::LogEvent(name_, parameters, kParameterCount);
+  }
+
+  const char* name_;
+  // Terminated by nullptr, so the array isn't empty for events without
+  // parameters.
+  const char* parameter_names_[kParameterCount + 1];
+};
+
+template <typename... Types>
+const size_t EventSchema<Types...>::kParameterCount;
+
+// Create the schema of event `name`, with a parameter for each of
+// `parameters`.
+template <typename... Types>
+constexpr EventSchema<Types...> MakeEventSchema(
+    const char* name, ParameterName<Types>... parameters) {
+  return EventSchema<Types...>(name, parameters.name...);
+}
+
+}  // namespace analytics_testapp
+
+// Declare `variable`, a constexpr EventSchema created by MakeEventSchema()
+// from the event name and ParameterNames that follow, failing to compile if
+// Analytics would reject the event.
+#define ANALYTICS_EVENT_SCHEMA(variable, ...)                       \
+  constexpr auto variable =                                         \
+      ::analytics_testapp::MakeEventSchema(__VA_ARGS__);            \
+  static_assert(variable.has_valid_name(),                          \
+                "Invalid Analytics event name in " #variable);      \
+  static_assert(variable.has_valid_parameter_names(),               \
+                "Invalid Analytics parameter name in " #variable);  \
+  static_assert(variable.has_unique_parameter_names(),              \
+                "Duplicate Analytics parameter name in " #variable)
+
+#endif  // FIREBASE_TESTAPP_EVENT_SCHEMA_H_  // NOLINT
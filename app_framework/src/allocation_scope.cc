@@ -0,0 +1,298 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "allocation_scope.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <TargetConditionals.h>
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif  // defined(__APPLE__)
+
+#include "main.h"  // NOLINT
+#include "memory_usage.h"  // NOLINT
+
+// Allocations are counted by replacing the global operator new and delete,
+// which is only done on desktop: on Android and iOS most of the SDK's
+// allocations are made by Java and Objective-C, which a hook wouldn't see.
+#if defined(APP_FRAMEWORK_TRACK_ALLOCATIONS) && !defined(__ANDROID__) && \
+    !(defined(__APPLE__) && TARGET_OS_IPHONE)
+#define APP_FRAMEWORK_ALLOCATION_HOOK 1
+#endif  // defined(APP_FRAMEWORK_TRACK_ALLOCATIONS) ...
+
+#if defined(APP_FRAMEWORK_ALLOCATION_HOOK)
+
+namespace {
+
+// Constant initialized, so they're valid for allocations made by the static
+// initializers of other translation units.
+std::atomic<int64_t> g_allocations(0);
+std::atomic<int64_t> g_allocated_bytes(0);
+std::atomic<int64_t> g_freed_bytes(0);
+
+// Bytes the allocator reserved for `pointer`, which may be more than were
+// requested. Used for allocations and frees alike so they balance.
+size_t AllocationSize(void* pointer) {
+#if defined(__APPLE__)
+  return malloc_size(pointer);
+#elif defined(_WIN32)
+  return _msize(pointer);
+#else
+  return malloc_usable_size(pointer);
+#endif  // defined(__APPLE__)
+}
+
+void* CountedAllocate(size_t size) {
+  void* pointer = malloc(size ? size : 1);
+  if (!pointer) return nullptr;
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_allocated_bytes.fetch_add(static_cast<int64_t>(AllocationSize(pointer)),
+                              std::memory_order_relaxed);
+  return pointer;
+}
+
+// Calls the new handler until the allocation succeeds, as operator new must.
+// Returns nullptr if there is no new handler.
+void* CountedAllocateOrRetry(size_t size) {
+  for (;;) {
+    void* pointer = CountedAllocate(size);
+    if (pointer) return pointer;
+    std::new_handler handler = std::set_new_handler(nullptr);
+    std::set_new_handler(handler);
+    if (!handler) return nullptr;
+    handler();
+  }
+}
+
+void* CountedAllocateOrThrow(size_t size) {
+  void* pointer = CountedAllocateOrRetry(size);
+  if (!pointer) {
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+    throw std::bad_alloc();
+#else
+    abort();
+#endif  // defined(__cpp_exceptions) || ...
+  }
+  return pointer;
+}
+
+void CountedFree(void* pointer) {
+  if (!pointer) return;
+  g_freed_bytes.fetch_add(static_cast<int64_t>(AllocationSize(pointer)),
+                          std::memory_order_relaxed);
+  free(pointer);
+}
+
+}  // namespace
+
+// The sized forms of operator delete call these, so they needn't be
+// replaced.
+void* operator new(size_t size) { return CountedAllocateOrThrow(size); }
+void* operator new[](size_t size) { return CountedAllocateOrThrow(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return CountedAllocateOrRetry(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return CountedAllocateOrRetry(size);
+}
+void operator delete(void* pointer) noexcept { CountedFree(pointer); }
+void operator delete[](void* pointer) noexcept { CountedFree(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  CountedFree(pointer);
+}
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+  CountedFree(pointer);
+}
+
+#endif  // defined(APP_FRAMEWORK_ALLOCATION_HOOK)
+
+namespace app_framework {
+
+namespace {
+
+// Totals of the scopes with the same name.
+struct NamedScope {
+  std::string name;
+  AllocationScopeStats stats;
+};
+
+std::mutex g_scopes_mutex;
+// In the order they were first used. Never freed, so scopes can end during
+// static destruction.
+std::vector<NamedScope*>* g_scopes = nullptr;
+
+// Innermost scope of each thread.
+thread_local const AllocationScope* g_innermost_scope = nullptr;
+
+// Add `delta` to `total` unless either is unknown, in which case the total
+// is unknown. `first` is whether this is the first value of the total.
+void Accumulate(int64_t delta, bool first, int64_t* total) {
+  if (first) {
+    *total = delta;
+  } else if (*total != -1) {
+    *total = delta == -1 ? -1 : *total + delta;
+  }
+}
+
+// Difference of two measurements, -1 if either is unknown.
+int64_t Difference(int64_t end, int64_t start) {
+  return end == -1 || start == -1 ? -1 : end - start;
+}
+
+// `value` divided by `divisor` if it's known, otherwise "?".
+std::string Format(int64_t value, bool known, int64_t divisor) {
+  if (!known) return "?";
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%lld",
+           static_cast<long long>(value / divisor));  // NOLINT
+  return buffer;
+}
+
+}  // namespace
+
+HeapSnapshot GetHeapSnapshot() {
+  HeapSnapshot snapshot;
+#if defined(APP_FRAMEWORK_ALLOCATION_HOOK)
+  snapshot.allocations = g_allocations.load(std::memory_order_relaxed);
+  snapshot.allocated_bytes = g_allocated_bytes.load(std::memory_order_relaxed);
+  snapshot.in_use_bytes =
+      snapshot.allocated_bytes - g_freed_bytes.load(std::memory_order_relaxed);
+#elif defined(__ANDROID__)
+  struct mallinfo info = mallinfo();
+  snapshot.in_use_bytes = static_cast<int64_t>(info.uordblks);
+#elif defined(__APPLE__)
+  malloc_statistics_t statistics;
+  malloc_zone_statistics(nullptr, &statistics);
+  snapshot.in_use_bytes = static_cast<int64_t>(statistics.size_in_use);
+#endif  // defined(APP_FRAMEWORK_ALLOCATION_HOOK)
+  return snapshot;
+}
+
+bool AllocationScopesEnabled() {
+#if defined(APP_FRAMEWORK_TRACK_ALLOCATIONS)
+  return true;
+#else
+  return false;
+#endif  // defined(APP_FRAMEWORK_TRACK_ALLOCATIONS)
+}
+
+AllocationScope::AllocationScope(const char* name)
+    : name_(name),
+      parent_(nullptr),
+      counted_(false),
+      start_peak_rss_bytes_(-1) {
+  if (!AllocationScopesEnabled()) return;
+  parent_ = g_innermost_scope;
+  g_innermost_scope = this;
+  for (const AllocationScope* scope = parent_; scope;
+       scope = scope->parent_) {
+    if (scope->counted_ && strcmp(scope->name_, name_) == 0) return;
+  }
+  counted_ = true;
+  start_peak_rss_bytes_ = GetPeakResidentMemoryBytes();
+  start_ = GetHeapSnapshot();
+}
+
+AllocationScope::~AllocationScope() {
+  if (!AllocationScopesEnabled()) return;
+  g_innermost_scope = parent_;
+  if (!counted_) return;
+  HeapSnapshot end = GetHeapSnapshot();
+  int64_t end_peak_rss_bytes = GetPeakResidentMemoryBytes();
+
+  std::lock_guard<std::mutex> lock(g_scopes_mutex);
+  if (!g_scopes) g_scopes = new std::vector<NamedScope*>();
+  NamedScope* scope = nullptr;
+  for (size_t i = 0; i < g_scopes->size() && !scope; ++i) {
+    if ((*g_scopes)[i]->name == name_) scope = (*g_scopes)[i];
+  }
+  if (!scope) {
+    scope = new NamedScope();
+    scope->name = name_;
+    g_scopes->push_back(scope);
+  }
+  AllocationScopeStats& stats = scope->stats;
+  bool first = stats.entries == 0;
+  stats.entries++;
+  Accumulate(Difference(end.allocations, start_.allocations), first,
+             &stats.allocations);
+  Accumulate(Difference(end.allocated_bytes, start_.allocated_bytes), first,
+             &stats.allocated_bytes);
+  // Retained bytes may be negative, so -1 can't mark them unknown.
+  if (end.in_use_bytes == -1 || start_.in_use_bytes == -1) {
+    stats.retained_bytes_known = false;
+  } else if (first || stats.retained_bytes_known) {
+    stats.retained_bytes_known = true;
+    stats.retained_bytes += end.in_use_bytes - start_.in_use_bytes;
+  }
+  Accumulate(Difference(end_peak_rss_bytes, start_peak_rss_bytes_), first,
+             &stats.peak_rss_growth_bytes);
+  stats.peak_rss_bytes = end_peak_rss_bytes;
+}
+
+bool GetAllocationScopeStats(const char* name, AllocationScopeStats* stats) {
+  std::lock_guard<std::mutex> lock(g_scopes_mutex);
+  if (!g_scopes) return false;
+  for (size_t i = 0; i < g_scopes->size(); ++i) {
+    if ((*g_scopes)[i]->name == name) {
+      *stats = (*g_scopes)[i]->stats;
+      return true;
+    }
+  }
+  return false;
+}
+
+void LogAllocationScopes() {
+  // Copied so the log calls, which may allocate, don't hold the lock.
+  std::vector<NamedScope> scopes;
+  {
+    std::lock_guard<std::mutex> lock(g_scopes_mutex);
+    if (!g_scopes) return;
+    for (size_t i = 0; i < g_scopes->size(); ++i) {
+      scopes.push_back(*(*g_scopes)[i]);
+    }
+  }
+  LogMessage("Memory by operation (KB, ? if unknown):");
+  for (size_t i = 0; i < scopes.size(); ++i) {
+    const AllocationScopeStats& stats = scopes[i].stats;
+    LogMessage(
+        "  %s: n=%lld allocations=%s allocated=%s retained=%s "
+        "peak_rss_growth=%s peak_rss=%s",
+        scopes[i].name.c_str(),
+        static_cast<long long>(stats.entries),  // NOLINT
+        Format(stats.allocations, stats.allocations != -1, 1).c_str(),
+        Format(stats.allocated_bytes, stats.allocated_bytes != -1, 1024)
+            .c_str(),
+        Format(stats.retained_bytes, stats.retained_bytes_known, 1024).c_str(),
+        Format(stats.peak_rss_growth_bytes, stats.peak_rss_growth_bytes != -1,
+               1024)
+            .c_str(),
+        Format(stats.peak_rss_bytes, stats.peak_rss_bytes != -1, 1024)
+            .c_str());
+  }
+}
+
+}  // namespace app_framework
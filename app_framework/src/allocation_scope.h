@@ -0,0 +1,116 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_ALLOCATION_SCOPE_H_  // NOLINT
+#define FIREBASE_TESTAPP_ALLOCATION_SCOPE_H_  // NOLINT
+
+#include <stdint.h>
+
+namespace app_framework {
+
+// Heap usage of the process at a point in time. Each field is -1 if it can't
+// be measured on this platform or build.
+struct HeapSnapshot {
+  HeapSnapshot() : allocations(-1), allocated_bytes(-1), in_use_bytes(-1) {}
+
+  // Allocations made, and bytes allocated, since the process started.
+  int64_t allocations;
+  int64_t allocated_bytes;
+  // Bytes of heap currently allocated.
+  int64_t in_use_bytes;
+};
+
+// Returns the heap usage of the process.
+//
+// Desktop builds with APP_FRAMEWORK_TRACK_ALLOCATIONS defined replace the
+// global operator new and delete to count every allocation made through them,
+// by the sample and the C++ SDK, on any thread. Elsewhere only the bytes in
+// use are known: from mallinfo() on Android and malloc_zone_statistics() on
+// iOS, where the SDK's allocations are mostly made by the platform's own
+// libraries so a hook would miss them.
+HeapSnapshot GetHeapSnapshot();
+
+// Totals of every AllocationScope with the same name.
+struct AllocationScopeStats {
+  AllocationScopeStats()
+      : entries(0),
+        allocations(-1),
+        allocated_bytes(-1),
+        retained_bytes(0),
+        retained_bytes_known(false),
+        peak_rss_growth_bytes(-1),
+        peak_rss_bytes(-1) {}
+
+  // Number of scopes that ended.
+  int64_t entries;
+  // Allocations made and bytes allocated during the scopes, -1 if they aren't
+  // counted.
+  int64_t allocations;
+  int64_t allocated_bytes;
+  // Growth of the heap in use from the start to the end of each scope,
+  // negative if the scopes freed more than they allocated. Only valid if
+  // retained_bytes_known.
+  int64_t retained_bytes;
+  bool retained_bytes_known;
+  // How much the scopes raised the peak resident memory of the process, and
+  // the peak when the last scope ended, -1 if it's unknown.
+  int64_t peak_rss_growth_bytes;
+  int64_t peak_rss_bytes;
+};
+
+// Measures the heap usage of the process from its creation to its
+// destruction, adding it to the totals of `name`. WaitForCompletion() opens a
+// scope named after the operation it waits for, so wrapping the code that
+// issues a request, or processes its result, in a scope of the same name
+// attributes their allocations to the same operation.
+//
+// The counts are of the whole process, so they include work done by other
+// threads meanwhile, such as the SDK's own threads completing the request. A
+// scope nested in one of the same name on the same thread isn't counted
+// again.
+//
+// Scopes are opt-in: unless APP_FRAMEWORK_TRACK_ALLOCATIONS is defined when
+// building app_framework (the CMake option of the same name, or a
+// preprocessor definition in Xcode) they do nothing.
+class AllocationScope {
+ public:
+  // `name` must outlive the scope.
+  explicit AllocationScope(const char* name);
+  ~AllocationScope();
+
+ private:
+  AllocationScope(const AllocationScope&) = delete;
+  AllocationScope& operator=(const AllocationScope&) = delete;
+
+  const char* name_;
+  // Innermost scope of the thread when this one was created.
+  const AllocationScope* parent_;
+  bool counted_;
+  HeapSnapshot start_;
+  int64_t start_peak_rss_bytes_;
+};
+
+// Whether AllocationScopes are recorded in this build.
+bool AllocationScopesEnabled();
+
+// Get the totals of the scopes named `name`. Returns false if none ended.
+bool GetAllocationScopeStats(const char* name, AllocationScopeStats* stats);
+
+// Log the totals of each scope name, in the order they were first used.
+// Called by the platform shell after common_main() returns.
+void LogAllocationScopes();
+
+}  // namespace app_framework
+
+#endif  // FIREBASE_TESTAPP_ALLOCATION_SCOPE_H_  // NOLINT
@@ -12,15 +12,22 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <stdarg.h>
-#include <stdio.h>
-
 #include <android/log.h>
 #include <android_native_app_glue.h>
 #include <pthread.h>
-#include <cassert>
+#include <unistd.h>
 
+#include <cassert>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "allocation_scope.h"  // NOLINT
+#include "async_log.h"  // NOLINT
 #include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
 
 // This implementation is derived from http://github.com/google/fplutil
 
@@ -31,12 +38,16 @@ static bool g_destroy_requested = false;
 static bool g_started = false;
 static bool g_restarted = false;
 static pthread_mutex_t g_started_mutex;
+// Saved at startup, so threads can be detached from the JVM when they exit.
+static JavaVM* g_java_vm = nullptr;
 
 // Handle state changes from via native app glue.
 static void OnAppCmd(struct android_app* app, int32_t cmd) {
   g_destroy_requested |= cmd == APP_CMD_DESTROY;
 }
 
+namespace app_framework {
+
 // Process events pending on the main thread.
 // Returns true when the app receives an event requesting exit.
 bool ProcessEvents(int msec) {
@@ -50,46 +61,130 @@ bool ProcessEvents(int msec) {
   return g_destroy_requested | g_restarted;
 }
 
+void WakeProcessEvents() {
+  if (g_app_state) ALooper_wake(g_app_state->looper);
+}
+
+std::string PathForResource() {
+  ANativeActivity* nativeActivity = g_app_state->activity;
+  std::string result(nativeActivity->internalDataPath);
+  return result + "/";
+}
+
 // Get the activity.
 jobject GetActivity() { return g_app_state->activity->clazz; }
 
 // Get the window context. For Android, it's a jobject pointing to the Activity.
 jobject GetWindowContext() { return g_app_state->activity->clazz; }
 
-// Find a class, attempting to load the class if it's not found.
-jclass FindClass(JNIEnv* env, jobject activity_object, const char* class_name) {
-  jclass class_object = env->FindClass(class_name);
-  if (env->ExceptionCheck()) {
-    env->ExceptionClear();
-    // If the class isn't found it's possible NativeActivity is being used by
-    // the application which means the class path is set to only load system
-    // classes.  The following falls back to loading the class using the
-    // Activity before retrieving a reference to it.
+// JNI environment of a thread, see GetJniEnv().
+struct ThreadJniEnv {
+  JNIEnv* env;
+  // Whether GetJniEnv() attached the thread, rather than it already being
+  // attached, e.g. a Java thread calling into native code.
+  bool attached;
+};
+
+static pthread_key_t g_jni_env_key;
+static pthread_once_t g_jni_env_key_once = PTHREAD_ONCE_INIT;
+
+// Detach the thread that owned `data`, if GetJniEnv() attached it.
+static void ReleaseThreadJniEnv(void* data) {
+  ThreadJniEnv* thread_env = static_cast<ThreadJniEnv*>(data);
+  if (thread_env->attached) g_java_vm->DetachCurrentThread();
+  delete thread_env;
+}
+
+// pthread calls ReleaseThreadJniEnv() when a thread that used GetJniEnv()
+// exits.
+static void CreateJniEnvKey() {
+  pthread_key_create(&g_jni_env_key, ReleaseThreadJniEnv);
+}
+
+// Detach the calling thread now rather than when it exits, if GetJniEnv()
+// attached it.
+static void DetachJniEnv() {
+  pthread_once(&g_jni_env_key_once, CreateJniEnvKey);
+  void* thread_env = pthread_getspecific(g_jni_env_key);
+  if (!thread_env) return;
+  pthread_setspecific(g_jni_env_key, nullptr);
+  ReleaseThreadJniEnv(thread_env);
+}
+
+// Classes and methods used by the rest of this file, resolved once at startup
+// rather than each time they're used.
+class JniBindings {
+ public:
+  JniBindings()
+      : class_loader_(nullptr),
+        class_loader_load_class_(0),
+        object_class_(nullptr),
+        object_to_string_(0) {}
+
+  ~JniBindings() {
+    JNIEnv* env = GetJniEnv();
+    assert(env);
+    if (class_loader_) env->DeleteGlobalRef(class_loader_);
+    if (object_class_) env->DeleteGlobalRef(object_class_);
+  }
+
+  void Init(JNIEnv* env, jobject activity_object) {
+    // If NativeActivity is being used by the application the class path is set
+    // to only load system classes, so application classes are loaded using the
+    // Activity's class loader.
     jclass activity_class = env->FindClass("android/app/Activity");
     jmethodID activity_get_class_loader = env->GetMethodID(
         activity_class, "getClassLoader", "()Ljava/lang/ClassLoader;");
-
     jobject class_loader_object =
         env->CallObjectMethod(activity_object, activity_get_class_loader);
+    class_loader_ = env->NewGlobalRef(class_loader_object);
+    env->DeleteLocalRef(class_loader_object);
+    env->DeleteLocalRef(activity_class);
 
     jclass class_loader_class = env->FindClass("java/lang/ClassLoader");
-    jmethodID class_loader_load_class =
+    class_loader_load_class_ =
         env->GetMethodID(class_loader_class, "loadClass",
                          "(Ljava/lang/String;)Ljava/lang/Class;");
-    jstring class_name_object = env->NewStringUTF(class_name);
+    env->DeleteLocalRef(class_loader_class);
 
-    class_object = static_cast<jclass>(env->CallObjectMethod(
-        class_loader_object, class_loader_load_class, class_name_object));
+    // Need to store as global references so it don't get moved during garbage
+    // collection.
+    jclass object_class = env->FindClass("java/lang/Object");
+    object_class_ = static_cast<jclass>(env->NewGlobalRef(object_class));
+    env->DeleteLocalRef(object_class);
+    object_to_string_ =
+        env->GetMethodID(object_class_, "toString", "()Ljava/lang/String;");
+  }
 
+  // Find a class, attempting to load it with the Activity's class loader if
+  // it's not found. Returns a local reference, or nullptr if the class isn't
+  // found.
+  jclass FindClass(JNIEnv* env, const char* class_name) const {
+    jclass class_object = env->FindClass(class_name);
+    if (!env->ExceptionCheck()) return class_object;
+    env->ExceptionClear();
+    jstring class_name_object = env->NewStringUTF(class_name);
+    class_object = static_cast<jclass>(env->CallObjectMethod(
+        class_loader_, class_loader_load_class_, class_name_object));
     if (env->ExceptionCheck()) {
       env->ExceptionClear();
       class_object = nullptr;
     }
     env->DeleteLocalRef(class_name_object);
-    env->DeleteLocalRef(class_loader_object);
+    return class_object;
   }
-  return class_object;
-}
+
+  // Object.toString().
+  jmethodID object_to_string() const { return object_to_string_; }
+
+ private:
+  jobject class_loader_;
+  jmethodID class_loader_load_class_;
+  jclass object_class_;
+  jmethodID object_to_string_;
+};
+
+JniBindings* g_jni_bindings;
 
 // Vars that we need available for appending text to the log window:
 class LoggingUtilsData {
@@ -97,7 +192,8 @@ class LoggingUtilsData {
   LoggingUtilsData()
       : logging_utils_class_(nullptr),
         logging_utils_add_log_text_(0),
-        logging_utils_init_log_window_(0) {}
+        logging_utils_init_log_window_(0),
+        logging_utils_get_did_touch_(0) {}
 
   ~LoggingUtilsData() {
     JNIEnv* env = GetJniEnv();
@@ -111,8 +207,8 @@ class LoggingUtilsData {
     JNIEnv* env = GetJniEnv();
     assert(env);
 
-    jclass logging_utils_class = FindClass(
-        env, GetActivity(), "com/google/firebase/example/LoggingUtils");
+    jclass logging_utils_class = g_jni_bindings->FindClass(
+        env, "com/google/firebase/example/LoggingUtils");
     assert(logging_utils_class != 0);
 
     // Need to store as global references so it don't get moved during garbage
@@ -125,6 +221,8 @@ class LoggingUtilsData {
         logging_utils_class_, "initLogWindow", "(Landroid/app/Activity;)V");
     logging_utils_add_log_text_ = env->GetStaticMethodID(
         logging_utils_class_, "addLogText", "(Ljava/lang/String;)V");
+    logging_utils_get_did_touch_ =
+        env->GetStaticMethodID(logging_utils_class_, "getDidTouch", "()Z");
 
     env->CallStaticVoidMethod(logging_utils_class_,
                               logging_utils_init_log_window_, GetActivity());
@@ -140,10 +238,19 @@ class LoggingUtilsData {
     env->DeleteLocalRef(text_string);
   }
 
+  bool DidTouch() {
+    if (logging_utils_class_ == 0) return false;  // haven't been initted yet
+    JNIEnv* env = GetJniEnv();
+    assert(env);
+    return env->CallStaticBooleanMethod(logging_utils_class_,
+                                        logging_utils_get_did_touch_);
+  }
+
  private:
   jclass logging_utils_class_;
   jmethodID logging_utils_add_log_text_;
   jmethodID logging_utils_init_log_window_;
+  jmethodID logging_utils_get_did_touch_;
 };
 
 LoggingUtilsData* g_logging_utils_data;
@@ -166,8 +273,8 @@ class TextEntryFieldData {
     JNIEnv* env = GetJniEnv();
     assert(env);
 
-    jclass text_entry_field_class = FindClass(
-        env, GetActivity(), "com/google/firebase/example/TextEntryField");
+    jclass text_entry_field_class = g_jni_bindings->FindClass(
+        env, "com/google/firebase/example/TextEntryField");
     assert(text_entry_field_class != 0);
 
     // Need to store as global references so it don't get moved during garbage
@@ -236,19 +343,15 @@ void CheckJNIException() {
     env->ExceptionClear();
 
     // Convert the exception to a string.
-    jclass object_class = env->FindClass("java/lang/Object");
-    jmethodID toString =
-        env->GetMethodID(object_class, "toString", "()Ljava/lang/String;");
-    jstring s = (jstring)env->CallObjectMethod(exception, toString);
+    jstring s = (jstring)env->CallObjectMethod(
+        exception, g_jni_bindings->object_to_string());
     const char* exception_text = env->GetStringUTFChars(s, nullptr);
 
     // Log the exception text.
-    __android_log_print(ANDROID_LOG_INFO, FIREBASE_TESTAPP_NAME,
+    __android_log_print(ANDROID_LOG_INFO, TESTAPP_NAME,
                         "-------------------JNI exception:");
-    __android_log_print(ANDROID_LOG_INFO, FIREBASE_TESTAPP_NAME, "%s",
-                        exception_text);
-    __android_log_print(ANDROID_LOG_INFO, FIREBASE_TESTAPP_NAME,
-                        "-------------------");
+    __android_log_print(ANDROID_LOG_INFO, TESTAPP_NAME, "%s", exception_text);
+    __android_log_print(ANDROID_LOG_INFO, TESTAPP_NAME, "-------------------");
 
     // Also, assert fail.
     assert(false);
@@ -260,31 +363,26 @@ void CheckJNIException() {
   }
 }
 
-// Log a message that can be viewed in "adb logcat".
-void LogMessage(const char* format, ...) {
-  static const int kLineBufferSize = 100;
-  char buffer[kLineBufferSize + 2];
-
-  va_list list;
-  va_start(list, format);
-  int string_len = vsnprintf(buffer, kLineBufferSize, format, list);
-  string_len = string_len < kLineBufferSize ? string_len : kLineBufferSize;
-  // append a linebreak to the buffer:
-  buffer[string_len] = '\n';
-  buffer[string_len + 1] = '\0';
-
-  __android_log_vprint(ANDROID_LOG_INFO, FIREBASE_TESTAPP_NAME, format, list);
-  g_logging_utils_data->AppendText(buffer);
-  CheckJNIException();
-  va_end(list);
+// Write a batch of log lines so they can be viewed in "adb logcat" and, via
+// the stdout pipe read by stdout_logger(), in the log window.
+void WriteLogBatch(const char* text, size_t length) {
+  const char* end = text + length;
+  for (const char* line = text; line < end;) {
+    const char* newline =
+        static_cast<const char*>(memchr(line, '\n', end - line));
+    const char* line_end = newline ? newline : end;
+    __android_log_print(ANDROID_LOG_INFO, TESTAPP_NAME, "%.*s",
+                        static_cast<int>(line_end - line), line);
+    line = line_end + 1;
+  }
+  fwrite(text, 1, length, stdout);
+  fflush(stdout);
 }
 
-// Get the JNI environment.
-JNIEnv* GetJniEnv() {
-  JavaVM* vm = g_app_state->activity->vm;
-  JNIEnv* env;
-  jint result = vm->AttachCurrentThread(&env, nullptr);
-  return result == JNI_OK ? env : nullptr;
+// Log a message that can be viewed in the console.
+void AddToTextView(const char* str) {
+  app_framework::g_logging_utils_data->AppendText(str);
+  CheckJNIException();
 }
 
 // Use a Java class, TextEntryField, to prompt the user to enter some text.
@@ -296,6 +394,81 @@ std::string ReadTextInput(const char* title, const char* message,
   return g_text_entry_field_data->ReadText(title, message, placeholder);
 }
 
+// Get the JNI environment, attaching the thread on first use.
+JNIEnv* GetJniEnv() {
+  pthread_once(&g_jni_env_key_once, CreateJniEnvKey);
+  ThreadJniEnv* thread_env =
+      static_cast<ThreadJniEnv*>(pthread_getspecific(g_jni_env_key));
+  if (thread_env) return thread_env->env;
+  JNIEnv* env = nullptr;
+  bool attached = false;
+  if (g_java_vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) !=
+      JNI_OK) {
+    if (g_java_vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+      return nullptr;
+    }
+    attached = true;
+  }
+  thread_env = new ThreadJniEnv;
+  thread_env->env = env;
+  thread_env->attached = attached;
+  pthread_setspecific(g_jni_env_key, thread_env);
+  return env;
+}
+
+// Remove all lines starting with these strings.
+static const char* const filter_lines[] = {"referenceTable ", nullptr};
+
+bool should_filter(const char* str) {
+  for (int i = 0; filter_lines[i] != nullptr; ++i) {
+    if (strncmp(str, filter_lines[i], strlen(filter_lines[i])) == 0)
+      return true;
+  }
+  return false;
+}
+
+void* stdout_logger(void* filedes_ptr) {
+  int fd = reinterpret_cast<int*>(filedes_ptr)[0];
+  // Text read from the pipe that isn't terminated by a newline yet.
+  std::string partial_line;
+  // Complete lines read from the pipe. Everything read at once is added to
+  // the text view in a single call, since each call is relatively expensive.
+  std::string lines;
+  char chunk[4096];
+  bool done = false;
+  while (!done) {
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n <= 0) break;
+    for (ssize_t i = 0; i < n; ++i) {
+      if (chunk[i] == '\0') {
+        done = true;
+        break;
+      }
+      partial_line += chunk[i];
+      if (chunk[i] == '\n') {
+        if (!should_filter(partial_line.c_str())) lines += partial_line;
+        partial_line.clear();
+      }
+    }
+    if (!lines.empty()) {
+      app_framework::AddToTextView(lines.c_str());
+      lines.clear();
+    }
+  }
+  // The thread is detached from the JVM when it exits.
+  return nullptr;
+}
+
+void RunOnBackgroundThread(void* (*func)(void*), void* data) {
+  pthread_t thread;
+  // If `func` uses GetJniEnv() the thread is detached from the JVM when it
+  // exits.
+  pthread_create(&thread, nullptr, func, data);
+  pthread_detach(thread);
+}
+
+}  // namespace app_framework
+
 // Execute common_main(), flush pending events and finish the activity.
 extern "C" void android_main(struct android_app* state) {
   // native_app_glue spawns a new thread, calling android_main() when the
@@ -318,29 +491,65 @@ extern "C" void android_main(struct android_app* state) {
   g_destroy_requested = false;
   g_app_state = state;
   g_app_state->onAppCmd = OnAppCmd;
+  g_java_vm = state->activity->vm;
+
+  // Resolve the classes and methods used to call into Java.
+  app_framework::g_jni_bindings = new app_framework::JniBindings();
+  app_framework::g_jni_bindings->Init(app_framework::GetJniEnv(),
+                                      app_framework::GetActivity());
 
   // Create the logging display.
-  g_logging_utils_data = new LoggingUtilsData();
-  g_logging_utils_data->Init();
+  app_framework::g_logging_utils_data = new app_framework::LoggingUtilsData();
+  app_framework::g_logging_utils_data->Init();
 
   // Create the text entry dialog.
-  g_text_entry_field_data = new TextEntryFieldData();
-  g_text_entry_field_data->Init();
+  app_framework::g_text_entry_field_data =
+      new app_framework::TextEntryFieldData();
+  app_framework::g_text_entry_field_data->Init();
+
+  // Pipe stdout to AddToTextView so we get the gtest output.
+  int filedes[2];
+  assert(pipe(filedes) != -1);
+  assert(dup2(filedes[1], STDOUT_FILENO) != -1);
+  pthread_t thread;
+  pthread_create(&thread, nullptr, app_framework::stdout_logger,
+                 reinterpret_cast<void*>(filedes));
 
   // Execute cross platform entry point.
-  static const char* argv[] = {FIREBASE_TESTAPP_NAME};
+  static const char* argv[] = {TESTAPP_NAME};
   int return_value = common_main(1, argv);
   (void)return_value;  // Ignore the return value.
-  ProcessEvents(10);
+  app_framework::LogLatencyHistograms();
+  app_framework::LogAllocationScopes();
+  app_framework::FlushLog();
+
+  // Signal to stdout_logger to exit.
+  write(filedes[1], "\0", 1);
+  pthread_join(thread, nullptr);
+  close(filedes[0]);
+  close(filedes[1]);
+  // Pause a few seconds so you can see the results. If the user touches
+  // the screen during that time, don't exit until they choose to.
+  bool should_exit = false;
+  do {
+    should_exit = app_framework::ProcessEvents(10000);
+  } while (app_framework::g_logging_utils_data->DidTouch() && !should_exit);
 
   // Clean up logging display.
-  delete g_logging_utils_data;
-  g_logging_utils_data = nullptr;
+  delete app_framework::g_logging_utils_data;
+  app_framework::g_logging_utils_data = nullptr;
+
+  // Clean up the text entry dialog.
+  delete app_framework::g_text_entry_field_data;
+  app_framework::g_text_entry_field_data = nullptr;
+
+  delete app_framework::g_jni_bindings;
+  app_framework::g_jni_bindings = nullptr;
 
   // Finish the activity.
   if (!g_restarted) ANativeActivity_finish(state->activity);
 
-  g_app_state->activity->vm->DetachCurrentThread();
+  app_framework::DetachJniEnv();
   g_started = false;
   g_restarted = false;
   pthread_mutex_unlock(&g_started_mutex);
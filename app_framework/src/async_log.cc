@@ -0,0 +1,198 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "async_log.h"  // NOLINT
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+
+#include "main.h"  // NOLINT
+
+namespace app_framework {
+
+namespace {
+
+// Number of messages that can be queued before producers have to wait for
+// the logging thread. Must be a power of two.
+const size_t kLogSlotCount = 512;
+
+// Maximum size of a batch passed to WriteLogBatch().
+const size_t kMaxLogBatchSize = 64 * 1024;
+
+// How long the logging thread sleeps when it isn't woken by a producer. This
+// only bounds the delay caused by a missed wake-up.
+const int kLogIdleWaitMs = 100;
+
+struct LogSlot {
+  // Position in the queue this slot can be written at (when equal to the
+  // enqueue position) or read at (when equal to the dequeue position + 1).
+  std::atomic<size_t> sequence;
+  size_t length;
+  char text[kMaxLogMessageLength + 1];
+};
+
+class AsyncLogger {
+ public:
+  AsyncLogger()
+      : enqueue_position_(0),
+        dequeue_position_(0),
+        written_position_(0),
+        sleeping_(false) {
+    for (size_t i = 0; i < kLogSlotCount; ++i) slots_[i].sequence = i;
+    batch_.reserve(kMaxLogBatchSize + kMaxLogMessageLength + 1);
+    std::thread thread(&AsyncLogger::Run, this);
+    thread.detach();
+  }
+
+  // Format a message into the next free slot.
+  void Append(const char* format, va_list list) {
+    size_t position = enqueue_position_.load(std::memory_order_relaxed);
+    LogSlot* slot;
+    while (true) {
+      slot = &slots_[position & (kLogSlotCount - 1)];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      intptr_t difference =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+      if (difference == 0) {
+        if (enqueue_position_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // The queue is full, let the logging thread catch up.
+        Wake();
+        std::this_thread::yield();
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      } else {
+        // Another producer claimed this slot.
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+    int length = vsnprintf(slot->text, sizeof(slot->text), format, list);
+    slot->length = length < 0 ? 0
+                              : length < static_cast<int>(kMaxLogMessageLength)
+                                    ? static_cast<size_t>(length)
+                                    : kMaxLogMessageLength;
+    slot->sequence.store(position + 1, std::memory_order_release);
+
+    // Pairs with the fence in Run(), so either the logging thread sees the
+    // message before it sleeps, or this thread sees that it's sleeping.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed)) Wake();
+  }
+
+  // Block until all messages queued before the call have been written.
+  void Flush() {
+    size_t target = enqueue_position_.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(mutex_);
+    wake_condition_.notify_one();
+    flushed_condition_.wait(lock, [this, target] {
+      return written_position_ >= target;
+    });
+  }
+
+ private:
+  void Wake() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wake_condition_.notify_one();
+  }
+
+  // Whether the slot at the dequeue position has been written.
+  bool HasPendingMessage() const {
+    const LogSlot& slot = slots_[dequeue_position_ & (kLogSlotCount - 1)];
+    return slot.sequence.load(std::memory_order_acquire) ==
+           dequeue_position_ + 1;
+  }
+
+  void Run() {
+    while (true) {
+      // Move everything that's queued into a single batch, releasing each
+      // slot as soon as it has been copied.
+      while (HasPendingMessage() && batch_.size() < kMaxLogBatchSize) {
+        LogSlot& slot = slots_[dequeue_position_ & (kLogSlotCount - 1)];
+        batch_.append(slot.text, slot.length);
+        batch_ += '\n';
+        slot.sequence.store(dequeue_position_ + kLogSlotCount,
+                            std::memory_order_release);
+        dequeue_position_++;
+      }
+      if (!batch_.empty()) {
+        WriteLogBatch(batch_.data(), batch_.size());
+        batch_.clear();
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          written_position_ = dequeue_position_;
+        }
+        flushed_condition_.notify_all();
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      sleeping_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!HasPendingMessage()) {
+        wake_condition_.wait_for(lock,
+                                 std::chrono::milliseconds(kLogIdleWaitMs));
+      }
+      sleeping_.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  LogSlot slots_[kLogSlotCount];
+  std::atomic<size_t> enqueue_position_;
+  // Only accessed by the logging thread.
+  size_t dequeue_position_;
+  std::string batch_;
+
+  // Number of messages passed to WriteLogBatch(), guarded by mutex_.
+  size_t written_position_;
+  std::atomic<bool> sleeping_;
+  std::mutex mutex_;
+  // Signaled to wake the logging thread.
+  std::condition_variable wake_condition_;
+  // Signaled when written_position_ changes.
+  std::condition_variable flushed_condition_;
+};
+
+// The logger is intentionally never destroyed, so messages logged while the
+// process exits don't use a destroyed object.
+AsyncLogger* GetLogger() {
+  static AsyncLogger* logger = new AsyncLogger();
+  return logger;
+}
+
+}  // namespace
+
+void LogMessage(const char* format, ...) {
+  va_list list;
+  va_start(list, format);
+  LogMessageV(format, list);
+  va_end(list);
+}
+
+void LogMessageV(const char* format, va_list list) {
+  GetLogger()->Append(format, list);
+}
+
+void FlushLog() { GetLogger()->Flush(); }
+
+}  // namespace app_framework
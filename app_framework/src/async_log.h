@@ -0,0 +1,52 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_ASYNC_LOG_H_  // NOLINT
+#define FIREBASE_TESTAPP_ASYNC_LOG_H_  // NOLINT
+
+#include <stddef.h>
+
+// Asynchronous logging backend for LogMessage().
+//
+// LogMessage() formats each message once, directly into a slot of a
+// preallocated ring buffer, and returns. A single background thread drains the
+// ring buffer and hands the queued lines to the platform shell in batches via
+// WriteLogBatch(), so the cost of logcat / NSLog / stdout and of updating the
+// on-screen log is paid once per batch rather than on the logging thread for
+// every line.
+//
+// The ring buffer is a bounded multi-producer single-consumer queue: producers
+// claim a slot with a single atomic increment and never take a lock. When the
+// buffer is full producers wait for the background thread to free a slot, so
+// messages are never dropped.
+
+namespace app_framework {
+
+// Maximum length of a single message, longer messages are truncated.
+const size_t kMaxLogMessageLength = 1024;
+
+// Block until all messages logged before the call have been passed to
+// WriteLogBatch(). Called by the platform shells before exit and before
+// writing to the console directly.
+void FlushLog();
+
+// Write `length` bytes of `text`, consisting of one or more newline
+// terminated lines, to the platform's log. Called from the logging thread.
+// Implemented by android/android_main.cc, desktop/desktop_main.cc or
+// ios/ios_main.mm.
+void WriteLogBatch(const char* text, size_t length);
+
+}  // namespace app_framework
+
+#endif  // FIREBASE_TESTAPP_ASYNC_LOG_H_  // NOLINT
@@ -0,0 +1,618 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "benchmark.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "firebase/future.h"
+#include "allocation_scope.h"  // NOLINT
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "memory_usage.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+namespace app_framework {
+
+namespace {
+
+// Columns of the CSV results, in order.
+const char* const kCsvColumns[] = {
+    "label",           "product",         "scenario",
+    "iterations",      "failures",        "concurrency",
+    "duration_us",     "throughput",      "latency_mean_us",
+    "latency_p50_us",  "latency_p90_us",  "latency_p99_us",
+    "latency_max_us",  "allocations",     "allocated_bytes",
+    "rss_start_bytes", "rss_end_bytes",   "rss_peak_bytes",
+};
+const size_t kCsvColumnCount = sizeof(kCsvColumns) / sizeof(kCsvColumns[0]);
+
+// Returns the value of `argument` if it's `--<flag>=<value>`, else nullptr.
+const char* FlagValue(const char* argument, const char* flag) {
+  size_t length = strlen(flag);
+  if (strncmp(argument, "--", 2) != 0 ||
+      strncmp(argument + 2, flag, length) != 0 ||
+      argument[2 + length] != '=') {
+    return nullptr;
+  }
+  return argument + 2 + length + 1;
+}
+
+// Prefix relative paths with PathForResource().
+std::string ResolvePath(const std::string& path) {
+  if (path.empty() || path[0] == '/' || path[0] == '\\' ||
+      (path.size() > 1 && path[1] == ':')) {
+    return path;
+  }
+  return PathForResource() + path;
+}
+
+// Measurements made while a scenario runs.
+struct ScenarioRun {
+  ScenarioRun() : completed(0), failures(0), rss_peak_bytes(-1) {}
+
+  LatencyHistogram latency;
+  int completed;
+  int failures;
+  int64_t rss_peak_bytes;
+  std::string first_error;
+};
+
+struct PendingOperation {
+  firebase::FutureBase future;
+  int64_t start_us;
+};
+
+void CompleteOperation(const PendingOperation& operation, int64_t latency_us,
+                       ScenarioRun* run) {
+  run->latency.Record(latency_us);
+  run->completed++;
+  if (operation.future.status() != firebase::kFutureStatusInvalid &&
+      operation.future.error() != 0) {
+    if (run->failures == 0) {
+      const char* message = operation.future.error_message();
+      char error[256];
+      snprintf(error, sizeof(error), "%d, `%s`", operation.future.error(),
+               message ? message : "");
+      run->first_error = error;
+    }
+    run->failures++;
+  }
+  run->rss_peak_bytes =
+      std::max(run->rss_peak_bytes, GetResidentMemoryBytes());
+}
+
+// Run `count` operations, `concurrency` at a time, until they complete or
+// `deadline_us` passes. Returns false if they didn't all complete.
+bool RunOperations(const BenchmarkSuite::Operation& start_operation, int count,
+                   int concurrency, int64_t deadline_us, ScenarioRun* run) {
+  int started = 0;
+  std::vector<PendingOperation> in_flight;
+  while (run->completed < count) {
+    while (started < count &&
+           in_flight.size() < static_cast<size_t>(concurrency)) {
+      PendingOperation operation;
+      operation.start_us = GetMonotonicTimeInMicroseconds();
+      operation.future = start_operation();
+      started++;
+      if (operation.future.status() == firebase::kFutureStatusPending) {
+        in_flight.push_back(operation);
+      } else {
+        CompleteOperation(
+            operation, GetMonotonicTimeInMicroseconds() - operation.start_us,
+            run);
+      }
+    }
+    if (in_flight.empty()) continue;
+
+    int64_t remaining_ms =
+        (deadline_us - GetMonotonicTimeInMicroseconds()) / 1000;
+    std::vector<firebase::FutureBase> futures;
+    for (size_t i = 0; i < in_flight.size(); ++i) {
+      futures.push_back(in_flight[i].future);
+    }
+    int64_t wait_start_us = GetMonotonicTimeInMicroseconds();
+    std::vector<FutureWaitResult> results;
+    if (remaining_ms <= 0 ||
+        WaitForAny(futures, static_cast<int>(remaining_ms), &results) < 0) {
+      return false;
+    }
+
+    // Several operations may have completed during the wait. Each is timed
+    // to when its Future completed rather than to when it's processed here.
+    std::vector<PendingOperation> still_in_flight;
+    for (size_t i = 0; i < in_flight.size(); ++i) {
+      const PendingOperation& operation = in_flight[i];
+      if (operation.future.status() == firebase::kFutureStatusPending) {
+        still_in_flight.push_back(operation);
+      } else if (results[i].latency_us >= 0) {
+        CompleteOperation(operation,
+                          wait_start_us - operation.start_us +
+                              results[i].latency_us,
+                          run);
+      } else {
+        // Completed after the wait returned.
+        CompleteOperation(
+            operation, GetMonotonicTimeInMicroseconds() - operation.start_us,
+            run);
+      }
+    }
+    in_flight.swap(still_in_flight);
+  }
+  return true;
+}
+
+// Quote a CSV field if it contains a delimiter, quote or line break.
+std::string CsvField(const std::string& value) {
+  if (value.find_first_of(",\"\r\n") == std::string::npos) return value;
+  std::string quoted("\"");
+  for (size_t i = 0; i < value.size(); ++i) {
+    if (value[i] == '"') quoted += '"';
+    quoted += value[i];
+  }
+  return quoted + "\"";
+}
+
+// Split a line of CSV into its fields, unquoting them.
+std::vector<std::string> SplitCsvLine(const std::string& line) {
+  std::vector<std::string> fields(1);
+  bool quoted = false;
+  for (size_t i = 0; i < line.size(); ++i) {
+    char c = line[i];
+    if (quoted) {
+      if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+        fields.back() += '"';
+        ++i;
+      } else if (c == '"') {
+        quoted = false;
+      } else {
+        fields.back() += c;
+      }
+    } else if (c == '"') {
+      quoted = true;
+    } else if (c == ',') {
+      fields.push_back(std::string());
+    } else if (c != '\r' && c != '\n') {
+      fields.back() += c;
+    }
+  }
+  return fields;
+}
+
+std::string JsonString(const std::string& value) {
+  std::string escaped("\"");
+  for (size_t i = 0; i < value.size(); ++i) {
+    char c = value[i];
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char code[8];
+      snprintf(code, sizeof(code), "\\u%04x", c);
+      escaped += code;
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped + "\"";
+}
+
+std::string FormatInteger(int64_t value) {
+  char number[32];
+  snprintf(number, sizeof(number), "%lld",
+           static_cast<long long>(value));  // NOLINT
+  return number;
+}
+
+std::string FormatDouble(const char* format, double value) {
+  char number[32];
+  snprintf(number, sizeof(number), format, value);
+  return number;
+}
+
+// The fields of `result`, formatted in the order of kCsvColumns. Strings
+// aren't quoted.
+std::vector<std::string> ResultFields(const BenchmarkResult& result) {
+  std::vector<std::string> fields;
+  fields.push_back(result.label);
+  fields.push_back(result.product);
+  fields.push_back(result.scenario);
+  fields.push_back(FormatInteger(result.iterations));
+  fields.push_back(FormatInteger(result.failures));
+  fields.push_back(FormatInteger(result.concurrency));
+  fields.push_back(FormatInteger(result.duration_us));
+  fields.push_back(FormatDouble("%.3f", result.throughput));
+  fields.push_back(FormatDouble("%.1f", result.latency_mean_us));
+  fields.push_back(FormatInteger(result.latency_p50_us));
+  fields.push_back(FormatInteger(result.latency_p90_us));
+  fields.push_back(FormatInteger(result.latency_p99_us));
+  fields.push_back(FormatInteger(result.latency_max_us));
+  fields.push_back(FormatInteger(result.allocations));
+  fields.push_back(FormatInteger(result.allocated_bytes));
+  fields.push_back(FormatInteger(result.rss_start_bytes));
+  fields.push_back(FormatInteger(result.rss_end_bytes));
+  fields.push_back(FormatInteger(result.rss_peak_bytes));
+  return fields;
+}
+
+void AddRegression(const BenchmarkResult& result, const char* metric,
+                   double baseline, double current,
+                   std::vector<BenchmarkRegression>* regressions) {
+  BenchmarkRegression regression;
+  regression.product = result.product;
+  regression.scenario = result.scenario;
+  regression.metric = metric;
+  regression.baseline = baseline;
+  regression.current = current;
+  regressions->push_back(regression);
+}
+
+double FailureRate(const BenchmarkResult& result) {
+  return result.iterations > 0
+             ? static_cast<double>(result.failures) / result.iterations
+             : 0.0;
+}
+
+}  // namespace
+
+bool ParseBenchmarkOptions(int argc, const char* argv[],
+                           BenchmarkOptions* options) {
+  for (int i = 1; i < argc; ++i) {
+    const char* argument = argv[i];
+    const char* value;
+    if (strcmp(argument, "--benchmark") == 0) {
+      options->enabled = true;
+    } else if ((value = FlagValue(argument, "benchmark_filter"))) {
+      options->filter = value;
+      options->enabled = true;
+    } else if ((value = FlagValue(argument, "benchmark_warmup"))) {
+      options->warmup_iterations = std::max(0, atoi(value));
+      options->enabled = true;
+    } else if ((value = FlagValue(argument, "benchmark_iterations"))) {
+      options->iterations = std::max(1, atoi(value));
+      options->enabled = true;
+    } else if ((value = FlagValue(argument, "benchmark_concurrency"))) {
+      options->concurrency = std::max(1, atoi(value));
+      options->enabled = true;
+    } else if ((value = FlagValue(argument, "benchmark_label"))) {
+      options->label = value;
+      options->enabled = true;
+    } else if ((value = FlagValue(argument, "benchmark_json"))) {
+      options->json_path = value;
+      options->enabled = true;
+    } else if ((value = FlagValue(argument, "benchmark_csv"))) {
+      options->csv_path = value;
+      options->enabled = true;
+    } else if ((value = FlagValue(argument, "benchmark_baseline"))) {
+      options->baseline_path = value;
+      options->enabled = true;
+    } else if ((value = FlagValue(argument, "benchmark_threshold"))) {
+      options->regression_threshold = atof(value);
+      options->enabled = true;
+    }
+  }
+  return options->enabled;
+}
+
+bool IsBenchmarkSelected(const BenchmarkOptions& options,
+                         const std::string& product,
+                         const std::string& scenario) {
+  return (product + "/" + scenario).find(options.filter) != std::string::npos;
+}
+
+BenchmarkSuite::BenchmarkSuite(const char* product) : product_(product) {}
+
+void BenchmarkSuite::AddScenario(const char* name,
+                                 const Operation& operation) {
+  Scenario scenario;
+  scenario.name = name;
+  scenario.operation = operation;
+  scenarios_.push_back(scenario);
+}
+
+std::vector<BenchmarkResult> BenchmarkSuite::Run(
+    const BenchmarkOptions& options) {
+  std::vector<BenchmarkResult> results;
+  for (size_t i = 0; i < scenarios_.size(); ++i) {
+    if (!IsBenchmarkSelected(options, product_, scenarios_[i].name)) {
+      continue;
+    }
+    LogMessage("Benchmark %s/%s...", product_.c_str(),
+               scenarios_[i].name.c_str());
+    results.push_back(RunScenario(scenarios_[i], options));
+  }
+  return results;
+}
+
+BenchmarkResult BenchmarkSuite::RunScenario(const Scenario& scenario,
+                                            const BenchmarkOptions& options) {
+  BenchmarkResult result;
+  result.label = options.label;
+  result.product = product_;
+  result.scenario = scenario.name;
+  result.concurrency = options.concurrency;
+  int64_t deadline_us =
+      GetMonotonicTimeInMicroseconds() + options.timeout_ms * 1000LL;
+
+  // LatencyHistogram is too large to keep on the stack.
+  std::unique_ptr<ScenarioRun> warmup(new ScenarioRun);
+  if (!RunOperations(scenario.operation, options.warmup_iterations,
+                     options.concurrency, deadline_us, warmup.get())) {
+    LogMessage("ERROR: Benchmark %s/%s timed out during its warmup",
+               product_.c_str(), scenario.name.c_str());
+    return result;
+  }
+
+  std::unique_ptr<ScenarioRun> run(new ScenarioRun);
+  result.rss_start_bytes = GetResidentMemoryBytes();
+  run->rss_peak_bytes = result.rss_start_bytes;
+  HeapSnapshot heap_start = GetHeapSnapshot();
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  if (!RunOperations(scenario.operation, options.iterations,
+                     options.concurrency, deadline_us, run.get())) {
+    LogMessage("ERROR: Benchmark %s/%s timed out after %d of %d operations",
+               product_.c_str(), scenario.name.c_str(), run->completed,
+               options.iterations);
+  }
+  result.duration_us = GetMonotonicTimeInMicroseconds() - start_us;
+  HeapSnapshot heap_end = GetHeapSnapshot();
+  if (heap_start.allocations >= 0) {
+    result.allocations = heap_end.allocations - heap_start.allocations;
+    result.allocated_bytes =
+        heap_end.allocated_bytes - heap_start.allocated_bytes;
+  }
+  result.rss_end_bytes = GetResidentMemoryBytes();
+  result.rss_peak_bytes = std::max(run->rss_peak_bytes, result.rss_end_bytes);
+  if (run->failures > 0) {
+    LogMessage("ERROR: Benchmark %s/%s: %d operations failed, first with %s",
+               product_.c_str(), scenario.name.c_str(), run->failures,
+               run->first_error.c_str());
+  }
+
+  result.iterations = run->completed;
+  result.failures = run->failures;
+  result.throughput = result.duration_us > 0
+                          ? run->completed * 1000000.0 / result.duration_us
+                          : 0.0;
+  SetBenchmarkLatency(run->latency, &result);
+  return result;
+}
+
+void SetBenchmarkLatency(const LatencyHistogram& latency,
+                         BenchmarkResult* result) {
+  result->latency_mean_us = latency.mean();
+  result->latency_p50_us = latency.Percentile(50.0);
+  result->latency_p90_us = latency.Percentile(90.0);
+  result->latency_p99_us = latency.Percentile(99.0);
+  result->latency_max_us = latency.max();
+}
+
+bool WriteBenchmarkJson(const std::vector<BenchmarkResult>& results,
+                        const std::string& path) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) return false;
+  bool succeeded = fprintf(file, "[\n") > 0;
+  for (size_t i = 0; i < results.size(); ++i) {
+    std::vector<std::string> fields = ResultFields(results[i]);
+    succeeded = fprintf(file, "  {") > 0 && succeeded;
+    for (size_t j = 0; j < kCsvColumnCount; ++j) {
+      // The label, product and scenario are the only strings.
+      std::string value = j < 3 ? JsonString(fields[j]) : fields[j];
+      succeeded = fprintf(file, "%s\"%s\": %s", j ? ", " : "", kCsvColumns[j],
+                          value.c_str()) > 0 &&
+                  succeeded;
+    }
+    succeeded =
+        fprintf(file, "}%s\n", i + 1 < results.size() ? "," : "") > 0 &&
+        succeeded;
+  }
+  succeeded = fprintf(file, "]\n") > 0 && succeeded;
+  return fclose(file) == 0 && succeeded;
+}
+
+bool WriteBenchmarkCsv(const std::vector<BenchmarkResult>& results,
+                       const std::string& path) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) return false;
+  bool succeeded = true;
+  for (size_t j = 0; j < kCsvColumnCount; ++j) {
+    succeeded = fprintf(file, "%s%s", j ? "," : "", kCsvColumns[j]) > 0 &&
+                succeeded;
+  }
+  succeeded = fprintf(file, "\n") > 0 && succeeded;
+  for (size_t i = 0; i < results.size(); ++i) {
+    std::vector<std::string> fields = ResultFields(results[i]);
+    for (size_t j = 0; j < fields.size(); ++j) {
+      succeeded = fprintf(file, "%s%s", j ? "," : "",
+                          CsvField(fields[j]).c_str()) > 0 &&
+                  succeeded;
+    }
+    succeeded = fprintf(file, "\n") > 0 && succeeded;
+  }
+  return fclose(file) == 0 && succeeded;
+}
+
+bool ReadBenchmarkCsv(const std::string& path,
+                      std::vector<BenchmarkResult>* results) {
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file) return false;
+  // Look up columns by the header rather than their position, so results
+  // written before a column was added can still be read.
+  std::map<std::string, size_t> columns;
+  char buffer[4096];
+  bool header = true;
+  while (fgets(buffer, sizeof(buffer), file)) {
+    std::vector<std::string> fields = SplitCsvLine(buffer);
+    if (header) {
+      for (size_t i = 0; i < fields.size(); ++i) columns[fields[i]] = i;
+      header = false;
+      continue;
+    }
+    std::map<std::string, std::string> values;
+    for (std::map<std::string, size_t>::const_iterator it = columns.begin();
+         it != columns.end(); ++it) {
+      if (it->second < fields.size()) values[it->first] = fields[it->second];
+    }
+    if (values["product"].empty() || values["scenario"].empty()) continue;
+    BenchmarkResult result;
+    result.label = values["label"];
+    result.product = values["product"];
+    result.scenario = values["scenario"];
+    result.iterations = atoi(values["iterations"].c_str());
+    result.failures = atoi(values["failures"].c_str());
+    result.concurrency = atoi(values["concurrency"].c_str());
+    result.duration_us = atoll(values["duration_us"].c_str());
+    result.throughput = atof(values["throughput"].c_str());
+    result.latency_mean_us = atof(values["latency_mean_us"].c_str());
+    result.latency_p50_us = atoll(values["latency_p50_us"].c_str());
+    result.latency_p90_us = atoll(values["latency_p90_us"].c_str());
+    result.latency_p99_us = atoll(values["latency_p99_us"].c_str());
+    result.latency_max_us = atoll(values["latency_max_us"].c_str());
+    result.allocations = atoll(values["allocations"].c_str());
+    result.allocated_bytes = atoll(values["allocated_bytes"].c_str());
+    result.rss_start_bytes = atoll(values["rss_start_bytes"].c_str());
+    result.rss_end_bytes = atoll(values["rss_end_bytes"].c_str());
+    result.rss_peak_bytes = atoll(values["rss_peak_bytes"].c_str());
+    results->push_back(result);
+  }
+  fclose(file);
+  return true;
+}
+
+std::vector<BenchmarkRegression> CompareBenchmarkResults(
+    const std::vector<BenchmarkResult>& baseline,
+    const std::vector<BenchmarkResult>& current, double threshold) {
+  std::map<std::string, const BenchmarkResult*> baseline_results;
+  for (size_t i = 0; i < baseline.size(); ++i) {
+    baseline_results[baseline[i].product + "/" + baseline[i].scenario] =
+        &baseline[i];
+  }
+  std::vector<BenchmarkRegression> regressions;
+  for (size_t i = 0; i < current.size(); ++i) {
+    const BenchmarkResult& result = current[i];
+    std::map<std::string, const BenchmarkResult*>::const_iterator it =
+        baseline_results.find(result.product + "/" + result.scenario);
+    if (it == baseline_results.end()) continue;
+    const BenchmarkResult& before = *it->second;
+    if (before.latency_p50_us > 0 &&
+        result.latency_p50_us > before.latency_p50_us * (1.0 + threshold)) {
+      AddRegression(result, "latency_p50_us", before.latency_p50_us,
+                    result.latency_p50_us, &regressions);
+    }
+    if (before.latency_p99_us > 0 &&
+        result.latency_p99_us > before.latency_p99_us * (1.0 + threshold)) {
+      AddRegression(result, "latency_p99_us", before.latency_p99_us,
+                    result.latency_p99_us, &regressions);
+    }
+    if (result.throughput < before.throughput * (1.0 - threshold)) {
+      AddRegression(result, "throughput", before.throughput,
+                    result.throughput, &regressions);
+    }
+    if (FailureRate(result) > FailureRate(before)) {
+      AddRegression(result, "failure_rate", FailureRate(before),
+                    FailureRate(result), &regressions);
+    }
+  }
+  return regressions;
+}
+
+void LogBenchmarkResults(const std::vector<BenchmarkResult>& results) {
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchmarkResult& result = results[i];
+    LogMessage(
+        "Benchmark %s/%s: %d operations (%d failed), %d at a time, "
+        "%.1f ops/s",
+        result.product.c_str(), result.scenario.c_str(), result.iterations,
+        result.failures, result.concurrency, result.throughput);
+    LogMessage(
+        "  Latency mean %.1f ms, p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, "
+        "max %.1f ms",
+        result.latency_mean_us / 1000.0, result.latency_p50_us / 1000.0,
+        result.latency_p90_us / 1000.0, result.latency_p99_us / 1000.0,
+        result.latency_max_us / 1000.0);
+    if (result.allocations >= 0) {
+      LogMessage("  %lld allocations, %lld bytes",
+                 static_cast<long long>(result.allocations),       // NOLINT
+                 static_cast<long long>(result.allocated_bytes));  // NOLINT
+    }
+    if (result.rss_peak_bytes >= 0) {
+      LogMessage("  RSS %.1f MB -> %.1f MB, peak %.1f MB",
+                 result.rss_start_bytes / (1024.0 * 1024.0),
+                 result.rss_end_bytes / (1024.0 * 1024.0),
+                 result.rss_peak_bytes / (1024.0 * 1024.0));
+    }
+  }
+}
+
+int ReportBenchmarkResults(const std::vector<BenchmarkResult>& results,
+                           const BenchmarkOptions& options) {
+  LogBenchmarkResults(results);
+
+  bool succeeded = true;
+  if (!options.json_path.empty()) {
+    std::string path = ResolvePath(options.json_path);
+    if (WriteBenchmarkJson(results, path)) {
+      LogMessage("Wrote benchmark results to %s", path.c_str());
+    } else {
+      LogMessage("ERROR: Failed to write benchmark results to %s",
+                 path.c_str());
+      succeeded = false;
+    }
+  }
+  if (!options.csv_path.empty()) {
+    std::string path = ResolvePath(options.csv_path);
+    if (WriteBenchmarkCsv(results, path)) {
+      LogMessage("Wrote benchmark results to %s", path.c_str());
+    } else {
+      LogMessage("ERROR: Failed to write benchmark results to %s",
+                 path.c_str());
+      succeeded = false;
+    }
+  }
+  if (options.baseline_path.empty()) return succeeded ? 0 : -1;
+
+  std::string path = ResolvePath(options.baseline_path);
+  std::vector<BenchmarkResult> baseline;
+  if (!ReadBenchmarkCsv(path, &baseline)) {
+    LogMessage("ERROR: Failed to read benchmark baseline %s", path.c_str());
+    return -1;
+  }
+  std::vector<BenchmarkRegression> regressions =
+      CompareBenchmarkResults(baseline, results, options.regression_threshold);
+  for (size_t i = 0; i < regressions.size(); ++i) {
+    const BenchmarkRegression& regression = regressions[i];
+    LogMessage("REGRESSION: %s/%s %s %.3f -> %.3f",
+               regression.product.c_str(), regression.scenario.c_str(),
+               regression.metric.c_str(), regression.baseline,
+               regression.current);
+  }
+  LogMessage("%d benchmark regressions against %s",
+             static_cast<int>(regressions.size()), path.c_str());
+  return succeeded ? static_cast<int>(regressions.size()) : -1;
+}
+
+int RunBenchmarks(BenchmarkSuite* suite, const BenchmarkOptions& options) {
+  return ReportBenchmarkResults(suite->Run(options), options);
+}
+
+}  // namespace app_framework
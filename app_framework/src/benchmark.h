@@ -0,0 +1,234 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_BENCHMARK_H_  // NOLINT
+#define FIREBASE_TESTAPP_BENCHMARK_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "firebase/future.h"
+#include "timing.h"  // NOLINT
+
+namespace app_framework {
+
+// How BenchmarkSuite::Run() runs its scenarios and reports their results.
+struct BenchmarkOptions {
+  BenchmarkOptions()
+      : enabled(false),
+        warmup_iterations(2),
+        iterations(20),
+        concurrency(1),
+        timeout_ms(5 * 60 * 1000),
+        regression_threshold(0.1) {}
+
+  // Whether the testapp should run its benchmarks.
+  bool enabled;
+  // Only scenarios whose "product/scenario" name contains this are run, all
+  // of them if it's empty.
+  std::string filter;
+  // Operations run, and not measured, before each scenario's iterations.
+  int warmup_iterations;
+  // Operations measured in each scenario.
+  int iterations;
+  // Operations of a scenario in flight at once.
+  int concurrency;
+  // Time allowed for each scenario, including its warmup.
+  int timeout_ms;
+  // Recorded in the results, e.g. the version of the SDK under test.
+  std::string label;
+  // Files the results are written to, none if empty. A relative path is
+  // relative to PathForResource().
+  std::string json_path;
+  std::string csv_path;
+  // CSV results of an earlier run to compare the results with, none if
+  // empty.
+  std::string baseline_path;
+  // Relative change of latency or throughput, compared to the baseline, that
+  // counts as a regression.
+  double regression_threshold;
+};
+
+// Enable the benchmarks and override `options` with the command line flags
+// of desktop testapps:
+//   --benchmark
+//   --benchmark_filter=<substring>
+//   --benchmark_warmup=<operations>
+//   --benchmark_iterations=<operations>
+//   --benchmark_concurrency=<operations>
+//   --benchmark_label=<label>
+//   --benchmark_json=<path>
+//   --benchmark_csv=<path>
+//   --benchmark_baseline=<path>
+//   --benchmark_threshold=<fraction>
+// Each flag other than --benchmark implies it. Unknown arguments are ignored,
+// so other flags can be mixed in. Returns options->enabled.
+bool ParseBenchmarkOptions(int argc, const char* argv[],
+                           BenchmarkOptions* options);
+
+// Whether the scenario `scenario` of `product` is selected by
+// options.filter.
+bool IsBenchmarkSelected(const BenchmarkOptions& options,
+                         const std::string& product,
+                         const std::string& scenario);
+
+// Measurements of one scenario.
+struct BenchmarkResult {
+  BenchmarkResult()
+      : iterations(0),
+        failures(0),
+        concurrency(0),
+        duration_us(0),
+        throughput(0.0),
+        latency_mean_us(0.0),
+        latency_p50_us(0),
+        latency_p90_us(0),
+        latency_p99_us(0),
+        latency_max_us(0),
+        allocations(-1),
+        allocated_bytes(-1),
+        rss_start_bytes(-1),
+        rss_end_bytes(-1),
+        rss_peak_bytes(-1) {}
+
+  std::string label;
+  std::string product;
+  std::string scenario;
+  // Measured operations that completed, including failures.
+  int iterations;
+  // Operations whose Future completed with an error.
+  int failures;
+  int concurrency;
+  // Time taken by the measured operations.
+  int64_t duration_us;
+  // Operations completed per second.
+  double throughput;
+  // Time from starting each operation to its completion.
+  double latency_mean_us;
+  int64_t latency_p50_us;
+  int64_t latency_p90_us;
+  int64_t latency_p99_us;
+  int64_t latency_max_us;
+  // Heap allocations made, and bytes allocated, by the process during the
+  // measured operations, -1 if allocations aren't counted (see
+  // GetHeapSnapshot() in allocation_scope.h).
+  int64_t allocations;
+  int64_t allocated_bytes;
+  // Resident memory before and after the measured operations and the most
+  // seen as they completed, -1 if it can't be determined.
+  int64_t rss_start_bytes;
+  int64_t rss_end_bytes;
+  int64_t rss_peak_bytes;
+};
+
+// A metric of a scenario that got worse than its baseline.
+struct BenchmarkRegression {
+  std::string product;
+  std::string scenario;
+  // "latency_p50_us", "latency_p99_us", "throughput" or "failure_rate".
+  std::string metric;
+  double baseline;
+  double current;
+};
+
+// Benchmark scenarios of a product.
+//
+// Each scenario is an operation that starts a request and returns its
+// Future, e.g. a read of a database reference. Run() starts `concurrency`
+// operations of a scenario, starting the next as soon as one completes,
+// until `iterations` have completed after the warmup, and measures their
+// latency, the throughput and the memory used. A scenario that times out is
+// abandoned with its operations still in flight, so anything an operation
+// hands to the SDK, such as a buffer to download into, must be kept until its
+// Future completes even after Run() returns.
+//
+// Every testapp shares the options, flags and result formats, so the results
+// of several products can be concatenated and compared with another run of
+// the same scenarios, e.g. with the previous release of the SDK.
+class BenchmarkSuite {
+ public:
+  // Starts an operation, returning the Future that completes when it's done.
+  // An operation that completes synchronously returns an invalid Future,
+  // which counts as done without an error.
+  typedef std::function<firebase::FutureBase()> Operation;
+
+  explicit BenchmarkSuite(const char* product);
+
+  void AddScenario(const char* name, const Operation& operation);
+
+  // Run the scenarios selected by `options.filter`, in the order they were
+  // added. Must be called from the thread which uses the product's API.
+  std::vector<BenchmarkResult> Run(const BenchmarkOptions& options);
+
+  const char* product() const { return product_.c_str(); }
+
+ private:
+  struct Scenario {
+    std::string name;
+    Operation operation;
+  };
+
+  BenchmarkResult RunScenario(const Scenario& scenario,
+                              const BenchmarkOptions& options);
+
+  std::string product_;
+  std::vector<Scenario> scenarios_;
+};
+
+// Write `results` as a JSON array of objects, or as CSV with a header row,
+// with the fields of BenchmarkResult. Returns false if the file couldn't be
+// written.
+bool WriteBenchmarkJson(const std::vector<BenchmarkResult>& results,
+                        const std::string& path);
+bool WriteBenchmarkCsv(const std::vector<BenchmarkResult>& results,
+                       const std::string& path);
+// Read results written by WriteBenchmarkCsv(), appending them to `results`.
+// Returns false if the file couldn't be read.
+bool ReadBenchmarkCsv(const std::string& path,
+                      std::vector<BenchmarkResult>* results);
+
+// Compare the scenarios present in both `baseline` and `current`. A scenario
+// regresses when its p50 or p99 latency grows, or its throughput drops, by
+// more than `threshold` relative to the baseline, or a larger fraction of
+// its operations fail.
+std::vector<BenchmarkRegression> CompareBenchmarkResults(
+    const std::vector<BenchmarkResult>& baseline,
+    const std::vector<BenchmarkResult>& current, double threshold);
+
+// Set the latency fields of `result` from `latency`.
+void SetBenchmarkLatency(const LatencyHistogram& latency,
+                         BenchmarkResult* result);
+
+// Log the throughput, latency and memory of each result.
+void LogBenchmarkResults(const std::vector<BenchmarkResult>& results);
+
+// Log and write `results` as configured by `options`, and compare them with
+// the baseline if there is one, logging each regression. Used directly by
+// benchmarks whose operations take several steps, so they can't be a
+// BenchmarkSuite scenario, to report their results, together with those of
+// the product's suite, in the same files and against the same baseline.
+// Returns the number of regressions, or -1 if the results couldn't be
+// written or the baseline couldn't be read.
+int ReportBenchmarkResults(const std::vector<BenchmarkResult>& results,
+                           const BenchmarkOptions& options);
+
+// Run `suite` and report its results with ReportBenchmarkResults().
+int RunBenchmarks(BenchmarkSuite* suite, const BenchmarkOptions& options);
+
+}  // namespace app_framework
+
+#endif  // FIREBASE_TESTAPP_BENCHMARK_H_  // NOLINT
@@ -32,9 +32,15 @@
 #endif  // _WIN32
 
 #include <algorithm>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>  // NOLINT
 #include <string>
 
+#include "allocation_scope.h"  // NOLINT
+#include "async_log.h"  // NOLINT
 #include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
 
 // The TO_STRING macro is useful for command line defined strings as the quotes
 // get stripped.
@@ -52,6 +58,11 @@ extern "C" int common_main(int argc, const char* argv[]);
 
 static bool quit = false;
 
+// Used to wake the main thread while it's blocked in ProcessEvents().
+static std::mutex g_event_mutex;
+static std::condition_variable g_event_condition;
+static bool g_wake_requested = false;
+
 #ifdef _WIN32
 static BOOL WINAPI SignalHandler(DWORD event) {
   if (!(event == CTRL_C_EVENT || event == CTRL_BREAK_EVENT)) {
@@ -67,14 +78,21 @@ static void SignalHandler(int /* ignored */) { quit = true; }
 namespace app_framework {
 
 bool ProcessEvents(int msec) {
-#ifdef _WIN32
-  Sleep(msec);
-#else
-  usleep(msec * 1000);
-#endif  // _WIN32
+  std::unique_lock<std::mutex> lock(g_event_mutex);
+  g_event_condition.wait_for(lock, std::chrono::milliseconds(msec),
+                             [] { return g_wake_requested; });
+  g_wake_requested = false;
   return quit;
 }
 
+void WakeProcessEvents() {
+  {
+    std::lock_guard<std::mutex> lock(g_event_mutex);
+    g_wake_requested = true;
+  }
+  g_event_condition.notify_all();
+}
+
 std::string PathForResource() {
 #if defined(_WIN32)
   // On Windows we should hvae TEST_TMPDIR or TEMP or TMP set.
@@ -107,16 +125,8 @@ std::string PathForResource() {
   return std::string();
 }
 
-void LogMessage(const char* format, ...) {
-  va_list list;
-  va_start(list, format);
-  LogMessageV(format, list);
-  va_end(list);
-}
-
-void LogMessageV(const char* format, va_list list) {
-  vprintf(format, list);
-  printf("\n");
+void WriteLogBatch(const char* text, size_t length) {
+  fwrite(text, 1, length, stdout);
   fflush(stdout);
 }
 
@@ -144,9 +154,10 @@ int64_t WinGetCurrentTimeInMicroseconds() {
   now.LowPart = file_time.dwLowDateTime;
   now.HighPart = file_time.dwHighDateTime;
 
-  // Windows file time is expressed in 100s of nanoseconds.
-  // To convert to microseconds, multiply x10.
-  return now.QuadPart * 10LL;
+  // Windows file time is expressed in 100s of nanoseconds since
+  // January 1, 1601. Convert to microseconds since January 1, 1970.
+  static const int64_t kEpochOffsetMicroseconds = 11644473600000000LL;
+  return static_cast<int64_t>(now.QuadPart / 10) - kEpochOffsetMicroseconds;
 }
 #endif
 
@@ -156,6 +167,24 @@ void RunOnBackgroundThread(void* (*func)(void*), void* data) {
   thread.detach();
 }
 
+// Prompt for a line of text on the console. Reaching the end of stdin is
+// treated the same way as canceling the dialog on mobile platforms.
+std::string ReadTextInput(const char* title, const char* message,
+                          const char* placeholder) {
+  // Make sure the prompt follows any queued log messages.
+  FlushLog();
+  printf("%s\n%s [%s]: ", title, message, placeholder);
+  fflush(stdout);
+  char line[1024];
+  if (!fgets(line, sizeof(line), stdin)) return std::string();
+  std::string text(line);
+  while (!text.empty() &&
+         (text[text.size() - 1] == '\n' || text[text.size() - 1] == '\r')) {
+    text.erase(text.size() - 1);
+  }
+  return text;
+}
+
 }  // namespace app_framework
 
 int main(int argc, const char* argv[]) {
@@ -167,5 +196,9 @@ int main(int argc, const char* argv[]) {
 #else
   signal(SIGINT, SignalHandler);
 #endif  // _WIN32
-  return common_main(argc, argv);
+  int return_value = common_main(argc, argv);
+  app_framework::LogLatencyHistograms();
+  app_framework::LogAllocationScopes();
+  app_framework::FlushLog();
+  return return_value;
 }
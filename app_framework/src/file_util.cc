@@ -0,0 +1,47 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "file_util.h"  // NOLINT
+
+#include <stdio.h>
+
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif  // defined(_WIN32)
+
+namespace app_framework {
+
+bool WriteFileReplacing(const std::string& path, const std::string& contents) {
+  std::string temporary_path = path + ".tmp";
+  FILE* file = fopen(temporary_path.c_str(), "wb");
+  if (!file) return false;
+  bool succeeded =
+      fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+  succeeded = fclose(file) == 0 && succeeded;
+  if (succeeded) {
+#if defined(_WIN32)
+    // rename() fails on Windows if the destination exists.
+    succeeded = MoveFileExA(temporary_path.c_str(), path.c_str(),
+                            MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    succeeded = rename(temporary_path.c_str(), path.c_str()) == 0;
+#endif  // defined(_WIN32)
+  }
+  if (!succeeded) remove(temporary_path.c_str());
+  return succeeded;
+}
+
+}  // namespace app_framework
@@ -0,0 +1,31 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_FILE_UTIL_H_  // NOLINT
+#define FIREBASE_TESTAPP_FILE_UTIL_H_  // NOLINT
+
+#include <string>
+
+namespace app_framework {
+
+// Replace the file at `path` with `contents`, creating it if it doesn't
+// exist. The contents are written to a temporary file next to `path` which
+// then replaces it in a single rename, so readers see either the old file or
+// the new one, and a failed write leaves the old file as it was.
+// Returns true if the file was replaced.
+bool WriteFileReplacing(const std::string& path, const std::string& contents);
+
+}  // namespace app_framework
+
+#endif  // FIREBASE_TESTAPP_FILE_UTIL_H_  // NOLINT
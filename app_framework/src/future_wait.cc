@@ -0,0 +1,348 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "future_wait.h"  // NOLINT
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "firebase/future.h"
+#include "allocation_scope.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+namespace app_framework {
+
+namespace {
+
+// Upper bound on the time spent in a single ProcessEvents() call while
+// waiting. Completion normally wakes the waiter immediately, this only bounds
+// how long a missed wake-up can delay the waiter.
+const int kMaxEventWaitMs = 100;
+
+int64_t MicrosecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Shared between a waiter and the completion callbacks of the Futures it is
+// waiting on. Callbacks can run after the waiter has given up (e.g on
+// timeout) so the state is reference counted.
+struct WaitGroup {
+  explicit WaitGroup(size_t count)
+      : start(std::chrono::steady_clock::now()),
+        completed(0),
+        waiting(true),
+        completion_us(new std::atomic<int64_t>[count]) {
+    for (size_t i = 0; i < count; ++i) completion_us[i] = -1;
+  }
+
+  const std::chrono::steady_clock::time_point start;
+  std::atomic<size_t> completed;
+  std::atomic<bool> waiting;
+  // Time each Future completed relative to `start`, -1 while pending.
+  std::unique_ptr<std::atomic<int64_t>[]> completion_us;
+};
+
+void OnFutureCompletion(WaitGroup* group, size_t index) {
+  int64_t expected = -1;
+  if (group->completion_us[index].compare_exchange_strong(
+          expected, MicrosecondsSince(group->start))) {
+    group->completed++;
+  }
+  // Only wake the event loop if someone is still blocked on this group,
+  // otherwise an unrelated ProcessEvents() call would return early.
+  if (group->waiting) WakeProcessEvents();
+}
+
+// Marks Futures that are no longer pending as complete. Only needed if a
+// completion callback was replaced by another OnCompletion() call.
+void PollFutures(const std::vector<firebase::FutureBase>& futures,
+                 WaitGroup* group) {
+  for (size_t i = 0; i < futures.size(); ++i) {
+    if (group->completion_us[i] < 0 &&
+        futures[i].status() != firebase::kFutureStatusPending) {
+      int64_t expected = -1;
+      if (group->completion_us[i].compare_exchange_strong(
+              expected, MicrosecondsSince(group->start))) {
+        group->completed++;
+      }
+    }
+  }
+}
+
+// Waits until at least `required` of `futures` are no longer pending.
+// Invalid Futures count as finished. Returns kWaitResultComplete,
+// kWaitResultTimeout or kWaitResultExitRequested and optionally the outcome of
+// each Future.
+WaitResult Wait(const std::vector<firebase::FutureBase>& futures,
+                size_t required, int timeout_ms, bool stop_on_exit,
+                std::vector<FutureWaitResult>* results) {
+  std::shared_ptr<WaitGroup> group(new WaitGroup(futures.size()));
+  for (size_t i = 0; i < futures.size(); ++i) {
+    if (futures[i].status() != firebase::kFutureStatusPending) {
+      group->completion_us[i] = 0;
+      group->completed++;
+    } else {
+      // The Future destroys the callback, and its reference to the group,
+      // once it has run or when a later wait replaces it, so waiting
+      // repeatedly on a pending Future doesn't accumulate callbacks.
+      futures[i].OnCompletion([group, i](const firebase::FutureBase&) {
+        OnFutureCompletion(group.get(), i);
+      });
+    }
+  }
+  required = std::min(required, futures.size());
+
+  WaitResult result = kWaitResultComplete;
+  std::chrono::steady_clock::time_point last_poll = group->start;
+  while (group->completed < required) {
+    int wait_ms = kMaxEventWaitMs;
+    if (timeout_ms != kWaitForever) {
+      int64_t remaining_ms =
+          timeout_ms - MicrosecondsSince(group->start) / 1000;
+      if (remaining_ms <= 0) {
+        result = kWaitResultTimeout;
+        break;
+      }
+      wait_ms = static_cast<int>(
+          std::min(static_cast<int64_t>(wait_ms), remaining_ms));
+    }
+    if (ProcessEvents(wait_ms) && stop_on_exit) {
+      result = kWaitResultExitRequested;
+      break;
+    }
+    if (MicrosecondsSince(last_poll) >= kMaxEventWaitMs * 1000) {
+      PollFutures(futures, group.get());
+      last_poll = std::chrono::steady_clock::now();
+    }
+  }
+  group->waiting = false;
+
+  if (results) {
+    results->resize(futures.size());
+    for (size_t i = 0; i < futures.size(); ++i) {
+      FutureWaitResult& future_result = (*results)[i];
+      const firebase::FutureBase& future = futures[i];
+      future_result.latency_us = group->completion_us[i];
+      future_result.error = 0;
+      future_result.error_message.clear();
+      switch (future.status()) {
+        case firebase::kFutureStatusComplete:
+          future_result.result = kWaitResultComplete;
+          future_result.error = future.error();
+          if (future.error_message()) {
+            future_result.error_message = future.error_message();
+          }
+          break;
+        case firebase::kFutureStatusInvalid:
+          future_result.result = kWaitResultInvalid;
+          break;
+        case firebase::kFutureStatusPending:
+          future_result.result = result;
+          future_result.latency_us = -1;
+          break;
+      }
+    }
+  }
+  return result;
+}
+
+// Wait for a single Future. If `latency_us` is non-null it's set to the
+// time the Future took to complete, see FutureWaitResult::latency_us.
+WaitResult WaitForSingleFuture(const firebase::FutureBase& future,
+                               int timeout_ms, bool stop_on_exit,
+                               int64_t* latency_us) {
+  if (latency_us) *latency_us = -1;
+  if (future.status() == firebase::kFutureStatusInvalid) {
+    return kWaitResultInvalid;
+  }
+  std::vector<FutureWaitResult> results;
+  WaitResult result = Wait(std::vector<firebase::FutureBase>(1, future), 1,
+                           timeout_ms, stop_on_exit, &results);
+  if (latency_us) *latency_us = results[0].latency_us;
+  return result;
+}
+
+// Record the latency of an operation that was waited on. Futures that had
+// already completed when the wait started have an unknown latency, so they
+// aren't recorded.
+void RecordWaitLatency(const char* name, int64_t latency_us) {
+  if (latency_us > 0) RecordLatency(name, latency_us);
+}
+
+}  // namespace
+
+void EventCounter::Signal() {
+  count_.fetch_add(1, std::memory_order_release);
+  if (waiters_.load(std::memory_order_acquire) > 0) WakeProcessEvents();
+}
+
+WaitResult EventCounter::WaitForCount(int count, int timeout_ms) const {
+  return WaitUntil([this, count]() { return this->count() >= count; },
+                   timeout_ms);
+}
+
+WaitResult EventCounter::WaitUntil(const std::function<bool()>& predicate,
+                                   int timeout_ms) const {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  waiters_.fetch_add(1, std::memory_order_acq_rel);
+  WaitResult result = kWaitResultComplete;
+  while (!predicate()) {
+    int wait_ms = kMaxEventWaitMs;
+    if (timeout_ms != kWaitForever) {
+      int64_t remaining_ms = timeout_ms - MicrosecondsSince(start) / 1000;
+      if (remaining_ms <= 0) {
+        result = kWaitResultTimeout;
+        break;
+      }
+      wait_ms = static_cast<int>(
+          std::min(static_cast<int64_t>(wait_ms), remaining_ms));
+    }
+    if (ProcessEvents(wait_ms)) {
+      result = kWaitResultExitRequested;
+      break;
+    }
+  }
+  waiters_.fetch_sub(1, std::memory_order_acq_rel);
+  return result;
+}
+
+bool WaitForEvents(const EventCounter& counter, int count, const char* name,
+                   int timeout_ms) {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  bool already_received = counter.count() >= count;
+  WaitResult result = counter.WaitForCount(count, timeout_ms);
+  if (result == kWaitResultTimeout) {
+    LogMessage("ERROR: %s timed out after receiving %d of %d events.", name,
+               counter.count(), count);
+    return false;
+  }
+  if (!already_received) RecordWaitLatency(name, MicrosecondsSince(start));
+  return result == kWaitResultComplete;
+}
+
+WaitResult WaitForFuture(const firebase::FutureBase& future, int timeout_ms) {
+  return WaitForSingleFuture(future, timeout_ms, true, nullptr);
+}
+
+bool WaitForCompletion(const firebase::FutureBase& future, const char* name,
+                       int timeout_ms) {
+  AllocationScope allocation_scope(name);
+  int64_t latency_us;
+  if (WaitForSingleFuture(future, timeout_ms, false, &latency_us) ==
+      kWaitResultTimeout) {
+    LogMessage("ERROR: %s timed out.", name);
+    return false;
+  }
+  RecordWaitLatency(name, latency_us);
+  if (future.status() != firebase::kFutureStatusComplete) {
+    LogMessage("ERROR: %s returned an invalid result.", name);
+    return false;
+  } else if (future.error() != 0) {
+    LogMessage("ERROR: %s returned error %d: %s", name, future.error(),
+               future.error_message());
+    return false;
+  }
+  return true;
+}
+
+std::vector<FutureWaitResult> WaitForAll(
+    const std::vector<firebase::FutureBase>& futures, int timeout_ms) {
+  std::vector<FutureWaitResult> results;
+  Wait(futures, futures.size(), timeout_ms, false, &results);
+  return results;
+}
+
+std::vector<FutureWaitResult> WaitForAll(
+    std::initializer_list<firebase::FutureBase> futures, int timeout_ms) {
+  return WaitForAll(std::vector<firebase::FutureBase>(futures), timeout_ms);
+}
+
+int WaitForAny(const std::vector<firebase::FutureBase>& futures,
+               int timeout_ms, std::vector<FutureWaitResult>* results) {
+  std::vector<FutureWaitResult> local_results;
+  if (!results) results = &local_results;
+  Wait(futures, 1, timeout_ms, true, results);
+  int first = -1;
+  for (size_t i = 0; i < results->size(); ++i) {
+    const FutureWaitResult& result = (*results)[i];
+    if (result.latency_us >= 0 &&
+        (first < 0 || result.latency_us < (*results)[first].latency_us)) {
+      first = static_cast<int>(i);
+    }
+  }
+  return first;
+}
+
+int WaitForAny(std::initializer_list<firebase::FutureBase> futures,
+               int timeout_ms, std::vector<FutureWaitResult>* results) {
+  return WaitForAny(std::vector<firebase::FutureBase>(futures), timeout_ms,
+                    results);
+}
+
+bool LogWaitResults(const std::vector<FutureWaitResult>& results,
+                    std::initializer_list<const char*> names) {
+  bool succeeded = true;
+  int64_t slowest_us = -1;
+  const char* slowest_name = "";
+  std::initializer_list<const char*>::iterator name = names.begin();
+  for (size_t i = 0; i < results.size(); ++i) {
+    const char* result_name = "(unnamed)";
+    if (name != names.end()) result_name = *name++;
+    const FutureWaitResult& result = results[i];
+    switch (result.result) {
+      case kWaitResultComplete:
+        if (result.error != 0) {
+          LogMessage("ERROR: %s returned error %d: %s", result_name,
+                     result.error, result.error_message.c_str());
+          succeeded = false;
+        }
+        break;
+      case kWaitResultTimeout:
+        LogMessage("ERROR: %s timed out.", result_name);
+        succeeded = false;
+        break;
+      case kWaitResultExitRequested:
+        succeeded = false;
+        break;
+      case kWaitResultInvalid:
+        LogMessage("ERROR: %s returned an invalid result.", result_name);
+        succeeded = false;
+        break;
+    }
+    RecordWaitLatency(result_name, result.latency_us);
+    if (result.latency_us > slowest_us) {
+      slowest_us = result.latency_us;
+      slowest_name = result_name;
+    }
+  }
+  if (slowest_us >= 0) {
+    LogMessage("  %d operations finished within %.1f ms (slowest: %s)",
+               static_cast<int>(results.size()),
+               static_cast<double>(slowest_us) / 1000.0, slowest_name);
+  }
+  return succeeded;
+}
+
+}  // namespace app_framework
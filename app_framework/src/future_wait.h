@@ -0,0 +1,161 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_FUTURE_WAIT_H_  // NOLINT
+#define FIREBASE_TESTAPP_FUTURE_WAIT_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "firebase/future.h"
+
+namespace app_framework {
+
+// Timeout value that makes the wait methods below block until the Future
+// completes.
+const int kWaitForever = -1;
+
+// Result of WaitForFuture().
+enum WaitResult {
+  // The Future completed, either successfully or with an error.
+  kWaitResultComplete = 0,
+  // The Future was still pending when the timeout expired.
+  kWaitResultTimeout,
+  // ProcessEvents() reported that the application should exit.
+  kWaitResultExitRequested,
+  // The Future was never started.
+  kWaitResultInvalid,
+};
+
+// Block until `future` is no longer pending, `timeout_ms` elapses or the
+// application is asked to exit. Platform events are processed while waiting.
+//
+// Rather than polling the Future, this registers a completion callback that
+// wakes the thread blocked in ProcessEvents(), so the wait ends as soon as the
+// result is available.
+//
+// NOTE: The callback is registered with FutureBase::OnCompletion(), which
+// replaces any callback already registered on `future`.
+WaitResult WaitForFuture(const firebase::FutureBase& future,
+                         int timeout_ms = kWaitForever);
+
+// Wait for a Future to be completed. If the Future returns an error, it will
+// be logged. Unlike WaitForFuture() this keeps waiting if the application is
+// asked to exit, so the Future's result is always available to the caller
+// when no timeout is specified.
+// The time taken for the Future to complete is recorded in the latency
+// histogram named `name`, see timing.h.
+// Returns true if the Future completed without an error.
+bool WaitForCompletion(const firebase::FutureBase& future, const char* name,
+                       int timeout_ms = kWaitForever);
+
+// Outcome of a single Future passed to WaitForAll() or WaitForAny().
+struct FutureWaitResult {
+  // kWaitResultComplete if the Future finished. Otherwise the reason the wait
+  // ended while the Future was still pending, or kWaitResultInvalid.
+  WaitResult result;
+  // Error code and message of a completed Future.
+  int error;
+  std::string error_message;
+  // Time from the start of the wait to the Future's completion, 0 if it had
+  // already completed when the wait started and -1 if it didn't complete.
+  int64_t latency_us;
+};
+
+// Block until all `futures` are no longer pending or `timeout_ms` elapses.
+// The timeout applies to the whole group rather than to each Future, so
+// waiting on N requests issued together takes as long as the slowest of them
+// rather than roughly the sum of their latencies. Like WaitForCompletion()
+// this doesn't stop when the application is asked to exit.
+// Returns the outcome of each Future, in the order they were passed.
+std::vector<FutureWaitResult> WaitForAll(
+    std::initializer_list<firebase::FutureBase> futures,
+    int timeout_ms = kWaitForever);
+std::vector<FutureWaitResult> WaitForAll(
+    const std::vector<firebase::FutureBase>& futures,
+    int timeout_ms = kWaitForever);
+
+// Block until any of `futures` is no longer pending, `timeout_ms` elapses or
+// the application is asked to exit.
+// Returns the index of the first Future to complete, or -1 if none completed.
+// If `results` is non-null it's populated with the outcome of every Future.
+int WaitForAny(std::initializer_list<firebase::FutureBase> futures,
+               int timeout_ms = kWaitForever,
+               std::vector<FutureWaitResult>* results = nullptr);
+int WaitForAny(const std::vector<firebase::FutureBase>& futures,
+               int timeout_ms = kWaitForever,
+               std::vector<FutureWaitResult>* results = nullptr);
+
+// Log each failed entry of `results` using the matching entry of `names`,
+// followed by a summary of the time taken by the slowest operation. Like
+// WaitForCompletion() the latency of each operation is recorded in the latency
+// histogram with the matching name.
+// Returns true if every Future completed without an error.
+bool LogWaitResults(const std::vector<FutureWaitResult>& results,
+                    std::initializer_list<const char*> names);
+
+// Counts the events received by a listener so a test can wait for the events
+// it expects rather than sleeping for a fixed time.
+//
+// The listener calls Signal() from its callbacks, on any thread, after
+// updating its own state. This wakes the thread blocked in WaitForCount() or
+// WaitUntil(), and state written before Signal() is visible to a thread that
+// has observed the new count.
+class EventCounter {
+ public:
+  EventCounter() : count_(0), waiters_(0) {}
+
+  // Record an event.
+  void Signal();
+
+  // Number of times Signal() was called.
+  int count() const { return count_.load(std::memory_order_acquire); }
+
+  // Block until count() is at least `count`, `timeout_ms` elapses or the
+  // application is asked to exit. Platform events are processed while
+  // waiting.
+  WaitResult WaitForCount(int count, int timeout_ms = kWaitForever) const;
+
+  // Like WaitForCount() but waits until `predicate` returns true. The
+  // predicate is evaluated on the waiting thread when the wait starts and
+  // after each Signal(), so it should only read state that the listener
+  // updates before signaling.
+  WaitResult WaitUntil(const std::function<bool()>& predicate,
+                       int timeout_ms = kWaitForever) const;
+
+ private:
+  EventCounter(const EventCounter&) = delete;
+  EventCounter& operator=(const EventCounter&) = delete;
+
+  std::atomic<int> count_;
+  // Number of threads blocked in a wait, Signal() only wakes the event loop
+  // if there are any.
+  mutable std::atomic<int> waiters_;
+};
+
+// Wait for `counter` to reach `count` events, logging an error if that
+// doesn't happen within `timeout_ms`. The time the events took to arrive is
+// recorded in the latency histogram named `name`, see timing.h.
+// Returns true if all events were received.
+bool WaitForEvents(const EventCounter& counter, int count, const char* name,
+                   int timeout_ms = kWaitForever);
+
+}  // namespace app_framework
+
+#endif  // FIREBASE_TESTAPP_FUTURE_WAIT_H_  // NOLINT
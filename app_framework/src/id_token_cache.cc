@@ -0,0 +1,344 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "id_token_cache.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+
+#include "firebase/auth.h"
+#include "firebase/future.h"
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+namespace app_framework {
+
+namespace {
+
+// Lifetime assumed for a token whose expiry can't be read.
+const int64_t kDefaultTokenLifetimeUs = 60LL * 60 * 1000000;
+// Shortest gap between refreshes, which is also the first retry delay.
+const int64_t kMinRefreshIntervalUs =
+    static_cast<int64_t>(IdTokenCache::kMinRefreshIntervalMs) * 1000;
+// Longest delay before retrying a failed refresh.
+const int64_t kMaxRetryDelayUs = 5LL * 60 * 1000000;
+
+// Decode base64url without padding, as used by JWTs. Stops at the first
+// character that isn't part of the alphabet.
+std::string Base64UrlDecode(const std::string& input) {
+  std::string output;
+  output.reserve(input.size() * 3 / 4);
+  uint32_t bits = 0;
+  int bit_count = 0;
+  for (size_t i = 0; i < input.size(); ++i) {
+    char c = input[i];
+    int value;
+    if (c >= 'A' && c <= 'Z') {
+      value = c - 'A';
+    } else if (c >= 'a' && c <= 'z') {
+      value = c - 'a' + 26;
+    } else if (c >= '0' && c <= '9') {
+      value = c - '0' + 52;
+    } else if (c == '-' || c == '+') {
+      value = 62;
+    } else if (c == '_' || c == '/') {
+      value = 63;
+    } else {
+      break;
+    }
+    bits = (bits << 6) | value;
+    bit_count += 6;
+    if (bit_count >= 8) {
+      bit_count -= 8;
+      output.push_back(static_cast<char>((bits >> bit_count) & 0xff));
+    }
+  }
+  return output;
+}
+
+// Read the integer claim whose quoted name, followed by a colon, is `claim`
+// from the JSON `payload`. Returns 0 if it's missing.
+int64_t ReadClaim(const std::string& payload, const char* claim) {
+  size_t position = payload.find(claim);
+  if (position == std::string::npos) return 0;
+  return strtoll(payload.c_str() + position + strlen(claim), nullptr, 10);
+}
+
+// Lifetime of `token`, from its "iat" (issued at) to its "exp" (expiry)
+// claims. Both are on the issuer's clock, so unlike the time left until
+// "exp" on this device's clock the lifetime doesn't depend on the device's
+// clock being right. If `may_be_stale`, the token may have been issued a
+// while ago, e.g. by a previous run of the app, so the lifetime is also
+// bounded by the time left on the device's clock when that's plausible.
+// Returns kDefaultTokenLifetimeUs if the token can't be parsed.
+int64_t GetTokenLifetimeUs(const std::string& token, bool may_be_stale) {
+  size_t payload_start = token.find('.');
+  if (payload_start == std::string::npos) return kDefaultTokenLifetimeUs;
+  payload_start++;
+  size_t payload_end = token.find('.', payload_start);
+  if (payload_end == std::string::npos) return kDefaultTokenLifetimeUs;
+  std::string payload =
+      Base64UrlDecode(token.substr(payload_start, payload_end - payload_start));
+
+  int64_t issued_seconds = ReadClaim(payload, "\"iat\":");
+  int64_t expiry_seconds = ReadClaim(payload, "\"exp\":");
+  if (issued_seconds <= 0 || expiry_seconds <= issued_seconds) {
+    return kDefaultTokenLifetimeUs;
+  }
+  int64_t lifetime_us = std::min((expiry_seconds - issued_seconds) * 1000000,
+                                 kDefaultTokenLifetimeUs);
+  if (may_be_stale) {
+    // A device clock past the expiry is wrong rather than the token expired,
+    // the SDK doesn't hand out expired tokens, so it's ignored.
+    int64_t remaining_us =
+        (expiry_seconds - static_cast<int64_t>(time(nullptr))) * 1000000;
+    if (remaining_us > 0) lifetime_us = std::min(lifetime_us, remaining_us);
+  }
+  return lifetime_us;
+}
+
+}  // namespace
+
+const int IdTokenCache::kDefaultRefreshMarginMs;
+const int IdTokenCache::kMinRefreshIntervalMs;
+
+struct IdTokenCache::PendingFetch {
+  PendingFetch() : done(false) {}
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  // Set when the call completes or the cache stops waiting for it.
+  bool done;
+};
+
+IdTokenCache::IdTokenCache(firebase::auth::Auth* auth, int refresh_margin_ms)
+    : auth_(auth),
+      refresh_margin_us_(static_cast<int64_t>(refresh_margin_ms) * 1000),
+      expires_us_(0),
+      refresh_us_(-1),
+      earliest_refresh_us_(0),
+      retry_delay_us_(kMinRefreshIntervalUs),
+      force_refresh_(false),
+      stopping_(false) {
+  thread_ = std::thread(&IdTokenCache::Run, this);
+  // Registering calls OnIdTokenChanged(), which fetches the token if a user
+  // is already signed in.
+  auth_->AddIdTokenListener(this);
+}
+
+IdTokenCache::~IdTokenCache() {
+  auth_->RemoveIdTokenListener(this);
+  std::shared_ptr<PendingFetch> pending_fetch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    pending_fetch = pending_fetch_;
+  }
+  condition_.notify_all();
+  // Wake the refresh thread if it's waiting for User::GetToken(), which
+  // could take as long as the SDK's own network timeout.
+  if (pending_fetch) {
+    std::lock_guard<std::mutex> lock(pending_fetch->mutex);
+    pending_fetch->done = true;
+    pending_fetch->condition.notify_all();
+  }
+  thread_.join();
+}
+
+bool IdTokenCache::GetToken(std::string* token) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  int64_t now_us = GetMonotonicTimeInMicroseconds();
+  if (!token_.empty() && now_us < expires_us_) {
+    stats_.hits++;
+    *token = token_;
+    return true;
+  }
+  stats_.misses++;
+  if (refresh_us_ < 0 || refresh_us_ > now_us) {
+    refresh_us_ = now_us;
+    condition_.notify_all();
+  }
+  return false;
+}
+
+bool IdTokenCache::WaitForToken(int timeout_ms) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  int64_t now_us = GetMonotonicTimeInMicroseconds();
+  if (!token_.empty() && now_us < expires_us_) return true;
+  if (refresh_us_ < 0 || refresh_us_ > now_us) {
+    refresh_us_ = now_us;
+    condition_.notify_all();
+  }
+  return condition_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                             [this] {
+                               return !token_.empty() &&
+                                      GetMonotonicTimeInMicroseconds() <
+                                          expires_us_;
+                             });
+}
+
+void IdTokenCache::Refresh() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  refresh_us_ = GetMonotonicTimeInMicroseconds();
+  force_refresh_ = true;
+  condition_.notify_all();
+}
+
+IdTokenCacheStats IdTokenCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+int64_t IdTokenCache::expires_in_us() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (token_.empty()) return -1;
+  return std::max(static_cast<int64_t>(0),
+                  expires_us_ - GetMonotonicTimeInMicroseconds());
+}
+
+void IdTokenCache::LogStats() const {
+  IdTokenCacheStats counters = stats();
+  LogMessage("ID token cache: %d hits, %d misses, %d refreshes (%d failed).",
+             counters.hits, counters.misses, counters.refreshes,
+             counters.failed_refreshes);
+  if (refresh_latency_.count() > 0) {
+    LogMessage("  Refresh latency p50 %.1f ms, p99 %.1f ms.",
+               refresh_latency_.Percentile(50.0) / 1000.0,
+               refresh_latency_.Percentile(99.0) / 1000.0);
+  }
+  int64_t expires_in = expires_in_us();
+  if (expires_in >= 0) {
+    LogMessage("  Token expires in %lld s.",
+               static_cast<long long>(expires_in / 1000000));  // NOLINT
+  }
+}
+
+void IdTokenCache::OnIdTokenChanged(firebase::auth::Auth* auth) {
+  // Only schedule the fetch, keeping the listener, which the SDK calls on its
+  // own thread, short. A refresh by this cache also notifies the listener,
+  // which costs one more fetch that the SDK answers from its own cache.
+  firebase::auth::User* user = auth->current_user();
+  std::string user_id = user ? user->uid() : std::string();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (user_id != user_id_) {
+    // The minimum interval and backoff only apply to refreshes of the same
+    // user's token, a new user's is fetched straight away.
+    user_id_ = user_id;
+    token_.clear();
+    expires_us_ = 0;
+    earliest_refresh_us_ = 0;
+    retry_delay_us_ = kMinRefreshIntervalUs;
+  }
+  refresh_us_ = user ? GetMonotonicTimeInMicroseconds() : -1;
+  force_refresh_ = false;
+  condition_.notify_all();
+}
+
+void IdTokenCache::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    if (refresh_us_ < 0) {
+      condition_.wait(lock);
+      continue;
+    }
+    int64_t wait_us = std::max(refresh_us_, earliest_refresh_us_) -
+                      GetMonotonicTimeInMicroseconds();
+    if (wait_us > 0) {
+      condition_.wait_for(lock, std::chrono::microseconds(wait_us));
+      continue;
+    }
+    bool force_refresh = force_refresh_;
+    refresh_us_ = -1;
+    force_refresh_ = false;
+    FetchToken(force_refresh, &lock);
+  }
+}
+
+void IdTokenCache::FetchToken(bool force_refresh,
+                              std::unique_lock<std::mutex>* lock) {
+  std::shared_ptr<PendingFetch> pending_fetch(new PendingFetch);
+  pending_fetch_ = pending_fetch;
+  lock->unlock();
+  firebase::auth::User* user = auth_->current_user();
+  if (user == nullptr) {
+    lock->lock();
+    pending_fetch_.reset();
+    token_.clear();
+    expires_us_ = 0;
+    return;
+  }
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  firebase::Future<std::string> future = user->GetToken(force_refresh);
+  // The callback only holds the shared state, so it's safe to run after the
+  // cache is destroyed.
+  future.OnCompletion(
+      [pending_fetch](const firebase::Future<std::string>& /*future*/) {
+        std::lock_guard<std::mutex> fetch_lock(pending_fetch->mutex);
+        pending_fetch->done = true;
+        pending_fetch->condition.notify_all();
+      });
+  {
+    std::unique_lock<std::mutex> fetch_lock(pending_fetch->mutex);
+    pending_fetch->condition.wait(
+        fetch_lock, [&pending_fetch] { return pending_fetch->done; });
+  }
+  lock->lock();
+  pending_fetch_.reset();
+  if (stopping_) return;
+  int64_t now_us = GetMonotonicTimeInMicroseconds();
+  refresh_latency_.Record(now_us - start_us);
+  RecordLatency("IdTokenCache refresh", now_us - start_us);
+
+  stats_.refreshes++;
+  // Keep any refresh requested while this one was in flight.
+  int64_t next_refresh_us;
+  if (future.error() != firebase::auth::kAuthErrorNone || !future.result()) {
+    stats_.failed_refreshes++;
+    LogMessage("ERROR: Failed to refresh the ID token, error %d: %s",
+               future.error(), future.error_message());
+    earliest_refresh_us_ = now_us + retry_delay_us_;
+    retry_delay_us_ = std::min(retry_delay_us_ * 2, kMaxRetryDelayUs);
+    next_refresh_us = earliest_refresh_us_;
+  } else {
+    // The expiry of a token that's already cached is known from when it was
+    // received. Without a forced refresh the SDK may return a token it has
+    // held for a while.
+    if (*future.result() != token_) {
+      token_ = *future.result();
+      expires_us_ = now_us + GetTokenLifetimeUs(token_, !force_refresh);
+    }
+    earliest_refresh_us_ = now_us + kMinRefreshIntervalUs;
+    retry_delay_us_ = kMinRefreshIntervalUs;
+    next_refresh_us = std::max(earliest_refresh_us_,
+                               expires_us_ - refresh_margin_us_);
+    condition_.notify_all();
+  }
+  if (refresh_us_ < 0 || refresh_us_ > next_refresh_us) {
+    refresh_us_ = next_refresh_us;
+    // The SDK would hand back the token it has until it expires.
+    force_refresh_ = true;
+  }
+}
+
+}  // namespace app_framework
@@ -0,0 +1,134 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_ID_TOKEN_CACHE_H_  // NOLINT
+#define FIREBASE_TESTAPP_ID_TOKEN_CACHE_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <condition_variable>  // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+
+#include "firebase/auth.h"
+#include "timing.h"  // NOLINT
+
+// Unlike the rest of the framework this depends on firebase_auth, so it isn't
+// part of the app_framework library: samples that use Auth add
+// id_token_cache.cc to their own sources.
+
+namespace app_framework {
+
+// Counters of an IdTokenCache.
+struct IdTokenCacheStats {
+  IdTokenCacheStats() : hits(0), misses(0), refreshes(0), failed_refreshes(0) {}
+
+  // GetToken() calls that found an unexpired token.
+  int hits;
+  // GetToken() calls that didn't, each of which requests a refresh.
+  int misses;
+  // Completed User::GetToken() calls, including failed ones.
+  int refreshes;
+  int failed_refreshes;
+};
+
+// Caches the ID token of the signed-in user and refreshes it on a background
+// thread `refresh_margin_ms` before it expires, so neither the app nor the
+// SDK, which shares the refreshed token, has to fetch one on the request path
+// when the hour-long token lifetime runs out.
+//
+// Expiry is tracked on the monotonic clock, from the lifetime the token's
+// claims give it, so a device whose wall clock is wrong doesn't refresh too
+// early or too late. Refreshes are at least kMinRefreshIntervalMs apart, and
+// failed ones are retried with exponential backoff.
+//
+// The cache follows the user through IdTokenListener: signing in fetches the
+// new user's token, signing out clears it.
+//
+// `auth` must outlive the cache. Methods can be called from any thread.
+class IdTokenCache : public firebase::auth::IdTokenListener {
+ public:
+  static const int kDefaultRefreshMarginMs = 5 * 60 * 1000;
+  static const int kMinRefreshIntervalMs = 10 * 1000;
+
+  explicit IdTokenCache(firebase::auth::Auth* auth,
+                        int refresh_margin_ms = kDefaultRefreshMarginMs);
+  // Stops the refresh thread, abandoning a refresh in progress.
+  ~IdTokenCache() override;
+
+  // Copy the cached token to `token` if it hasn't expired. Otherwise counts a
+  // miss, requests a refresh and returns false.
+  bool GetToken(std::string* token);
+  // Wait up to `timeout_ms` for an unexpired token. Returns true if there is
+  // one.
+  bool WaitForToken(int timeout_ms);
+  // Force a refresh of the token as soon as the minimum refresh interval
+  // allows, rather than shortly before it expires.
+  void Refresh();
+
+  IdTokenCacheStats stats() const;
+  // Time taken by each User::GetToken() call.
+  const LatencyHistogram& refresh_latency() const { return refresh_latency_; }
+  // Time until the cached token expires, -1 if there's none.
+  int64_t expires_in_us() const;
+  // Log the counters and refresh latency.
+  void LogStats() const;
+
+  void OnIdTokenChanged(firebase::auth::Auth* auth) override;
+
+ private:
+  // State shared with the completion callback of a User::GetToken() call,
+  // which may outlive the cache.
+  struct PendingFetch;
+
+  IdTokenCache(const IdTokenCache&) = delete;
+  IdTokenCache& operator=(const IdTokenCache&) = delete;
+
+  // Body of the refresh thread.
+  void Run();
+  // Fetch the current user's token, waiting for it with the lock released.
+  void FetchToken(bool force_refresh, std::unique_lock<std::mutex>* lock);
+
+  firebase::auth::Auth* auth_;
+  int64_t refresh_margin_us_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::string token_;
+  // Monotonic time at which token_ expires, 0 if there's no token.
+  int64_t expires_us_;
+  // Monotonic time of the next refresh, -1 if none is scheduled.
+  int64_t refresh_us_;
+  // No refresh starts before this monotonic time, which enforces the minimum
+  // refresh interval and the backoff after failures.
+  int64_t earliest_refresh_us_;
+  // Delay before retrying a failed refresh, doubled by each failure in a row.
+  int64_t retry_delay_us_;
+  // User whose token is cached.
+  std::string user_id_;
+  // Whether the next refresh should bypass the SDK's own cached token.
+  bool force_refresh_;
+  bool stopping_;
+  // The User::GetToken() call in flight, if any.
+  std::shared_ptr<PendingFetch> pending_fetch_;
+  IdTokenCacheStats stats_;
+  LatencyHistogram refresh_latency_;
+  std::thread thread_;
+};
+
+}  // namespace app_framework
+
+#endif  // FIREBASE_TESTAPP_ID_TOKEN_CACHE_H_  // NOLINT
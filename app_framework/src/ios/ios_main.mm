@@ -12,12 +12,25 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#if defined(TESTAPP_ENABLE_GAME_CENTER)
 #import <GameKit/GameKit.h>
+#endif  // defined(TESTAPP_ENABLE_GAME_CENTER)
 #import <UIKit/UIKit.h>
 
-#include <stdarg.h>
+#include <pthread.h>
+#include <unistd.h>
 
+#include <cassert>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "allocation_scope.h"
+#include "async_log.h"
 #include "main.h"
+#include "timing.h"
 
 extern "C" int common_main(int argc, const char* argv[]);
 
@@ -36,14 +49,19 @@ extern "C" int common_main(int argc, const char* argv[]);
 static int g_exit_status = 0;
 static bool g_shutdown = false;
 static NSCondition *g_shutdown_complete;
+// Wakes the thread running common_main() while it's blocked in
+// ProcessEvents(). g_shutdown and g_wake_requested are guarded by its lock.
 static NSCondition *g_shutdown_signal;
+static bool g_wake_requested = false;
 static UITextView *g_text_view;
 static UIView *g_parent_view;
 static FTAViewController *g_view_controller;
 
-void initGameCenter(UIViewController* view_controller) {
-  if (![GKLocalPlayer class])
-    return;
+#if defined(TESTAPP_ENABLE_GAME_CENTER)
+// Signs in the local Game Center player. Only enabled for samples that define
+// TESTAPP_ENABLE_GAME_CENTER, as it prompts the user and requires GameKit.
+static void InitGameCenter(UIViewController *view_controller) {
+  if (![GKLocalPlayer class]) return;
 
   __weak GKLocalPlayer *localPlayer = [GKLocalPlayer localPlayer];
   localPlayer.authenticateHandler = ^(UIViewController *gcAuthViewController, NSError *error) {
@@ -53,16 +71,15 @@ void initGameCenter(UIViewController* view_controller) {
       [view_controller presentViewController:gcAuthViewController animated:YES completion:nil];
     } else if (localPlayer.isAuthenticated) {
       // Player is already logged into Game Center
+    } else if (error) {
+      app_framework::LogMessage("Unable to initialize GameCenter: %s",
+                                error.localizedDescription.UTF8String);
     } else {
-      if (error) {
-        LogMessage("Unable to initialize GameCenter: %s", error.localizedDescription);
-        return;
-      } else {
-        LogMessage("Unable to initialize GameCenter: Unknown Error");
-      }
+      app_framework::LogMessage("Unable to initialize GameCenter: Unknown Error");
     }
   };
 }
+#endif  // defined(TESTAPP_ENABLE_GAME_CENTER)
 
 @implementation FTAViewController
 
@@ -70,48 +87,123 @@ void initGameCenter(UIViewController* view_controller) {
   [super viewDidLoad];
   g_parent_view = self.view;
   dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-    const char *argv[] = {FIREBASE_TESTAPP_NAME};
-    [g_shutdown_signal lock];
-    initGameCenter(self);
+    const char *argv[] = {TESTAPP_NAME};
+#if defined(TESTAPP_ENABLE_GAME_CENTER)
+    InitGameCenter(self);
+#endif  // defined(TESTAPP_ENABLE_GAME_CENTER)
     g_exit_status = common_main(1, argv);
+    app_framework::LogLatencyHistograms();
+    app_framework::LogAllocationScopes();
+    app_framework::FlushLog();
     [g_shutdown_complete signal];
   });
 }
 
 @end
+namespace app_framework {
 
 bool ProcessEvents(int msec) {
-  [g_shutdown_signal
-      waitUntilDate:[NSDate dateWithTimeIntervalSinceNow:static_cast<float>(msec) / 1000.0f]];
-  return g_shutdown;
+  NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:static_cast<float>(msec) / 1000.0f];
+  [g_shutdown_signal lock];
+  // A wake-up requested while this thread wasn't waiting ends this wait at
+  // once rather than being lost.
+  while (!g_wake_requested && !g_shutdown) {
+    if (![g_shutdown_signal waitUntilDate:deadline]) break;
+  }
+  g_wake_requested = false;
+  bool shutdown = g_shutdown;
+  [g_shutdown_signal unlock];
+  return shutdown;
 }
 
-WindowContext GetWindowContext() {
-  return g_parent_view;
+void WakeProcessEvents() {
+  [g_shutdown_signal lock];
+  g_wake_requested = true;
+  [g_shutdown_signal signal];
+  [g_shutdown_signal unlock];
 }
 
-// Log a message that can be viewed in the console.
-void LogMessage(const char* format, ...) {
-  va_list args;
-  NSString *formatString = @(format);
+std::string PathForResource() {
+  NSArray<NSString *> *paths =
+      NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, YES);
+  NSString *documentsDirectory = paths.firstObject;
+  // Force a trailing slash by removing any that exists, then appending another.
+  return std::string(
+      [[documentsDirectory stringByStandardizingPath] stringByAppendingString:@"/"].UTF8String);
+}
 
-  va_start(args, format);
-  NSString *message = [[NSString alloc] initWithFormat:formatString arguments:args];
-  va_end(args);
+WindowContext GetWindowContext() {
+  return g_parent_view;
+}
 
+// Write a batch of log lines so they can be viewed in the console and, via the
+// stdout pipe read by stdout_logger(), in the text view.
+void WriteLogBatch(const char *text, size_t length) {
+  // Strip the final newline as NSLog adds its own.
+  NSString *message = [[NSString alloc] initWithBytes:text
+                                               length:length - 1
+                                             encoding:NSUTF8StringEncoding];
   NSLog(@"%@", message);
-  message = [message stringByAppendingString:@"\n"];
+  fwrite(text, 1, length, stdout);
+  fflush(stdout);
+}
+
+// Log a message that can be viewed in the console.
+void AddToTextView(const char *str) {
+  NSString *message = @(str);
 
   dispatch_async(dispatch_get_main_queue(), ^{
     g_text_view.text = [g_text_view.text stringByAppendingString:message];
+    NSRange range = NSMakeRange(g_text_view.text.length, 0);
+    [g_text_view scrollRangeToVisible:range];
   });
 }
 
-int main(int argc, char* argv[]) {
-  @autoreleasepool {
-    UIApplicationMain(argc, argv, nil, NSStringFromClass([AppDelegate class]));
+// Remove all lines starting with these strings.
+static const char *const filter_lines[] = {nullptr};
+
+bool should_filter(const char *str) {
+  for (int i = 0; filter_lines[i] != nullptr; ++i) {
+    if (strncmp(str, filter_lines[i], strlen(filter_lines[i])) == 0) return true;
   }
-  return g_exit_status;
+  return false;
+}
+
+void *stdout_logger(void *filedes_ptr) {
+  int fd = reinterpret_cast<int *>(filedes_ptr)[0];
+  // Text read from the pipe that isn't terminated by a newline yet.
+  std::string partial_line;
+  // Complete lines read from the pipe. Everything read at once is added to
+  // the text view in a single call, since each call is relatively expensive.
+  std::string lines;
+  char chunk[4096];
+  bool done = false;
+  while (!done) {
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n <= 0) break;
+    for (ssize_t i = 0; i < n; ++i) {
+      if (chunk[i] == '\0') {
+        done = true;
+        break;
+      }
+      partial_line += chunk[i];
+      if (chunk[i] == '\n') {
+        if (!should_filter(partial_line.c_str())) lines += partial_line;
+        partial_line.clear();
+      }
+    }
+    if (!lines.empty()) {
+      app_framework::AddToTextView(lines.c_str());
+      lines.clear();
+    }
+  }
+  return nullptr;
+}
+
+void RunOnBackgroundThread(void* (*func)(void*), void* data) {
+  dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+      func(data);
+    });
 }
 
 // Create an alert dialog via UIAlertController, and prompt the user to enter a line of text.
@@ -164,6 +256,28 @@ std::string ReadTextInput(const char *title, const char *message, const char *pl
   }
 }
 
+}  // namespace app_framework
+
+int main(int argc, char* argv[]) {
+  // Pipe stdout to call LogToTextView so we can see the gtest output.
+  int filedes[2];
+  assert(pipe(filedes) != -1);
+  assert(dup2(filedes[1], STDOUT_FILENO) != -1);
+  pthread_t thread;
+  pthread_create(&thread, nullptr, app_framework::stdout_logger, reinterpret_cast<void *>(filedes));
+  @autoreleasepool {
+    UIApplicationMain(argc, argv, nil, NSStringFromClass([AppDelegate class]));
+  }
+  // Signal to stdout_logger to exit.
+  write(filedes[1], "\0", 1);
+  pthread_join(thread, nullptr);
+  close(filedes[0]);
+  close(filedes[1]);
+
+  NSLog(@"Application Exit");
+  return g_exit_status;
+}
+
 @implementation AppDelegate
 
 - (BOOL)application:(UIApplication*)application
@@ -179,20 +293,22 @@ std::string ReadTextInput(const char *title, const char *message, const char *pl
 
   g_text_view = [[UITextView alloc] initWithFrame:g_view_controller.view.bounds];
 
+  g_text_view.accessibilityIdentifier = @"Logger";
   g_text_view.editable = NO;
   g_text_view.scrollEnabled = YES;
   g_text_view.userInteractionEnabled = YES;
-
+  g_text_view.font = [UIFont fontWithName:@"Courier" size:10];
   [g_view_controller.view addSubview:g_text_view];
 
   return YES;
 }
 
 - (void)applicationWillTerminate:(UIApplication *)application {
-  g_view_controller = nil;
+  [g_shutdown_signal lock];
   g_shutdown = true;
   [g_shutdown_signal signal];
+  [g_shutdown_signal unlock];
   [g_shutdown_complete wait];
+  g_view_controller = nil;
 }
-
 @end
@@ -25,10 +25,11 @@
 #include <android/native_activity.h>
 #include <jni.h>
 #elif defined(__APPLE__)
+#include <TargetConditionals.h>
 extern "C" {
 #include <objc/objc.h>
 }  // extern "C"
-#endif  // __ANDROID__
+#endif  // __ANDROID__, __APPLE__
 
 // Defined using -DTESTAPP_NAME=some_app_name when compiling this
 // file.
@@ -39,7 +40,7 @@ extern "C" {
 namespace app_framework {
 
 // Cross platform logging method.
-// Implemented by android/android_main.cc or ios/ios_main.mm.
+// Messages are queued and written by a background thread, see async_log.h.
 void LogMessage(const char* format, ...);
 void LogMessageV(const char* format, va_list list);
 
@@ -47,6 +48,10 @@ void LogMessageV(const char* format, va_list list);
 // Returns true when an event requesting program-exit is received.
 bool ProcessEvents(int msec);
 
+// Wake the thread blocked in ProcessEvents(), causing it to return before its
+// timeout expires. Safe to call from any thread.
+void WakeProcessEvents();
+
 // Returns a path to a file suitable for the given platform.
 std::string PathForResource();
 
@@ -55,8 +60,10 @@ std::string PathForResource();
 int64_t WinGetCurrentTimeInMicroseconds();
 #endif
 
-// Returns the number of microseconds since the epoch.
-static int64_t GetCurrentTimeInMicroseconds() {
+// Returns the number of microseconds since the epoch. This follows the system
+// clock, use GetMonotonicTimeInMicroseconds() from timing.h to measure
+// durations.
+inline int64_t GetCurrentTimeInMicroseconds() {
 #if !defined(_WIN32)
   struct timeval now;
   gettimeofday(&now, nullptr);
@@ -70,14 +77,16 @@ static int64_t GetCurrentTimeInMicroseconds() {
 // (and usage) vary based on the OS.
 #if defined(__ANDROID__)
 typedef jobject WindowContext;  // A jobject to the Java Activity.
-#elif defined(__APPLE__)
+#elif TARGET_OS_IPHONE
 typedef id WindowContext;  // A pointer to an iOS UIView.
 #else
 typedef void* WindowContext;  // A void* for any other environments.
 #endif
 
 #if defined(__ANDROID__)
-// Get the JNI environment.
+// Get the JNI environment of the calling thread, attaching the thread to the
+// JVM on first use. The environment is cached for each thread, and threads
+// attached by this are detached when they exit.
 JNIEnv* GetJniEnv();
 // Get the activity.
 jobject GetActivity();
@@ -91,6 +100,13 @@ WindowContext GetWindowContext();
 // Run the given function on a detached background thread.
 void RunOnBackgroundThread(void* (*func)(void* data), void* data);
 
+// Prompt the user with a dialog box to enter a line of text, blocking
+// until the user enters the text or the dialog box is canceled.
+// Returns the text that was entered, or an empty string if the user
+// canceled.
+std::string ReadTextInput(const char* title, const char* message,
+                          const char* placeholder);
+
 }  // namespace app_framework
 
 #endif  // FIREBASE_TESTAPP_MAIN_H_  // NOLINT
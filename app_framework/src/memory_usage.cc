@@ -0,0 +1,87 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "memory_usage.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(_WIN32)
+// Maps GetProcessMemoryInfo() to the kernel32 export, so psapi.lib doesn't
+// need to be linked.
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif  // defined(_WIN32)
+
+namespace app_framework {
+
+int64_t GetResidentMemoryBytes() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                            sizeof(counters))) {
+    return -1;
+  }
+  return static_cast<int64_t>(counters.WorkingSetSize);
+#elif defined(__APPLE__)
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                reinterpret_cast<task_info_t>(&info),
+                &count) != KERN_SUCCESS) {
+    return -1;
+  }
+  return static_cast<int64_t>(info.resident_size);
+#else
+  // The second field of statm is the number of resident pages.
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (!statm) return -1;
+  long long size_pages = 0;  // NOLINT
+  long long resident_pages = 0;  // NOLINT
+  int fields = fscanf(statm, "%lld %lld", &size_pages, &resident_pages);
+  fclose(statm);
+  long page_size = sysconf(_SC_PAGESIZE);  // NOLINT
+  if (fields != 2 || page_size <= 0) return -1;
+  return static_cast<int64_t>(resident_pages) * page_size;
+#endif  // defined(_WIN32)
+}
+
+int64_t GetPeakResidentMemoryBytes() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                            sizeof(counters))) {
+    return -1;
+  }
+  return static_cast<int64_t>(counters.PeakWorkingSetSize);
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#if defined(__APPLE__)
+  // Darwin reports bytes, Linux kilobytes.
+  return static_cast<int64_t>(usage.ru_maxrss);
+#else
+  return static_cast<int64_t>(usage.ru_maxrss) * 1024;
+#endif  // defined(__APPLE__)
+#endif  // defined(_WIN32)
+}
+
+}  // namespace app_framework
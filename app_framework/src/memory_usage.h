@@ -0,0 +1,35 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_MEMORY_USAGE_H_  // NOLINT
+#define FIREBASE_TESTAPP_MEMORY_USAGE_H_  // NOLINT
+
+#include <stdint.h>
+
+namespace app_framework {
+
+// Returns the number of bytes of physical memory used by the process: the
+// resident set size on Linux and Android, the resident size of the task on
+// iOS and macOS and the working set on Windows. Returns -1 if it can't be
+// determined.
+int64_t GetResidentMemoryBytes();
+
+// Returns the most bytes of physical memory the process has used since it
+// started, measured as for GetResidentMemoryBytes(). Returns -1 if it can't be
+// determined.
+int64_t GetPeakResidentMemoryBytes();
+
+}  // namespace app_framework
+
+#endif  // FIREBASE_TESTAPP_MEMORY_USAGE_H_  // NOLINT
@@ -0,0 +1,242 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "startup.h"  // NOLINT
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "firebase/app.h"
+#include "firebase/future.h"
+#include "firebase/util.h"
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+namespace app_framework {
+
+StartupSequence::StartupSequence()
+    : start_us_(GetMonotonicTimeInMicroseconds()) {}
+
+StartupSequence::~StartupSequence() {}
+
+int StartupSequence::AddStep(const char* name, StartFunction start,
+                             const std::vector<int>& dependencies) {
+  Step step;
+  step.name = name;
+  step.start = std::move(start);
+  step.dependencies = dependencies;
+  steps_.push_back(std::move(step));
+  return static_cast<int>(steps_.size()) - 1;
+}
+
+int StartupSequence::AddModule(
+    const char* name, firebase::App* app,
+    firebase::ModuleInitializer::InitializerFn initializer, void* target,
+    const std::vector<int>& dependencies) {
+  std::shared_ptr<firebase::ModuleInitializer> module_initializer =
+      std::make_shared<firebase::ModuleInitializer>();
+  int step = AddStep(
+      name,
+      [module_initializer, app, initializer, target]() -> firebase::FutureBase {
+        return module_initializer->Initialize(app, target, initializer);
+      },
+      dependencies);
+  // The ModuleInitializer owns the Future, so it must outlive the step.
+  steps_[step].initializer = module_initializer;
+  return step;
+}
+
+bool StartupSequence::Run(int timeout_ms) {
+  int64_t deadline_us =
+      timeout_ms == kWaitForever
+          ? 0
+          : GetMonotonicTimeInMicroseconds() +
+                static_cast<int64_t>(timeout_ms) * 1000;
+  while (StartReadySteps() > 0) {
+    std::vector<firebase::FutureBase> futures;
+    std::vector<Step*> running;
+    for (size_t i = 0; i < steps_.size(); ++i) {
+      if (steps_[i].state == kStepRunning) {
+        futures.push_back(steps_[i].future);
+        running.push_back(&steps_[i]);
+      }
+    }
+    int wait_ms = kWaitForever;
+    if (deadline_us) {
+      wait_ms = static_cast<int>(
+          std::max(static_cast<int64_t>(0),
+                   (deadline_us - GetMonotonicTimeInMicroseconds()) / 1000));
+    }
+    if (WaitForAny(futures, wait_ms) < 0) {
+      for (size_t i = 0; i < running.size(); ++i) {
+        LogMessage("ERROR: Startup step %s didn't complete.",
+                   running[i]->name.c_str());
+      }
+      break;
+    }
+    // Any Future that's no longer pending is finished, including one that
+    // became invalid, which Finish() marks as failed. Otherwise WaitForAny()
+    // would keep returning at once for it.
+    for (size_t i = 0; i < running.size(); ++i) {
+      if (running[i]->future.status() != firebase::kFutureStatusPending) {
+        Finish(running[i]);
+      }
+    }
+  }
+  for (size_t i = 0; i < steps_.size(); ++i) {
+    if (steps_[i].state != kStepComplete) return false;
+  }
+  return true;
+}
+
+bool StartupSequence::succeeded(int step) const {
+  return steps_[step].state == kStepComplete;
+}
+
+const firebase::FutureBase& StartupSequence::result(int step) const {
+  return steps_[step].future;
+}
+
+int64_t StartupSequence::duration_us(int step) const {
+  const Step& entry = steps_[step];
+  if (entry.state != kStepComplete && entry.state != kStepFailed) return -1;
+  return entry.end_us - entry.start_us;
+}
+
+void StartupSequence::Mark(const char* name) {
+  Milestone milestone;
+  milestone.name = name;
+  milestone.time_us = GetMonotonicTimeInMicroseconds();
+  milestones_.push_back(milestone);
+}
+
+int64_t StartupSequence::elapsed_us() const {
+  return GetMonotonicTimeInMicroseconds() - start_us_;
+}
+
+void StartupSequence::LogTimeline() const {
+  // A step or milestone, which has a duration of -1.
+  struct Entry {
+    int64_t start_us;
+    int64_t duration_us;
+    const char* name;
+    const char* state;
+
+    bool operator<(const Entry& other) const {
+      return start_us < other.start_us;
+    }
+  };
+  std::vector<Entry> entries;
+  for (size_t i = 0; i < steps_.size(); ++i) {
+    const Step& step = steps_[i];
+    Entry entry = {step.start_us, step.end_us - step.start_us,
+                   step.name.c_str(), ""};
+    if (step.state == kStepFailed) {
+      entry.state = " (failed)";
+    } else if (step.state == kStepSkipped) {
+      entry.state = " (skipped)";
+    } else if (step.state != kStepComplete) {
+      entry.state = " (incomplete)";
+    }
+    if (!step.start_us) {
+      entry.start_us = step.end_us ? step.end_us : start_us_;
+      entry.duration_us = 0;
+    }
+    entries.push_back(entry);
+  }
+  for (size_t i = 0; i < milestones_.size(); ++i) {
+    Entry entry = {milestones_[i].time_us, -1, milestones_[i].name.c_str(),
+                   ""};
+    entries.push_back(entry);
+  }
+  std::stable_sort(entries.begin(), entries.end());
+  LogMessage("Startup timeline:");
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const Entry& entry = entries[i];
+    if (entry.duration_us < 0) {
+      LogMessage("  %8.1f ms  %s", (entry.start_us - start_us_) / 1000.0,
+                 entry.name);
+    } else {
+      LogMessage("  %8.1f ms  %s took %.1f ms%s",
+                 (entry.start_us - start_us_) / 1000.0, entry.name,
+                 entry.duration_us / 1000.0, entry.state);
+    }
+  }
+}
+
+int StartupSequence::StartReadySteps() {
+  int pending = 0;
+  bool started;
+  do {
+    started = false;
+    pending = 0;
+    for (size_t i = 0; i < steps_.size(); ++i) {
+      Step& step = steps_[i];
+      if (step.state == kStepRunning) pending++;
+      if (step.state != kStepWaiting) continue;
+      bool ready = true;
+      bool blocked = false;
+      for (size_t j = 0; j < step.dependencies.size(); ++j) {
+        StepState state = steps_[step.dependencies[j]].state;
+        if (state == kStepFailed || state == kStepSkipped) blocked = true;
+        if (state != kStepComplete) ready = false;
+      }
+      if (blocked) {
+        LogMessage("ERROR: Startup step %s skipped, a dependency failed.",
+                   step.name.c_str());
+        step.state = kStepSkipped;
+        step.end_us = GetMonotonicTimeInMicroseconds();
+        // Steps depending on this one may now be skipped too.
+        started = true;
+        continue;
+      }
+      if (!ready) {
+        pending++;
+        continue;
+      }
+      step.start_us = GetMonotonicTimeInMicroseconds();
+      step.future = step.start();
+      step.state = kStepRunning;
+      pending++;
+      // A step can complete synchronously, unblocking later steps.
+      if (step.future.status() != firebase::kFutureStatusPending) {
+        Finish(&step);
+        pending--;
+        started = true;
+      }
+    }
+  } while (started);
+  return pending;
+}
+
+void StartupSequence::Finish(Step* step) {
+  step->end_us = GetMonotonicTimeInMicroseconds();
+  if (step->future.status() == firebase::kFutureStatusComplete &&
+      step->future.error() == 0) {
+    step->state = kStepComplete;
+    return;
+  }
+  step->state = kStepFailed;
+  LogMessage("ERROR: Startup step %s failed, error %d: %s", step->name.c_str(),
+             step->future.error(),
+             step->future.error_message() ? step->future.error_message() : "");
+}
+
+}  // namespace app_framework
@@ -0,0 +1,134 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_STARTUP_H_  // NOLINT
+#define FIREBASE_TESTAPP_STARTUP_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "firebase/app.h"
+#include "firebase/future.h"
+#include "firebase/util.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+
+namespace app_framework {
+
+// Runs the steps of an application's startup, each as soon as the steps it
+// depends on have completed, and records when each started and finished.
+//
+// A step is anything that completes a Future: a module initialized with a
+// ModuleInitializer, which on Android resolves missing dependencies such as
+// Google Play services, or a request like Auth::SignInAnonymously(). Steps
+// without a dependency between them run at the same time, so the startup
+// takes as long as its longest chain of steps rather than all of them.
+//
+// Milestones that aren't steps, such as the completion of the first request
+// after startup, are added to the timeline with Mark().
+//
+// All methods must be called from the same thread.
+class StartupSequence {
+ public:
+  // Starts a step, returning the Future that completes when it's done.
+  typedef std::function<firebase::FutureBase()> StartFunction;
+
+  // Times on the timeline are relative to the creation of the sequence, so
+  // create it before firebase::App::Create().
+  StartupSequence();
+  ~StartupSequence();
+
+  // Add a step started once every step in `dependencies` has completed
+  // without an error. Returns the step's id.
+  int AddStep(const char* name, StartFunction start,
+              const std::vector<int>& dependencies = std::vector<int>());
+  // Add a step that initializes a module of `app` using its own
+  // ModuleInitializer, passing `target` to `initializer`.
+  int AddModule(const char* name, firebase::App* app,
+                firebase::ModuleInitializer::InitializerFn initializer,
+                void* target,
+                const std::vector<int>& dependencies = std::vector<int>());
+
+  // Start steps as their dependencies complete, until every step has
+  // completed or can't start because a dependency failed, or `timeout_ms`
+  // elapses. A step which fails is logged. Returns true if every step
+  // completed without an error.
+  bool Run(int timeout_ms = kWaitForever);
+
+  // Whether a step completed without an error.
+  bool succeeded(int step) const;
+  // The Future of a step, invalid if it wasn't started.
+  const firebase::FutureBase& result(int step) const;
+  // Time from starting a step to its completion, -1 if it didn't finish.
+  int64_t duration_us(int step) const;
+
+  // Record an instant on the timeline.
+  void Mark(const char* name);
+  // Time since the sequence was created.
+  int64_t elapsed_us() const;
+
+  // Log each step and milestone in the order they started, with its start
+  // time and duration.
+  void LogTimeline() const;
+
+ private:
+  enum StepState {
+    kStepWaiting = 0,
+    kStepRunning,
+    kStepComplete,
+    kStepFailed,
+    // A dependency failed, so the step was never started.
+    kStepSkipped,
+  };
+
+  struct Step {
+    Step() : state(kStepWaiting), start_us(0), end_us(0) {}
+
+    std::string name;
+    StartFunction start;
+    std::vector<int> dependencies;
+    std::shared_ptr<firebase::ModuleInitializer> initializer;
+    StepState state;
+    firebase::FutureBase future;
+    int64_t start_us;
+    int64_t end_us;
+  };
+
+  struct Milestone {
+    std::string name;
+    int64_t time_us;
+  };
+
+  StartupSequence(const StartupSequence&) = delete;
+  StartupSequence& operator=(const StartupSequence&) = delete;
+
+  // Start every waiting step whose dependencies completed, and skip those
+  // with a dependency that failed. Returns the number of steps still
+  // waiting or running.
+  int StartReadySteps();
+  void Finish(Step* step);
+
+  int64_t start_us_;
+  std::vector<Step> steps_;
+  std::vector<Milestone> milestones_;
+};
+
+}  // namespace app_framework
+
+#endif  // FIREBASE_TESTAPP_STARTUP_H_  // NOLINT
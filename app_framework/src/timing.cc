@@ -0,0 +1,197 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "timing.h"  // NOLINT
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "main.h"  // NOLINT
+
+namespace app_framework {
+
+int64_t GetMonotonicTimeInMicroseconds() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+const int64_t LatencyHistogram::kMaxValue;
+
+LatencyHistogram::LatencyHistogram()
+    : count_(0),
+      sum_(0),
+      min_(std::numeric_limits<int64_t>::max()),
+      max_(0) {
+  for (int i = 0; i < kBucketCount; ++i) buckets_[i] = 0;
+}
+
+// Values below kSubBucketCount map directly to a bucket. Larger values are
+// split into power-of-two ranges, each of which has kSubBucketHalfCount
+// buckets indexed by the top kSubBucketBits bits of the value.
+int LatencyHistogram::BucketIndex(int64_t value) {
+  if (value < kSubBucketCount) return static_cast<int>(value);
+  int most_significant_bit = kSubBucketBits;
+  while (value >> (most_significant_bit + 1)) most_significant_bit++;
+  int shift = most_significant_bit - kSubBucketBits + 1;
+  return shift * kSubBucketHalfCount + static_cast<int>(value >> shift);
+}
+
+int64_t LatencyHistogram::BucketUpperBound(int index) {
+  if (index < kSubBucketCount) return index;
+  int shift = index / kSubBucketHalfCount - 1;
+  int64_t sub_bucket = index % kSubBucketHalfCount + kSubBucketHalfCount;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(int64_t value) {
+  if (value < 0) return;
+  value = std::min(value, kMaxValue);
+  buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  int64_t current = min_.load(std::memory_order_relaxed);
+  while (value < current &&
+         !min_.compare_exchange_weak(current, value,
+                                     std::memory_order_relaxed)) {
+  }
+  current = max_.load(std::memory_order_relaxed);
+  while (value > current &&
+         !max_.compare_exchange_weak(current, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+int64_t LatencyHistogram::min() const {
+  return count() ? min_.load(std::memory_order_relaxed) : 0;
+}
+
+double LatencyHistogram::mean() const {
+  uint64_t samples = count();
+  return samples ? static_cast<double>(sum_.load(std::memory_order_relaxed)) /
+                       static_cast<double>(samples)
+                 : 0.0;
+}
+
+int64_t LatencyHistogram::Percentile(double percentile) const {
+  uint64_t samples = count();
+  if (samples == 0) return 0;
+  percentile = std::max(0.0, std::min(percentile, 100.0));
+  // Rank of the sample to report, starting from 1.
+  uint64_t rank = static_cast<uint64_t>(
+      percentile / 100.0 * static_cast<double>(samples) + 0.5);
+  rank = std::max(rank, static_cast<uint64_t>(1));
+  uint64_t seen = 0;
+  for (int i = 0; i < kBucketCount; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) return std::min(BucketUpperBound(i), max());
+  }
+  return max();
+}
+
+namespace {
+
+// Maximum number of distinct histogram names.
+const int kMaxHistograms = 256;
+
+struct NamedHistogram {
+  NamedHistogram(const char* histogram_name, int histogram_sequence)
+      : name(histogram_name), sequence(histogram_sequence) {}
+
+  std::string name;
+  // Order in which the histogram was created.
+  int sequence;
+  LatencyHistogram histogram;
+};
+
+// Open-addressed hash table of histograms. Slots are only ever filled, never
+// cleared, so lookups don't need a lock. Histograms live until the process
+// exits so that they can be dumped after common_main() returns.
+std::atomic<NamedHistogram*> g_histograms[kMaxHistograms];
+std::atomic<int> g_histogram_sequence(0);
+
+// FNV-1a hash of a string.
+uint32_t HashName(const char* name) {
+  uint32_t hash = 2166136261u;
+  for (const char* c = name; *c; ++c) {
+    hash ^= static_cast<uint8_t>(*c);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+}  // namespace
+
+LatencyHistogram* GetLatencyHistogram(const char* name) {
+  uint32_t hash = HashName(name);
+  NamedHistogram* created = nullptr;
+  for (int probe = 0; probe < kMaxHistograms; ++probe) {
+    std::atomic<NamedHistogram*>& slot =
+        g_histograms[(hash + probe) % kMaxHistograms];
+    NamedHistogram* entry = slot.load(std::memory_order_acquire);
+    if (!entry) {
+      if (!created) {
+        created = new NamedHistogram(name, g_histogram_sequence++);
+      }
+      if (slot.compare_exchange_strong(entry, created,
+                                       std::memory_order_acq_rel)) {
+        return &created->histogram;
+      }
+      // Another thread filled the slot, `entry` now refers to its histogram.
+    }
+    if (strcmp(entry->name.c_str(), name) == 0) {
+      delete created;
+      return &entry->histogram;
+    }
+  }
+  delete created;
+  return nullptr;
+}
+
+void RecordLatency(const char* name, int64_t latency_us) {
+  LatencyHistogram* histogram = GetLatencyHistogram(name);
+  if (histogram) histogram->Record(latency_us);
+}
+
+void LogLatencyHistograms() {
+  std::vector<NamedHistogram*> entries;
+  for (int i = 0; i < kMaxHistograms; ++i) {
+    NamedHistogram* entry = g_histograms[i].load(std::memory_order_acquire);
+    if (entry && entry->histogram.count()) entries.push_back(entry);
+  }
+  if (entries.empty()) return;
+  std::sort(entries.begin(), entries.end(),
+            [](const NamedHistogram* a, const NamedHistogram* b) {
+              return a->sequence < b->sequence;
+            });
+  LogMessage("Operation latency (ms):");
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const LatencyHistogram& histogram = entries[i]->histogram;
+    LogMessage("  %s: n=%llu p50=%.1f p90=%.1f p99=%.1f max=%.1f",
+               entries[i]->name.c_str(),
+               static_cast<unsigned long long>(histogram.count()),  // NOLINT
+               histogram.Percentile(50.0) / 1000.0,
+               histogram.Percentile(90.0) / 1000.0,
+               histogram.Percentile(99.0) / 1000.0, histogram.max() / 1000.0);
+  }
+}
+
+}  // namespace app_framework
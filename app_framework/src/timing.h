@@ -0,0 +1,93 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_TIMING_H_  // NOLINT
+#define FIREBASE_TESTAPP_TIMING_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <atomic>
+
+namespace app_framework {
+
+// Returns the number of microseconds elapsed since an arbitrary point in time.
+// Unlike GetCurrentTimeInMicroseconds() this never goes backwards when the
+// system clock is adjusted, so it should be used to measure durations.
+int64_t GetMonotonicTimeInMicroseconds();
+
+// Histogram of latencies in microseconds using log-linear buckets, in the
+// style of HdrHistogram. Values below kSubBucketCount are recorded exactly,
+// larger values are recorded with a relative error of at most
+// 1 / (kSubBucketCount / 2), i.e ~3%.
+//
+// Record() is lock-free and can be called from any thread, readers may observe
+// a histogram that is being updated concurrently.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  // Add a sample. Negative values are ignored and values larger than
+  // kMaxValue are clamped.
+  void Record(int64_t value);
+
+  // Number of samples recorded.
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  // Smallest and largest sample recorded, 0 if no samples were recorded.
+  int64_t min() const;
+  int64_t max() const { return max_.load(std::memory_order_relaxed); }
+  // Mean of the recorded samples, 0 if no samples were recorded.
+  double mean() const;
+
+  // Returns the value below which `percentile` percent of the samples fall,
+  // e.g Percentile(99.0) for p99. The result is the upper bound of the bucket
+  // containing that sample, capped at max().
+  int64_t Percentile(double percentile) const;
+
+  // Largest value that can be recorded with the precision described above
+  // (2^40 us, roughly 12 days).
+  static const int64_t kMaxValue = (1LL << 40) - 1;
+
+ private:
+  static const int kSubBucketBits = 6;
+  static const int kSubBucketCount = 1 << kSubBucketBits;
+  static const int kSubBucketHalfCount = kSubBucketCount / 2;
+  static const int kBucketCount =
+      (40 - kSubBucketBits) * kSubBucketHalfCount + kSubBucketCount;
+
+  static int BucketIndex(int64_t value);
+  static int64_t BucketUpperBound(int index);
+
+  std::atomic<uint64_t> buckets_[kBucketCount];
+  std::atomic<uint64_t> count_;
+  std::atomic<int64_t> sum_;
+  std::atomic<int64_t> min_;
+  std::atomic<int64_t> max_;
+};
+
+// Returns the histogram associated with `name`, creating it the first time a
+// name is used. Lookups are lock-free, so this can be called on every
+// operation. Returns nullptr if too many distinct names have been used.
+LatencyHistogram* GetLatencyHistogram(const char* name);
+
+// Record `latency_us` in the histogram associated with `name`.
+void RecordLatency(const char* name, int64_t latency_us);
+
+// Log the sample count and p50 / p90 / p99 / max of every latency histogram in
+// the order the histograms were created. Called by the platform shell after
+// common_main() returns.
+void LogLatencyHistograms();
+
+}  // namespace app_framework
+
+#endif  // FIREBASE_TESTAPP_TIMING_H_  // NOLINT
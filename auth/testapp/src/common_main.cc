@@ -15,6 +15,7 @@
 #include <ctime>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "firebase/app.h"
 #include "firebase/auth.h"
@@ -22,8 +23,16 @@
 #include "firebase/util.h"
 
 // Thin OS abstraction layer.
+#include "allocation_scope.h"  // NOLINT
+#include "benchmark.h"  // NOLINT
+#include "future_wait.h"  // NOLINT
+#include "id_token_cache.h"  // NOLINT
 #include "main.h"  // NOLINT
+#include "sign_in_benchmark.h"  // NOLINT
 
+using app_framework::LogMessage;
+using app_framework::ProcessEvents;
+using app_framework::ReadTextInput;
 using ::firebase::App;
 using ::firebase::AppOptions;
 using ::firebase::Future;
@@ -74,6 +83,8 @@ static const int kWaitIntervalMs = 300;
 static const int kPhoneAuthCodeSendWaitMs = 600000;
 static const int kPhoneAuthCompletionWaitMs = 8000;
 static const int kPhoneAuthTimeoutMs = 0;
+static const int kIdTokenWaitMs = 10000;
+
 
 static const char kFirebaseProviderId[] =
 #if defined(__ANDROID__)
@@ -95,8 +106,9 @@ static bool WaitForFuture(const FutureBase& future, const char* fn,
 
   // Wait for future to complete.
   LogMessage("  Calling %s...", fn);
-  while (future.status() == ::firebase::kFutureStatusPending) {
-    if (ProcessEvents(100)) return true;
+  if (app_framework::WaitForFuture(future) ==
+      app_framework::kWaitResultExitRequested) {
+    return true;
   }
 
   // Log error result.
@@ -260,7 +272,11 @@ static void LogSignInResult(const SignInResult& result) {
   const AdditionalUserInfo& info = result.info;
   LogMessage("* Provider ID %s", info.provider_id.c_str());
   LogMessage("* User Name %s", info.user_name.c_str());
-  LogVariantMap(info.profile, 0);
+  {
+    // The profile is a map of variants, copied and converted as it's logged.
+    app_framework::AllocationScope allocation_scope("LogVariantMap");
+    LogVariantMap(info.profile, 0);
+  }
   const UserMetadata& metadata = result.meta;
   LogMessage("* Sign in timestamp %d",
              static_cast<int>(metadata.last_sign_in_timestamp));
@@ -459,7 +475,8 @@ extern "C" int common_main(int argc, const char* argv[]) {
   LogMessage("Starting Auth tests.");
 
 #if defined(__ANDROID__)
-  app = App::Create(GetJniEnv(), GetActivity());
+  app = App::Create(app_framework::GetJniEnv(),
+                    app_framework::GetActivity());
 #else
   app = App::Create();
 #endif  // defined(__ANDROID__)
@@ -474,9 +491,9 @@ extern "C" int common_main(int argc, const char* argv[]) {
     Auth::GetAuth(app, &init_result);
     return init_result;
   });
-  while (initializer.InitializeLastResult().status() !=
-         firebase::kFutureStatusComplete) {
-    if (ProcessEvents(100)) return 1;  // exit if requested
+  if (app_framework::WaitForFuture(initializer.InitializeLastResult()) ==
+      app_framework::kWaitResultExitRequested) {
+    return 1;  // exit if requested
   }
 
   if (initializer.InitializeLastResult().error() != 0) {
@@ -589,6 +606,45 @@ extern "C" int common_main(int argc, const char* argv[]) {
     auth->RemoveIdTokenListener(&token_counter);
   }
 
+  // --- IdTokenCache tests ----------------------------------------------------
+  {
+    app_framework::IdTokenCache token_cache(auth);
+    std::string token;
+    ExpectTrue("IdTokenCache misses when signed-out",
+               !token_cache.GetToken(&token));
+
+    // The cache fetches the token as soon as the user signs in.
+    Future<User*> sign_in_future = auth->SignInAnonymously();
+    WaitForSignInFuture(sign_in_future, "Auth::SignInAnonymously()",
+                        kAuthErrorNone, auth);
+    ExpectTrue("IdTokenCache fetched the token after SignInAnonymously()",
+               token_cache.WaitForToken(kIdTokenWaitMs));
+    ExpectTrue("IdTokenCache hits after SignInAnonymously()",
+               token_cache.GetToken(&token) && !token.empty());
+
+    // Refresh the token the way the cache does shortly before it expires.
+    const int refreshes = token_cache.stats().refreshes;
+    token_cache.Refresh();
+    for (int waited_ms = 0; token_cache.stats().refreshes == refreshes &&
+                            waited_ms < kIdTokenWaitMs;
+         waited_ms += kWaitIntervalMs) {
+      ProcessEvents(kWaitIntervalMs);
+    }
+    ExpectTrue("IdTokenCache refreshed the token",
+               token_cache.stats().refreshes > refreshes &&
+                   token_cache.stats().failed_refreshes == 0);
+    ExpectTrue("IdTokenCache token is valid beyond the refresh margin",
+               token_cache.expires_in_us() >
+                   app_framework::IdTokenCache::kDefaultRefreshMarginMs *
+                       1000LL);
+
+    auth->SignOut();
+    WaitForSignOut(auth);
+    ExpectTrue("IdTokenCache misses after SignOut()",
+               !token_cache.GetToken(&token));
+    token_cache.LogStats();
+  }
+
   // Phone verification isn't currently implemented on desktop
 #if defined(__ANDROID__) || TARGET_OS_IPHONE
   // --- PhoneListener tests ---------------------------------------------------
@@ -1373,6 +1429,46 @@ extern "C" int common_main(int argc, const char* argv[]) {
 #endif  // TARGET_OS_IPHONE || defined(__ANDROID__)
 #endif  // INTERNAL_EXPERIMENTAL
 
+  // --- Benchmarks ------------------------------------------------------------
+  app_framework::BenchmarkOptions benchmark_options;
+  if (app_framework::ParseBenchmarkOptions(argc, argv, &benchmark_options)) {
+    LogMessage("Running benchmarks.");
+    // Signing in with each provider is timed first, as it must start signed
+    // out, then reported with the suite's results.
+    if (auth->current_user() != nullptr) {
+      auth->SignOut();
+      WaitForSignOut(auth);
+    }
+    auth_testapp::SignInBenchmarkOptions sign_in_options;
+    sign_in_options.password = kTestPassword;
+    std::vector<app_framework::BenchmarkResult> results;
+    auth_testapp::RunSignInBenchmark(auth, sign_in_options, benchmark_options,
+                                     &results);
+
+    WaitForSignInFuture(auth->SignInAnonymously(), "Auth::SignInAnonymously()",
+                        kAuthErrorNone, auth);
+    User* user = auth->current_user();
+    if (user) {
+      app_framework::BenchmarkSuite benchmarks("auth");
+      benchmarks.AddScenario("get_token_cached", [user]() -> FutureBase {
+        return user->GetToken(false);
+      });
+      benchmarks.AddScenario("get_token_refresh", [user]() -> FutureBase {
+        return user->GetToken(true);
+      });
+      benchmarks.AddScenario("reload", [user]() -> FutureBase {
+        return user->Reload();
+      });
+      std::vector<app_framework::BenchmarkResult> suite_results =
+          benchmarks.Run(benchmark_options);
+      results.insert(results.end(), suite_results.begin(),
+                     suite_results.end());
+      WaitForFuture(user->Delete(), "Delete User", kAuthErrorNone);
+    }
+    app_framework::ReportBenchmarkResults(results, benchmark_options);
+    LogMessage("Ran benchmarks.");
+  }
+
   LogMessage("Completed Auth tests.");
 
   while (!ProcessEvents(1000)) {
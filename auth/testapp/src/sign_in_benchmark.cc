@@ -0,0 +1,329 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sign_in_benchmark.h"  // NOLINT
+
+#include <stdint.h>
+
+#include <ctime>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "firebase/auth.h"
+#include "firebase/auth/credential.h"
+#include "firebase/future.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::BenchmarkResult;
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+
+namespace auth_testapp {
+
+const char* GetSignInMethodName(SignInMethod method) {
+  static const char* const kNames[] = {
+      "sign_in_anonymously",
+      "sign_in_with_credential",
+      "sign_in_and_retrieve_data_with_credential",
+      "link_with_credential",
+      "create_user_with_email_and_password",
+  };
+  return method >= 0 && method < kSignInMethodCount ? kNames[method]
+                                                    : "unknown";
+}
+
+const char* GetSignInPhaseName(SignInPhase phase) {
+  static const char* const kNames[] = {
+      "create_account", "sign_in", "link", "sign_out", "delete",
+  };
+  return phase >= 0 && phase < kSignInPhaseCount ? kNames[phase] : "unknown";
+}
+
+namespace {
+
+// Signals each change of the signed-in user, so a sign-out can be timed
+// without polling Auth::current_user().
+class AuthStateCounter : public firebase::auth::AuthStateListener {
+ public:
+  void OnAuthStateChanged(firebase::auth::Auth* /*auth*/) override {
+    events_.Signal();
+  }
+
+  const app_framework::EventCounter& events() const { return events_; }
+
+ private:
+  app_framework::EventCounter events_;
+};
+
+// Create an email that's different for every account of every run.
+std::string CreateBenchmarkEmail() {
+  static int account_count = 0;
+  std::stringstream email;
+  email << "random_" << std::time(0) << "_" << account_count++ << "@gmail.com";
+  return email.str();
+}
+
+// Measurements of one phase of the method being run.
+struct PhaseRun {
+  PhaseRun() : failed(0), duration_us(0) {}
+
+  app_framework::LatencyHistogram latency;
+  int failed;
+  // Sum of the latencies.
+  int64_t duration_us;
+};
+
+class SignInBenchmark {
+ public:
+  SignInBenchmark(firebase::auth::Auth* auth,
+                  const SignInBenchmarkOptions& options, int cycles)
+      : auth_(auth),
+        options_(options),
+        cycles_(cycles),
+        method_(kSignInMethodAnonymous),
+        phases_(nullptr) {
+    auth_->AddAuthStateListener(&listener_);
+  }
+
+  ~SignInBenchmark() { auth_->RemoveAuthStateListener(&listener_); }
+
+  // Run `cycles` cycles of `method`, appending a result for each phase
+  // measured, without a label or product, to `results`.
+  void Run(SignInMethod method, std::vector<BenchmarkResult>* results);
+
+ private:
+  SignInBenchmark(const SignInBenchmark&) = delete;
+  SignInBenchmark& operator=(const SignInBenchmark&) = delete;
+
+  // Wait for `future`, started at `start_us`, and record the time it took
+  // to complete in `phase`. Returns true if it completed without an error.
+  bool Measure(const firebase::FutureBase& future, int64_t start_us,
+               SignInPhase phase);
+  void Record(SignInPhase phase, int64_t latency_us);
+  bool SignOut();
+  // Delete the signed-in user, which also signs it out.
+  bool DeleteUser();
+  // Leave the app signed out after a failed cycle, deleting the user if it
+  // was created by the cycle.
+  void Recover(bool delete_user);
+
+  void RunEmailCredential(SignInMethod method);
+
+  firebase::auth::Auth* auth_;
+  const SignInBenchmarkOptions& options_;
+  const int cycles_;
+  AuthStateCounter listener_;
+  // The method being run and each of its phases.
+  SignInMethod method_;
+  PhaseRun* phases_;
+};
+
+bool SignInBenchmark::Measure(const firebase::FutureBase& future,
+                              int64_t start_us, SignInPhase phase) {
+  int64_t wait_start_us = GetMonotonicTimeInMicroseconds();
+  const app_framework::FutureWaitResult wait =
+      app_framework::WaitForAll({future}, options_.timeout_ms)[0];
+  if (wait.result != app_framework::kWaitResultComplete ||
+      wait.error != firebase::auth::kAuthErrorNone) {
+    phases_[phase].failed++;
+    LogMessage("ERROR: %s %s failed, error %d: %s",
+               GetSignInMethodName(method_), GetSignInPhaseName(phase),
+               wait.error, wait.error_message.c_str());
+    return false;
+  }
+  Record(phase, wait_start_us - start_us + wait.latency_us);
+  return true;
+}
+
+void SignInBenchmark::Record(SignInPhase phase, int64_t latency_us) {
+  phases_[phase].latency.Record(latency_us);
+  phases_[phase].duration_us += latency_us;
+}
+
+bool SignInBenchmark::SignOut() {
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  auth_->SignOut();
+  if (listener_.events().WaitUntil(
+          [this]() { return auth_->current_user() == nullptr; },
+          options_.timeout_ms) != app_framework::kWaitResultComplete) {
+    phases_[kSignInPhaseSignOut].failed++;
+    LogMessage("ERROR: %s sign out didn't complete.",
+               GetSignInMethodName(method_));
+    return false;
+  }
+  Record(kSignInPhaseSignOut, GetMonotonicTimeInMicroseconds() - start_us);
+  return true;
+}
+
+bool SignInBenchmark::DeleteUser() {
+  firebase::auth::User* user = auth_->current_user();
+  if (user == nullptr) return false;
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  return Measure(user->Delete(), start_us, kSignInPhaseDelete);
+}
+
+void SignInBenchmark::Recover(bool delete_user) {
+  firebase::auth::User* user = auth_->current_user();
+  if (user == nullptr) return;
+  if (delete_user) {
+    app_framework::WaitForAll({user->Delete()}, options_.timeout_ms);
+  }
+  if (auth_->current_user() != nullptr) auth_->SignOut();
+}
+
+void SignInBenchmark::RunEmailCredential(SignInMethod method) {
+  // Every cycle signs in to the same account.
+  std::string email = CreateBenchmarkEmail();
+  const char* password = options_.password.c_str();
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  if (!Measure(auth_->CreateUserWithEmailAndPassword(email.c_str(), password),
+               start_us, kSignInPhaseCreateAccount)) {
+    return;
+  }
+  if (!SignOut()) {
+    Recover(true);
+    return;
+  }
+
+  firebase::auth::Credential credential =
+      firebase::auth::EmailAuthProvider::GetCredential(email.c_str(),
+                                                       password);
+  for (int cycle = 0; cycle < cycles_; ++cycle) {
+    start_us = GetMonotonicTimeInMicroseconds();
+    firebase::FutureBase sign_in;
+    if (method == kSignInMethodEmailCredential) {
+      sign_in = auth_->SignInWithCredential(credential);
+    } else {
+      sign_in = auth_->SignInAndRetrieveDataWithCredential(credential);
+    }
+    if (!Measure(sign_in, start_us, kSignInPhaseSignIn) || !SignOut()) {
+      Recover(false);
+    }
+  }
+
+  // Sign in once more to delete the account.
+  app_framework::WaitForAll({auth_->SignInWithCredential(credential)},
+                            options_.timeout_ms);
+  if (!DeleteUser()) {
+    LogMessage("ERROR: Failed to delete %s.", email.c_str());
+    Recover(false);
+  }
+}
+
+void SignInBenchmark::Run(SignInMethod method,
+                          std::vector<BenchmarkResult>* results) {
+  // LatencyHistogram is too large to keep on the stack.
+  std::unique_ptr<PhaseRun[]> phases(new PhaseRun[kSignInPhaseCount]);
+  method_ = method;
+  phases_ = phases.get();
+
+  const char* password = options_.password.c_str();
+  switch (method) {
+    case kSignInMethodAnonymous:
+      for (int cycle = 0; cycle < cycles_; ++cycle) {
+        int64_t start_us = GetMonotonicTimeInMicroseconds();
+        if (!Measure(auth_->SignInAnonymously(), start_us,
+                     kSignInPhaseSignIn) ||
+            !DeleteUser()) {
+          Recover(true);
+        }
+      }
+      break;
+    case kSignInMethodEmailCredential:
+    case kSignInMethodRetrieveDataWithCredential:
+      RunEmailCredential(method);
+      break;
+    case kSignInMethodLinkWithCredential:
+      for (int cycle = 0; cycle < cycles_; ++cycle) {
+        int64_t start_us = GetMonotonicTimeInMicroseconds();
+        bool succeeded =
+            Measure(auth_->SignInAnonymously(), start_us, kSignInPhaseSignIn);
+        if (succeeded) {
+          std::string email = CreateBenchmarkEmail();
+          firebase::auth::Credential credential =
+              firebase::auth::EmailAuthProvider::GetCredential(email.c_str(),
+                                                               password);
+          start_us = GetMonotonicTimeInMicroseconds();
+          succeeded =
+              Measure(auth_->current_user()->LinkWithCredential(credential),
+                      start_us, kSignInPhaseLink) &&
+              DeleteUser();
+        }
+        if (!succeeded) Recover(true);
+      }
+      break;
+    case kSignInMethodCreateAccount:
+      for (int cycle = 0; cycle < cycles_; ++cycle) {
+        std::string email = CreateBenchmarkEmail();
+        int64_t start_us = GetMonotonicTimeInMicroseconds();
+        if (!Measure(auth_->CreateUserWithEmailAndPassword(email.c_str(),
+                                                           password),
+                     start_us, kSignInPhaseCreateAccount) ||
+            !DeleteUser()) {
+          Recover(true);
+        }
+      }
+      break;
+    case kSignInMethodCount:
+      break;
+  }
+
+  for (int i = 0; i < kSignInPhaseCount; ++i) {
+    const PhaseRun& phase = phases_[i];
+    int samples = static_cast<int>(phase.latency.count());
+    if (samples == 0 && phase.failed == 0) continue;
+    BenchmarkResult result;
+    result.scenario = std::string(GetSignInMethodName(method)) + "/" +
+                      GetSignInPhaseName(static_cast<SignInPhase>(i));
+    result.iterations = samples + phase.failed;
+    result.failures = phase.failed;
+    result.concurrency = 1;
+    result.duration_us = phase.duration_us;
+    result.throughput =
+        phase.duration_us > 0 ? samples * 1000000.0 / phase.duration_us : 0.0;
+    app_framework::SetBenchmarkLatency(phase.latency, &result);
+    results->push_back(result);
+  }
+  phases_ = nullptr;
+}
+
+}  // namespace
+
+void RunSignInBenchmark(
+    firebase::auth::Auth* auth, const SignInBenchmarkOptions& options,
+    const app_framework::BenchmarkOptions& benchmark_options,
+    std::vector<BenchmarkResult>* results) {
+  SignInBenchmark benchmark(auth, options, benchmark_options.iterations);
+  for (size_t i = 0; i < options.methods.size(); ++i) {
+    const char* name = GetSignInMethodName(options.methods[i]);
+    if (!app_framework::IsBenchmarkSelected(benchmark_options, "auth", name)) {
+      continue;
+    }
+    LogMessage("Benchmark auth/%s...", name);
+    size_t first = results->size();
+    benchmark.Run(options.methods[i], results);
+    for (size_t j = first; j < results->size(); ++j) {
+      (*results)[j].label = benchmark_options.label;
+      (*results)[j].product = "auth";
+    }
+  }
+}
+
+}  // namespace auth_testapp
@@ -0,0 +1,91 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_SIGN_IN_BENCHMARK_H_  // NOLINT
+#define FIREBASE_TESTAPP_SIGN_IN_BENCHMARK_H_  // NOLINT
+
+#include <string>
+#include <vector>
+
+#include "firebase/auth.h"
+
+// Thin OS abstraction layer.
+#include "benchmark.h"  // NOLINT
+
+namespace auth_testapp {
+
+// Ways of signing in measured by RunSignInBenchmark().
+enum SignInMethod {
+  // Auth::SignInAnonymously(), then User::Delete().
+  kSignInMethodAnonymous = 0,
+  // Auth::SignInWithCredential() with an EmailAuthProvider credential, then
+  // Auth::SignOut(), reusing one account for every cycle.
+  kSignInMethodEmailCredential,
+  // Like kSignInMethodEmailCredential, using
+  // Auth::SignInAndRetrieveDataWithCredential().
+  kSignInMethodRetrieveDataWithCredential,
+  // Auth::SignInAnonymously(), User::LinkWithCredential() with a new email
+  // account, then User::Delete().
+  kSignInMethodLinkWithCredential,
+  // Auth::CreateUserWithEmailAndPassword() with a new email account, then
+  // User::Delete(). Run with many cycles to load test account creation.
+  kSignInMethodCreateAccount,
+  kSignInMethodCount,
+};
+
+// Steps of a sign-in cycle.
+enum SignInPhase {
+  kSignInPhaseCreateAccount = 0,
+  kSignInPhaseSignIn,
+  kSignInPhaseLink,
+  kSignInPhaseSignOut,
+  kSignInPhaseDelete,
+  kSignInPhaseCount,
+};
+
+// Names used in the scenarios of the results, e.g.
+// "sign_in_anonymously/sign_in".
+const char* GetSignInMethodName(SignInMethod method);
+const char* GetSignInPhaseName(SignInPhase phase);
+
+// Configuration of RunSignInBenchmark().
+struct SignInBenchmarkOptions {
+  SignInBenchmarkOptions()
+      : password("benchmarkPassword123"), timeout_ms(30000) {
+    for (int i = 0; i < kSignInMethodCount; ++i) {
+      methods.push_back(static_cast<SignInMethod>(i));
+    }
+  }
+
+  std::vector<SignInMethod> methods;
+  // Password of the email accounts the benchmark creates.
+  std::string password;
+  // Time allowed for each phase.
+  int timeout_ms;
+};
+
+// Sign in and out benchmark_options.iterations times with each of `methods`
+// selected by benchmark_options.filter, timing each phase, and append a
+// result of product "auth" and scenario "<method>/<phase>" for each phase to
+// `results`. Most cycles create an account, so raising the iterations load
+// tests the backend. Accounts created by the benchmark are deleted. Must be
+// called while signed out, and leaves the app signed out.
+void RunSignInBenchmark(
+    firebase::auth::Auth* auth, const SignInBenchmarkOptions& options,
+    const app_framework::BenchmarkOptions& benchmark_options,
+    std::vector<app_framework::BenchmarkResult>* results);
+
+}  // namespace auth_testapp
+
+#endif  // FIREBASE_TESTAPP_SIGN_IN_BENCHMARK_H_  // NOLINT
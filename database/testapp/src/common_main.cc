@@ -14,6 +14,8 @@
 
 #include <algorithm>
 #include <ctime>
+#include <string>
+#include <unordered_map>
 #include "firebase/app.h"
 #include "firebase/auth.h"
 #include "firebase/database.h"
@@ -21,7 +23,30 @@
 #include "firebase/util.h"
 
 // Thin OS abstraction layer.
+#include "allocation_scope.h"  // NOLINT
+#include "benchmark.h"  // NOLINT
+#include "future_wait.h"  // NOLINT
+#include "listener_benchmark.h"  // NOLINT
 #include "main.h"  // NOLINT
+#include "persistence_profile.h"  // NOLINT
+#include "query_pager.h"  // NOLINT
+#include "startup.h"  // NOLINT
+#include "timing.h"  // NOLINT
+#include "transaction_stress.h"  // NOLINT
+#include "variant_builder.h"  // NOLINT
+#include "write_benchmark.h"  // NOLINT
+
+using app_framework::EventCounter;
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+using app_framework::LogWaitResults;
+using app_framework::ProcessEvents;
+using app_framework::WaitForAll;
+using app_framework::WaitForCompletion;
+using app_framework::WaitForEvents;
+
+// Time to wait for listeners to receive the events a test expects.
+const int kListenerTimeoutMs = 10000;
 
 // An example of a ValueListener object. This specific version will
 // simply log every value it sees, and store them in a list so we can
@@ -34,6 +59,7 @@ class SampleValueListener : public firebase::database::ValueListener {
                snapshot.value().AsString().string_value());
     last_seen_value_ = snapshot.value();
     seen_values_.push_back(snapshot.value());
+    events_.Signal();
   }
   void OnCancelled(const firebase::database::Error& error_code,
                    const char* error_message) override {
@@ -47,9 +73,13 @@ class SampleValueListener : public firebase::database::ValueListener {
   }
   size_t num_seen_values() { return seen_values_.size(); }
 
+  // Signaled each time a value is received.
+  const EventCounter& events() const { return events_; }
+
  private:
   firebase::Variant last_seen_value_;
   std::vector<firebase::Variant> seen_values_;
+  EventCounter events_;
 };
 
 // An example ChildListener class.
@@ -58,22 +88,22 @@ class SampleChildListener : public firebase::database::ChildListener {
   void OnChildAdded(const firebase::database::DataSnapshot& snapshot,
                     const char* previous_sibling) override {
     LogMessage("  ChildListener.OnChildAdded(%s)", snapshot.key());
-    events_.push_back(std::string("added ") + snapshot.key());
+    AddEvent(std::string("added ") + snapshot.key());
   }
   void OnChildChanged(const firebase::database::DataSnapshot& snapshot,
                       const char* previous_sibling) override {
     LogMessage("  ChildListener.OnChildChanged(%s)", snapshot.key());
-    events_.push_back(std::string("changed ") + snapshot.key());
+    AddEvent(std::string("changed ") + snapshot.key());
   }
   void OnChildMoved(const firebase::database::DataSnapshot& snapshot,
                     const char* previous_sibling) override {
     LogMessage("  ChildListener.OnChildMoved(%s)", snapshot.key());
-    events_.push_back(std::string("moved ") + snapshot.key());
+    AddEvent(std::string("moved ") + snapshot.key());
   }
   void OnChildRemoved(
       const firebase::database::DataSnapshot& snapshot) override {
     LogMessage("  ChildListener.OnChildRemoved(%s)", snapshot.key());
-    events_.push_back(std::string("removed ") + snapshot.key());
+    AddEvent(std::string("removed ") + snapshot.key());
   }
   void OnCancelled(const firebase::database::Error& error_code,
                    const char* error_message) override {
@@ -82,22 +112,29 @@ class SampleChildListener : public firebase::database::ChildListener {
   }
 
   // Get the total number of Child events this listener saw.
-  size_t total_events() { return events_.size(); }
+  size_t total_events() { return total_events_; }
 
   // Get the number of times this event was seen.
   int num_events(const std::string& event) {
-    int count = 0;
-    for (int i = 0; i < events_.size(); i++) {
-      if (events_[i] == event) {
-        count++;
-      }
-    }
-    return count;
+    std::unordered_map<std::string, int>::const_iterator it =
+        event_counts_.find(event);
+    return it != event_counts_.end() ? it->second : 0;
   }
 
- public:
-  // Vector of strings defining the events we saw, in order.
-  std::vector<std::string> events_;
+  // Signaled each time a Child event is received.
+  const EventCounter& events() const { return events_; }
+
+ private:
+  void AddEvent(const std::string& event) {
+    event_counts_[event]++;
+    total_events_++;
+    events_.Signal();
+  }
+
+  // Number of times each event was seen, e.g "added <key>".
+  std::unordered_map<std::string, int> event_counts_;
+  size_t total_events_ = 0;
+  EventCounter events_;
 };
 
 // A ValueListener that expects a specific value to be set.
@@ -109,6 +146,7 @@ class ExpectValueListener : public firebase::database::ValueListener {
       const firebase::database::DataSnapshot& snapshot) override {
     if (snapshot.value().AsString() == wait_value_) {
       got_value_ = true;
+      got_value_event_.Signal();
     } else {
       LogMessage(
           "FAILURE: ExpectValueListener did not receive the expected result.");
@@ -122,71 +160,117 @@ class ExpectValueListener : public firebase::database::ValueListener {
 
   bool got_value() { return got_value_; }
 
+  // Wait for the expected value to be received, logging an error if it
+  // doesn't arrive within `timeout_ms`.
+  bool WaitForValue(const char* name, int timeout_ms = kListenerTimeoutMs) {
+    return WaitForEvents(got_value_event_, 1, name, timeout_ms);
+  }
+
  private:
   firebase::Variant wait_value_;
   bool got_value_;
+  EventCounter got_value_event_;
 };
 
-// Wait for a Future to be completed. If the Future returns an error, it will
-// be logged.
-void WaitForCompletion(const firebase::FutureBase& future, const char* name) {
-  while (future.status() == firebase::kFutureStatusPending) {
-    ProcessEvents(100);
+// A ValueListener that records when it receives its initial value. Events
+// are delivered in order, so once a listener attached to a location after a
+// write completed has seen the location's value, every listener has seen the
+// events raised by that write.
+class BarrierListener : public firebase::database::ValueListener {
+ public:
+  void OnValueChanged(
+      const firebase::database::DataSnapshot& snapshot) override {
+    events_.Signal();
   }
-  if (future.status() != firebase::kFutureStatusComplete) {
-    LogMessage("ERROR: %s returned an invalid result.", name);
-  } else if (future.error() != 0) {
-    LogMessage("ERROR: %s returned error %d: %s", name, future.error(),
-               future.error_message());
+  void OnCancelled(const firebase::database::Error& error_code,
+                   const char* error_message) override {
+    LogMessage("ERROR: BarrierListener canceled: %d: %s", error_code,
+               error_message);
+    events_.Signal();
   }
+
+  const EventCounter& events() const { return events_; }
+
+ private:
+  EventCounter events_;
+};
+
+// Wait until the events raised by writes to `ref` that already completed
+// have been delivered to its listeners.
+bool WaitForPendingEvents(firebase::database::DatabaseReference ref,
+                          const char* name) {
+  BarrierListener barrier;
+  ref.AddValueListener(&barrier);
+  bool delivered = WaitForEvents(barrier.events(), 1, name, kListenerTimeoutMs);
+  ref.RemoveValueListener(&barrier);
+  return delivered;
 }
 
 extern "C" int common_main(int argc, const char* argv[]) {
+  // Timeline of the startup, from App creation to the first request.
+  app_framework::StartupSequence startup;
   ::firebase::App* app;
 
 #if defined(__ANDROID__)
-  app = ::firebase::App::Create(GetJniEnv(), GetActivity());
+  app = ::firebase::App::Create(app_framework::GetJniEnv(),
+                                app_framework::GetActivity());
 #else
   app = ::firebase::App::Create();
 #endif  // defined(__ANDROID__)
+  startup.Mark("App::Create");
 
   LogMessage("Initialized Firebase App.");
 
   LogMessage("Initialize Firebase Auth and Firebase Database.");
 
-  // Use ModuleInitializer to initialize both Auth and Database, ensuring no
-  // dependencies are missing.
+  // Auth and Database each get their own ModuleInitializer, so if one of
+  // them is waiting for a missing dependency to be resolved the other isn't
+  // held up. Each initializer runs synchronously when its step starts, so
+  // both modules are initialized before sign-in, which depends only on Auth,
+  // is started.
   ::firebase::database::Database* database = nullptr;
   ::firebase::auth::Auth* auth = nullptr;
-  void* initialize_targets[] = {&auth, &database};
-
-  const firebase::ModuleInitializer::InitializerFn initializers[] = {
-      [](::firebase::App* app, void* data) {
+  // Time taken by the first Database::GetInstance() call, which is compared
+  // with later calls by the persistence profile below.
+  int64_t cold_get_instance_us = -1;
+  void* database_targets[] = {&database, &cold_get_instance_us};
+
+  const int auth_step = startup.AddModule(
+      "Auth", app,
+      [](::firebase::App* app, void* target) {
         LogMessage("Attempt to initialize Firebase Auth.");
-        void** targets = reinterpret_cast<void**>(data);
         ::firebase::InitResult result;
-        *reinterpret_cast<::firebase::auth::Auth**>(targets[0]) =
+        *reinterpret_cast<::firebase::auth::Auth**>(target) =
             ::firebase::auth::Auth::GetAuth(app, &result);
         return result;
       },
+      &auth);
+  const int database_step = startup.AddModule(
+      "Firebase Database", app,
       [](::firebase::App* app, void* data) {
         LogMessage("Attempt to initialize Firebase Database.");
         void** targets = reinterpret_cast<void**>(data);
         ::firebase::InitResult result;
-        *reinterpret_cast<::firebase::database::Database**>(targets[1]) =
+        int64_t start_us = GetMonotonicTimeInMicroseconds();
+        *reinterpret_cast<::firebase::database::Database**>(targets[0]) =
             ::firebase::database::Database::GetInstance(app, &result);
+        *reinterpret_cast<int64_t*>(targets[1]) =
+            GetMonotonicTimeInMicroseconds() - start_us;
         return result;
-      }};
-
-  ::firebase::ModuleInitializer initializer;
-  initializer.Initialize(app, initialize_targets, initializers,
-                         sizeof(initializers) / sizeof(initializers[0]));
+      },
+      database_targets);
+  // The default Database permissions allow anonymous users access. This will
+  // work as long as your project's Authentication permissions allow anonymous
+  // signin.
+  const int sign_in_step = startup.AddStep(
+      "SignInAnonymously",
+      [&auth]() -> firebase::FutureBase { return auth->SignInAnonymously(); },
+      {auth_step});
 
-  WaitForCompletion(initializer.InitializeLastResult(), "Initialize");
+  startup.Run();
 
-  if (initializer.InitializeLastResult().error() != 0) {
-    LogMessage("Failed to initialize Firebase libraries: %s",
-               initializer.InitializeLastResult().error_message());
+  if (!startup.succeeded(auth_step) || !startup.succeeded(database_step)) {
+    LogMessage("Failed to initialize Firebase libraries.");
     ProcessEvents(2000);
     return 1;
   }
@@ -194,14 +278,8 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
   database->set_persistence_enabled(true);
 
-  // Sign in using Auth before accessing the database.
-  // The default Database permissions allow anonymous users access. This will
-  // work as long as your project's Authentication permissions allow anonymous
-  // signin.
   {
-    firebase::Future<firebase::auth::User*> sign_in_future =
-        auth->SignInAnonymously();
-    WaitForCompletion(sign_in_future, "SignInAnonymously");
+    const firebase::FutureBase& sign_in_future = startup.result(sign_in_step);
     if (sign_in_future.error() == firebase::auth::kAuthErrorNone) {
       LogMessage("Auth: Signed in anonymously.");
     } else {
@@ -216,6 +294,12 @@ extern "C" int common_main(int argc, const char* argv[]) {
     }
   }
 
+  // The stress tests and benchmarks are slow and write a lot of data, so
+  // they're only run when requested with --benchmark (or another
+  // --benchmark_* flag).
+  app_framework::BenchmarkOptions benchmark_options;
+  app_framework::ParseBenchmarkOptions(argc, argv, &benchmark_options);
+
   std::string saved_url;  // persists across connections
 
   // Create a unique child in the database that we can run our tests in.
@@ -253,12 +337,14 @@ extern "C" int common_main(int argc, const char* argv[]) {
           ref.Child("Simple")
               .Child("IntAndPriority")
               .SetValueAndPriority(kSimpleInt, kSimplePriority);
-      WaitForCompletion(f1, "SetSimpleString");
-      WaitForCompletion(f2, "SetSimpleInt");
-      WaitForCompletion(f3, "SetSimpleDouble");
-      WaitForCompletion(f4, "SetSimpleBool");
-      WaitForCompletion(f5, "SetSimpleTimestamp");
-      WaitForCompletion(f6, "SetSimpleIntAndPriority");
+      // The writes are independent so wait for them as a group, which takes
+      // as long as the slowest write rather than the sum of all of them.
+      LogWaitResults(WaitForAll({f1, f2, f3, f4, f5, f6}),
+                     {"SetSimpleString", "SetSimpleInt", "SetSimpleDouble",
+                      "SetSimpleBool", "SetSimpleTimestamp",
+                      "SetSimpleIntAndPriority"});
+      startup.Mark("First request");
+      startup.LogTimeline();
       if (f1.error() != firebase::database::kErrorNone ||
           f2.error() != firebase::database::kErrorNone ||
           f3.error() != firebase::database::kErrorNone ||
@@ -281,6 +367,8 @@ extern "C" int common_main(int argc, const char* argv[]) {
     // set them to.
     {
       LogMessage("TEST: Get simple values.");
+      // Counts the snapshots and the variants read from them.
+      app_framework::AllocationScope allocation_scope("GetSimpleValues");
       firebase::Future<firebase::database::DataSnapshot> f1 =
           ref.Child("Simple").Child("String").GetValue();
       firebase::Future<firebase::database::DataSnapshot> f2 =
@@ -293,12 +381,10 @@ extern "C" int common_main(int argc, const char* argv[]) {
           ref.Child("Simple").Child("Timestamp").GetValue();
       firebase::Future<firebase::database::DataSnapshot> f6 =
           ref.Child("Simple").Child("IntAndPriority").GetValue();
-      WaitForCompletion(f1, "GetSimpleString");
-      WaitForCompletion(f2, "GetSimpleInt");
-      WaitForCompletion(f3, "GetSimpleDouble");
-      WaitForCompletion(f4, "GetSimpleBool");
-      WaitForCompletion(f5, "GetSimpleTimestamp");
-      WaitForCompletion(f6, "GetSimpleIntAndPriority");
+      LogWaitResults(WaitForAll({f1, f2, f3, f4, f5, f6}),
+                     {"GetSimpleString", "GetSimpleInt", "GetSimpleDouble",
+                      "GetSimpleBool", "GetSimpleTimestamp",
+                      "GetSimpleIntAndPriority"});
 
       if (f1.error() == firebase::database::kErrorNone &&
           f2.error() == firebase::database::kErrorNone &&
@@ -370,24 +456,38 @@ extern "C" int common_main(int argc, const char* argv[]) {
     }
   }
 
-#if defined(__ANDROID__) || TARGET_OS_IPHONE
   // Actually shut down the realtime database, and restart it, to make sure
-  // that persistence persists across database object instances.
+  // that persistence persists across database object instances. While doing
+  // so, profile how long it takes for a cached dataset to be available again.
   {
     // Write a value that we can test for.
     const char* kPersistenceString = "Persistence Test!";
     WaitForCompletion(ref.Child("PersistenceTest").SetValue(kPersistenceString),
                       "SetPersistenceTestValue");
 
-    LogMessage("Destroying database object.");
-    delete database;
-    LogMessage("Recreating database object.");
-    database = ::firebase::database::Database::GetInstance(app);
+    LogMessage("TEST: Persistence warm-start profile.");
+    database_testapp::PersistenceProfileOptions options;
+    database_testapp::PersistenceProfileResult profile;
+    profile.cold_get_instance_us = cold_get_instance_us;
+    LogMessage("Destroying and recreating database object.");
+    database = database_testapp::RunPersistenceProfile(
+        app, database, ref.Child("PersistenceProfile"), options, &profile);
+    if (!database) {
+      LogMessage("ERROR: Persistence profile failed to recreate the database.");
+      ProcessEvents(2000);
+      return 1;
+    }
+    database_testapp::LogPersistenceProfile(profile);
+    if (profile.cached_records == options.record_count) {
+      LogMessage("SUCCESS: Cached dataset read back while offline.");
+    } else {
+      LogMessage("ERROR: Read %d of %d cached records while offline.",
+                 profile.cached_records, options.record_count);
+    }
 
     // Offline mode.  If persistence works, we should still be able to fetch
-    // our value even though we're offline.
-
-    database->GoOffline();
+    // our value even though we're offline. The profile left the database
+    // offline.
     ref = database->GetReferenceFromUrl(saved_url.c_str());
 
     {
@@ -396,10 +496,8 @@ extern "C" int common_main(int argc, const char* argv[]) {
       ExpectValueListener* listener =
           new ExpectValueListener(kPersistenceString);
       ref.Child("PersistenceTest").AddValueListener(listener);
-
-      while (!listener->got_value()) {
-        ProcessEvents(100);
-      }
+      listener->WaitForValue("PersistenceTest ValueListener");
+      ref.Child("PersistenceTest").RemoveValueListener(listener);
       delete listener;
       listener = nullptr;
     }
@@ -426,8 +524,9 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
     LogMessage("Going back online.");
     database->GoOnline();
+    database_testapp::RemovePersistenceProfileData(
+        ref.Child("PersistenceProfile"));
   }
-#endif  // defined(__ANDROID__) || TARGET_OS_IPHONE
 
   // Test running a transaction. This will call RunTransaction and set
   // some values, including incrementing the player's score.
@@ -511,6 +610,26 @@ extern "C" int common_main(int argc, const char* argv[]) {
     }
   }
 
+  // Increment a counter with an increasing number of concurrent transactions
+  // to see how contention affects retries, aborts and latency.
+  if (benchmark_options.enabled) {
+    LogMessage("TEST: Transaction contention stress test.");
+    database_testapp::TransactionStressOptions options;
+    std::vector<database_testapp::TransactionStressResult> results =
+        database_testapp::RunTransactionStress(
+            app, database, ref.Child("TransactionStress").url(), options);
+    database_testapp::LogTransactionStressResults(results);
+    bool consistent = !results.empty();
+    for (size_t i = 0; i < results.size(); ++i) {
+      consistent &= results[i].counter_consistent;
+    }
+    if (consistent) {
+      LogMessage("SUCCESS: Transaction stress counters match their commits.");
+    } else {
+      LogMessage("ERROR: Transaction stress counters don't match commits.");
+    }
+  }
+
   // Set up a map of values that we will put into the database, then modify.
   std::map<std::string, int> sample_values;
   sample_values.insert(std::make_pair("Apple", 1));
@@ -595,6 +714,43 @@ extern "C" int common_main(int argc, const char* argv[]) {
     }
   }
 
+  // Measure how many writes per second the client sustains when writing the
+  // same records as individual pipelined writes, a single multi-path update or
+  // a single write of the whole subtree.
+  if (benchmark_options.enabled) {
+    LogMessage("TEST: Write throughput benchmark.");
+    database_testapp::WriteBenchmarkOptions options;
+    std::vector<database_testapp::WriteBenchmarkResult> results =
+        database_testapp::RunWriteBenchmark(ref.Child("WriteBenchmark"),
+                                            options);
+    database_testapp::LogWriteBenchmarkResults(results);
+    bool failed = false;
+    for (size_t i = 0; i < results.size(); ++i) {
+      if (results[i].failed) failed = true;
+    }
+    if (!failed) {
+      LogMessage("SUCCESS: Write throughput benchmark completed.");
+    } else {
+      LogMessage("ERROR: Write throughput benchmark had failed writes.");
+    }
+  }
+
+  // Build a large payload in place with a VariantBuilder rather than through
+  // nested std::maps, and read it back through a FlatVariant.
+  if (benchmark_options.enabled) {
+    LogMessage("TEST: Variant builder.");
+    database_testapp::VariantBuilderBenchmarkResult result =
+        database_testapp::RunVariantBuilderBenchmark(
+            ref.Child("VariantBuilder"),
+            database_testapp::VariantBuilderBenchmarkOptions());
+    database_testapp::LogVariantBuilderBenchmarkResult(result);
+    if (result.trees_equal && result.read_back_equal) {
+      LogMessage("SUCCESS: Variant builder payload read back correctly.");
+    } else {
+      LogMessage("ERROR: Variant builder payload didn't match.");
+    }
+  }
+
   // Test Query, which gives you different views into the same location in the
   // database.
   {
@@ -628,11 +784,9 @@ extern "C" int common_main(int argc, const char* argv[]) {
                       .EqualTo("Cranberry")
                       .GetValue();
 
-    WaitForCompletion(b_to_d, "QueryBthruD");
-    WaitForCompletion(one_to_three, "Query1to3");
-    WaitForCompletion(four_and_five, "Query4and5");
-    WaitForCompletion(a_and_b, "QueryAandB");
-    WaitForCompletion(c_only, "QueryC");
+    LogWaitResults(
+        WaitForAll({b_to_d, one_to_three, four_and_five, a_and_b, c_only}),
+        {"QueryBthruD", "Query1to3", "Query4and5", "QueryAandB", "QueryC"});
 
     bool failed = false;
     // Check that the queries each returned the expected results.
@@ -677,6 +831,22 @@ extern "C" int common_main(int argc, const char* argv[]) {
     }
   }
 
+  // Stream a large location page by page rather than reading it with a
+  // single GetValue().
+  if (benchmark_options.enabled) {
+    LogMessage("TEST: Query pagination.");
+    database_testapp::QueryPagerBenchmarkResult result =
+        database_testapp::RunQueryPagerBenchmark(
+            ref.Child("QueryPagination"),
+            database_testapp::QueryPagerBenchmarkOptions());
+    database_testapp::LogQueryPagerBenchmarkResult(result);
+    if (result.in_order) {
+      LogMessage("SUCCESS: Query pagination read every child in order.");
+    } else {
+      LogMessage("ERROR: Query pagination missed or reordered children.");
+    }
+  }
+
   // Test a ValueListener, which sits on a Query and listens for changes in
   // the value at that location.
   {
@@ -689,8 +859,9 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
     // The listener's OnChanged callback is triggered once when the listener is
     // attached and again every time the data, including children, changes.
-    // Wait for here for a moment for the initial values to be received.
-    ProcessEvents(2000);
+    // Wait for the initial value to be received.
+    WaitForEvents(listener->events(), 1, "ValueListener initial value",
+                  kListenerTimeoutMs);
 
     WaitForCompletion(ref.Child("ValueListener").SetValue(1), "SetValueOne");
     WaitForCompletion(ref.Child("ValueListener").SetValue(2), "SetValueTwo");
@@ -698,8 +869,9 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
     LogMessage("  Waiting for ValueListener...");
 
-    // Wait a few seconds for the value listener to be triggered.
-    ProcessEvents(2000);
+    // Wait for the value listener to be triggered by each write.
+    WaitForEvents(listener->events(), 4, "ValueListener values",
+                  kListenerTimeoutMs);
 
     // Unregister the listener, so it stops triggering.
     ref.Child("ValueListener").RemoveValueListener(listener);
@@ -707,8 +879,8 @@ extern "C" int common_main(int argc, const char* argv[]) {
     // Ensure that the listener is not triggered once removed.
     WaitForCompletion(ref.Child("ValueListener").SetValue(4), "SetValueFour");
 
-    // Wait a few more seconds to ensure the listener is not triggered.
-    ProcessEvents(2000);
+    // Wait for any events raised by the last write to be delivered.
+    WaitForPendingEvents(ref.Child("ValueListener"), "ValueListener removed");
 
     // Ensure that the listener was only triggered 4 times, with the values
     // 0 (the initial value), 1, 2, and 3.
@@ -735,10 +907,9 @@ extern "C" int common_main(int argc, const char* argv[]) {
         .EqualTo("enemy")
         .AddChildListener(listener);
 
-    // The listener's OnChanged callback is triggered once when the listener is
-    // attached and again every time the data, including children, changes.
-    // Wait for here for a moment for the initial values to be received.
-    ProcessEvents(2000);
+    // The listener's child callbacks are triggered once for each existing
+    // child when the listener is attached and again every time a child
+    // changes. The list is empty, so there are no initial events.
 
     std::map<std::string, std::string> params;
     params["entity_name"] = "cobra";
@@ -794,20 +965,19 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
     LogMessage("  Waiting for ChildListener...");
 
-    // Wait a few seconds for the child listener to be triggered.
-    ProcessEvents(2000);
+    // Wait for the 9 events expected below.
+    WaitForEvents(listener->events(), 9, "ChildListener events",
+                  kListenerTimeoutMs);
 
     // Unregister the listener, so it stops triggering.
     entity_list.OrderByChild("entity_type")
         .EqualTo("enemy")
         .RemoveChildListener(listener);
 
-    // Wait a few seconds for the child listener to be triggered.
-    ProcessEvents(2000);
-
     // Make one more change, to ensure the listener has been removed.
     WaitForCompletion(entity_list.Child("6").SetPriority(0),
                       "SetEntity6Priority");
+    WaitForPendingEvents(entity_list, "ChildListener removed");
 
     // We are expecting to have the following events:
     bool failed = false;
@@ -864,6 +1034,26 @@ extern "C" int common_main(int argc, const char* argv[]) {
     delete listener;
   }
 
+  // Measure how long writes take to reach their listeners and how that
+  // changes as the number of listeners grows.
+  if (benchmark_options.enabled) {
+    LogMessage("TEST: Listener fan-out benchmark.");
+    std::vector<database_testapp::ListenerBenchmarkResult> results =
+        database_testapp::RunListenerBenchmark(
+            ref.Child("ListenerBenchmark"),
+            database_testapp::ListenerBenchmarkOptions());
+    database_testapp::LogListenerBenchmarkResults(results);
+    bool timed_out = false;
+    for (size_t i = 0; i < results.size(); ++i) {
+      timed_out |= results[i].timed_out;
+    }
+    if (timed_out) {
+      LogMessage("ERROR: Listener fan-out benchmark missed events.");
+    } else {
+      LogMessage("SUCCESS: Listener fan-out benchmark completed.");
+    }
+  }
+
   // Now check OnDisconnect. When you set an OnDisconnect handler for a
   // database location, an operation will be performed on that location when
   // you disconnect from Firebase Database. In this sample app, we replicate
@@ -927,9 +1117,7 @@ extern "C" int common_main(int argc, const char* argv[]) {
     LogMessage("  Disconnecting from Firebase Database.");
     database->GoOffline();
 
-    while (!listener->got_value()) {
-      ProcessEvents(100);
-    }
+    listener->WaitForValue("OnDisconnect ValueListener");
     ref.Child("OnDisconnectTests")
         .Child("SetValueTo1")
         .RemoveValueListener(listener);
@@ -1014,6 +1202,30 @@ extern "C" int common_main(int argc, const char* argv[]) {
     test_snapshot_was_valid = test_snapshot->is_valid();
   }
 
+  if (benchmark_options.enabled) {
+    LogMessage("Running benchmarks.");
+    firebase::database::DatabaseReference benchmark_ref =
+        ref.Child("Benchmark");
+    int64_t benchmark_writes = 0;
+    app_framework::BenchmarkSuite benchmarks("database");
+    benchmarks.AddScenario("set_value", [&]() -> firebase::FutureBase {
+      return benchmark_ref.Child("Value").SetValue(
+          firebase::Variant::FromInt64(benchmark_writes++));
+    });
+    benchmarks.AddScenario("get_value", [&]() -> firebase::FutureBase {
+      return benchmark_ref.Child("Value").GetValue();
+    });
+    benchmarks.AddScenario("update_children", [&]() -> firebase::FutureBase {
+      std::map<std::string, firebase::Variant> children;
+      children["one"] = firebase::Variant::FromInt64(benchmark_writes++);
+      children["two"] = firebase::Variant::FromInt64(benchmark_writes++);
+      return benchmark_ref.Child("Children").UpdateChildren(children);
+    });
+    app_framework::RunBenchmarks(&benchmarks, benchmark_options);
+    benchmark_ref.RemoveValue();
+    LogMessage("Ran benchmarks.");
+  }
+
   LogMessage("Shutdown the Database library.");
   delete database;
   database = nullptr;
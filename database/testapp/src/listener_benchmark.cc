@@ -0,0 +1,279 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "listener_benchmark.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "firebase/database.h"
+#include "firebase/variant.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LatencyHistogram;
+using app_framework::LogMessage;
+using app_framework::WaitForCompletion;
+
+namespace database_testapp {
+
+const char kWriteTimeKey[] = "write_us";
+
+namespace {
+
+std::string SiblingKey(int index) {
+  char key[16];
+  snprintf(key, sizeof(key), "l%05d", index);
+  return key;
+}
+
+// Update that writes a TimestampedValue() to each of `count` siblings.
+firebase::Variant SiblingUpdate(int count, int64_t sequence) {
+  std::map<std::string, firebase::Variant> updates;
+  for (int i = 0; i < count; ++i) {
+    updates[SiblingKey(i)] = TimestampedValue(sequence);
+  }
+  return firebase::Variant(updates);
+}
+
+// Issue `write`, then wait for `stats` to have received `expected_total`
+// events. Returns the time taken or -1 if the events didn't arrive in time.
+template <typename WriteFunction>
+int64_t TimeDelivery(const WriteFunction& write, const char* name,
+                     const ListenerEventStats& stats, uint64_t expected_total,
+                     int timeout_ms) {
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  firebase::FutureBase future = write();
+  bool delivered = stats.WaitForTotal(expected_total, timeout_ms);
+  int64_t elapsed_us = GetMonotonicTimeInMicroseconds() - start_us;
+  WaitForCompletion(future, name);
+  return delivered ? elapsed_us : -1;
+}
+
+}  // namespace
+
+const char* ListenerEventTypeName(ListenerEventType type) {
+  static const char* kNames[kListenerEventTypeCount] = {
+      "ValueChanged", "ChildAdded",   "ChildChanged",
+      "ChildMoved",   "ChildRemoved", "Cancelled"};
+  return type >= 0 && type < kListenerEventTypeCount ? kNames[type] : "?";
+}
+
+firebase::Variant TimestampedValue(int64_t sequence) {
+  std::map<std::string, firebase::Variant> value;
+  value[kWriteTimeKey] = GetMonotonicTimeInMicroseconds();
+  value["seq"] = sequence;
+  return firebase::Variant(value);
+}
+
+ListenerEventStats::ListenerEventStats() : write_time_us_(0) {
+  for (int i = 0; i < kListenerEventTypeCount; ++i) counts_[i] = 0;
+}
+
+void ListenerEventStats::Record(
+    ListenerEventType type, const firebase::database::DataSnapshot& snapshot) {
+  int64_t now_us = GetMonotonicTimeInMicroseconds();
+  int64_t write_time_us = 0;
+  if (type != kListenerEventChildRemoved) {
+    firebase::Variant value = snapshot.Child(kWriteTimeKey).value();
+    if (value.is_numeric()) write_time_us = value.AsInt64().int64_value();
+  }
+  if (!write_time_us) {
+    write_time_us = write_time_us_.load(std::memory_order_relaxed);
+  }
+  if (write_time_us) {
+    latency_[type].Record(now_us - write_time_us);
+    if (type != kListenerEventValueChanged) {
+      child_latency_.Record(now_us - write_time_us);
+    }
+  }
+  counts_[type].fetch_add(1, std::memory_order_relaxed);
+  events_.Signal();
+}
+
+void ListenerEventStats::RecordCancelled() {
+  counts_[kListenerEventCancelled].fetch_add(1, std::memory_order_relaxed);
+  events_.Signal();
+}
+
+void ListenerEventStats::MarkWrite(int64_t write_time_us) {
+  write_time_us_.store(write_time_us, std::memory_order_relaxed);
+}
+
+bool ListenerEventStats::WaitForTotal(uint64_t total, int timeout_ms) const {
+  return events_.WaitForCount(static_cast<int>(total), timeout_ms) ==
+         app_framework::kWaitResultComplete;
+}
+
+void InstrumentedValueListener::OnValueChanged(
+    const firebase::database::DataSnapshot& snapshot) {
+  stats_->Record(kListenerEventValueChanged, snapshot);
+}
+
+void InstrumentedValueListener::OnCancelled(
+    const firebase::database::Error& error_code, const char* error_message) {
+  LogMessage("ERROR: InstrumentedValueListener canceled: %d: %s", error_code,
+             error_message);
+  stats_->RecordCancelled();
+}
+
+void InstrumentedChildListener::OnChildAdded(
+    const firebase::database::DataSnapshot& snapshot,
+    const char* /*previous_sibling*/) {
+  stats_->Record(kListenerEventChildAdded, snapshot);
+}
+
+void InstrumentedChildListener::OnChildChanged(
+    const firebase::database::DataSnapshot& snapshot,
+    const char* /*previous_sibling*/) {
+  stats_->Record(kListenerEventChildChanged, snapshot);
+}
+
+void InstrumentedChildListener::OnChildMoved(
+    const firebase::database::DataSnapshot& snapshot,
+    const char* /*previous_sibling*/) {
+  stats_->Record(kListenerEventChildMoved, snapshot);
+}
+
+void InstrumentedChildListener::OnChildRemoved(
+    const firebase::database::DataSnapshot& snapshot) {
+  stats_->Record(kListenerEventChildRemoved, snapshot);
+}
+
+void InstrumentedChildListener::OnCancelled(
+    const firebase::database::Error& error_code, const char* error_message) {
+  LogMessage("ERROR: InstrumentedChildListener canceled: %d: %s", error_code,
+             error_message);
+  stats_->RecordCancelled();
+}
+
+double ListenerBenchmarkResult::attach_us_per_listener() const {
+  return listeners > 0 ? static_cast<double>(attach_us) / listeners : 0.0;
+}
+
+double ListenerBenchmarkResult::add_us_per_listener() const {
+  return listeners > 0 ? static_cast<double>(add_us) / listeners : 0.0;
+}
+
+std::vector<ListenerBenchmarkResult> RunListenerBenchmark(
+    firebase::database::DatabaseReference ref,
+    const ListenerBenchmarkOptions& options) {
+  std::vector<ListenerBenchmarkResult> results;
+  for (size_t run = 0; run < options.listener_counts.size(); ++run) {
+    const int count = options.listener_counts[run];
+    ListenerBenchmarkResult result;
+    result.listeners = count;
+    ListenerEventStats stats;
+    firebase::database::DatabaseReference parent = ref.Child("ListenerFanOut");
+    WaitForCompletion(parent.RemoveValue(), "ClearListenerFanOut");
+
+    // Each listener reports its initial (null) value once it's attached, the
+    // child listener on the empty parent doesn't report anything.
+    InstrumentedChildListener child_listener(&stats);
+    std::vector<firebase::database::DatabaseReference> siblings;
+    std::vector<std::unique_ptr<InstrumentedValueListener>> listeners;
+    siblings.reserve(count);
+    listeners.reserve(count);
+    int64_t start_us = GetMonotonicTimeInMicroseconds();
+    parent.AddChildListener(&child_listener);
+    for (int i = 0; i < count; ++i) {
+      siblings.push_back(parent.Child(SiblingKey(i)));
+      listeners.push_back(std::unique_ptr<InstrumentedValueListener>(
+          new InstrumentedValueListener(&stats)));
+      siblings.back().AddValueListener(listeners.back().get());
+    }
+    uint64_t expected = count;
+    bool delivered = stats.WaitForTotal(expected, options.timeout_ms);
+    result.attach_us = GetMonotonicTimeInMicroseconds() - start_us;
+    result.timed_out |= !delivered;
+
+    // Every write below raises one OnValueChanged() per sibling plus one
+    // child event per sibling on the parent.
+    expected += 2 * count;
+    result.add_us = TimeDelivery(
+        [&]() { return parent.UpdateChildren(SiblingUpdate(count, 1)); },
+        "ListenerFanOut Add", stats, expected, options.timeout_ms);
+    expected += 2 * count;
+    result.change_us = TimeDelivery(
+        [&]() { return parent.UpdateChildren(SiblingUpdate(count, 2)); },
+        "ListenerFanOut Change", stats, expected, options.timeout_ms);
+    expected += 2 * count;
+    result.remove_us = TimeDelivery(
+        [&]() {
+          stats.MarkWrite(GetMonotonicTimeInMicroseconds());
+          return parent.RemoveValue();
+        },
+        "ListenerFanOut Remove", stats, expected, options.timeout_ms);
+    result.timed_out |=
+        result.add_us < 0 || result.change_us < 0 || result.remove_us < 0;
+
+    start_us = GetMonotonicTimeInMicroseconds();
+    for (int i = 0; i < count; ++i) {
+      siblings[i].RemoveValueListener(listeners[i].get());
+    }
+    parent.RemoveChildListener(&child_listener);
+    result.detach_us = GetMonotonicTimeInMicroseconds() - start_us;
+
+    const LatencyHistogram& value_latency =
+        stats.latency(kListenerEventValueChanged);
+    result.value_p50_us = value_latency.Percentile(50.0);
+    result.value_p99_us = value_latency.Percentile(99.0);
+    result.value_max_us = value_latency.max();
+    result.child_p50_us = stats.child_latency().Percentile(50.0);
+    result.child_p99_us = stats.child_latency().Percentile(99.0);
+    for (int type = 0; type < kListenerEventTypeCount; ++type) {
+      result.counts[type] = stats.count(static_cast<ListenerEventType>(type));
+    }
+    if (result.timed_out) {
+      LogMessage("ERROR: ListenerFanOut with %d listeners received %d of %d "
+                 "events.", count, static_cast<int>(stats.total()),
+                 static_cast<int>(expected));
+    }
+    results.push_back(result);
+  }
+  return results;
+}
+
+void LogListenerBenchmarkResults(
+    const std::vector<ListenerBenchmarkResult>& results) {
+  LogMessage("  Write-to-listener latencies in ms.");
+  LogMessage("  %9s %10s %10s %9s %9s %9s %9s %9s %9s %7s", "listeners",
+             "attach ms", "us/attach", "add ms", "us/event", "value p50",
+             "value p99", "child p50", "child p99", "events");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const ListenerBenchmarkResult& result = results[i];
+    uint64_t events = 0;
+    for (int type = 0; type < kListenerEventTypeCount; ++type) {
+      events += result.counts[type];
+    }
+    LogMessage("  %9d %10.1f %10.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %7d%s",
+               result.listeners, result.attach_us / 1000.0,
+               result.attach_us_per_listener(), result.add_us / 1000.0,
+               result.add_us_per_listener(), result.value_p50_us / 1000.0,
+               result.value_p99_us / 1000.0, result.child_p50_us / 1000.0,
+               result.child_p99_us / 1000.0, static_cast<int>(events),
+               result.timed_out ? " (timed out)" : "");
+  }
+}
+
+}  // namespace database_testapp
@@ -0,0 +1,218 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_LISTENER_BENCHMARK_H_  // NOLINT
+#define FIREBASE_TESTAPP_LISTENER_BENCHMARK_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+#include "firebase/database.h"
+#include "firebase/variant.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+namespace database_testapp {
+
+// Events raised by ValueListener and ChildListener.
+enum ListenerEventType {
+  kListenerEventValueChanged = 0,
+  kListenerEventChildAdded,
+  kListenerEventChildChanged,
+  kListenerEventChildMoved,
+  kListenerEventChildRemoved,
+  kListenerEventCancelled,
+  kListenerEventTypeCount
+};
+
+const char* ListenerEventTypeName(ListenerEventType type);
+
+// Child of a value written by TimestampedValue() holding the time of the
+// write, from app_framework::GetMonotonicTimeInMicroseconds().
+extern const char kWriteTimeKey[];
+
+// Returns a map holding the current time in kWriteTimeKey and `sequence` in
+// "seq". Listeners that receive the value measure their delivery latency from
+// the write time.
+firebase::Variant TimestampedValue(int64_t sequence);
+
+// Event counters and write-to-listener latency histograms shared by any number
+// of instrumented listeners. Recording an event is lock-free and O(1), so
+// thousands of listeners can report to the same stats from the database
+// callback thread.
+//
+// The latency of an event is measured from the write time stored in the
+// snapshot's kWriteTimeKey child. Snapshots without one (e.g the null value
+// seen after a removal) and removed children, whose snapshot holds the
+// removed value, are measured from the time passed to MarkWrite() instead.
+// Events seen before the first write are counted but not timed.
+class ListenerEventStats {
+ public:
+  ListenerEventStats();
+
+  void Record(ListenerEventType type,
+              const firebase::database::DataSnapshot& snapshot);
+  void RecordCancelled();
+
+  // Set the time of a write whose events don't carry a timestamp.
+  void MarkWrite(int64_t write_time_us);
+
+  uint64_t count(ListenerEventType type) const {
+    return counts_[type].load(std::memory_order_relaxed);
+  }
+  uint64_t total() const { return static_cast<uint64_t>(events_.count()); }
+  const app_framework::LatencyHistogram& latency(ListenerEventType type) const {
+    return latency_[type];
+  }
+  // Latency of all child events.
+  const app_framework::LatencyHistogram& child_latency() const {
+    return child_latency_;
+  }
+
+  // Process events until total() reaches `total`. Returns false on timeout
+  // or if the app was asked to exit.
+  bool WaitForTotal(uint64_t total, int timeout_ms) const;
+
+ private:
+  ListenerEventStats(const ListenerEventStats&) = delete;
+  ListenerEventStats& operator=(const ListenerEventStats&) = delete;
+
+  std::atomic<uint64_t> counts_[kListenerEventTypeCount];
+  // Signaled for every event.
+  app_framework::EventCounter events_;
+  std::atomic<int64_t> write_time_us_;
+  app_framework::LatencyHistogram latency_[kListenerEventTypeCount];
+  app_framework::LatencyHistogram child_latency_;
+};
+
+// ValueListener that reports each event to a ListenerEventStats.
+class InstrumentedValueListener : public firebase::database::ValueListener {
+ public:
+  explicit InstrumentedValueListener(ListenerEventStats* stats)
+      : stats_(stats) {}
+
+  void OnValueChanged(
+      const firebase::database::DataSnapshot& snapshot) override;
+  void OnCancelled(const firebase::database::Error& error_code,
+                   const char* error_message) override;
+
+ private:
+  ListenerEventStats* stats_;
+};
+
+// ChildListener that reports each event to a ListenerEventStats.
+class InstrumentedChildListener : public firebase::database::ChildListener {
+ public:
+  explicit InstrumentedChildListener(ListenerEventStats* stats)
+      : stats_(stats) {}
+
+  void OnChildAdded(const firebase::database::DataSnapshot& snapshot,
+                    const char* previous_sibling) override;
+  void OnChildChanged(const firebase::database::DataSnapshot& snapshot,
+                      const char* previous_sibling) override;
+  void OnChildMoved(const firebase::database::DataSnapshot& snapshot,
+                    const char* previous_sibling) override;
+  void OnChildRemoved(
+      const firebase::database::DataSnapshot& snapshot) override;
+  void OnCancelled(const firebase::database::Error& error_code,
+                   const char* error_message) override;
+
+ private:
+  ListenerEventStats* stats_;
+};
+
+// Configuration of RunListenerBenchmark().
+struct ListenerBenchmarkOptions {
+  ListenerBenchmarkOptions() : timeout_ms(30000) {
+    listener_counts.push_back(1);
+    listener_counts.push_back(10);
+    listener_counts.push_back(100);
+    listener_counts.push_back(1000);
+  }
+
+  // Number of sibling paths, each with its own ValueListener, of each run.
+  std::vector<int> listener_counts;
+  // Time to wait for the events of each step of a run.
+  int timeout_ms;
+};
+
+// Measurements of one run of RunListenerBenchmark().
+struct ListenerBenchmarkResult {
+  ListenerBenchmarkResult()
+      : listeners(0),
+        attach_us(0),
+        add_us(0),
+        change_us(0),
+        remove_us(0),
+        detach_us(0),
+        value_p50_us(0),
+        value_p99_us(0),
+        value_max_us(0),
+        child_p50_us(0),
+        child_p99_us(0),
+        timed_out(false) {
+    for (int i = 0; i < kListenerEventTypeCount; ++i) counts[i] = 0;
+  }
+
+  int listeners;
+  // Time from attaching the first ValueListener to every listener having
+  // received its initial value.
+  int64_t attach_us;
+  // Time from issuing the write that adds, changes or removes every sibling
+  // to every listener having received the resulting events.
+  int64_t add_us;
+  int64_t change_us;
+  int64_t remove_us;
+  // Time taken to remove every listener.
+  int64_t detach_us;
+  // Write-to-listener latency of OnValueChanged() on the siblings and of the
+  // OnChildAdded/Changed/Removed() events on their parent.
+  int64_t value_p50_us;
+  int64_t value_p99_us;
+  int64_t value_max_us;
+  int64_t child_p50_us;
+  int64_t child_p99_us;
+  // Number of events of each ListenerEventType received.
+  uint64_t counts[kListenerEventTypeCount];
+  // Whether some of the expected events didn't arrive in time.
+  bool timed_out;
+
+  double attach_us_per_listener() const;
+  double add_us_per_listener() const;
+};
+
+// For each entry of options.listener_counts, attach a ValueListener to that
+// many sibling paths below `ref` plus a ChildListener to their parent, then
+// add, change and remove every sibling with one write each, waiting for all
+// listeners to see each write. Measures the cost of attaching listeners and
+// of delivering one write to all of them as fan-out grows.
+//
+// Local writes raise events before the server acknowledges them, so the
+// latencies measure the client's event dispatch rather than a network round
+// trip. The data written is removed afterwards.
+std::vector<ListenerBenchmarkResult> RunListenerBenchmark(
+    firebase::database::DatabaseReference ref,
+    const ListenerBenchmarkOptions& options);
+
+// Log a table of the results of RunListenerBenchmark().
+void LogListenerBenchmarkResults(
+    const std::vector<ListenerBenchmarkResult>& results);
+
+}  // namespace database_testapp
+
+#endif  // FIREBASE_TESTAPP_LISTENER_BENCHMARK_H_  // NOLINT
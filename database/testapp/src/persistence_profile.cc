@@ -0,0 +1,242 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "persistence_profile.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif  // defined(_WIN32)
+
+#include <map>
+#include <string>
+
+#include "firebase/app.h"
+#include "firebase/database.h"
+#include "firebase/variant.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+#include "write_benchmark.h"  // NOLINT
+
+using app_framework::EventCounter;
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+using app_framework::RecordLatency;
+using app_framework::WaitForCompletion;
+using app_framework::WaitForEvents;
+
+namespace database_testapp {
+
+namespace {
+
+// Directories nested deeper than this below the root aren't measured.
+const int kMaxDirectoryDepth = 16;
+
+const double kBytesPerKilobyte = 1024.0;
+
+bool AddDirectorySize(const std::string& path, int depth, uint64_t* bytes,
+                      int* files) {
+  if (depth > kMaxDirectoryDepth) return true;
+#if defined(_WIN32)
+  WIN32_FIND_DATAA entry;
+  HANDLE find = FindFirstFileA((path + "\\*").c_str(), &entry);
+  if (find == INVALID_HANDLE_VALUE) return false;
+  do {
+    std::string name(entry.cFileName);
+    if (name == "." || name == "..") continue;
+    if (entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) continue;
+    if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+      AddDirectorySize(path + "\\" + name, depth + 1, bytes, files);
+    } else {
+      *bytes += (static_cast<uint64_t>(entry.nFileSizeHigh) << 32) |
+                entry.nFileSizeLow;
+      (*files)++;
+    }
+  } while (FindNextFileA(find, &entry));
+  FindClose(find);
+#else
+  DIR* directory = opendir(path.c_str());
+  if (!directory) return false;
+  while (struct dirent* entry = readdir(directory)) {
+    std::string name(entry->d_name);
+    if (name == "." || name == "..") continue;
+    std::string entry_path = path + "/" + name;
+    struct stat status;
+    if (lstat(entry_path.c_str(), &status) != 0) continue;
+    if (S_ISDIR(status.st_mode)) {
+      AddDirectorySize(entry_path, depth + 1, bytes, files);
+    } else if (S_ISREG(status.st_mode)) {
+      *bytes += static_cast<uint64_t>(status.st_size);
+      (*files)++;
+    }
+  }
+  closedir(directory);
+#endif  // defined(_WIN32)
+  return true;
+}
+
+firebase::Variant MakeDataset(const PersistenceProfileOptions& options) {
+  const std::string payload(options.value_size, 'p');
+  std::map<std::string, firebase::Variant> dataset;
+  for (int i = 0; i < options.record_count; ++i) {
+    char key[24];
+    snprintf(key, sizeof(key), "record%05d", i);
+    std::map<std::string, firebase::Variant> record;
+    record["index"] = i;
+    record["payload"] = payload;
+    dataset[key] = firebase::Variant(record);
+  }
+  return firebase::Variant(dataset);
+}
+
+// Records when the first value arrives and how many children it has.
+class FirstValueListener : public firebase::database::ValueListener {
+ public:
+  explicit FirstValueListener(int64_t start_us)
+      : start_us_(start_us), latency_us_(-1), children_(0) {}
+
+  void OnValueChanged(
+      const firebase::database::DataSnapshot& snapshot) override {
+    if (events_.count()) return;
+    latency_us_ = GetMonotonicTimeInMicroseconds() - start_us_;
+    children_ = static_cast<int>(snapshot.children_count());
+    events_.Signal();
+  }
+  void OnCancelled(const firebase::database::Error& error_code,
+                   const char* error_message) override {
+    LogMessage("ERROR: FirstValueListener canceled: %d: %s", error_code,
+               error_message);
+  }
+
+  const EventCounter& events() const { return events_; }
+  int64_t latency_us() const { return latency_us_; }
+  int children() const { return children_; }
+
+ private:
+  const int64_t start_us_;
+  int64_t latency_us_;
+  int children_;
+  EventCounter events_;
+};
+
+// Log a duration of PersistenceProfileResult, which is -1 if the step failed.
+void LogDuration(const char* step, int64_t duration_us) {
+  if (duration_us < 0) {
+    LogMessage("  %s: failed", step);
+  } else {
+    LogMessage("  %s: %.2f ms", step, duration_us / 1000.0);
+  }
+}
+
+std::string StripTrailingSlash(const std::string& path) {
+  if (path.size() > 1 && (path[path.size() - 1] == '/' ||
+                          path[path.size() - 1] == '\\')) {
+    return path.substr(0, path.size() - 1);
+  }
+  return path;
+}
+
+}  // namespace
+
+bool GetDirectorySize(const std::string& path, uint64_t* bytes, int* files) {
+  *bytes = 0;
+  *files = 0;
+  return AddDirectorySize(StripTrailingSlash(path.empty() ? "." : path), 0,
+                          bytes, files);
+}
+
+firebase::database::Database* RunPersistenceProfile(
+    firebase::App* app, firebase::database::Database* database,
+    firebase::database::DatabaseReference ref,
+    const PersistenceProfileOptions& options,
+    PersistenceProfileResult* result) {
+  const std::string resource_path = app_framework::PathForResource();
+  const std::string url = ref.url();
+  result->records = options.record_count;
+  GetDirectorySize(resource_path, &result->disk_bytes_before,
+                   &result->disk_files_before);
+
+  // Only data that is listened to or kept synced is cached, so keep the
+  // dataset synced for the new instance to find it on disk.
+  firebase::Variant dataset = MakeDataset(options);
+  result->dataset_bytes = JsonSize(dataset);
+  ref.SetKeepSynced(true);
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  if (WaitForCompletion(ref.SetValue(dataset), "PersistenceProfile Fill",
+                        options.timeout_ms)) {
+    result->fill_us = GetMonotonicTimeInMicroseconds() - start_us;
+  }
+
+  start_us = GetMonotonicTimeInMicroseconds();
+  delete database;
+  result->destroy_us = GetMonotonicTimeInMicroseconds() - start_us;
+  GetDirectorySize(resource_path, &result->disk_bytes_after,
+                   &result->disk_files_after);
+
+  start_us = GetMonotonicTimeInMicroseconds();
+  database = firebase::database::Database::GetInstance(app);
+  if (!database) {
+    LogMessage("ERROR: Unable to recreate the database.");
+    return nullptr;
+  }
+  result->warm_get_instance_us = GetMonotonicTimeInMicroseconds() - start_us;
+  RecordLatency("Database::GetInstance warm", result->warm_get_instance_us);
+  database->set_persistence_enabled(true);
+
+  // Offline, the first value can only come from the cache.
+  database->GoOffline();
+  firebase::database::DatabaseReference cached_ref =
+      database->GetReferenceFromUrl(url.c_str());
+  FirstValueListener listener(GetMonotonicTimeInMicroseconds());
+  cached_ref.AddValueListener(&listener);
+  if (WaitForEvents(listener.events(), 1, "PersistenceProfile FirstValue",
+                    options.timeout_ms)) {
+    result->first_cached_value_us = listener.latency_us();
+    result->cached_records = listener.children();
+  }
+  cached_ref.RemoveValueListener(&listener);
+  return database;
+}
+
+void RemovePersistenceProfileData(firebase::database::DatabaseReference ref) {
+  ref.SetKeepSynced(false);
+  WaitForCompletion(ref.RemoveValue(), "RemovePersistenceProfile");
+}
+
+void LogPersistenceProfile(const PersistenceProfileResult& result) {
+  LogMessage("  Dataset: %d records, %.1f KB", result.records,
+             result.dataset_bytes / kBytesPerKilobyte);
+  LogDuration("Cold GetInstance", result.cold_get_instance_us);
+  LogDuration("Fill", result.fill_us);
+  LogDuration("Delete database", result.destroy_us);
+  LogDuration("Warm GetInstance", result.warm_get_instance_us);
+  LogDuration("First cached OnValueChanged", result.first_cached_value_us);
+  LogMessage("  Records in the first cached value: %d", result.cached_records);
+  LogMessage("  Files below %s: %d -> %d, %.1f KB -> %.1f KB",
+             app_framework::PathForResource().c_str(),
+             result.disk_files_before, result.disk_files_after,
+             result.disk_bytes_before / kBytesPerKilobyte,
+             result.disk_bytes_after / kBytesPerKilobyte);
+}
+
+}  // namespace database_testapp
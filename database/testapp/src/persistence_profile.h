@@ -0,0 +1,114 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_PERSISTENCE_PROFILE_H_  // NOLINT
+#define FIREBASE_TESTAPP_PERSISTENCE_PROFILE_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "firebase/app.h"
+#include "firebase/database.h"
+
+namespace database_testapp {
+
+// Configuration of RunPersistenceProfile().
+struct PersistenceProfileOptions {
+  PersistenceProfileOptions()
+      : record_count(1000), value_size(256), timeout_ms(30000) {}
+
+  // Number of records written to the cache and the length of the string
+  // payload of each one.
+  int record_count;
+  size_t value_size;
+  // Time to wait for the dataset to be written and read back.
+  int timeout_ms;
+};
+
+// Measurements of RunPersistenceProfile(). Durations are -1 if the step
+// failed.
+struct PersistenceProfileResult {
+  PersistenceProfileResult()
+      : records(0),
+        dataset_bytes(0),
+        cold_get_instance_us(-1),
+        fill_us(-1),
+        destroy_us(-1),
+        warm_get_instance_us(-1),
+        first_cached_value_us(-1),
+        cached_records(0),
+        disk_bytes_before(0),
+        disk_bytes_after(0),
+        disk_files_before(0),
+        disk_files_after(0) {}
+
+  int records;
+  // Size of the JSON encoding of the dataset.
+  uint64_t dataset_bytes;
+  // Time taken by the first Database::GetInstance() call of the process,
+  // measured by the caller.
+  int64_t cold_get_instance_us;
+  // Time taken to write the dataset and have the server acknowledge it.
+  int64_t fill_us;
+  // Time taken to delete the Database, which flushes the cache.
+  int64_t destroy_us;
+  // Time taken by Database::GetInstance() once the cache is on disk.
+  int64_t warm_get_instance_us;
+  // Time from attaching a ValueListener to the dataset while offline to its
+  // first OnValueChanged(), which is served from the cache.
+  int64_t first_cached_value_us;
+  // Number of records in that first value.
+  int cached_records;
+  // Size and number of the files below app_framework::PathForResource()
+  // before the dataset was written and after the Database was deleted.
+  uint64_t disk_bytes_before;
+  uint64_t disk_bytes_after;
+  int disk_files_before;
+  int disk_files_after;
+};
+
+// Sum the size of the regular files below `path`, without following
+// symbolic links. Returns false if `path` couldn't be read.
+bool GetDirectorySize(const std::string& path, uint64_t* bytes, int* files);
+
+// Profile how quickly the offline cache warms up. Writes a dataset of
+// options.record_count records to `ref`, which is kept synced so the data is
+// cached, deletes `database` and creates a new instance with persistence
+// enabled, then takes it offline and reads the dataset back from the cache.
+//
+// The caller fills in result->cold_get_instance_us, the cost of the first
+// Database::GetInstance() call, as only the caller can measure it.
+//
+// Returns the new Database instance, which is left offline, or nullptr if it
+// couldn't be created. `ref` belongs to the deleted instance and mustn't be
+// used again. Call RemovePersistenceProfileData() with a reference from the
+// new instance once it's back online.
+firebase::database::Database* RunPersistenceProfile(
+    firebase::App* app, firebase::database::Database* database,
+    firebase::database::DatabaseReference ref,
+    const PersistenceProfileOptions& options,
+    PersistenceProfileResult* result);
+
+// Stop keeping `ref` synced and remove the dataset written by
+// RunPersistenceProfile().
+void RemovePersistenceProfileData(firebase::database::DatabaseReference ref);
+
+// Log the results of RunPersistenceProfile().
+void LogPersistenceProfile(const PersistenceProfileResult& result);
+
+}  // namespace database_testapp
+
+#endif  // FIREBASE_TESTAPP_PERSISTENCE_PROFILE_H_  // NOLINT
@@ -0,0 +1,190 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "query_pager.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "firebase/database.h"
+#include "firebase/future.h"
+#include "firebase/variant.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+using app_framework::RecordLatency;
+using app_framework::WaitForAll;
+using app_framework::WaitForCompletion;
+
+namespace database_testapp {
+
+namespace {
+
+std::string ChildKey(int index) {
+  char key[16];
+  snprintf(key, sizeof(key), "c%07d", index);
+  return key;
+}
+
+}  // namespace
+
+QueryPager::QueryPager(firebase::database::DatabaseReference ref,
+                       size_t page_size)
+    : ref_(ref),
+      page_size_(std::max(page_size, static_cast<size_t>(1))),
+      requested_(false),
+      done_(false),
+      error_(0),
+      pages_(0),
+      children_(0),
+      stall_us_(0) {}
+
+void QueryPager::RequestPage() {
+  requested_ = true;
+  if (last_key_.empty()) {
+    pending_ = ref_.OrderByKey().LimitToFirst(page_size_).GetValue();
+  } else {
+    pending_ = ref_.OrderByKey()
+                   .StartAt(firebase::Variant(last_key_))
+                   .LimitToFirst(page_size_ + 1)
+                   .GetValue();
+  }
+}
+
+bool QueryPager::NextPage(
+    std::vector<firebase::database::DataSnapshot>* children, int timeout_ms) {
+  children->clear();
+  if (done_ || error_) return false;
+  if (!requested_) RequestPage();
+
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  bool stalled = pending_.status() == firebase::kFutureStatusPending;
+  app_framework::WaitResult wait_result =
+      app_framework::WaitForFuture(pending_, timeout_ms);
+  if (stalled) {
+    int64_t waited_us = GetMonotonicTimeInMicroseconds() - start_us;
+    stall_us_ += waited_us;
+    RecordLatency("QueryPager stall", waited_us);
+  }
+  if (wait_result != app_framework::kWaitResultComplete) {
+    error_ = -1;
+    return false;
+  }
+  if (pending_.error() != firebase::database::kErrorNone) {
+    error_ = pending_.error();
+    LogMessage("ERROR: QueryPager page %d failed with error %d: %s", pages_,
+               pending_.error(), pending_.error_message());
+    return false;
+  }
+
+  std::vector<firebase::database::DataSnapshot> page =
+      pending_.result()->children();
+  pending_ = firebase::Future<firebase::database::DataSnapshot>();
+  const size_t limit = last_key_.empty() ? page_size_ : page_size_ + 1;
+  done_ = page.size() < limit;
+  if (!last_key_.empty() && !page.empty() &&
+      page.front().key_string() == last_key_) {
+    page.erase(page.begin());
+  }
+  if (page.empty()) {
+    done_ = true;
+    return false;
+  }
+  last_key_ = page.back().key_string();
+  pages_++;
+  children_ += static_cast<int64_t>(page.size());
+  children->swap(page);
+  if (!done_) RequestPage();
+  return true;
+}
+
+QueryPagerBenchmarkResult RunQueryPagerBenchmark(
+    firebase::database::DatabaseReference ref,
+    const QueryPagerBenchmarkOptions& options) {
+  QueryPagerBenchmarkResult result;
+  WaitForCompletion(ref.RemoveValue(), "ClearQueryPager");
+
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  std::vector<firebase::FutureBase> writes;
+  const int batch_size = std::max(options.write_batch_size, 1);
+  for (int first = 0; first < options.child_count; first += batch_size) {
+    std::map<std::string, firebase::Variant> batch;
+    int last = std::min(first + batch_size, options.child_count);
+    for (int i = first; i < last; ++i) batch[ChildKey(i)] = i;
+    writes.push_back(ref.UpdateChildren(firebase::Variant(batch)));
+  }
+  std::vector<app_framework::FutureWaitResult> write_results =
+      WaitForAll(writes, options.timeout_ms);
+  result.write_us = GetMonotonicTimeInMicroseconds() - start_us;
+  for (size_t i = 0; i < write_results.size(); ++i) {
+    if (write_results[i].result == app_framework::kWaitResultComplete &&
+        write_results[i].error == 0) {
+      result.children_written += std::min(
+          batch_size, options.child_count - static_cast<int>(i) * batch_size);
+    }
+  }
+  if (result.children_written != options.child_count) {
+    LogMessage("ERROR: Only wrote %d of %d QueryPager children.",
+               result.children_written, options.child_count);
+  }
+
+  start_us = GetMonotonicTimeInMicroseconds();
+  QueryPager pager(ref, options.page_size);
+  std::vector<firebase::database::DataSnapshot> page;
+  int64_t expected = 0;
+  while (pager.NextPage(&page, options.timeout_ms)) {
+    result.max_page_children = std::max(result.max_page_children, page.size());
+    for (size_t i = 0; i < page.size(); ++i, ++expected) {
+      if (page[i].value().AsInt64().int64_value() != expected) {
+        result.in_order = false;
+      }
+    }
+  }
+  result.read_us = GetMonotonicTimeInMicroseconds() - start_us;
+  result.children_read = pager.children();
+  result.pages = pager.pages();
+  result.stall_us = pager.stall_us();
+  if (pager.error() || result.children_read != result.children_written) {
+    result.in_order = false;
+  }
+
+  WaitForCompletion(ref.RemoveValue(), "RemoveQueryPager");
+  return result;
+}
+
+void LogQueryPagerBenchmarkResult(const QueryPagerBenchmarkResult& result) {
+  LogMessage("  Wrote %d children in %.1f ms", result.children_written,
+             result.write_us / 1000.0);
+  LogMessage("  Read %lld children in %d pages in %.1f ms (%.0f children/s)",
+             static_cast<long long>(result.children_read),  // NOLINT
+             result.pages, result.read_us / 1000.0,
+             result.read_us > 0
+                 ? result.children_read * 1000000.0 / result.read_us
+                 : 0.0);
+  LogMessage("  Waited %.1f ms for pages, largest page %d children",
+             result.stall_us / 1000.0,
+             static_cast<int>(result.max_page_children));
+}
+
+}  // namespace database_testapp
@@ -0,0 +1,131 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_QUERY_PAGER_H_  // NOLINT
+#define FIREBASE_TESTAPP_QUERY_PAGER_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "firebase/database.h"
+#include "firebase/future.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+
+namespace database_testapp {
+
+// Reads the children of a location in key order, one page at a time, using
+// OrderByKey().StartAt(<last key>).LimitToFirst(<page size + 1>) queries.
+//
+// While the caller processes a page the request for the following page is
+// already in flight, so network latency overlaps with processing. At most
+// the current page and the page being fetched are held, so memory use is
+// bounded by the page size rather than by the size of the location.
+class QueryPager {
+ public:
+  // `page_size` is the number of children returned by each NextPage() call,
+  // except the last.
+  QueryPager(firebase::database::DatabaseReference ref, size_t page_size);
+
+  // Wait for the next page and replace the contents of `children` with it,
+  // then request the page after it. Returns false once every child has been
+  // returned, or if a request failed or timed out, see error().
+  bool NextPage(std::vector<firebase::database::DataSnapshot>* children,
+                int timeout_ms = app_framework::kWaitForever);
+
+  // Error of the request that failed, 0 if none did.
+  int error() const { return error_; }
+  // Number of pages and children returned so far.
+  int pages() const { return pages_; }
+  int64_t children() const { return children_; }
+  // Time NextPage() spent waiting for pages that hadn't arrived yet.
+  int64_t stall_us() const { return stall_us_; }
+
+ private:
+  void RequestPage();
+
+  firebase::database::DatabaseReference ref_;
+  const size_t page_size_;
+  // Key of the last child returned. Queries are inclusive of their start, so
+  // this child is dropped from the page that starts with it.
+  std::string last_key_;
+  firebase::Future<firebase::database::DataSnapshot> pending_;
+  bool requested_;
+  bool done_;
+  int error_;
+  int pages_;
+  int64_t children_;
+  int64_t stall_us_;
+};
+
+// Configuration of RunQueryPagerBenchmark().
+struct QueryPagerBenchmarkOptions {
+  QueryPagerBenchmarkOptions()
+      : child_count(100000),
+        page_size(1000),
+        write_batch_size(5000),
+        timeout_ms(60000) {}
+
+  // Number of children written and then read back.
+  int child_count;
+  // Children per page read.
+  size_t page_size;
+  // Children per UpdateChildren() call while writing the dataset.
+  int write_batch_size;
+  // Time to wait for each write and page.
+  int timeout_ms;
+};
+
+// Measurements of RunQueryPagerBenchmark().
+struct QueryPagerBenchmarkResult {
+  QueryPagerBenchmarkResult()
+      : children_written(0),
+        children_read(0),
+        pages(0),
+        max_page_children(0),
+        in_order(true),
+        write_us(0),
+        read_us(0),
+        stall_us(0) {}
+
+  int children_written;
+  int64_t children_read;
+  int pages;
+  // Largest number of children held at once, bounding memory use.
+  size_t max_page_children;
+  // Whether every child was read exactly once, in key order.
+  bool in_order;
+  int64_t write_us;
+  int64_t read_us;
+  // Part of read_us spent waiting for pages rather than processing them.
+  int64_t stall_us;
+};
+
+// Write options.child_count children below `ref` in batches, then stream
+// them back with a QueryPager, checking that each child is read once and in
+// order. The data written is removed afterwards.
+QueryPagerBenchmarkResult RunQueryPagerBenchmark(
+    firebase::database::DatabaseReference ref,
+    const QueryPagerBenchmarkOptions& options);
+
+// Log the results of RunQueryPagerBenchmark().
+void LogQueryPagerBenchmarkResult(const QueryPagerBenchmarkResult& result);
+
+}  // namespace database_testapp
+
+#endif  // FIREBASE_TESTAPP_QUERY_PAGER_H_  // NOLINT
@@ -0,0 +1,254 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "transaction_stress.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "firebase/app.h"
+#include "firebase/auth.h"
+#include "firebase/database.h"
+#include "firebase/future.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::FutureWaitResult;
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LatencyHistogram;
+using app_framework::LogMessage;
+using app_framework::RecordLatency;
+using app_framework::WaitForAll;
+using app_framework::WaitForCompletion;
+
+namespace database_testapp {
+
+namespace {
+
+// State shared with the transaction function of a single transaction.
+struct TransactionContext {
+  TransactionContext() : executions(0), retry_budget(0) {}
+
+  // The transaction function runs on the database's worker thread.
+  std::atomic<int> executions;
+  int retry_budget;
+};
+
+firebase::database::TransactionResult IncrementCounter(
+    firebase::database::MutableData* data, void* context_void) {
+  TransactionContext* context =
+      static_cast<TransactionContext*>(context_void);
+  int executions = ++context->executions;
+  if (context->retry_budget && executions > context->retry_budget) {
+    return firebase::database::kTransactionResultAbort;
+  }
+  firebase::Variant value = data->value();
+  int64_t count = value.is_numeric() ? value.AsInt64().int64_value() : 0;
+  data->set_value(count + 1);
+  return firebase::database::kTransactionResultSuccess;
+}
+
+// An App, signed in anonymously, with its own connection to the database.
+struct StressClient {
+  StressClient() : app(nullptr), auth(nullptr), database(nullptr) {}
+
+  firebase::App* app;
+  firebase::auth::Auth* auth;
+  firebase::database::Database* database;
+};
+
+bool CreateClient(firebase::App* app, int index, StressClient* client) {
+  char name[32];
+  snprintf(name, sizeof(name), "transaction_stress_%d", index);
+#if defined(__ANDROID__)
+  client->app = firebase::App::Create(app->options(), name,
+                                      app_framework::GetJniEnv(),
+                                      app_framework::GetActivity());
+#else
+  client->app = firebase::App::Create(app->options(), name);
+#endif  // defined(__ANDROID__)
+  if (!client->app) return false;
+  client->auth = firebase::auth::Auth::GetAuth(client->app);
+  if (client->auth) {
+    WaitForCompletion(client->auth->SignInAnonymously(),
+                      "TransactionStress SignInAnonymously");
+  }
+  client->database = firebase::database::Database::GetInstance(client->app);
+  return client->database != nullptr;
+}
+
+void DestroyClient(StressClient* client) {
+  delete client->database;
+  if (client->auth) client->auth->SignOut();
+  delete client->auth;
+  delete client->app;
+  *client = StressClient();
+}
+
+// Run options.rounds groups of refs.size() concurrent transactions, each
+// incrementing the counter through the matching entry of `refs`.
+TransactionStressResult RunLevel(
+    TransactionStressMode mode,
+    std::vector<firebase::database::DatabaseReference>* refs,
+    const TransactionStressOptions& options) {
+  TransactionStressResult result;
+  result.mode = mode;
+  result.concurrency = static_cast<int>(refs->size());
+  WaitForCompletion((*refs)[0].SetValue(0), "TransactionStress Reset");
+
+  LatencyHistogram latencies;
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  for (int round = 0; round < options.rounds; ++round) {
+    std::vector<std::unique_ptr<TransactionContext>> contexts;
+    std::vector<firebase::FutureBase> futures;
+    std::vector<int64_t> issue_us;
+    for (size_t i = 0; i < refs->size(); ++i) {
+      contexts.push_back(
+          std::unique_ptr<TransactionContext>(new TransactionContext));
+      contexts.back()->retry_budget = options.retry_budget;
+      issue_us.push_back(GetMonotonicTimeInMicroseconds());
+      futures.push_back(
+          (*refs)[i].RunTransaction(IncrementCounter, contexts.back().get()));
+    }
+    int64_t wait_start_us = GetMonotonicTimeInMicroseconds();
+    std::vector<FutureWaitResult> wait_results =
+        WaitForAll(futures, options.timeout_ms);
+    for (size_t i = 0; i < wait_results.size(); ++i) {
+      const FutureWaitResult& wait_result = wait_results[i];
+      result.transactions++;
+      if (wait_result.result != app_framework::kWaitResultComplete) {
+        // The transaction function may still run, so its context is freed
+        // once the transaction finishes rather than under it.
+        TransactionContext* context = contexts[i].release();
+        futures[i].OnCompletion(
+            [context](const firebase::FutureBase&) { delete context; });
+        result.failed++;
+        continue;
+      }
+      int executions = contexts[i]->executions;
+      result.executions += executions;
+      result.max_executions = std::max(result.max_executions, executions);
+      if (wait_result.error == firebase::database::kErrorNone) {
+        result.committed++;
+      } else if (wait_result.error ==
+                     firebase::database::kErrorTransactionAbortedByUser ||
+                 wait_result.error == firebase::database::kErrorMaxRetries) {
+        result.aborted++;
+      } else {
+        result.failed++;
+      }
+      int64_t latency_us = wait_start_us - issue_us[i] + wait_result.latency_us;
+      latencies.Record(latency_us);
+      RecordLatency("TransactionStress", latency_us);
+    }
+  }
+  result.elapsed_us = GetMonotonicTimeInMicroseconds() - start_us;
+  result.latency_p50_us = latencies.Percentile(50.0);
+  result.latency_p99_us = latencies.Percentile(99.0);
+  result.latency_max_us = latencies.max();
+
+  firebase::Future<firebase::database::DataSnapshot> future =
+      (*refs)[0].GetValue();
+  if (WaitForCompletion(future, "TransactionStress ReadCounter")) {
+    result.counter_consistent =
+        future.result()->value().AsInt64().int64_value() == result.committed;
+  }
+  return result;
+}
+
+const char* ModeName(TransactionStressMode mode) {
+  return mode == kTransactionStressSharedClient ? "shared" : "separate";
+}
+
+}  // namespace
+
+double TransactionStressResult::commit_rate() const {
+  return transactions ? static_cast<double>(committed) / transactions : 0.0;
+}
+
+double TransactionStressResult::retries_per_transaction() const {
+  int finished = transactions - failed;
+  return finished ? static_cast<double>(executions - finished) / finished
+                  : 0.0;
+}
+
+std::vector<TransactionStressResult> RunTransactionStress(
+    firebase::App* app, firebase::database::Database* database,
+    const std::string& url, const TransactionStressOptions& options) {
+  std::vector<TransactionStressResult> results;
+  int max_concurrency = 0;
+  for (size_t i = 0; i < options.contention_levels.size(); ++i) {
+    max_concurrency = std::max(max_concurrency, options.contention_levels[i]);
+  }
+  if (max_concurrency <= 0) return results;
+
+  for (size_t i = 0; i < options.contention_levels.size(); ++i) {
+    std::vector<firebase::database::DatabaseReference> refs(
+        options.contention_levels[i],
+        database->GetReferenceFromUrl(url.c_str()));
+    results.push_back(
+        RunLevel(kTransactionStressSharedClient, &refs, options));
+  }
+
+  std::vector<StressClient> clients(max_concurrency);
+  bool created = true;
+  for (int i = 0; i < max_concurrency && created; ++i) {
+    created = CreateClient(app, i, &clients[i]);
+  }
+  if (created) {
+    for (size_t i = 0; i < options.contention_levels.size(); ++i) {
+      std::vector<firebase::database::DatabaseReference> refs;
+      for (int j = 0; j < options.contention_levels[i]; ++j) {
+        refs.push_back(clients[j].database->GetReferenceFromUrl(url.c_str()));
+      }
+      results.push_back(
+          RunLevel(kTransactionStressSeparateClients, &refs, options));
+    }
+  } else {
+    LogMessage("ERROR: Unable to create the transaction stress clients.");
+  }
+  for (size_t i = 0; i < clients.size(); ++i) DestroyClient(&clients[i]);
+
+  WaitForCompletion(database->GetReferenceFromUrl(url.c_str()).RemoveValue(),
+                    "RemoveTransactionStress");
+  return results;
+}
+
+void LogTransactionStressResults(
+    const std::vector<TransactionStressResult>& results) {
+  LogMessage("  %-8s %3s %6s %7s %7s %6s %9s %8s %9s %9s %9s", "clients", "K",
+             "txns", "commit%", "aborted", "failed", "retries/t", "max runs",
+             "p50 ms", "p99 ms", "max ms");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const TransactionStressResult& result = results[i];
+    LogMessage("  %-8s %3d %6d %7.1f %7d %6d %9.2f %8d %9.1f %9.1f %9.1f%s",
+               ModeName(result.mode), result.concurrency, result.transactions,
+               result.commit_rate() * 100.0, result.aborted, result.failed,
+               result.retries_per_transaction(), result.max_executions,
+               result.latency_p50_us / 1000.0, result.latency_p99_us / 1000.0,
+               result.latency_max_us / 1000.0,
+               result.counter_consistent ? "" : " (counter mismatch)");
+  }
+}
+
+}  // namespace database_testapp
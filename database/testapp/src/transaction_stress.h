@@ -0,0 +1,121 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_TRANSACTION_STRESS_H_  // NOLINT
+#define FIREBASE_TESTAPP_TRANSACTION_STRESS_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "firebase/app.h"
+#include "firebase/database.h"
+
+namespace database_testapp {
+
+// Configuration of RunTransactionStress().
+struct TransactionStressOptions {
+  TransactionStressOptions()
+      : rounds(3), retry_budget(0), timeout_ms(60000) {
+    contention_levels.push_back(1);
+    contention_levels.push_back(2);
+    contention_levels.push_back(4);
+    contention_levels.push_back(8);
+  }
+
+  // Numbers of concurrent transactions (K) to measure.
+  std::vector<int> contention_levels;
+  // Number of times each group of K transactions is run per level.
+  int rounds;
+  // If non-zero, a transaction function that has run this many times aborts
+  // the transaction rather than retrying again, modeling a client that gives
+  // up on a hot counter. Otherwise transactions are retried until the SDK
+  // gives up with kErrorMaxRetries.
+  int retry_budget;
+  // Time to wait for each round.
+  int timeout_ms;
+};
+
+// How the concurrent transactions of a level are issued.
+enum TransactionStressMode {
+  // All transactions run on the same Database instance. The client queues
+  // transactions on the same location locally, so they rarely conflict on
+  // the server.
+  kTransactionStressSharedClient = 0,
+  // Each transaction runs on its own Database instance, from its own App, so
+  // every transaction is a separate client competing for the node.
+  kTransactionStressSeparateClients,
+};
+
+// Measurements of one contention level.
+struct TransactionStressResult {
+  TransactionStressResult()
+      : mode(kTransactionStressSharedClient),
+        concurrency(0),
+        transactions(0),
+        committed(0),
+        aborted(0),
+        failed(0),
+        executions(0),
+        max_executions(0),
+        elapsed_us(0),
+        latency_p50_us(0),
+        latency_p99_us(0),
+        latency_max_us(0),
+        counter_consistent(false) {}
+
+  TransactionStressMode mode;
+  // Number of transactions run at the same time (K).
+  int concurrency;
+  int transactions;
+  // Transactions that committed, were aborted (by the retry budget or the
+  // SDK's retry limit) or failed with any other error.
+  int committed;
+  int aborted;
+  int failed;
+  // Number of times the transaction functions ran in total and the most any
+  // single transaction ran. Every execution after the first of a transaction
+  // is a retry caused by a conflicting write or a stale local value.
+  int executions;
+  int max_executions;
+  // Time taken by all rounds.
+  int64_t elapsed_us;
+  // Time from issuing each transaction to its completion.
+  int64_t latency_p50_us;
+  int64_t latency_p99_us;
+  int64_t latency_max_us;
+  // Whether the counter ended up equal to the number of commits.
+  bool counter_consistent;
+
+  double commit_rate() const;
+  double retries_per_transaction() const;
+};
+
+// Increment a counter at `url` with K concurrent transactions for each
+// options.contention_levels entry, first with every transaction on
+// `database`, then with each from a separate client. Clients are created from
+// named copies of `app` and sign in anonymously. The counter is removed
+// afterwards.
+std::vector<TransactionStressResult> RunTransactionStress(
+    firebase::App* app, firebase::database::Database* database,
+    const std::string& url, const TransactionStressOptions& options);
+
+// Log a table of the results of RunTransactionStress().
+void LogTransactionStressResults(
+    const std::vector<TransactionStressResult>& results);
+
+}  // namespace database_testapp
+
+#endif  // FIREBASE_TESTAPP_TRANSACTION_STRESS_H_  // NOLINT
@@ -0,0 +1,441 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "variant_builder.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "firebase/database.h"
+#include "firebase/future.h"
+#include "firebase/variant.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+using app_framework::WaitForCompletion;
+
+namespace database_testapp {
+
+VariantBuilder::VariantBuilder() : root_(firebase::Variant::EmptyMap()) {
+  open_.push_back(&root_);
+}
+
+firebase::Variant* VariantBuilder::Insert(const std::string& key,
+                                          firebase::Variant value) {
+  firebase::Variant* container = open_.back();
+  if (container->is_vector()) return Push(std::move(value));
+  std::map<firebase::Variant, firebase::Variant>& map = container->map();
+  // The hint makes appending keys in order constant time. An existing key
+  // is found by emplace_hint() and overwritten.
+  std::map<firebase::Variant, firebase::Variant>::iterator it =
+      map.emplace_hint(map.end(), firebase::Variant(key), firebase::Variant());
+  it->second = std::move(value);
+  return &it->second;
+}
+
+firebase::Variant* VariantBuilder::Push(firebase::Variant value) {
+  firebase::Variant* container = open_.back();
+  if (container->is_map()) return Insert(std::string(), std::move(value));
+  std::vector<firebase::Variant>& vector = container->vector();
+  vector.push_back(std::move(value));
+  return &vector.back();
+}
+
+VariantBuilder& VariantBuilder::Set(const std::string& key,
+                                    firebase::Variant value) {
+  Insert(key, std::move(value));
+  return *this;
+}
+
+VariantBuilder& VariantBuilder::Append(firebase::Variant value) {
+  Push(std::move(value));
+  return *this;
+}
+
+VariantBuilder& VariantBuilder::BeginMap(const std::string& key) {
+  open_.push_back(Insert(key, firebase::Variant::EmptyMap()));
+  return *this;
+}
+
+VariantBuilder& VariantBuilder::BeginVector(const std::string& key) {
+  open_.push_back(Insert(key, firebase::Variant::EmptyVector()));
+  return *this;
+}
+
+VariantBuilder& VariantBuilder::AppendMap() {
+  open_.push_back(Push(firebase::Variant::EmptyMap()));
+  return *this;
+}
+
+VariantBuilder& VariantBuilder::AppendVector() {
+  open_.push_back(Push(firebase::Variant::EmptyVector()));
+  return *this;
+}
+
+VariantBuilder& VariantBuilder::End() {
+  if (open_.size() > 1) open_.pop_back();
+  return *this;
+}
+
+firebase::Variant VariantBuilder::Build() {
+  firebase::Variant tree(std::move(root_));
+  root_ = firebase::Variant::EmptyMap();
+  open_.resize(1);
+  return tree;
+}
+
+FlatVariant::Type FlatVariant::Node::type() const {
+  return flat_ ? static_cast<Type>(flat_->nodes_[index_].type) : kTypeNull;
+}
+
+const char* FlatVariant::Node::key() const {
+  if (!flat_) return "";
+  uint32_t key = flat_->nodes_[index_].key;
+  return key == kNoKey ? "" : flat_->strings_.c_str() + key;
+}
+
+int64_t FlatVariant::Node::int64_value() const {
+  switch (type()) {
+    case kTypeInt64:
+      return flat_->nodes_[index_].int64_value;
+    case kTypeDouble:
+      return static_cast<int64_t>(flat_->nodes_[index_].double_value);
+    default:
+      return 0;
+  }
+}
+
+double FlatVariant::Node::double_value() const {
+  switch (type()) {
+    case kTypeInt64:
+      return static_cast<double>(flat_->nodes_[index_].int64_value);
+    case kTypeDouble:
+      return flat_->nodes_[index_].double_value;
+    default:
+      return 0.0;
+  }
+}
+
+bool FlatVariant::Node::bool_value() const {
+  return type() == kTypeBool && flat_->nodes_[index_].bool_value;
+}
+
+const char* FlatVariant::Node::string_value() const {
+  Type node_type = type();
+  if (node_type != kTypeString && node_type != kTypeBlob) return "";
+  return flat_->strings_.c_str() + flat_->nodes_[index_].range.offset;
+}
+
+size_t FlatVariant::Node::string_size() const {
+  Type node_type = type();
+  if (node_type != kTypeString && node_type != kTypeBlob) return 0;
+  return flat_->nodes_[index_].range.size;
+}
+
+size_t FlatVariant::Node::size() const {
+  Type node_type = type();
+  if (node_type != kTypeVector && node_type != kTypeMap) return 0;
+  return flat_->nodes_[index_].range.size;
+}
+
+FlatVariant::Node FlatVariant::Node::child(size_t index) const {
+  if (index >= size()) return Node();
+  return Node(flat_, flat_->nodes_[index_].range.offset +
+                         static_cast<uint32_t>(index));
+}
+
+FlatVariant::Node FlatVariant::Node::Find(const char* key) const {
+  if (type() != kTypeMap) return Node();
+  const Entry& entry = flat_->nodes_[index_];
+  const char* strings = flat_->strings_.c_str();
+  uint32_t first = entry.range.offset;
+  uint32_t last = first + entry.range.size;
+  while (first < last) {
+    uint32_t middle = first + (last - first) / 2;
+    int order = strcmp(strings + flat_->nodes_[middle].key, key);
+    if (order == 0) return Node(flat_, middle);
+    if (order < 0) {
+      first = middle + 1;
+    } else {
+      last = middle;
+    }
+  }
+  return Node();
+}
+
+uint32_t FlatVariant::AddString(const char* data, size_t size) {
+  uint32_t offset = static_cast<uint32_t>(strings_.size());
+  strings_.append(data, size);
+  strings_.push_back('\0');
+  return offset;
+}
+
+void FlatVariant::SetScalar(const firebase::Variant& value, Entry* entry) {
+  entry->range.offset = 0;
+  entry->range.size = 0;
+  if (value.is_int64()) {
+    entry->type = kTypeInt64;
+    entry->int64_value = value.int64_value();
+  } else if (value.is_double()) {
+    entry->type = kTypeDouble;
+    entry->double_value = value.double_value();
+  } else if (value.is_bool()) {
+    entry->type = kTypeBool;
+    entry->bool_value = value.bool_value();
+  } else if (value.is_string()) {
+    entry->type = kTypeString;
+    const char* string_value = value.string_value();
+    size_t size = strlen(string_value);
+    entry->range.offset = AddString(string_value, size);
+    entry->range.size = static_cast<uint32_t>(size);
+  } else if (value.is_blob()) {
+    entry->type = kTypeBlob;
+    entry->range.offset = AddString(
+        reinterpret_cast<const char*>(value.blob_data()), value.blob_size());
+    entry->range.size = static_cast<uint32_t>(value.blob_size());
+  } else if (value.is_vector()) {
+    entry->type = kTypeVector;
+  } else if (value.is_map()) {
+    entry->type = kTypeMap;
+  } else {
+    entry->type = kTypeNull;
+  }
+}
+
+void FlatVariant::Assign(const firebase::Variant& value) {
+  nodes_.clear();
+  strings_.clear();
+  // Nodes are laid out breadth first: when a container is reached its
+  // children are appended together, so they're adjacent. sources[i] is the
+  // Variant nodes_[i] was copied from.
+  std::vector<const firebase::Variant*> sources;
+  nodes_.push_back(Entry());
+  nodes_.back().key = kNoKey;
+  SetScalar(value, &nodes_.back());
+  sources.push_back(&value);
+
+  // Children of the map being expanded, sorted by key.
+  std::vector<std::pair<uint32_t, const firebase::Variant*>> children;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const firebase::Variant& source = *sources[i];
+    uint32_t first = static_cast<uint32_t>(nodes_.size());
+    if (source.is_vector()) {
+      const std::vector<firebase::Variant>& vector = source.vector();
+      for (size_t j = 0; j < vector.size(); ++j) {
+        nodes_.push_back(Entry());
+        nodes_.back().key = kNoKey;
+        SetScalar(vector[j], &nodes_.back());
+        sources.push_back(&vector[j]);
+      }
+    } else if (source.is_map()) {
+      const std::map<firebase::Variant, firebase::Variant>& map = source.map();
+      children.clear();
+      for (std::map<firebase::Variant, firebase::Variant>::const_iterator it =
+               map.begin();
+           it != map.end(); ++it) {
+        uint32_t key;
+        if (it->first.is_string()) {
+          const char* string_value = it->first.string_value();
+          key = AddString(string_value, strlen(string_value));
+        } else {
+          firebase::Variant string_key = it->first.AsString();
+          key = AddString(string_key.string_value(),
+                          strlen(string_key.string_value()));
+        }
+        children.push_back(std::make_pair(key, &it->second));
+      }
+      // Variant orders string keys by strcmp(), so this only sorts maps
+      // that have keys of other types.
+      const char* strings = strings_.c_str();
+      struct KeyLess {
+        explicit KeyLess(const char* key_strings) : strings(key_strings) {}
+        bool operator()(
+            const std::pair<uint32_t, const firebase::Variant*>& lhs,
+            const std::pair<uint32_t, const firebase::Variant*>& rhs) const {
+          return strcmp(strings + lhs.first, strings + rhs.first) < 0;
+        }
+        const char* strings;
+      };
+      KeyLess key_less(strings);
+      if (!std::is_sorted(children.begin(), children.end(), key_less)) {
+        std::sort(children.begin(), children.end(), key_less);
+      }
+      for (size_t j = 0; j < children.size(); ++j) {
+        nodes_.push_back(Entry());
+        nodes_.back().key = children[j].first;
+        SetScalar(*children[j].second, &nodes_.back());
+        sources.push_back(children[j].second);
+      }
+    } else {
+      continue;
+    }
+    nodes_[i].range.offset = first;
+    nodes_[i].range.size = static_cast<uint32_t>(nodes_.size()) - first;
+  }
+}
+
+FlatVariant::Node FlatVariant::root() const {
+  return nodes_.empty() ? Node() : Node(this, 0);
+}
+
+size_t FlatVariant::bytes() const {
+  return nodes_.capacity() * sizeof(Entry) + strings_.capacity();
+}
+
+namespace {
+
+std::string RecordKey(int index) {
+  char key[16];
+  snprintf(key, sizeof(key), "r%07d", index);
+  return key;
+}
+
+std::string RecordName(int index, size_t size) {
+  return std::string(size, static_cast<char>('a' + index % 26));
+}
+
+}  // namespace
+
+VariantBuilderBenchmarkResult RunVariantBuilderBenchmark(
+    firebase::database::DatabaseReference ref,
+    const VariantBuilderBenchmarkOptions& options) {
+  VariantBuilderBenchmarkResult result;
+  result.entries = options.entry_count;
+  int64_t expected_sum = 0;
+  for (int i = 0; i < options.entry_count; ++i) expected_sum += i;
+
+  // Assemble the payload the way the samples do: a std::map per record,
+  // each converted to a Variant when it's added to its parent, and the whole
+  // tree converted again when it's passed to SetValue().
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  firebase::Variant std_map_payload;
+  {
+    std::map<std::string, firebase::Variant> records;
+    for (int i = 0; i < options.entry_count; ++i) {
+      std::map<std::string, firebase::Variant> record;
+      record["active"] = i % 2 == 0;
+      record["index"] = i;
+      record["name"] = RecordName(i, options.value_size);
+      record["score"] = i * 0.5;
+      records[RecordKey(i)] = record;
+    }
+    std_map_payload = firebase::Variant(records);
+  }
+  result.std_map_build_us = GetMonotonicTimeInMicroseconds() - start_us;
+
+  start_us = GetMonotonicTimeInMicroseconds();
+  VariantBuilder builder;
+  for (int i = 0; i < options.entry_count; ++i) {
+    builder.BeginMap(RecordKey(i))
+        .Set("active", i % 2 == 0)
+        .Set("index", i)
+        .Set("name", RecordName(i, options.value_size))
+        .Set("score", i * 0.5)
+        .End();
+  }
+  firebase::Variant payload = builder.Build();
+  result.builder_build_us = GetMonotonicTimeInMicroseconds() - start_us;
+  result.trees_equal = payload == std_map_payload;
+  std_map_payload = firebase::Variant::Null();
+
+  start_us = GetMonotonicTimeInMicroseconds();
+  bool written = WaitForCompletion(ref.SetValue(payload),
+                                   "VariantBuilder SetValue");
+  if (written) result.write_us = GetMonotonicTimeInMicroseconds() - start_us;
+  payload = firebase::Variant::Null();
+
+  start_us = GetMonotonicTimeInMicroseconds();
+  firebase::Future<firebase::database::DataSnapshot> future = ref.GetValue();
+  if (written && WaitForCompletion(future, "VariantBuilder GetValue")) {
+    result.read_us = GetMonotonicTimeInMicroseconds() - start_us;
+    firebase::Variant value = future.result()->value();
+
+    start_us = GetMonotonicTimeInMicroseconds();
+    FlatVariant flat(value);
+    result.flatten_us = GetMonotonicTimeInMicroseconds() - start_us;
+    result.flat_nodes = flat.node_count();
+    result.flat_bytes = flat.bytes();
+
+    start_us = GetMonotonicTimeInMicroseconds();
+    int64_t variant_sum = 0;
+    size_t variant_records = 0;
+    if (value.is_map()) {
+      const firebase::Variant index_key("index");
+      const std::map<firebase::Variant, firebase::Variant>& records =
+          value.map();
+      for (std::map<firebase::Variant, firebase::Variant>::const_iterator it =
+               records.begin();
+           it != records.end(); ++it, ++variant_records) {
+        if (!it->second.is_map()) continue;
+        std::map<firebase::Variant, firebase::Variant>::const_iterator index =
+            it->second.map().find(index_key);
+        if (index != it->second.map().end() && index->second.is_numeric()) {
+          variant_sum += index->second.AsInt64().int64_value();
+        }
+      }
+    }
+    result.variant_scan_us = GetMonotonicTimeInMicroseconds() - start_us;
+
+    start_us = GetMonotonicTimeInMicroseconds();
+    int64_t flat_sum = 0;
+    FlatVariant::Node root = flat.root();
+    for (size_t i = 0; i < root.size(); ++i) {
+      flat_sum += root.child(i).Find("index").int64_value();
+    }
+    result.flat_scan_us = GetMonotonicTimeInMicroseconds() - start_us;
+
+    FlatVariant::Node last =
+        root.Find(RecordKey(options.entry_count - 1).c_str());
+    result.read_back_equal =
+        root.size() == static_cast<size_t>(options.entry_count) &&
+        variant_records == root.size() && variant_sum == expected_sum &&
+        flat_sum == expected_sum &&
+        (options.entry_count == 0 ||
+         last.Find("name").string_size() == options.value_size);
+  }
+
+  WaitForCompletion(ref.RemoveValue(), "RemoveVariantBuilder");
+  return result;
+}
+
+void LogVariantBuilderBenchmarkResult(
+    const VariantBuilderBenchmarkResult& result) {
+  LogMessage("  Built %d records in %.1f ms with std::map, %.1f ms with "
+             "VariantBuilder%s",
+             result.entries, result.std_map_build_us / 1000.0,
+             result.builder_build_us / 1000.0,
+             result.trees_equal ? "" : " (trees differ)");
+  LogMessage("  Wrote in %.1f ms, read back in %.1f ms",
+             result.write_us / 1000.0, result.read_us / 1000.0);
+  LogMessage("  Flattened %d nodes into %d bytes in %.1f ms",
+             static_cast<int>(result.flat_nodes),
+             static_cast<int>(result.flat_bytes), result.flatten_us / 1000.0);
+  LogMessage("  Scanned records in %.2f ms via Variant, %.2f ms via "
+             "FlatVariant",
+             result.variant_scan_us / 1000.0, result.flat_scan_us / 1000.0);
+}
+
+}  // namespace database_testapp
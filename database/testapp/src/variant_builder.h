@@ -0,0 +1,232 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_VARIANT_BUILDER_H_  // NOLINT
+#define FIREBASE_TESTAPP_VARIANT_BUILDER_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "firebase/database.h"
+#include "firebase/variant.h"
+
+namespace database_testapp {
+
+// Builds a Variant tree in place. Payloads assembled as nested
+// std::map<std::string, Variant> are converted to a Variant, copying every
+// node, when they're passed to SetValue() or UpdateChildren(). The builder
+// instead inserts each value straight into its final position in the tree,
+// so every node is allocated once and no intermediate containers exist, and
+// Build() moves the finished tree out.
+//
+// Keys added to a map in ascending order are inserted in constant time.
+//
+//   VariantBuilder builder;
+//   builder.BeginMap("player").Set("name", "Ann").Set("score", 10).End();
+//   ref.SetValue(builder.Build());
+class VariantBuilder {
+ public:
+  // The root of the tree is a map.
+  VariantBuilder();
+
+  // Set `key` of the innermost open map to `value`.
+  VariantBuilder& Set(const std::string& key, firebase::Variant value);
+  // Append `value` to the innermost open vector.
+  VariantBuilder& Append(firebase::Variant value);
+
+  // Open a map or vector at `key` of the innermost open map, or appended to
+  // the innermost open vector. Values are added to it until End().
+  VariantBuilder& BeginMap(const std::string& key);
+  VariantBuilder& BeginVector(const std::string& key);
+  VariantBuilder& AppendMap();
+  VariantBuilder& AppendVector();
+  VariantBuilder& End();
+
+  // Number of containers opened with Begin*() / Append*() and not yet closed.
+  size_t depth() const { return open_.size() - 1; }
+
+  // Returns the tree, closing any open containers, and resets the builder.
+  firebase::Variant Build();
+
+ private:
+  VariantBuilder(const VariantBuilder&) = delete;
+  VariantBuilder& operator=(const VariantBuilder&) = delete;
+
+  firebase::Variant* Insert(const std::string& key, firebase::Variant value);
+  firebase::Variant* Push(firebase::Variant value);
+
+  firebase::Variant root_;
+  // Innermost open container last. Containers are only modified while
+  // they're innermost, so pointers to them stay valid.
+  std::vector<firebase::Variant*> open_;
+};
+
+// Read-only, compact copy of a Variant tree, e.g DataSnapshot::value().
+// Every node lives in one array and every key and string in one buffer, so a
+// tree of any size takes a handful of allocations, and the children of a
+// container are adjacent so iterating them doesn't chase pointers. Map
+// children are sorted by key and can be found by binary search.
+class FlatVariant {
+ public:
+  enum Type {
+    kTypeNull = 0,
+    kTypeInt64,
+    kTypeDouble,
+    kTypeBool,
+    kTypeString,
+    kTypeBlob,
+    kTypeVector,
+    kTypeMap,
+  };
+
+  // A node of a FlatVariant, valid while the FlatVariant isn't modified.
+  class Node {
+   public:
+    Node() : flat_(nullptr), index_(0) {}
+
+    bool is_valid() const { return flat_ != nullptr; }
+    Type type() const;
+    // Key of a map child, empty otherwise.
+    const char* key() const;
+
+    int64_t int64_value() const;
+    double double_value() const;
+    bool bool_value() const;
+    // NUL terminated string or the bytes of a blob.
+    const char* string_value() const;
+    size_t string_size() const;
+
+    // Number of children of a map or vector, 0 for other types.
+    size_t size() const;
+    Node child(size_t index) const;
+    // Child of a map with `key`, invalid if there's none.
+    Node Find(const char* key) const;
+
+   private:
+    friend class FlatVariant;
+    Node(const FlatVariant* flat, uint32_t index)
+        : flat_(flat), index_(index) {}
+
+    const FlatVariant* flat_;
+    uint32_t index_;
+  };
+
+  FlatVariant() {}
+  explicit FlatVariant(const firebase::Variant& value) { Assign(value); }
+
+  // Replace the contents with a copy of `value`. Reuses the existing buffers.
+  void Assign(const firebase::Variant& value);
+  void Assign(const firebase::database::DataSnapshot& snapshot) {
+    Assign(snapshot.value());
+  }
+
+  // Root of the tree, invalid if nothing was assigned.
+  Node root() const;
+
+  size_t node_count() const { return nodes_.size(); }
+  // Memory used by the nodes and strings.
+  size_t bytes() const;
+
+ private:
+  struct Entry {
+    uint8_t type;
+    // Offset of the key in strings_, kNoKey if the node has none.
+    uint32_t key;
+    // Scalars are stored inline. Strings and blobs hold their offset in
+    // strings_ and size, containers the index of their first child and
+    // their number of children.
+    union {
+      int64_t int64_value;
+      double double_value;
+      bool bool_value;
+      struct {
+        uint32_t offset;
+        uint32_t size;
+      } range;
+    };
+  };
+
+  static const uint32_t kNoKey = 0xffffffff;
+
+  uint32_t AddString(const char* data, size_t size);
+  void SetScalar(const firebase::Variant& value, Entry* entry);
+
+  std::vector<Entry> nodes_;
+  std::string strings_;
+};
+
+// Configuration of RunVariantBuilderBenchmark().
+struct VariantBuilderBenchmarkOptions {
+  VariantBuilderBenchmarkOptions() : entry_count(10000), value_size(32) {}
+
+  // Number of records in the map that's built and written.
+  int entry_count;
+  // Length of the string payload of each record.
+  size_t value_size;
+};
+
+// Measurements of RunVariantBuilderBenchmark().
+struct VariantBuilderBenchmarkResult {
+  VariantBuilderBenchmarkResult()
+      : entries(0),
+        std_map_build_us(0),
+        builder_build_us(0),
+        trees_equal(false),
+        write_us(-1),
+        read_us(-1),
+        flatten_us(0),
+        variant_scan_us(0),
+        flat_scan_us(0),
+        flat_nodes(0),
+        flat_bytes(0),
+        read_back_equal(false) {}
+
+  int entries;
+  // Time to assemble the payload as nested std::maps and convert it to a
+  // Variant, as SetValue() does, and to build it with a VariantBuilder.
+  int64_t std_map_build_us;
+  int64_t builder_build_us;
+  bool trees_equal;
+  // Time to write the payload and read it back.
+  int64_t write_us;
+  int64_t read_us;
+  // Time to copy the value read into a FlatVariant, and to sum a field of
+  // every record using the Variant and the FlatVariant.
+  int64_t flatten_us;
+  int64_t variant_scan_us;
+  int64_t flat_scan_us;
+  size_t flat_nodes;
+  size_t flat_bytes;
+  // Whether the flattened value matched the payload.
+  bool read_back_equal;
+};
+
+// Compare building a payload of options.entry_count records with nested
+// std::maps and with a VariantBuilder, write it to `ref`, read it back and
+// scan it through Variant and FlatVariant. The data written is removed
+// afterwards.
+VariantBuilderBenchmarkResult RunVariantBuilderBenchmark(
+    firebase::database::DatabaseReference ref,
+    const VariantBuilderBenchmarkOptions& options);
+
+// Log the results of RunVariantBuilderBenchmark().
+void LogVariantBuilderBenchmarkResult(
+    const VariantBuilderBenchmarkResult& result);
+
+}  // namespace database_testapp
+
+#endif  // FIREBASE_TESTAPP_VARIANT_BUILDER_H_  // NOLINT
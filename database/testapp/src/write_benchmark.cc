@@ -0,0 +1,251 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "write_benchmark.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "firebase/database.h"
+#include "firebase/future.h"
+#include "firebase/variant.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::FutureWaitResult;
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LatencyHistogram;
+using app_framework::LogMessage;
+using app_framework::RecordLatency;
+using app_framework::WaitForAll;
+using app_framework::WaitForCompletion;
+
+namespace database_testapp {
+
+namespace {
+
+// Size of a write frame excluding its path and value, assuming a four digit
+// request number: {"t":"d","d":{"r":1234,"a":"p","b":{"p":"","d":}}}
+const size_t kWriteFrameOverhead = 50;
+
+size_t JsonStringSize(const char* text) {
+  size_t size = 2;
+  for (const char* c = text; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      size += 2;
+    } else if (static_cast<unsigned char>(*c) < 0x20) {
+      size += 6;
+    } else {
+      size++;
+    }
+  }
+  return size;
+}
+
+// Path of `ref` relative to the root of the database, e.g "/a/b".
+std::string PathOf(const firebase::database::DatabaseReference& ref) {
+  std::string url = ref.url();
+  size_t scheme = url.find("://");
+  size_t path = url.find('/', scheme == std::string::npos ? 0 : scheme + 3);
+  return path == std::string::npos ? "/" : url.substr(path);
+}
+
+std::string RecordKey(int index) {
+  char key[16];
+  snprintf(key, sizeof(key), "record%05d", index);
+  return key;
+}
+
+firebase::Variant MakeRecord(int index, const std::string& payload) {
+  std::map<std::string, firebase::Variant> record;
+  record["index"] = index;
+  record["payload"] = payload;
+  return firebase::Variant(record);
+}
+
+// Fill in the result of a strategy that writes everything with one request.
+void RunSingleRequest(const firebase::FutureBase& future, int64_t start_us,
+                      WriteBenchmarkResult* result) {
+  result->requests = 1;
+  std::string name = std::string("WriteBenchmark ") + result->strategy;
+  if (!WaitForCompletion(future, name.c_str())) result->failed = 1;
+  result->elapsed_us = GetMonotonicTimeInMicroseconds() - start_us;
+  result->latency_p50_us = result->elapsed_us;
+  result->latency_p99_us = result->elapsed_us;
+  result->latency_max_us = result->elapsed_us;
+}
+
+}  // namespace
+
+double WriteBenchmarkResult::records_per_second() const {
+  return elapsed_us > 0 ? static_cast<double>(records - failed) * 1000000.0 /
+                              static_cast<double>(elapsed_us)
+                        : 0.0;
+}
+
+size_t JsonSize(const firebase::Variant& value) {
+  char number[32];
+  if (value.is_null()) {
+    return 4;
+  } else if (value.is_bool()) {
+    return value.bool_value() ? 4 : 5;
+  } else if (value.is_int64()) {
+    return static_cast<size_t>(snprintf(
+        number, sizeof(number), "%lld",
+        static_cast<long long>(value.int64_value())));  // NOLINT
+  } else if (value.is_double()) {
+    return static_cast<size_t>(
+        snprintf(number, sizeof(number), "%.17g", value.double_value()));
+  } else if (value.is_string()) {
+    return JsonStringSize(value.string_value());
+  } else if (value.is_blob()) {
+    // Blobs are sent as base64 strings.
+    return (value.blob_size() + 2) / 3 * 4 + 2;
+  } else if (value.is_vector()) {
+    const std::vector<firebase::Variant>& items = value.vector();
+    size_t size = 2 + (items.empty() ? 0 : items.size() - 1);
+    for (size_t i = 0; i < items.size(); ++i) size += JsonSize(items[i]);
+    return size;
+  } else if (value.is_map()) {
+    const std::map<firebase::Variant, firebase::Variant>& items = value.map();
+    size_t size = 2 + (items.empty() ? 0 : items.size() - 1);
+    for (std::map<firebase::Variant, firebase::Variant>::const_iterator it =
+             items.begin();
+         it != items.end(); ++it) {
+      firebase::Variant key = it->first.AsString();
+      size += JsonStringSize(key.string_value()) + 1 + JsonSize(it->second);
+    }
+    return size;
+  }
+  return 0;
+}
+
+uint64_t EstimateWireBytes(const std::string& path,
+                           const firebase::Variant& value) {
+  return kWriteFrameOverhead + JsonStringSize(path.c_str()) - 2 +
+         JsonSize(value);
+}
+
+std::vector<WriteBenchmarkResult> RunWriteBenchmark(
+    firebase::database::DatabaseReference ref,
+    const WriteBenchmarkOptions& options) {
+  const std::string root_path = PathOf(ref);
+  const std::string payload(options.value_size, 'x');
+  std::vector<WriteBenchmarkResult> results;
+
+  {
+    WriteBenchmarkResult result;
+    result.strategy = "FanOut";
+    result.records = options.write_count;
+    result.requests = options.write_count;
+    firebase::database::DatabaseReference fan_out = ref.Child("FanOut");
+    std::vector<firebase::FutureBase> futures;
+    std::vector<int64_t> issue_us;
+    futures.reserve(options.write_count);
+    issue_us.reserve(options.write_count);
+    int64_t start_us = GetMonotonicTimeInMicroseconds();
+    for (int i = 0; i < options.write_count; ++i) {
+      std::string key = RecordKey(i);
+      firebase::Variant record = MakeRecord(i, payload);
+      result.wire_bytes +=
+          EstimateWireBytes(root_path + "/FanOut/" + key, record);
+      issue_us.push_back(GetMonotonicTimeInMicroseconds());
+      futures.push_back(fan_out.Child(key).SetValue(record));
+    }
+    int64_t wait_start_us = GetMonotonicTimeInMicroseconds();
+    std::vector<FutureWaitResult> wait_results = WaitForAll(futures);
+    result.elapsed_us = GetMonotonicTimeInMicroseconds() - start_us;
+    // Latencies reported by WaitForAll() start when the wait started, add the
+    // time each write was waiting before that.
+    LatencyHistogram latencies;
+    for (size_t i = 0; i < wait_results.size(); ++i) {
+      const FutureWaitResult& wait_result = wait_results[i];
+      if (wait_result.result != app_framework::kWaitResultComplete ||
+          wait_result.error != 0) {
+        result.failed++;
+        continue;
+      }
+      int64_t latency_us = wait_start_us - issue_us[i] + wait_result.latency_us;
+      latencies.Record(latency_us);
+      RecordLatency("WriteBenchmark FanOut", latency_us);
+    }
+    if (result.failed) {
+      LogMessage("ERROR: %d of %d FanOut writes failed.", result.failed,
+                 result.requests);
+    }
+    result.latency_p50_us = latencies.Percentile(50.0);
+    result.latency_p99_us = latencies.Percentile(99.0);
+    result.latency_max_us = latencies.max();
+    results.push_back(result);
+  }
+
+  {
+    WriteBenchmarkResult result;
+    result.strategy = "MultiPathUpdate";
+    result.records = options.write_count;
+    std::map<std::string, firebase::Variant> updates;
+    for (int i = 0; i < options.write_count; ++i) {
+      updates["MultiPathUpdate/" + RecordKey(i)] = MakeRecord(i, payload);
+    }
+    firebase::Variant value(updates);
+    result.wire_bytes = EstimateWireBytes(root_path, value);
+    int64_t start_us = GetMonotonicTimeInMicroseconds();
+    RunSingleRequest(ref.UpdateChildren(value), start_us, &result);
+    if (result.failed) result.failed = result.records;
+    results.push_back(result);
+  }
+
+  {
+    WriteBenchmarkResult result;
+    result.strategy = "SubtreeSet";
+    result.records = options.write_count;
+    std::map<std::string, firebase::Variant> subtree;
+    for (int i = 0; i < options.write_count; ++i) {
+      subtree[RecordKey(i)] = MakeRecord(i, payload);
+    }
+    firebase::Variant value(subtree);
+    result.wire_bytes = EstimateWireBytes(root_path + "/SubtreeSet", value);
+    int64_t start_us = GetMonotonicTimeInMicroseconds();
+    RunSingleRequest(ref.Child("SubtreeSet").SetValue(value), start_us,
+                     &result);
+    if (result.failed) result.failed = result.records;
+    results.push_back(result);
+  }
+
+  WaitForCompletion(ref.RemoveValue(), "RemoveWriteBenchmark");
+  return results;
+}
+
+void LogWriteBenchmarkResults(
+    const std::vector<WriteBenchmarkResult>& results) {
+  LogMessage("  %-16s %8s %10s %9s %9s %9s %10s %6s", "strategy", "requests",
+             "records/s", "p50 ms", "p99 ms", "max ms", "KB sent", "failed");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const WriteBenchmarkResult& result = results[i];
+    LogMessage("  %-16s %8d %10.0f %9.1f %9.1f %9.1f %10.1f %6d",
+               result.strategy, result.requests, result.records_per_second(),
+               result.latency_p50_us / 1000.0, result.latency_p99_us / 1000.0,
+               result.latency_max_us / 1000.0, result.wire_bytes / 1024.0,
+               result.failed);
+  }
+}
+
+}  // namespace database_testapp
@@ -0,0 +1,97 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_WRITE_BENCHMARK_H_  // NOLINT
+#define FIREBASE_TESTAPP_WRITE_BENCHMARK_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "firebase/database.h"
+#include "firebase/variant.h"
+
+namespace database_testapp {
+
+// Configuration of RunWriteBenchmark().
+struct WriteBenchmarkOptions {
+  WriteBenchmarkOptions() : write_count(500), value_size(64) {}
+
+  // Number of records written by each strategy.
+  int write_count;
+  // Length of the string payload of each record.
+  size_t value_size;
+};
+
+// Measurements of one write strategy.
+struct WriteBenchmarkResult {
+  WriteBenchmarkResult()
+      : strategy(nullptr),
+        requests(0),
+        failed(0),
+        records(0),
+        elapsed_us(0),
+        wire_bytes(0),
+        latency_p50_us(0),
+        latency_p99_us(0),
+        latency_max_us(0) {}
+
+  const char* strategy;
+  // Number of SetValue() / UpdateChildren() calls and how many of them failed.
+  int requests;
+  int failed;
+  // Number of records written.
+  int records;
+  // Time from issuing the first request to the last one completing.
+  int64_t elapsed_us;
+  // Estimated size of the write requests sent to the server, see
+  // EstimateWireBytes().
+  uint64_t wire_bytes;
+  // Latency of each request, from issue to completion.
+  int64_t latency_p50_us;
+  int64_t latency_p99_us;
+  int64_t latency_max_us;
+
+  double records_per_second() const;
+};
+
+// Estimate the number of bytes the client sends to write `value` at `path`.
+// The Realtime Database protocol sends each write as a JSON frame holding the
+// path and the JSON encoding of the value, so this is the size of that frame.
+// TLS and WebSocket framing aren't included.
+uint64_t EstimateWireBytes(const std::string& path,
+                           const firebase::Variant& value);
+
+// Size of the JSON encoding of `value`.
+size_t JsonSize(const firebase::Variant& value);
+
+// Write options.write_count records below `ref` with each of three strategies
+// and measure the throughput of each:
+//  - "FanOut": one SetValue() per record, all issued before waiting so they
+//    are pipelined over the connection.
+//  - "MultiPathUpdate": a single UpdateChildren() with one path per record.
+//  - "SubtreeSet": a single SetValue() of a map holding every record.
+// The data written is removed afterwards.
+std::vector<WriteBenchmarkResult> RunWriteBenchmark(
+    firebase::database::DatabaseReference ref,
+    const WriteBenchmarkOptions& options);
+
+// Log a table of the results of RunWriteBenchmark().
+void LogWriteBenchmarkResults(const std::vector<WriteBenchmarkResult>& results);
+
+}  // namespace database_testapp
+
+#endif  // FIREBASE_TESTAPP_WRITE_BENCHMARK_H_  // NOLINT
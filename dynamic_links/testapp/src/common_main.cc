@@ -15,14 +15,33 @@
 #include <assert.h>
 #include <string.h>
 
+#include <string>
+#include <vector>
+
 #include "firebase/app.h"
 #include "firebase/dynamic_links.h"
 #include "firebase/dynamic_links/components.h"
 #include "firebase/future.h"
 #include "firebase/util.h"
 // Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "link_shortener.h"  // NOLINT
 #include "main.h"  // NOLINT
 
+using app_framework::LogMessage;
+using app_framework::ProcessEvents;
+using app_framework::WaitForCompletion;
+using app_framework::WaitForFuture;
+
+// Name of the file, in app_framework::PathForResource(), caching short links.
+static const char kShortLinkCacheFile[] = "dynamic_links_short_links.txt";
+
+// Paths of the items in the feed shared by the app. "item/2" is repeated to
+// show that it's only requested once.
+static const char* kFeedItemPaths[] = {
+    "item/1", "item/2", "item/3", "item/2", "item/4", "item/5",
+};
+
 // Invalid domain, used to make sure the user sets a valid domain.
 #define INVALID_DOMAIN_URI_PREFIX "THIS_IS_AN_INVALID_DOMAIN"
 
@@ -48,18 +67,6 @@ class Listener : public firebase::dynamic_links::Listener {
   }
 };
 
-void WaitForCompletion(const firebase::FutureBase& future, const char* name) {
-  while (future.status() == firebase::kFutureStatusPending) {
-    ProcessEvents(100);
-  }
-  if (future.status() != firebase::kFutureStatusComplete) {
-    LogMessage("ERROR: %s returned an invalid result.", name);
-  } else if (future.error() != 0) {
-    LogMessage("ERROR: %s returned error %d: %s", name, future.error(),
-               future.error_message());
-  }
-}
-
 // Show a generated link.
 void ShowGeneratedLink(
     const firebase::dynamic_links::GeneratedDynamicLink& generated_link,
@@ -99,7 +106,8 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
   LogMessage("Initialize the Firebase Dynamic Links library");
 #if defined(__ANDROID__)
-  app = ::firebase::App::Create(GetJniEnv(), GetActivity());
+  app = ::firebase::App::Create(app_framework::GetJniEnv(),
+                                app_framework::GetActivity());
 #else
   app = ::firebase::App::Create();
 #endif  // defined(__ANDROID__)
@@ -114,9 +122,9 @@ extern "C" int common_main(int argc, const char* argv[]) {
                            return ::firebase::dynamic_links::Initialize(
                                *app, reinterpret_cast<Listener*>(listener));
                          });
-  while (initializer.InitializeLastResult().status() !=
-         firebase::kFutureStatusComplete) {
-    if (ProcessEvents(100)) return 1;  // exit if requested
+  if (WaitForFuture(initializer.InitializeLastResult()) ==
+      app_framework::kWaitResultExitRequested) {
+    return 1;  // exit if requested
   }
   if (initializer.InitializeLastResult().error() != 0) {
     LogMessage("Failed to initialize Firebase Dynamic Links: %s",
@@ -189,6 +197,37 @@ extern "C" int common_main(int argc, const char* argv[]) {
           dynamic_links::GetShortLink(long_link.url.c_str(), options);
       WaitForAndShowGeneratedLink(link_future, "Generate short from long link");
     }
+    {
+      // Share every item of the feed, shortening their links in one batch.
+      std::vector<std::string> feed_links;
+      for (size_t i = 0; i < sizeof(kFeedItemPaths) / sizeof(kFeedItemPaths[0]);
+           ++i) {
+        std::string item_url =
+            std::string("https://google.com/") + kFeedItemPaths[i];
+        dynamic_links::DynamicLinkComponents item_components = components;
+        item_components.link = item_url.c_str();
+        feed_links.push_back(dynamic_links::GetLongLink(item_components).url);
+      }
+      dynamic_links_testapp::LinkShortenerOptions shortener_options;
+      shortener_options.link_options.path_length =
+          firebase::dynamic_links::kPathLengthShort;
+      dynamic_links_testapp::LinkShortener shortener(kShortLinkCacheFile,
+                                                     shortener_options);
+      LogMessage("Shorten the links of %d feed items (%d cached)...",
+                 static_cast<int>(feed_links.size()),
+                 static_cast<int>(shortener.cache_size()));
+      dynamic_links_testapp::LinkBatchResult result =
+          shortener.ShortenBatch(feed_links);
+      dynamic_links_testapp::LogLinkBatchResult(result);
+      for (size_t i = 0; i < result.links.size(); ++i) {
+        LogMessage("  %s: %s%s", kFeedItemPaths[i],
+                   result.links[i].short_link.c_str(),
+                   result.links[i].cached ? " (cached)" : "");
+      }
+      // Sharing the feed again is served from the cache.
+      dynamic_links_testapp::LogLinkBatchResult(
+          shortener.ShortenBatch(feed_links));
+    }
   }
 
   // Wait until the user wants to quit the app.
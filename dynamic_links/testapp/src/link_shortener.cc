@@ -0,0 +1,307 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "link_shortener.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "firebase/dynamic_links.h"
+#include "firebase/future.h"
+
+// Thin OS abstraction layer.
+#include "file_util.h"  // NOLINT
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+
+namespace dynamic_links = ::firebase::dynamic_links;
+
+namespace dynamic_links_testapp {
+
+namespace {
+
+// A distinct long link of a batch that wasn't in the cache.
+struct LinkRequest {
+  std::string long_link;
+  firebase::Future<dynamic_links::GeneratedDynamicLink> future;
+  // Whether this batch made the request, rather than joining the request of
+  // another batch.
+  bool owned;
+  int64_t start_us;
+};
+
+// Read a line of any length from `file`, without its line terminator.
+// Returns false at the end of the file.
+bool ReadLine(FILE* file, std::string* line) {
+  line->clear();
+  char buffer[1024];
+  while (fgets(buffer, sizeof(buffer), file)) {
+    line->append(buffer);
+    if (!line->empty() && line->back() == '\n') break;
+  }
+  if (line->empty()) return false;
+  while (!line->empty() && (line->back() == '\n' || line->back() == '\r')) {
+    line->erase(line->size() - 1);
+  }
+  return true;
+}
+
+}  // namespace
+
+LinkShortener::LinkShortener(const char* cache_name,
+                             const LinkShortenerOptions& options)
+    : cache_path_(app_framework::PathForResource() + cache_name),
+      options_(options) {
+  // Otherwise ShortenBatch() could never issue a request.
+  options_.max_concurrent_requests =
+      std::max(1, options_.max_concurrent_requests);
+  Load();
+}
+
+LinkBatchResult LinkShortener::ShortenBatch(
+    const std::vector<std::string>& long_links) {
+  LinkBatchResult result;
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+
+  // Shorten each distinct link once, filling in every position it occurs at.
+  result.links.resize(long_links.size());
+  std::map<std::string, std::vector<size_t>> positions;
+  std::vector<LinkRequest> requests;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < long_links.size(); ++i) {
+      result.links[i].long_link = long_links[i];
+      std::vector<size_t>& link_positions = positions[long_links[i]];
+      link_positions.push_back(i);
+      if (link_positions.size() > 1) {
+        result.duplicates++;
+        continue;
+      }
+      std::string short_link;
+      if (LookUp(long_links[i], &short_link)) {
+        result.links[i].short_link = short_link;
+        result.links[i].cached = true;
+        result.cache_hits++;
+        continue;
+      }
+      LinkRequest request;
+      request.long_link = long_links[i];
+      request.owned = false;
+      request.start_us = 0;
+      requests.push_back(request);
+    }
+  }
+
+  // Keep up to max_concurrent_requests of this batch's own requests in
+  // flight, issuing the next one as soon as one completes.
+  size_t next = 0;
+  std::vector<size_t> in_flight;
+  int owned_in_flight = 0;
+  bool changed = false;
+  while (next < requests.size() || !in_flight.empty()) {
+    while (next < requests.size() &&
+           owned_in_flight < options_.max_concurrent_requests) {
+      LinkRequest& request = requests[next];
+      std::lock_guard<std::mutex> lock(mutex_);
+      // Another batch may have shortened or started requesting the link since
+      // it was looked up. GetShortLink() only starts the request, so it's
+      // called under the lock to make the check and the request atomic.
+      std::string short_link;
+      if (LookUp(request.long_link, &short_link)) {
+        const std::vector<size_t>& link_positions =
+            positions[request.long_link];
+        for (size_t i = 0; i < link_positions.size(); ++i) {
+          result.links[link_positions[i]].short_link = short_link;
+          result.links[link_positions[i]].cached = true;
+        }
+        result.cache_hits++;
+        next++;
+        continue;
+      }
+      std::map<std::string,
+               firebase::Future<dynamic_links::GeneratedDynamicLink>>::iterator
+          it = in_flight_.find(request.long_link);
+      if (it != in_flight_.end()) {
+        request.future = it->second;
+        result.joined++;
+      } else {
+        request.future = dynamic_links::GetShortLink(
+            request.long_link.c_str(), options_.link_options);
+        request.owned = true;
+        in_flight_[request.long_link] = request.future;
+        result.requested++;
+        owned_in_flight++;
+      }
+      request.start_us = GetMonotonicTimeInMicroseconds();
+      in_flight.push_back(next++);
+    }
+    if (in_flight.empty()) continue;
+
+    int64_t remaining_ms =
+        options_.timeout_ms -
+        (GetMonotonicTimeInMicroseconds() - start_us) / 1000;
+    std::vector<firebase::FutureBase> futures;
+    for (size_t i = 0; i < in_flight.size(); ++i) {
+      futures.push_back(requests[in_flight[i]].future);
+    }
+    if (remaining_ms <= 0 ||
+        app_framework::WaitForAny(futures, static_cast<int>(remaining_ms)) <
+            0) {
+      break;
+    }
+
+    // Several requests may have completed during the wait.
+    std::vector<size_t> still_in_flight;
+    for (size_t i = 0; i < in_flight.size(); ++i) {
+      const LinkRequest& request = requests[in_flight[i]];
+      if (request.future.status() == firebase::kFutureStatusPending) {
+        still_in_flight.push_back(in_flight[i]);
+        continue;
+      }
+      const dynamic_links::GeneratedDynamicLink* generated =
+          request.future.result();
+      int error = request.future.error();
+      std::string short_link;
+      std::string error_message;
+      if (error == 0 && generated && !generated->url.empty()) {
+        short_link = generated->url;
+      } else {
+        error_message = request.future.error_message()
+                            ? request.future.error_message()
+                            : "";
+        if (error_message.empty()) error_message = "No short link generated";
+        LogMessage("ERROR: GetShortLink(\"%s\") failed: %d, `%s`",
+                   request.long_link.c_str(), error, error_message.c_str());
+        result.failed++;
+      }
+      if (request.owned) {
+        app_framework::RecordLatency(
+            "Dynamic Links GetShortLink",
+            GetMonotonicTimeInMicroseconds() - request.start_us);
+        owned_in_flight--;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (request.owned) in_flight_.erase(request.long_link);
+        // Joined requests are cached too, in case their owner timed out.
+        if (!short_link.empty()) {
+          Insert(request.long_link, short_link);
+          changed = true;
+        }
+      }
+      const std::vector<size_t>& link_positions = positions[request.long_link];
+      for (size_t j = 0; j < link_positions.size(); ++j) {
+        ShortenedLink& link = result.links[link_positions[j]];
+        link.short_link = short_link;
+        link.error = error;
+        link.error_message = error_message;
+      }
+    }
+    in_flight.swap(still_in_flight);
+  }
+  result.pending = static_cast<int>(requests.size() - next + in_flight.size());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Requests this batch gave up on can't be joined any more, the next batch
+  // that needs their links requests them again.
+  for (size_t i = 0; i < in_flight.size(); ++i) {
+    const LinkRequest& request = requests[in_flight[i]];
+    if (request.owned) in_flight_.erase(request.long_link);
+  }
+  if (changed && !Save()) {
+    LogMessage("ERROR: Failed to save short links to %s", cache_path_.c_str());
+  }
+  result.duration_us = GetMonotonicTimeInMicroseconds() - start_us;
+  return result;
+}
+
+size_t LinkShortener::cache_size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return cache_.size();
+}
+
+bool LinkShortener::LookUp(const std::string& long_link,
+                           std::string* short_link) {
+  std::map<std::string, CacheList::iterator>::iterator it =
+      cache_index_.find(long_link);
+  if (it == cache_index_.end()) return false;
+  cache_.splice(cache_.begin(), cache_, it->second);
+  *short_link = it->second->second;
+  return true;
+}
+
+void LinkShortener::Insert(const std::string& long_link,
+                           const std::string& short_link) {
+  std::map<std::string, CacheList::iterator>::iterator it =
+      cache_index_.find(long_link);
+  if (it != cache_index_.end()) {
+    cache_.splice(cache_.begin(), cache_, it->second);
+    it->second->second = short_link;
+    return;
+  }
+  cache_.push_front(CacheEntry(long_link, short_link));
+  cache_index_[long_link] = cache_.begin();
+  while (cache_.size() > options_.cache_capacity) {
+    cache_index_.erase(cache_.back().first);
+    cache_.pop_back();
+  }
+}
+
+bool LinkShortener::Load() {
+  FILE* file = fopen(cache_path_.c_str(), "r");
+  if (!file) return false;
+  std::string line;
+  while (cache_.size() < options_.cache_capacity && ReadLine(file, &line)) {
+    size_t tab = line.find('\t');
+    if (tab == std::string::npos || tab == 0 || tab + 1 == line.size()) {
+      continue;
+    }
+    std::string long_link = line.substr(0, tab);
+    if (cache_index_.count(long_link)) continue;
+    cache_.push_back(CacheEntry(long_link, line.substr(tab + 1)));
+    cache_index_[long_link] = --cache_.end();
+  }
+  fclose(file);
+  return true;
+}
+
+bool LinkShortener::Save() const {
+  std::string contents;
+  for (CacheList::const_iterator it = cache_.begin(); it != cache_.end();
+       ++it) {
+    contents += it->first + "\t" + it->second + "\n";
+  }
+  return app_framework::WriteFileReplacing(cache_path_, contents);
+}
+
+void LogLinkBatchResult(const LinkBatchResult& result) {
+  LogMessage(
+      "Shortened %d links in %.1f ms: %d cached, %d requested, %d joined, "
+      "%d duplicates, %d failed, %d pending.",
+      static_cast<int>(result.links.size()), result.duration_us / 1000.0,
+      result.cache_hits, result.requested, result.joined, result.duplicates,
+      result.failed, result.pending);
+}
+
+}  // namespace dynamic_links_testapp
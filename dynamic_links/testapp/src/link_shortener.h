@@ -0,0 +1,164 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_LINK_SHORTENER_H_  // NOLINT
+#define FIREBASE_TESTAPP_LINK_SHORTENER_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "firebase/dynamic_links.h"
+#include "firebase/future.h"
+
+namespace dynamic_links_testapp {
+
+// Configuration of a LinkShortener.
+struct LinkShortenerOptions {
+  LinkShortenerOptions()
+      : max_concurrent_requests(8), cache_capacity(1024), timeout_ms(30000) {}
+
+  // Options passed to every GetShortLink(). The cache doesn't record them,
+  // so shorteners with different options need different cache files.
+  firebase::dynamic_links::DynamicLinkOptions link_options;
+  // Most GetShortLink() requests a ShortenBatch() has in flight at once.
+  // Values below 1 are treated as 1.
+  int max_concurrent_requests;
+  // Most long to short link mappings kept, the least recently used are
+  // dropped first.
+  size_t cache_capacity;
+  // Time allowed for a whole ShortenBatch().
+  int timeout_ms;
+};
+
+// A long link passed to ShortenBatch() and its short link.
+struct ShortenedLink {
+  ShortenedLink() : error(0), cached(false) {}
+
+  std::string long_link;
+  // Empty if the link couldn't be shortened.
+  std::string short_link;
+  // Error of the GetShortLink() request, 0 if it succeeded or is pending.
+  int error;
+  std::string error_message;
+  // Whether the short link came from the cache.
+  bool cached;
+};
+
+// Outcome of LinkShortener::ShortenBatch().
+struct LinkBatchResult {
+  LinkBatchResult()
+      : cache_hits(0),
+        requested(0),
+        joined(0),
+        duplicates(0),
+        failed(0),
+        pending(0),
+        duration_us(0) {}
+
+  // In the order the long links were passed.
+  std::vector<ShortenedLink> links;
+  // Distinct links found in the cache, for which no request was made.
+  int cache_hits;
+  // GetShortLink() requests made by this batch.
+  int requested;
+  // Distinct links already being requested by another ShortenBatch(), whose
+  // request this batch waited on instead of making its own.
+  int joined;
+  // Links repeated within the batch, shortened once.
+  int duplicates;
+  // Distinct links whose request completed with an error.
+  int failed;
+  // Distinct links not shortened when the timeout expired or the app was
+  // asked to exit.
+  int pending;
+  int64_t duration_us;
+};
+
+// Shortens batches of long dynamic links, such as the links of every item in
+// a feed being shared.
+//
+// ShortenBatch() issues the GetShortLink() requests of a batch concurrently,
+// up to max_concurrent_requests at a time, so a batch costs about as long as
+// its slowest requests rather than the sum of their latencies. A link that's
+// already being requested, by the same batch or by a ShortenBatch() on
+// another thread, isn't requested again: the later callers wait on the
+// request in flight.
+//
+// Short links that were generated are kept in a least recently used cache,
+// saved to a file in app_framework::PathForResource(), so sharing a link
+// again, even on a later launch of the app, doesn't touch the network.
+// Failed requests aren't cached, so they're retried by the next batch.
+//
+// All methods are thread safe.
+class LinkShortener {
+ public:
+  // Load the cache from the file called `cache_name` in PathForResource(),
+  // if there is one.
+  explicit LinkShortener(
+      const char* cache_name,
+      const LinkShortenerOptions& options = LinkShortenerOptions());
+
+  // Shorten each of `long_links`, blocking until their short links are
+  // cached or requested. The cache is saved when any request succeeds.
+  LinkBatchResult ShortenBatch(const std::vector<std::string>& long_links);
+
+  // Number of mappings in the cache.
+  size_t cache_size() const;
+
+ private:
+  typedef std::pair<std::string, std::string> CacheEntry;
+  typedef std::list<CacheEntry> CacheList;
+
+  LinkShortener(const LinkShortener&) = delete;
+  LinkShortener& operator=(const LinkShortener&) = delete;
+
+  // Look up `long_link`, making it the most recently used mapping. The
+  // caller must hold mutex_.
+  bool LookUp(const std::string& long_link, std::string* short_link);
+  // Add or replace a mapping, evicting the least recently used ones beyond
+  // cache_capacity. The caller must hold mutex_.
+  void Insert(const std::string& long_link, const std::string& short_link);
+
+  // Read and write the cache, one tab separated mapping per line from the
+  // most to the least recently used. Returns false if the file couldn't be
+  // read or written. The caller must hold mutex_.
+  bool Load();
+  bool Save() const;
+
+  std::string cache_path_;
+  LinkShortenerOptions options_;
+
+  mutable std::mutex mutex_;
+  // Most recently used first.
+  CacheList cache_;
+  std::map<std::string, CacheList::iterator> cache_index_;
+  // Requests in flight, by long link, which any batch can wait on.
+  std::map<std::string,
+           firebase::Future<firebase::dynamic_links::GeneratedDynamicLink>>
+      in_flight_;
+};
+
+// Log the counts and duration of `result`.
+void LogLinkBatchResult(const LinkBatchResult& result);
+
+}  // namespace dynamic_links_testapp
+
+#endif  // FIREBASE_TESTAPP_LINK_SHORTENER_H_  // NOLINT
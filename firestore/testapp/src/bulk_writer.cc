@@ -0,0 +1,240 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bulk_writer.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "firebase/firestore.h"
+#include "firebase/future.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+using app_framework::RecordLatency;
+
+namespace firestore_testapp {
+
+double BulkWriterStats::documents_per_second() const {
+  return elapsed_us > 0 ? documents_written * 1000000.0 / elapsed_us : 0.0;
+}
+
+BulkWriter::BulkWriter(firebase::firestore::Firestore* firestore,
+                       const BulkWriterOptions& options)
+    : firestore_(firestore), options_(options), start_us_(0) {
+  options_.batch_size =
+      std::max(1, std::min(options_.batch_size, kMaxWritesPerBatch));
+  options_.max_in_flight = std::max(1, options_.max_in_flight);
+  in_flight_limit_ = options_.max_in_flight;
+}
+
+BulkWriter::~BulkWriter() { Flush(); }
+
+void BulkWriter::Set(const firebase::firestore::DocumentReference& document,
+                     const firebase::firestore::MapFieldValue& data) {
+  Add(kWriteSet, document, data);
+}
+
+void BulkWriter::Update(
+    const firebase::firestore::DocumentReference& document,
+    const firebase::firestore::MapFieldValue& data) {
+  Add(kWriteUpdate, document, data);
+}
+
+void BulkWriter::Delete(
+    const firebase::firestore::DocumentReference& document) {
+  Add(kWriteDelete, document, firebase::firestore::MapFieldValue());
+}
+
+void BulkWriter::Add(WriteType type,
+                     const firebase::firestore::DocumentReference& document,
+                     const firebase::firestore::MapFieldValue& data) {
+  if (!start_us_) start_us_ = GetMonotonicTimeInMicroseconds();
+  Write write;
+  write.type = type;
+  write.document = document;
+  write.data = data;
+  pending_.writes.push_back(std::move(write));
+  if (static_cast<int>(pending_.writes.size()) >= options_.batch_size) {
+    CommitPending();
+  }
+}
+
+void BulkWriter::CommitPending() {
+  if (pending_.writes.empty()) return;
+  while (static_cast<int>(in_flight_.size()) >= in_flight_limit_) {
+    WaitForBatch();
+  }
+  Commit(std::move(pending_));
+  pending_ = Batch();
+}
+
+void BulkWriter::Commit(Batch batch) {
+  firebase::firestore::WriteBatch write_batch = firestore_->batch();
+  for (size_t i = 0; i < batch.writes.size(); ++i) {
+    const Write& write = batch.writes[i];
+    switch (write.type) {
+      case kWriteSet:
+        write_batch.Set(write.document, write.data);
+        break;
+      case kWriteUpdate:
+        write_batch.Update(write.document, write.data);
+        break;
+      case kWriteDelete:
+        write_batch.Delete(write.document);
+        break;
+    }
+  }
+  batch.attempts++;
+  batch.issue_us = GetMonotonicTimeInMicroseconds();
+  batch.commit = write_batch.Commit();
+  in_flight_.push_back(std::move(batch));
+}
+
+void BulkWriter::FailBatch(const Batch& batch, int error,
+                           const char* error_message) {
+  LogMessage("ERROR: BulkWriter batch of %d writes failed after %d attempts "
+             "with error %d: %s",
+             static_cast<int>(batch.writes.size()), batch.attempts, error,
+             error_message);
+  stats_.documents_failed += static_cast<int64_t>(batch.writes.size());
+  stats_.batches_failed++;
+}
+
+void BulkWriter::WaitForBatch() {
+  std::vector<firebase::FutureBase> commits;
+  for (size_t i = 0; i < in_flight_.size(); ++i) {
+    commits.push_back(in_flight_[i].commit);
+  }
+  int index = app_framework::WaitForAny(commits, options_.timeout_ms);
+  if (index < 0) {
+    // Nothing completed in time, give up on every batch in flight.
+    for (size_t i = 0; i < in_flight_.size(); ++i) {
+      FailBatch(in_flight_[i], -1, "timed out");
+    }
+    in_flight_.clear();
+    return;
+  }
+
+  Batch batch = std::move(in_flight_[index]);
+  in_flight_.erase(in_flight_.begin() + index);
+  int error = batch.commit.error();
+  if (error == firebase::firestore::kOk) {
+    RecordLatency("BulkWriter Commit",
+                  GetMonotonicTimeInMicroseconds() - batch.issue_us);
+    stats_.documents_written += static_cast<int64_t>(batch.writes.size());
+    stats_.batches_committed++;
+    in_flight_limit_ = std::min(in_flight_limit_ + 1, options_.max_in_flight);
+    return;
+  }
+
+  bool overloaded = error == firebase::firestore::kResourceExhausted ||
+                    error == firebase::firestore::kUnavailable;
+  if (!overloaded || batch.attempts > options_.max_retries) {
+    FailBatch(batch, error, batch.commit.error_message());
+    return;
+  }
+  // Back off, and commit fewer batches at once until they succeed again.
+  in_flight_limit_ = std::max(1, in_flight_limit_ / 2);
+  int backoff_ms = options_.initial_backoff_ms;
+  for (int i = 1; i < batch.attempts && backoff_ms < options_.max_backoff_ms;
+       ++i) {
+    backoff_ms *= 2;
+  }
+  backoff_ms = std::min(backoff_ms, options_.max_backoff_ms);
+  LogMessage("BulkWriter batch rejected with error %d, retrying in %d ms.",
+             error, backoff_ms);
+  int64_t backoff_start_us = GetMonotonicTimeInMicroseconds();
+  if (app_framework::ProcessEvents(backoff_ms)) {
+    FailBatch(batch, error, "exit requested while backing off");
+    return;
+  }
+  stats_.backoff_us += GetMonotonicTimeInMicroseconds() - backoff_start_us;
+  stats_.retries++;
+  Commit(std::move(batch));
+}
+
+bool BulkWriter::Flush() {
+  CommitPending();
+  while (!in_flight_.empty()) WaitForBatch();
+  if (start_us_) {
+    stats_.elapsed_us = GetMonotonicTimeInMicroseconds() - start_us_;
+  }
+  return stats_.documents_failed == 0;
+}
+
+std::vector<BulkWriterBenchmarkResult> RunBulkWriterBenchmark(
+    firebase::firestore::Firestore* firestore,
+    const firebase::firestore::CollectionReference& collection,
+    const BulkWriterBenchmarkOptions& options) {
+  std::vector<BulkWriterBenchmarkResult> results;
+  const std::string payload(options.payload_size, 'x');
+  char id[16];
+  for (size_t level = 0; level < options.in_flight_levels.size(); ++level) {
+    BulkWriterOptions writer_options;
+    writer_options.max_in_flight = options.in_flight_levels[level];
+    BulkWriter writer(firestore, writer_options);
+    for (int i = 0; i < options.document_count; ++i) {
+      snprintf(id, sizeof(id), "d%06d", i);
+      writer.Set(collection.Document(id),
+                 firebase::firestore::MapFieldValue{
+                     {"index", firebase::firestore::FieldValue::Integer(i)},
+                     {"payload",
+                      firebase::firestore::FieldValue::String(payload)}});
+    }
+    BulkWriterBenchmarkResult result;
+    result.max_in_flight = writer_options.max_in_flight;
+    result.succeeded = writer.Flush();
+    result.stats = writer.stats();
+    results.push_back(result);
+  }
+
+  BulkWriter cleanup(firestore, BulkWriterOptions());
+  for (int i = 0; i < options.document_count; ++i) {
+    snprintf(id, sizeof(id), "d%06d", i);
+    cleanup.Delete(collection.Document(id));
+  }
+  if (!cleanup.Flush()) {
+    LogMessage("ERROR: Failed to delete the BulkWriter benchmark documents.");
+  }
+  return results;
+}
+
+void LogBulkWriterBenchmarkResults(
+    const std::vector<BulkWriterBenchmarkResult>& results) {
+  LogMessage("  %9s %8s %7s %7s %7s %8s %10s %9s", "in-flight", "docs",
+             "failed", "batches", "retries", "backoff", "elapsed", "docs/s");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BulkWriterStats& stats = results[i].stats;
+    LogMessage("  %9d %8lld %7lld %7d %7d %6.0fms %8.0fms %9.0f",
+               results[i].max_in_flight,
+               static_cast<long long>(stats.documents_written),  // NOLINT
+               static_cast<long long>(stats.documents_failed),  // NOLINT
+               stats.batches_committed, stats.retries,
+               stats.backoff_us / 1000.0, stats.elapsed_us / 1000.0,
+               stats.documents_per_second());
+  }
+}
+
+}  // namespace firestore_testapp
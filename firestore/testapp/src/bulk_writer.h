@@ -0,0 +1,203 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_BULK_WRITER_H_  // NOLINT
+#define FIREBASE_TESTAPP_BULK_WRITER_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "firebase/firestore.h"
+#include "firebase/future.h"
+
+namespace firestore_testapp {
+
+// Maximum number of writes Firestore accepts in a single WriteBatch.
+const int kMaxWritesPerBatch = 500;
+
+// Configuration of a BulkWriter.
+struct BulkWriterOptions {
+  BulkWriterOptions()
+      : batch_size(kMaxWritesPerBatch),
+        max_in_flight(4),
+        max_retries(5),
+        initial_backoff_ms(500),
+        max_backoff_ms(30000),
+        timeout_ms(60000) {}
+
+  // Writes per WriteBatch, at most kMaxWritesPerBatch.
+  int batch_size;
+  // Most batches committing at the same time.
+  int max_in_flight;
+  // Times a batch rejected with kResourceExhausted or kUnavailable is
+  // committed again before its writes are counted as failed.
+  int max_retries;
+  // Delay before the first retry of a batch, doubled for each further retry
+  // up to max_backoff_ms.
+  int initial_backoff_ms;
+  int max_backoff_ms;
+  // Time to wait for any in-flight batch to complete.
+  int timeout_ms;
+};
+
+// Counters of a BulkWriter.
+struct BulkWriterStats {
+  BulkWriterStats()
+      : documents_written(0),
+        documents_failed(0),
+        batches_committed(0),
+        batches_failed(0),
+        retries(0),
+        backoff_us(0),
+        elapsed_us(0) {}
+
+  int64_t documents_written;
+  int64_t documents_failed;
+  int batches_committed;
+  int batches_failed;
+  // Commits retried after a kResourceExhausted or kUnavailable error, and
+  // the time spent backing off before them.
+  int retries;
+  int64_t backoff_us;
+  // Time from the first write to the end of the last Flush().
+  int64_t elapsed_us;
+
+  double documents_per_second() const;
+};
+
+// Writes any number of documents by grouping them into WriteBatches of
+// options.batch_size writes and keeping up to options.max_in_flight batches
+// committing at once.
+//
+// Batches rejected because the backend is overloaded are committed again
+// after an exponential backoff, and the number of batches in flight is
+// halved, then grows back by one for each batch that succeeds, so a writer
+// settles at the rate the backend accepts.
+//
+// Writes are buffered until their batch is full, so call Flush() to commit
+// the last partial batch and wait for every commit. Writes to the same
+// document in different batches may be applied in any order.
+//
+// All methods must be called from the same thread.
+class BulkWriter {
+ public:
+  BulkWriter(firebase::firestore::Firestore* firestore,
+             const BulkWriterOptions& options);
+  // Flushes the remaining writes.
+  ~BulkWriter();
+
+  void Set(const firebase::firestore::DocumentReference& document,
+           const firebase::firestore::MapFieldValue& data);
+  void Update(const firebase::firestore::DocumentReference& document,
+              const firebase::firestore::MapFieldValue& data);
+  void Delete(const firebase::firestore::DocumentReference& document);
+
+  // Commit the buffered writes and wait for every batch to finish.
+  // Returns true if no write has failed since the writer was created.
+  bool Flush();
+
+  // Batches currently committing.
+  int in_flight() const { return static_cast<int>(in_flight_.size()); }
+  const BulkWriterStats& stats() const { return stats_; }
+
+ private:
+  enum WriteType {
+    kWriteSet = 0,
+    kWriteUpdate,
+    kWriteDelete,
+  };
+
+  struct Write {
+    WriteType type;
+    firebase::firestore::DocumentReference document;
+    firebase::firestore::MapFieldValue data;
+  };
+
+  // Writes committed together. They're kept until the commit succeeds so
+  // the batch can be rebuilt for a retry, as a committed WriteBatch can't be
+  // reused.
+  struct Batch {
+    Batch() : attempts(0), issue_us(0) {}
+
+    std::vector<Write> writes;
+    firebase::Future<void> commit;
+    int attempts;
+    int64_t issue_us;
+  };
+
+  BulkWriter(const BulkWriter&) = delete;
+  BulkWriter& operator=(const BulkWriter&) = delete;
+
+  void Add(WriteType type,
+           const firebase::firestore::DocumentReference& document,
+           const firebase::firestore::MapFieldValue& data);
+  // Commit the pending batch, first waiting for a free in-flight slot.
+  void CommitPending();
+  void Commit(Batch batch);
+  // Wait for any in-flight batch to complete and handle the result.
+  void WaitForBatch();
+  void FailBatch(const Batch& batch, int error, const char* error_message);
+
+  firebase::firestore::Firestore* firestore_;
+  BulkWriterOptions options_;
+  // Current limit on the number of batches in flight, at most
+  // options_.max_in_flight.
+  int in_flight_limit_;
+  Batch pending_;
+  std::vector<Batch> in_flight_;
+  BulkWriterStats stats_;
+  int64_t start_us_;
+};
+
+// Configuration of RunBulkWriterBenchmark().
+struct BulkWriterBenchmarkOptions {
+  BulkWriterBenchmarkOptions() : document_count(2000), payload_size(64) {
+    in_flight_levels.push_back(1);
+    in_flight_levels.push_back(4);
+  }
+
+  // Documents written at each level.
+  int document_count;
+  // Length of the string field of each document.
+  size_t payload_size;
+  // Values of BulkWriterOptions::max_in_flight to measure.
+  std::vector<int> in_flight_levels;
+};
+
+// Measurements of one in-flight level.
+struct BulkWriterBenchmarkResult {
+  BulkWriterBenchmarkResult() : max_in_flight(0), succeeded(false) {}
+
+  int max_in_flight;
+  BulkWriterStats stats;
+  bool succeeded;
+};
+
+// Write options.document_count documents to `collection` with a BulkWriter
+// for each options.in_flight_levels entry, overwriting the same documents
+// each time, then delete them.
+std::vector<BulkWriterBenchmarkResult> RunBulkWriterBenchmark(
+    firebase::firestore::Firestore* firestore,
+    const firebase::firestore::CollectionReference& collection,
+    const BulkWriterBenchmarkOptions& options);
+
+// Log a table of the results of RunBulkWriterBenchmark().
+void LogBulkWriterBenchmarkResults(
+    const std::vector<BulkWriterBenchmarkResult>& results);
+
+}  // namespace firestore_testapp
+
+#endif  // FIREBASE_TESTAPP_BULK_WRITER_H_  // NOLINT
@@ -18,6 +18,7 @@
 #include <iostream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "firebase/auth.h"
 #include "firebase/auth/user.h"
@@ -25,112 +26,108 @@
 #include "firebase/util.h"
 
 // Thin OS abstraction layer.
+#include "allocation_scope.h"  // NOLINT
+#include "benchmark.h"  // NOLINT
+#include "bulk_writer.h"  // NOLINT
+#include "document_reader.h"  // NOLINT
+#include "future_wait.h"  // NOLINT
 #include "main.h"  // NOLINT
+#include "query_benchmark.h"  // NOLINT
+#include "settings_profile.h"  // NOLINT
+#include "snapshot_listener_benchmark.h"  // NOLINT
+#include "startup.h"  // NOLINT
+#include "test_event_listener.h"  // NOLINT
+#include "transaction_runner.h"  // NOLINT
+
+using app_framework::LogMessage;
+using app_framework::ProcessEvents;
+using app_framework::WaitForCompletion;
+using app_framework::WaitForEvents;
+using firestore_testapp::Countable;
+using firestore_testapp::TestEventListener;
 
 const int kTimeoutMs = 5000;
-const int kSleepMs = 100;
 
 // Waits for a Future to be completed and returns whether the future has
 // completed successfully. If the Future returns an error, it will be logged.
 bool Await(const firebase::FutureBase& future, const char* name) {
-  int remaining_timeout = kTimeoutMs;
-  while (future.status() == firebase::kFutureStatusPending &&
-         remaining_timeout > 0) {
-    remaining_timeout -= kSleepMs;
-    ProcessEvents(kSleepMs);
-  }
-
-  if (future.status() != firebase::kFutureStatusComplete) {
-    LogMessage("ERROR: %s returned an invalid result.", name);
-    return false;
-  } else if (future.error() != 0) {
-    LogMessage("ERROR: %s returned error %d: %s", name, future.error(),
-               future.error_message());
-    return false;
-  }
-  return true;
+  return WaitForCompletion(future, name, kTimeoutMs);
 }
 
-class Countable {
- public:
-  int event_count() const { return event_count_; }
-
- protected:
-  int event_count_ = 0;
-};
-
-template <typename T>
-class TestEventListener : public Countable,
-                          public firebase::firestore::EventListener<T> {
- public:
-  explicit TestEventListener(std::string name) : name_(std::move(name)) {}
-
-  void OnEvent(const T& value,
-               const firebase::firestore::Error error) override {
-    event_count_++;
-    if (error != firebase::firestore::kOk) {
-      LogMessage("ERROR: EventListener %s got %d.", name_.c_str(), error);
-    }
-  }
-
-  // Hides the STLPort-related quirk that `AddSnapshotListener` has different
-  // signatures depending on whether `std::function` is available.
-  template <typename U>
-  firebase::firestore::ListenerRegistration AttachTo(U* ref) {
-#if !defined(STLPORT)
-    return ref->AddSnapshotListener(
-        [this](const T& result, firebase::firestore::Error error) {
-          OnEvent(result, error);
-        });
-#else
-    return ref->AddSnapshotListener(this);
-#endif
-  }
-
- private:
-  std::string name_;
-};
-
-void Await(const Countable& listener, const char* name) {
-  int remaining_timeout = kTimeoutMs;
-  while (listener.event_count() && remaining_timeout > 0) {
-    remaining_timeout -= kSleepMs;
-    ProcessEvents(kSleepMs);
-  }
-  if (remaining_timeout <= 0) {
-    LogMessage("ERROR: %s listener timed out.", name);
-  }
+// Waits for a listener to receive its first event and returns whether it did.
+// If it times out, an error will be logged.
+bool Await(const Countable& listener, const char* name) {
+  return WaitForEvents(listener.events(), 1, name, kTimeoutMs);
 }
 
 extern "C" int common_main(int argc, const char* argv[]) {
+  // Timeline of the startup, from App creation to the first request.
+  app_framework::StartupSequence startup;
   firebase::App* app;
 
 #if defined(__ANDROID__)
-  app = firebase::App::Create(GetJniEnv(), GetActivity());
+  app = firebase::App::Create(app_framework::GetJniEnv(),
+                              app_framework::GetActivity());
 #else
   app = firebase::App::Create();
 #endif  // defined(__ANDROID__)
+  startup.Mark("App::Create");
 
   LogMessage("Initialized Firebase App.");
 
-  LogMessage("Initializing Firebase Auth...");
-  firebase::InitResult result;
-  firebase::auth::Auth* auth = firebase::auth::Auth::GetAuth(app, &result);
-  if (result != firebase::kInitResultSuccess) {
-    LogMessage("Failed to initialize Firebase Auth, error: %d",
-               static_cast<int>(result));
+  LogMessage("Initializing Firebase Auth and Firebase Firestore.");
+
+  // Initialize Auth, then sign in and initialize Firestore at the same time,
+  // each module with its own ModuleInitializer to ensure no dependencies are
+  // missing. Firestore picks up the Auth instance of the App when it's
+  // created, so it waits for Auth, but not for the sign-in: it only needs the
+  // token once it makes a request.
+  firebase::auth::Auth* auth = nullptr;
+  firebase::firestore::Firestore* firestore = nullptr;
+  firebase::Future<firebase::auth::User*> login_future;
+
+  const int auth_step = startup.AddModule(
+      "Auth", app,
+      [](firebase::App* app, void* target) {
+        LogMessage("Attempt to initialize Firebase Auth.");
+        firebase::InitResult result;
+        *reinterpret_cast<firebase::auth::Auth**>(target) =
+            firebase::auth::Auth::GetAuth(app, &result);
+        return result;
+      },
+      &auth);
+  const int sign_in_step = startup.AddStep(
+      "SignInAnonymously",
+      [&auth, &login_future]() -> firebase::FutureBase {
+        LogMessage("Signing in...");
+        // Auth caches the previously signed-in user, which can be annoying
+        // when trying to test for sign-in failures.
+        auth->SignOut();
+        login_future = auth->SignInAnonymously();
+        return login_future;
+      },
+      {auth_step});
+  const int firestore_step = startup.AddModule(
+      "Firebase Firestore", app,
+      [](firebase::App* app, void* target) {
+        LogMessage("Attempt to initialize Firebase Firestore.");
+        firebase::InitResult result;
+        *reinterpret_cast<firebase::firestore::Firestore**>(target) =
+            firebase::firestore::Firestore::GetInstance(app, &result);
+        return result;
+      },
+      &firestore, {auth_step});
+
+  startup.Run(kTimeoutMs);
+
+  if (!startup.succeeded(auth_step) || !startup.succeeded(firestore_step)) {
+    LogMessage("Failed to initialize Firebase libraries.");
     return -1;
   }
-  LogMessage("Initialized Firebase Auth.");
-
-  LogMessage("Signing in...");
-  // Auth caches the previously signed-in user, which can be annoying when
-  // trying to test for sign-in failures.
-  auth->SignOut();
-  auto login_future = auth->SignInAnonymously();
-  Await(login_future, "Auth sign-in");
+  LogMessage("Successfully initialized Firebase Auth and Firebase Firestore.");
+
   auto* login_result = login_future.result();
-  if (login_result && *login_result) {
+  if (startup.succeeded(sign_in_step) && login_result && *login_result) {
     const firebase::auth::User* user = *login_result;
     LogMessage("Signed in as %s user, uid: %s, email: %s.\n",
                user->is_anonymous() ? "an anonymous" : "a non-anonymous",
@@ -143,36 +140,6 @@ extern "C" int common_main(int argc, const char* argv[]) {
   // still valid.
   login_future.Release();
 
-  LogMessage("Initialize Firebase Firestore.");
-
-  // Use ModuleInitializer to initialize Database, ensuring no dependencies are
-  // missing.
-  firebase::firestore::Firestore* firestore = nullptr;
-  void* initialize_targets[] = {&firestore};
-
-  const firebase::ModuleInitializer::InitializerFn initializers[] = {
-      [](firebase::App* app, void* data) {
-        LogMessage("Attempt to initialize Firebase Firestore.");
-        void** targets = reinterpret_cast<void**>(data);
-        firebase::InitResult result;
-        *reinterpret_cast<firebase::firestore::Firestore**>(targets[0]) =
-            firebase::firestore::Firestore::GetInstance(app, &result);
-        return result;
-      }};
-
-  firebase::ModuleInitializer initializer;
-  initializer.Initialize(app, initialize_targets, initializers,
-                         sizeof(initializers) / sizeof(initializers[0]));
-
-  Await(initializer.InitializeLastResult(), "Initialize");
-
-  if (initializer.InitializeLastResult().error() != 0) {
-    LogMessage("Failed to initialize Firebase libraries: %s",
-               initializer.InitializeLastResult().error_message());
-    return -1;
-  }
-  LogMessage("Successfully initialized Firebase Firestore.");
-
   firestore->set_log_level(firebase::kLogLevelDebug);
 
   if (firestore->app() != app) {
@@ -183,6 +150,12 @@ extern "C" int common_main(int argc, const char* argv[]) {
   firestore->set_settings(settings);
   LogMessage("Successfully set Firestore settings.");
 
+  // The benchmarks are slow, write a lot of documents and some recreate
+  // Firestore, so they're only run when requested with --benchmark (or
+  // another --benchmark_* flag).
+  app_framework::BenchmarkOptions benchmark_options;
+  app_framework::ParseBenchmarkOptions(argc, argv, &benchmark_options);
+
   LogMessage("Testing non-wrapping types.");
   const firebase::Timestamp timestamp{1, 2};
   if (timestamp.seconds() != 1 || timestamp.nanoseconds() != 2) {
@@ -226,6 +199,8 @@ extern "C" int common_main(int argc, const char* argv[]) {
             {"str", firebase::firestore::FieldValue::String("foo")},
             {"int", firebase::firestore::FieldValue::Integer(123)}}),
         "document.Set");
+  startup.Mark("First request");
+  startup.LogTimeline();
 
   LogMessage("Testing Update().");
   Await(document.Update(firebase::firestore::MapFieldValue{
@@ -233,30 +208,51 @@ extern "C" int common_main(int argc, const char* argv[]) {
         "document.Update");
 
   LogMessage("Testing Get().");
-  auto doc_future = document.Get();
-  if (Await(doc_future, "document.Get")) {
-    const firebase::firestore::DocumentSnapshot* snapshot = doc_future.result();
-    if (snapshot == nullptr) {
-      LogMessage("ERROR: failed to read document.");
-    } else {
-      for (const auto& kv : snapshot->GetData()) {
-        if (kv.second.type() ==
-            firebase::firestore::FieldValue::Type::kString) {
-          LogMessage("key is %s, value is %s", kv.first.c_str(),
-                     kv.second.string_value().c_str());
-        } else if (kv.second.type() ==
-                   firebase::firestore::FieldValue::Type::kInteger) {
-          LogMessage("key is %s, value is %ld", kv.first.c_str(),
-                     kv.second.integer_value());
-        } else {
-          // Log unexpected type for debugging.
-          LogMessage("key is %s, value is neither string nor integer",
-                     kv.first.c_str());
+  {
+    // Counts the snapshot and the copy of its fields made by GetData() along
+    // with the request, under the name the wait records.
+    app_framework::AllocationScope allocation_scope("document.Get");
+    auto doc_future = document.Get();
+    if (Await(doc_future, "document.Get")) {
+      const firebase::firestore::DocumentSnapshot* snapshot =
+          doc_future.result();
+      if (snapshot == nullptr) {
+        LogMessage("ERROR: failed to read document.");
+      } else {
+        for (const auto& kv : snapshot->GetData()) {
+          if (kv.second.type() ==
+              firebase::firestore::FieldValue::Type::kString) {
+            LogMessage("key is %s, value is %s", kv.first.c_str(),
+                       kv.second.string_value().c_str());
+          } else if (kv.second.type() ==
+                     firebase::firestore::FieldValue::Type::kInteger) {
+            LogMessage("key is %s, value is %ld", kv.first.c_str(),
+                       kv.second.integer_value());
+          } else {
+            // Log unexpected type for debugging.
+            LogMessage("key is %s, value is neither string nor integer",
+                       kv.first.c_str());
+          }
         }
       }
     }
   }
 
+  if (benchmark_options.enabled) {
+    LogMessage("Testing typed document reads.");
+    firestore_testapp::DocumentReaderBenchmarkResult reader_benchmark =
+        firestore_testapp::RunDocumentReaderBenchmark(
+            firestore->Document("foo/wide"),
+            firestore_testapp::DocumentReaderBenchmarkOptions());
+    firestore_testapp::LogDocumentReaderBenchmarkResult(reader_benchmark);
+    if (!reader_benchmark.values_match) {
+      LogMessage("ERROR: DocumentReader read different values than GetData().");
+    }
+    if (!reader_benchmark.round_trip) {
+      LogMessage("ERROR: DocumentReader failed to update the document.");
+    }
+  }
+
   LogMessage("Testing Delete().");
   Await(document.Delete(), "document.Delete");
   LogMessage("Tested document operations.");
@@ -280,6 +276,22 @@ extern "C" int common_main(int argc, const char* argv[]) {
   Await(batch.Commit(), "batch.Commit");
   LogMessage("Tested batch write.");
 
+  if (benchmark_options.enabled) {
+    LogMessage("Testing bulk write.");
+    std::vector<firestore_testapp::BulkWriterBenchmarkResult> bulk_results =
+        firestore_testapp::RunBulkWriterBenchmark(
+            firestore, firestore->Collection("bulk_writer"),
+            firestore_testapp::BulkWriterBenchmarkOptions());
+    firestore_testapp::LogBulkWriterBenchmarkResults(bulk_results);
+    for (const auto& bulk_result : bulk_results) {
+      if (!bulk_result.succeeded) {
+        LogMessage("ERROR: bulk write with %d batches in flight failed.",
+                   bulk_result.max_in_flight);
+      }
+    }
+    LogMessage("Tested bulk write.");
+  }
+
   LogMessage("Testing transaction.");
   Await(
       firestore->RunTransaction(
@@ -299,6 +311,22 @@ extern "C" int common_main(int argc, const char* argv[]) {
       "firestore.RunTransaction");
   LogMessage("Tested transaction.");
 
+  if (benchmark_options.enabled) {
+    LogMessage("Testing transaction contention.");
+    std::vector<firestore_testapp::TransactionContentionResult>
+        contention_results =
+            firestore_testapp::RunTransactionContentionBenchmark(
+                firestore, firestore->Collection("transaction_contention"),
+                firestore_testapp::TransactionContentionOptions());
+    firestore_testapp::LogTransactionContentionResults(contention_results);
+    for (size_t i = 0; i < contention_results.size(); ++i) {
+      if (!contention_results[i].counters_match) {
+        LogMessage("ERROR: counters don't match the increments committed.");
+      }
+    }
+    LogMessage("Tested transaction contention.");
+  }
+
   LogMessage("Testing query.");
   firebase::firestore::Query query =
       collection
@@ -325,6 +353,77 @@ extern "C" int common_main(int argc, const char* argv[]) {
   }
   LogMessage("Tested query.");
 
+  if (benchmark_options.enabled) {
+    LogMessage("Testing query performance.");
+    firestore_testapp::QueryBenchmarkResult query_benchmark =
+        firestore_testapp::RunQueryBenchmark(
+            firestore, firestore->Collection("query_benchmark"),
+            firestore_testapp::QueryBenchmarkOptions());
+    firestore_testapp::LogQueryBenchmarkResult(query_benchmark);
+    if (!query_benchmark.values_match) {
+      LogMessage("ERROR: GetData() and Get() read different values.");
+    }
+    LogMessage("Tested query performance.");
+  }
+
+  if (benchmark_options.enabled) {
+    LogMessage("Testing query snapshot listener throughput.");
+    firestore_testapp::SnapshotListenerBenchmarkResult listener_benchmark =
+        firestore_testapp::RunSnapshotListenerBenchmark(
+            firestore->Collection("snapshot_listener_benchmark"),
+            firestore_testapp::SnapshotListenerBenchmarkOptions());
+    firestore_testapp::LogSnapshotListenerBenchmarkResult(listener_benchmark);
+    if (listener_benchmark.latency_writes == 0) {
+      LogMessage("ERROR: no write was acknowledged to the snapshot listener.");
+    }
+    LogMessage("Tested query snapshot listener throughput.");
+  }
+
+  if (benchmark_options.enabled) {
+    LogMessage("Testing settings profiles.");
+    std::vector<firestore_testapp::SettingsProfileResult> profile_results =
+        firestore_testapp::RunSettingsProfileBenchmark(
+            app, &firestore, "settings_profile_benchmark",
+            firestore_testapp::GetSettingsProfiles(),
+            firestore_testapp::SettingsProfileBenchmarkOptions());
+    firestore_testapp::LogSettingsProfileResults(profile_results);
+    for (size_t i = 0; i < profile_results.size(); ++i) {
+      if (profile_results[i].failed) {
+        LogMessage("ERROR: settings profile %s failed.",
+                   profile_results[i].profile->name);
+      }
+    }
+    if (!firestore) {
+      LogMessage(
+          "ERROR: failed to recreate Firestore after settings profiles.");
+    }
+    LogMessage("Tested settings profiles.");
+  }
+
+  if (firestore && benchmark_options.enabled) {
+    LogMessage("Running benchmarks.");
+    // The settings profiles recreated Firestore, so make new references.
+    firebase::firestore::DocumentReference benchmark_document =
+        firestore->Document("benchmark/document");
+    firebase::firestore::Query benchmark_query =
+        firestore->Collection("query_benchmark").Limit(10);
+    int64_t benchmark_writes = 0;
+    app_framework::BenchmarkSuite benchmarks("firestore");
+    benchmarks.AddScenario("document_set", [&]() -> firebase::FutureBase {
+      return benchmark_document.Set(firebase::firestore::MapFieldValue{
+          {"int", firebase::firestore::FieldValue::Integer(
+                      benchmark_writes++)}});
+    });
+    benchmarks.AddScenario("document_get", [&]() -> firebase::FutureBase {
+      return benchmark_document.Get();
+    });
+    benchmarks.AddScenario("query_get", [&]() -> firebase::FutureBase {
+      return benchmark_query.Get();
+    });
+    app_framework::RunBenchmarks(&benchmarks, benchmark_options);
+    LogMessage("Ran benchmarks.");
+  }
+
   LogMessage("Shutdown the Firestore library.");
   delete firestore;
   firestore = nullptr;
@@ -0,0 +1,173 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "document_reader.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "firebase/firestore.h"
+#include "firebase/future.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+using app_framework::WaitForCompletion;
+
+namespace firestore_testapp {
+
+namespace {
+
+// The few fields of a wide document that a reader needs.
+struct DocumentSummary {
+  DocumentSummary() : score(0), level(0) {}
+
+  bool operator==(const DocumentSummary& other) const {
+    return name == other.name && score == other.score && level == other.level;
+  }
+
+  std::string name;
+  int64_t score;
+  int64_t level;
+};
+
+struct DocumentSummarySchema {
+  typedef DocumentSummary Struct;
+
+  template <typename Visitor>
+  static void Visit(Visitor* visitor) {
+    (*visitor)("name", &DocumentSummary::name);
+    (*visitor)("score", &DocumentSummary::score);
+    (*visitor)("stats.level", &DocumentSummary::level);
+  }
+};
+
+// Decode a DocumentSummary the way the samples read documents, from the map
+// of every field.
+DocumentSummary DecodeWithGetData(
+    const firebase::firestore::DocumentSnapshot& snapshot) {
+  DocumentSummary summary;
+  firebase::firestore::MapFieldValue data = snapshot.GetData();
+  firebase::firestore::MapFieldValue::const_iterator it = data.find("name");
+  if (it != data.end() &&
+      it->second.type() == firebase::firestore::FieldValue::Type::kString) {
+    summary.name = it->second.string_value();
+  }
+  it = data.find("score");
+  if (it != data.end() &&
+      it->second.type() == firebase::firestore::FieldValue::Type::kInteger) {
+    summary.score = it->second.integer_value();
+  }
+  it = data.find("stats");
+  if (it != data.end() &&
+      it->second.type() == firebase::firestore::FieldValue::Type::kMap) {
+    firebase::firestore::MapFieldValue stats = it->second.map_value();
+    it = stats.find("level");
+    if (it != stats.end() &&
+        it->second.type() == firebase::firestore::FieldValue::Type::kInteger) {
+      summary.level = it->second.integer_value();
+    }
+  }
+  return summary;
+}
+
+}  // namespace
+
+DocumentReaderBenchmarkResult RunDocumentReaderBenchmark(
+    firebase::firestore::DocumentReference document,
+    const DocumentReaderBenchmarkOptions& options) {
+  DocumentReaderBenchmarkResult result;
+  const DocumentReader<DocumentSummarySchema> reader;
+  DocumentSummary expected;
+  expected.name = "wide document";
+  expected.score = 42;
+  expected.level = 7;
+
+  firebase::firestore::MapFieldValue data = reader.EncodeSet(expected);
+  for (int i = 0; i < options.field_count; ++i) {
+    char name[16];
+    snprintf(name, sizeof(name), "f%03d", i);
+    data[name] = firebase::firestore::FieldValue::Integer(i);
+  }
+  if (!WaitForCompletion(document.Set(data), "DocumentReader Set",
+                         options.timeout_ms)) {
+    return result;
+  }
+  firebase::Future<firebase::firestore::DocumentSnapshot> future =
+      document.Get();
+  if (!WaitForCompletion(future, "DocumentReader Get", options.timeout_ms) ||
+      !future.result()) {
+    return result;
+  }
+  const firebase::firestore::DocumentSnapshot& snapshot = *future.result();
+  result.fields = static_cast<int>(snapshot.GetData().size());
+
+  DocumentSummary from_map;
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  for (int i = 0; i < options.decode_passes; ++i) {
+    from_map = DecodeWithGetData(snapshot);
+  }
+  int64_t get_data_us = GetMonotonicTimeInMicroseconds() - start_us;
+
+  DocumentSummary from_reader;
+  size_t decoded = 0;
+  start_us = GetMonotonicTimeInMicroseconds();
+  for (int i = 0; i < options.decode_passes; ++i) {
+    decoded = reader.Read(snapshot, &from_reader);
+  }
+  int64_t reader_us = GetMonotonicTimeInMicroseconds() - start_us;
+
+  if (options.decode_passes > 0) {
+    result.get_data_ns = get_data_us * 1000.0 / options.decode_passes;
+    result.reader_ns = reader_us * 1000.0 / options.decode_passes;
+  }
+  result.values_match = decoded == reader.size() && from_map == expected &&
+                        from_reader == expected;
+
+  // Update only the schema's fields and check the rest are untouched.
+  expected.score++;
+  expected.level++;
+  if (WaitForCompletion(reader.Update(document, expected),
+                        "DocumentReader Update", options.timeout_ms)) {
+    future = document.Get();
+    if (WaitForCompletion(future, "DocumentReader Get", options.timeout_ms) &&
+        future.result()) {
+      DocumentSummary updated;
+      result.round_trip =
+          reader.Read(*future.result(), &updated) == reader.size() &&
+          updated == expected &&
+          future.result()->Get("f000").type() ==
+              firebase::firestore::FieldValue::Type::kInteger;
+    }
+  }
+
+  WaitForCompletion(document.Delete(), "DocumentReader Delete",
+                    options.timeout_ms);
+  return result;
+}
+
+void LogDocumentReaderBenchmarkResult(
+    const DocumentReaderBenchmarkResult& result) {
+  LogMessage("  Reading 3 of %d fields: GetData() %.0f ns, DocumentReader "
+             "%.0f ns",
+             result.fields, result.get_data_ns, result.reader_ns);
+}
+
+}  // namespace firestore_testapp
@@ -0,0 +1,382 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_DOCUMENT_READER_H_  // NOLINT
+#define FIREBASE_TESTAPP_DOCUMENT_READER_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "firebase/firestore.h"
+#include "firebase/future.h"
+
+namespace firestore_testapp {
+
+// Converts between a C++ type and a FieldValue. Specialized for each type a
+// schema field may have, so using any other type fails to compile.
+//
+// Decode() returns false, leaving `value` unchanged, if `field` doesn't hold
+// a value of a compatible type.
+template <typename T>
+struct FieldCodec;
+
+template <>
+struct FieldCodec<int64_t> {
+  static bool Decode(const firebase::firestore::FieldValue& field,
+                     int64_t* value) {
+    if (field.type() == firebase::firestore::FieldValue::Type::kInteger) {
+      *value = field.integer_value();
+      return true;
+    }
+    if (field.type() == firebase::firestore::FieldValue::Type::kDouble) {
+      *value = static_cast<int64_t>(field.double_value());
+      return true;
+    }
+    return false;
+  }
+  static firebase::firestore::FieldValue Encode(int64_t value) {
+    return firebase::firestore::FieldValue::Integer(value);
+  }
+};
+
+template <>
+struct FieldCodec<int32_t> {
+  static bool Decode(const firebase::firestore::FieldValue& field,
+                     int32_t* value) {
+    int64_t integer_value;
+    if (!FieldCodec<int64_t>::Decode(field, &integer_value)) return false;
+    *value = static_cast<int32_t>(integer_value);
+    return true;
+  }
+  static firebase::firestore::FieldValue Encode(int32_t value) {
+    return firebase::firestore::FieldValue::Integer(value);
+  }
+};
+
+template <>
+struct FieldCodec<double> {
+  static bool Decode(const firebase::firestore::FieldValue& field,
+                     double* value) {
+    if (field.type() == firebase::firestore::FieldValue::Type::kDouble) {
+      *value = field.double_value();
+      return true;
+    }
+    if (field.type() == firebase::firestore::FieldValue::Type::kInteger) {
+      *value = static_cast<double>(field.integer_value());
+      return true;
+    }
+    return false;
+  }
+  static firebase::firestore::FieldValue Encode(double value) {
+    return firebase::firestore::FieldValue::Double(value);
+  }
+};
+
+template <>
+struct FieldCodec<bool> {
+  static bool Decode(const firebase::firestore::FieldValue& field,
+                     bool* value) {
+    if (field.type() != firebase::firestore::FieldValue::Type::kBoolean) {
+      return false;
+    }
+    *value = field.boolean_value();
+    return true;
+  }
+  static firebase::firestore::FieldValue Encode(bool value) {
+    return firebase::firestore::FieldValue::Boolean(value);
+  }
+};
+
+template <>
+struct FieldCodec<std::string> {
+  static bool Decode(const firebase::firestore::FieldValue& field,
+                     std::string* value) {
+    if (field.type() != firebase::firestore::FieldValue::Type::kString) {
+      return false;
+    }
+    *value = field.string_value();
+    return true;
+  }
+  static firebase::firestore::FieldValue Encode(const std::string& value) {
+    return firebase::firestore::FieldValue::String(value);
+  }
+};
+
+template <>
+struct FieldCodec<firebase::Timestamp> {
+  static bool Decode(const firebase::firestore::FieldValue& field,
+                     firebase::Timestamp* value) {
+    if (field.type() != firebase::firestore::FieldValue::Type::kTimestamp) {
+      return false;
+    }
+    *value = field.timestamp_value();
+    return true;
+  }
+  static firebase::firestore::FieldValue Encode(
+      const firebase::Timestamp& value) {
+    return firebase::firestore::FieldValue::Timestamp(value);
+  }
+};
+
+// Reads and writes the fields of a struct that a Schema lists, directly
+// through their field paths, rather than through a MapFieldValue of the
+// whole document. A schema is a class naming the struct and visiting each
+// of its fields with a path and a member pointer. Paths may use dots to
+// name nested fields:
+//
+//   struct Player {
+//     std::string name;
+//     int64_t level;
+//   };
+//
+//   struct PlayerSchema {
+//     typedef Player Struct;
+//     template <typename Visitor>
+//     static void Visit(Visitor* visitor) {
+//       (*visitor)("name", &Player::name);
+//       (*visitor)("stats.level", &Player::level);
+//     }
+//   };
+//
+//   DocumentReader<PlayerSchema> reader;
+//   Player player;
+//   reader.Read(snapshot, &player);
+//
+// The codec of each field is selected at compile time from its member type,
+// see FieldCodec. Field paths are parsed once, when the reader is created.
+template <typename Schema>
+class DocumentReader {
+ public:
+  typedef typename Schema::Struct Struct;
+
+  DocumentReader() {
+    PathCollector collector(&fields_);
+    Schema::Visit(&collector);
+  }
+
+  // Number of fields in the schema.
+  size_t size() const { return fields_.size(); }
+
+  // Decode each field of the schema from `snapshot` into `value`. Fields
+  // that are missing or have an incompatible type are left unchanged.
+  // Returns the number of fields decoded, size() if all of them were.
+  size_t Read(const firebase::firestore::DocumentSnapshot& snapshot,
+              Struct* value) const {
+    FieldReader reader(&fields_, &snapshot, value);
+    Schema::Visit(&reader);
+    return reader.decoded();
+  }
+
+  // Encode `value` as data for DocumentReference::Set(), with nested fields
+  // as nested maps.
+  firebase::firestore::MapFieldValue EncodeSet(const Struct& value) const {
+    std::vector<EncodedField> encoded;
+    FieldWriter writer(&fields_, &value, &encoded);
+    Schema::Visit(&writer);
+    return Nest(&encoded, 0, encoded.size(), 0);
+  }
+
+  // Encode `value` as data for DocumentReference::Update(), keyed by field
+  // path, so fields outside the schema are left unchanged.
+  firebase::firestore::MapFieldValue EncodeUpdate(const Struct& value) const {
+    std::vector<EncodedField> encoded;
+    FieldWriter writer(&fields_, &value, &encoded);
+    Schema::Visit(&writer);
+    firebase::firestore::MapFieldValue data;
+    for (size_t i = 0; i < encoded.size(); ++i) {
+      data[fields_[encoded[i].first].path] = std::move(encoded[i].second);
+    }
+    return data;
+  }
+
+  firebase::Future<void> Set(firebase::firestore::DocumentReference document,
+                             const Struct& value) const {
+    return document.Set(EncodeSet(value));
+  }
+  firebase::Future<void> Update(
+      firebase::firestore::DocumentReference document,
+      const Struct& value) const {
+    return document.Update(EncodeUpdate(value));
+  }
+
+ private:
+  struct SchemaField {
+    // Dotted path, as given by the schema.
+    std::string path;
+    std::vector<std::string> segments;
+    firebase::firestore::FieldPath field_path;
+  };
+
+  // Index of the schema field and its encoded value.
+  typedef std::pair<size_t, firebase::firestore::FieldValue> EncodedField;
+
+  class PathCollector {
+   public:
+    explicit PathCollector(std::vector<SchemaField>* fields)
+        : fields_(fields) {}
+
+    template <typename T>
+    void operator()(const char* path, T Struct::*) {
+      SchemaField field;
+      field.path = path;
+      size_t start = 0;
+      for (;;) {
+        size_t dot = field.path.find('.', start);
+        field.segments.push_back(field.path.substr(start, dot - start));
+        if (dot == std::string::npos) break;
+        start = dot + 1;
+      }
+      field.field_path = firebase::firestore::FieldPath(field.segments);
+      fields_->push_back(std::move(field));
+    }
+
+   private:
+    std::vector<SchemaField>* fields_;
+  };
+
+  class FieldReader {
+   public:
+    FieldReader(const std::vector<SchemaField>* fields,
+                const firebase::firestore::DocumentSnapshot* snapshot,
+                Struct* value)
+        : fields_(fields),
+          snapshot_(snapshot),
+          value_(value),
+          index_(0),
+          decoded_(0) {}
+
+    template <typename T>
+    void operator()(const char*, T Struct::*member) {
+      firebase::firestore::FieldValue field =
+          snapshot_->Get((*fields_)[index_++].field_path);
+      if (FieldCodec<T>::Decode(field, &(value_->*member))) decoded_++;
+    }
+
+    size_t decoded() const { return decoded_; }
+
+   private:
+    const std::vector<SchemaField>* fields_;
+    const firebase::firestore::DocumentSnapshot* snapshot_;
+    Struct* value_;
+    size_t index_;
+    size_t decoded_;
+  };
+
+  class FieldWriter {
+   public:
+    FieldWriter(const std::vector<SchemaField>* fields, const Struct* value,
+                std::vector<EncodedField>* encoded)
+        : value_(value), encoded_(encoded) {
+      encoded_->reserve(fields->size());
+    }
+
+    template <typename T>
+    void operator()(const char*, T Struct::*member) {
+      size_t index = encoded_->size();
+      encoded_->push_back(
+          EncodedField(index, FieldCodec<T>::Encode(value_->*member)));
+    }
+
+   private:
+    const Struct* value_;
+    std::vector<EncodedField>* encoded_;
+  };
+
+  // Build the map holding encoded[begin, end), whose paths share their
+  // first `depth` segments.
+  firebase::firestore::MapFieldValue Nest(std::vector<EncodedField>* encoded,
+                                          size_t begin, size_t end,
+                                          size_t depth) const {
+    firebase::firestore::MapFieldValue data;
+    std::vector<bool> nested(end - begin, false);
+    for (size_t i = begin; i < end; ++i) {
+      if (nested[i - begin]) continue;
+      const std::vector<std::string>& segments =
+          fields_[(*encoded)[i].first].segments;
+      if (segments.size() == depth + 1) {
+        data[segments[depth]] = std::move((*encoded)[i].second);
+        continue;
+      }
+      // Gather every field below the same map, keeping their order.
+      std::vector<EncodedField> children;
+      for (size_t j = i; j < end; ++j) {
+        const std::vector<std::string>& other =
+            fields_[(*encoded)[j].first].segments;
+        if (!nested[j - begin] && other.size() > depth + 1 &&
+            other[depth] == segments[depth]) {
+          children.push_back(std::move((*encoded)[j]));
+          nested[j - begin] = true;
+        }
+      }
+      data[segments[depth]] = firebase::firestore::FieldValue::Map(
+          Nest(&children, 0, children.size(), depth + 1));
+    }
+    return data;
+  }
+
+  std::vector<SchemaField> fields_;
+};
+
+// Configuration of RunDocumentReaderBenchmark().
+struct DocumentReaderBenchmarkOptions {
+  DocumentReaderBenchmarkOptions()
+      : field_count(200), decode_passes(1000), timeout_ms(10000) {}
+
+  // Fields of the document besides the ones in the schema.
+  int field_count;
+  // Times the document is decoded with each method.
+  int decode_passes;
+  int timeout_ms;
+};
+
+// Measurements of RunDocumentReaderBenchmark().
+struct DocumentReaderBenchmarkResult {
+  DocumentReaderBenchmarkResult()
+      : fields(0),
+        get_data_ns(0.0),
+        reader_ns(0.0),
+        values_match(false),
+        round_trip(false) {}
+
+  // Fields in the document read.
+  int fields;
+  // Time to decode the schema's fields from the document by materializing
+  // it with GetData(), and with a DocumentReader.
+  double get_data_ns;
+  double reader_ns;
+  // Whether both methods decoded the same values.
+  bool values_match;
+  // Whether values written with EncodeSet() and EncodeUpdate() read back.
+  bool round_trip;
+};
+
+// Write a document with options.field_count fields plus the fields of a
+// three field schema to `document`, then time reading the schema's fields
+// from it with GetData() and with a DocumentReader. The document is deleted
+// afterwards.
+DocumentReaderBenchmarkResult RunDocumentReaderBenchmark(
+    firebase::firestore::DocumentReference document,
+    const DocumentReaderBenchmarkOptions& options);
+
+// Log the results of RunDocumentReaderBenchmark().
+void LogDocumentReaderBenchmarkResult(
+    const DocumentReaderBenchmarkResult& result);
+
+}  // namespace firestore_testapp
+
+#endif  // FIREBASE_TESTAPP_DOCUMENT_READER_H_  // NOLINT
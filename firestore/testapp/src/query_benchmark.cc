@@ -0,0 +1,196 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "query_benchmark.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "firebase/firestore.h"
+#include "firebase/future.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+#include "bulk_writer.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LatencyHistogram;
+using app_framework::LogMessage;
+using app_framework::WaitForCompletion;
+
+namespace firestore_testapp {
+
+namespace {
+
+std::string DocumentId(int index) {
+  char id[16];
+  snprintf(id, sizeof(id), "q%06d", index);
+  return id;
+}
+
+const char* SourceName(firebase::firestore::Source source) {
+  switch (source) {
+    case firebase::firestore::Source::kServer:
+      return "server";
+    case firebase::firestore::Source::kCache:
+      return "cache";
+    default:
+      return "default";
+  }
+}
+
+QuerySourceResult RunSource(const firebase::firestore::Query& query,
+                            firebase::firestore::Source source,
+                            const QueryBenchmarkOptions& options) {
+  QuerySourceResult result;
+  result.source = source;
+  LatencyHistogram latencies;
+  for (int i = 0; i < options.repetitions; ++i) {
+    int64_t start_us = GetMonotonicTimeInMicroseconds();
+    firebase::Future<firebase::firestore::QuerySnapshot> future =
+        query.Get(source);
+    if (!WaitForCompletion(future, "QueryBenchmark Get", options.timeout_ms) ||
+        !future.result()) {
+      result.failed = true;
+      break;
+    }
+    int64_t latency_us = GetMonotonicTimeInMicroseconds() - start_us;
+    if (i == 0) result.first_us = latency_us;
+    latencies.Record(latency_us);
+    result.documents = static_cast<int>(future.result()->size());
+    result.from_cache = future.result()->metadata().is_from_cache();
+  }
+  result.p50_us = latencies.Percentile(50.0);
+  return result;
+}
+
+}  // namespace
+
+QueryBenchmarkResult RunQueryBenchmark(
+    firebase::firestore::Firestore* firestore,
+    const firebase::firestore::CollectionReference& collection,
+    const QueryBenchmarkOptions& options) {
+  QueryBenchmarkResult result;
+  {
+    BulkWriter writer(firestore, BulkWriterOptions());
+    std::vector<std::string> field_names;
+    for (int i = 0; i < options.field_count; ++i) {
+      char name[16];
+      snprintf(name, sizeof(name), "f%02d", i);
+      field_names.push_back(name);
+    }
+    for (int i = 0; i < options.document_count; ++i) {
+      firebase::firestore::MapFieldValue data;
+      data["int"] = firebase::firestore::FieldValue::Integer(i);
+      for (size_t j = 0; j < field_names.size(); ++j) {
+        data[field_names[j]] =
+            firebase::firestore::FieldValue::String(field_names[j]);
+      }
+      writer.Set(collection.Document(DocumentId(i)), data);
+    }
+    writer.Flush();
+    result.documents_written =
+        static_cast<int>(writer.stats().documents_written);
+  }
+
+  // The server source runs before the cache source, so the cache holds the
+  // whole collection even if some of the local writes were evicted.
+  const firebase::firestore::Source sources[] = {
+      firebase::firestore::Source::kDefault,
+      firebase::firestore::Source::kServer,
+      firebase::firestore::Source::kCache,
+  };
+  for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); ++i) {
+    result.sources.push_back(RunSource(collection, sources[i], options));
+  }
+
+  // Time decoding with a result from the cache to leave the network out.
+  firebase::Future<firebase::firestore::QuerySnapshot> future =
+      collection.Get(firebase::firestore::Source::kCache);
+  if (WaitForCompletion(future, "QueryBenchmark Decode", options.timeout_ms) &&
+      future.result()) {
+    int64_t start_us = GetMonotonicTimeInMicroseconds();
+    const std::vector<firebase::firestore::DocumentSnapshot> documents =
+        future.result()->documents();
+    result.documents_copy_us = GetMonotonicTimeInMicroseconds() - start_us;
+
+    int64_t get_data_sum = 0;
+    start_us = GetMonotonicTimeInMicroseconds();
+    for (int pass = 0; pass < options.decode_passes; ++pass) {
+      for (size_t i = 0; i < documents.size(); ++i) {
+        firebase::firestore::MapFieldValue data = documents[i].GetData();
+        firebase::firestore::MapFieldValue::const_iterator it =
+            data.find("int");
+        if (it != data.end()) get_data_sum += it->second.integer_value();
+      }
+    }
+    int64_t get_data_us = GetMonotonicTimeInMicroseconds() - start_us;
+
+    int64_t get_field_sum = 0;
+    start_us = GetMonotonicTimeInMicroseconds();
+    for (int pass = 0; pass < options.decode_passes; ++pass) {
+      for (size_t i = 0; i < documents.size(); ++i) {
+        get_field_sum += documents[i].Get("int").integer_value();
+      }
+    }
+    int64_t get_field_us = GetMonotonicTimeInMicroseconds() - start_us;
+
+    double decoded =
+        static_cast<double>(documents.size()) * options.decode_passes;
+    if (decoded > 0) {
+      result.get_data_ns_per_document = get_data_us * 1000.0 / decoded;
+      result.get_field_ns_per_document = get_field_us * 1000.0 / decoded;
+    }
+    result.values_match = !documents.empty() && get_data_sum == get_field_sum;
+  }
+
+  BulkWriter cleanup(firestore, BulkWriterOptions());
+  for (int i = 0; i < options.document_count; ++i) {
+    cleanup.Delete(collection.Document(DocumentId(i)));
+  }
+  if (!cleanup.Flush()) {
+    LogMessage("ERROR: Failed to delete the query benchmark documents.");
+  }
+  return result;
+}
+
+void LogQueryBenchmarkResult(const QueryBenchmarkResult& result) {
+  LogMessage("  Queried %d documents", result.documents_written);
+  LogMessage("  %-8s %9s %10s %9s", "source", "documents", "first ms",
+             "p50 ms");
+  for (size_t i = 0; i < result.sources.size(); ++i) {
+    const QuerySourceResult& source = result.sources[i];
+    if (source.failed) {
+      LogMessage("  %-8s failed", SourceName(source.source));
+      continue;
+    }
+    LogMessage("  %-8s %9d %10.1f %9.1f%s", SourceName(source.source),
+               source.documents, source.first_us / 1000.0,
+               source.p50_us / 1000.0,
+               source.from_cache ? " (from cache)" : "");
+  }
+  LogMessage("  documents() copy took %.2f ms",
+             result.documents_copy_us / 1000.0);
+  LogMessage("  Reading \"int\": GetData() %.0f ns/doc, Get() %.0f ns/doc",
+             result.get_data_ns_per_document,
+             result.get_field_ns_per_document);
+}
+
+}  // namespace firestore_testapp
@@ -0,0 +1,105 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_QUERY_BENCHMARK_H_  // NOLINT
+#define FIREBASE_TESTAPP_QUERY_BENCHMARK_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "firebase/firestore.h"
+
+namespace firestore_testapp {
+
+// Configuration of RunQueryBenchmark().
+struct QueryBenchmarkOptions {
+  QueryBenchmarkOptions()
+      : document_count(1000),
+        field_count(20),
+        repetitions(3),
+        decode_passes(10),
+        timeout_ms(30000) {}
+
+  // Documents written to the collection that's queried.
+  int document_count;
+  // String fields of each document, in addition to the "int" field.
+  int field_count;
+  // Times the query is run from each source.
+  int repetitions;
+  // Times each decoding method is run over the result to time it.
+  int decode_passes;
+  // Time to wait for each query.
+  int timeout_ms;
+};
+
+// Measurements of Query::Get() from one Source.
+struct QuerySourceResult {
+  QuerySourceResult()
+      : source(firebase::firestore::Source::kDefault),
+        documents(0),
+        from_cache(false),
+        failed(false),
+        first_us(0),
+        p50_us(0) {}
+
+  firebase::firestore::Source source;
+  // Documents returned by the last run, and whether they came from the
+  // cache.
+  int documents;
+  bool from_cache;
+  bool failed;
+  // Get() returns the whole result at once, so the time to its first
+  // document is the time to the result. first_us is the first run from the
+  // source, p50_us the median over every run.
+  int64_t first_us;
+  int64_t p50_us;
+};
+
+// Measurements of RunQueryBenchmark().
+struct QueryBenchmarkResult {
+  QueryBenchmarkResult()
+      : documents_written(0),
+        documents_copy_us(0),
+        get_data_ns_per_document(0.0),
+        get_field_ns_per_document(0.0),
+        values_match(false) {}
+
+  int documents_written;
+  std::vector<QuerySourceResult> sources;
+  // Time taken by QuerySnapshot::documents(), which copies every
+  // DocumentSnapshot of the result.
+  int64_t documents_copy_us;
+  // Time to read the "int" field of a document by materializing the whole
+  // document with GetData(), and with Get("int").
+  double get_data_ns_per_document;
+  double get_field_ns_per_document;
+  // Whether both methods read the same values.
+  bool values_match;
+};
+
+// Write options.document_count documents to `collection`, query them with
+// Query::Get() from the default, server and cache sources and time decoding
+// the result, then delete the documents.
+QueryBenchmarkResult RunQueryBenchmark(
+    firebase::firestore::Firestore* firestore,
+    const firebase::firestore::CollectionReference& collection,
+    const QueryBenchmarkOptions& options);
+
+// Log the results of RunQueryBenchmark().
+void LogQueryBenchmarkResult(const QueryBenchmarkResult& result);
+
+}  // namespace firestore_testapp
+
+#endif  // FIREBASE_TESTAPP_QUERY_BENCHMARK_H_  // NOLINT
@@ -0,0 +1,256 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "settings_profile.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "firebase/app.h"
+#include "firebase/firestore.h"
+#include "firebase/future.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "memory_usage.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::GetResidentMemoryBytes;
+using app_framework::LatencyHistogram;
+using app_framework::LogMessage;
+using app_framework::WaitForAll;
+using app_framework::WaitForCompletion;
+
+namespace firestore_testapp {
+
+const SettingsProfile kSdkDefaultProfile = {"sdk-default", true, 0};
+const SettingsProfile kLowMemoryProfile = {"low-memory-mobile", true,
+                                           1024 * 1024};
+const SettingsProfile kOfflineFirstProfile = {
+    "offline-first", true, firebase::firestore::Settings::kCacheSizeUnlimited};
+const SettingsProfile kServerHeavyProfile = {"server-heavy", false, 0};
+
+std::vector<const SettingsProfile*> GetSettingsProfiles() {
+  std::vector<const SettingsProfile*> profiles;
+  profiles.push_back(&kSdkDefaultProfile);
+  profiles.push_back(&kLowMemoryProfile);
+  profiles.push_back(&kOfflineFirstProfile);
+  profiles.push_back(&kServerHeavyProfile);
+  return profiles;
+}
+
+const SettingsProfile* FindSettingsProfile(const char* name) {
+  std::vector<const SettingsProfile*> profiles = GetSettingsProfiles();
+  for (size_t i = 0; i < profiles.size(); ++i) {
+    if (strcmp(profiles[i]->name, name) == 0) return profiles[i];
+  }
+  return nullptr;
+}
+
+void ApplySettingsProfile(const SettingsProfile& profile,
+                          firebase::firestore::Settings* settings) {
+  settings->set_persistence_enabled(profile.persistence_enabled);
+  if (profile.cache_size_bytes != 0) {
+    settings->set_cache_size_bytes(profile.cache_size_bytes);
+  }
+}
+
+namespace {
+
+std::string DocumentId(int index) {
+  char id[16];
+  snprintf(id, sizeof(id), "p%04d", index);
+  return id;
+}
+
+OperationLatency Summarize(const LatencyHistogram& histogram) {
+  OperationLatency latency;
+  latency.p50_us = histogram.Percentile(50.0);
+  latency.p99_us = histogram.Percentile(99.0);
+  return latency;
+}
+
+// Delete `*firestore`, clearing its persisted data so that the next profile
+// starts with an empty cache, and create a new instance using `profile`.
+bool RecreateFirestore(firebase::App* app,
+                       firebase::firestore::Firestore** firestore,
+                       const SettingsProfile& profile, int timeout_ms) {
+  if (*firestore) {
+    // Persistence can only be cleared once the instance is terminated.
+    WaitForCompletion((*firestore)->Terminate(), "Firestore Terminate",
+                      timeout_ms);
+    WaitForCompletion((*firestore)->ClearPersistence(),
+                      "Firestore ClearPersistence", timeout_ms);
+    delete *firestore;
+    *firestore = nullptr;
+  }
+  firebase::InitResult init_result;
+  *firestore = firebase::firestore::Firestore::GetInstance(app, &init_result);
+  if (init_result != firebase::kInitResultSuccess || !*firestore) {
+    LogMessage("ERROR: Failed to create Firestore for settings profile %s, "
+               "error: %d",
+               profile.name, static_cast<int>(init_result));
+    *firestore = nullptr;
+    return false;
+  }
+  // Settings must be set before the instance is used for anything else.
+  firebase::firestore::Settings settings = (*firestore)->settings();
+  ApplySettingsProfile(profile, &settings);
+  (*firestore)->set_settings(settings);
+  return true;
+}
+
+SettingsProfileResult RunProfile(
+    firebase::firestore::Firestore* firestore, const char* collection_path,
+    const SettingsProfileBenchmarkOptions& options) {
+  SettingsProfileResult result;
+  firebase::firestore::CollectionReference collection =
+      firestore->Collection(collection_path);
+
+  // Documents for the query to match, written before anything is timed.
+  std::vector<firebase::FutureBase> writes;
+  for (int i = 0; i < options.document_count; ++i) {
+    writes.push_back(collection.Document(DocumentId(i))
+                         .Set(firebase::firestore::MapFieldValue{
+                             {"int", firebase::firestore::FieldValue::Integer(
+                                         i % 10)}}));
+  }
+  std::vector<app_framework::FutureWaitResult> write_results =
+      WaitForAll(writes, options.timeout_ms);
+  for (size_t i = 0; i < write_results.size(); ++i) {
+    if (write_results[i].result != app_framework::kWaitResultComplete ||
+        write_results[i].error != firebase::firestore::kOk) {
+      result.failed = true;
+    }
+  }
+
+  LatencyHistogram set_latency;
+  LatencyHistogram update_latency;
+  LatencyHistogram get_latency;
+  LatencyHistogram query_latency;
+  firebase::firestore::DocumentReference document =
+      collection.Document("profiled");
+  firebase::firestore::Query query =
+      collection.WhereGreaterThan("int",
+                                  firebase::firestore::FieldValue::Integer(5))
+          .Limit(3);
+  for (int i = 0; i < options.iterations && !result.failed; ++i) {
+    int64_t start_us = GetMonotonicTimeInMicroseconds();
+    if (!WaitForCompletion(
+            document.Set(firebase::firestore::MapFieldValue{
+                {"iteration", firebase::firestore::FieldValue::Integer(i)}}),
+            "SettingsProfile Set", options.timeout_ms)) {
+      result.failed = true;
+      break;
+    }
+    set_latency.Record(GetMonotonicTimeInMicroseconds() - start_us);
+
+    start_us = GetMonotonicTimeInMicroseconds();
+    if (!WaitForCompletion(
+            document.Update(firebase::firestore::MapFieldValue{
+                {"updated", firebase::firestore::FieldValue::Boolean(true)}}),
+            "SettingsProfile Update", options.timeout_ms)) {
+      result.failed = true;
+      break;
+    }
+    update_latency.Record(GetMonotonicTimeInMicroseconds() - start_us);
+
+    start_us = GetMonotonicTimeInMicroseconds();
+    if (!WaitForCompletion(document.Get(), "SettingsProfile Get",
+                           options.timeout_ms)) {
+      result.failed = true;
+      break;
+    }
+    get_latency.Record(GetMonotonicTimeInMicroseconds() - start_us);
+
+    start_us = GetMonotonicTimeInMicroseconds();
+    if (!WaitForCompletion(query.Get(), "SettingsProfile Query",
+                           options.timeout_ms)) {
+      result.failed = true;
+      break;
+    }
+    query_latency.Record(GetMonotonicTimeInMicroseconds() - start_us);
+  }
+  result.set = Summarize(set_latency);
+  result.update = Summarize(update_latency);
+  result.get = Summarize(get_latency);
+  result.query = Summarize(query_latency);
+
+  std::vector<firebase::FutureBase> deletes;
+  deletes.push_back(document.Delete());
+  for (int i = 0; i < options.document_count; ++i) {
+    deletes.push_back(collection.Document(DocumentId(i)).Delete());
+  }
+  WaitForAll(deletes, options.timeout_ms);
+  return result;
+}
+
+}  // namespace
+
+std::vector<SettingsProfileResult> RunSettingsProfileBenchmark(
+    firebase::App* app, firebase::firestore::Firestore** firestore,
+    const char* collection_path,
+    const std::vector<const SettingsProfile*>& profiles,
+    const SettingsProfileBenchmarkOptions& options) {
+  std::vector<SettingsProfileResult> results;
+  for (size_t i = 0; i < profiles.size(); ++i) {
+    int64_t resident_before_bytes = GetResidentMemoryBytes();
+    SettingsProfileResult result;
+    if (RecreateFirestore(app, firestore, *profiles[i], options.timeout_ms)) {
+      result = RunProfile(*firestore, collection_path, options);
+    } else {
+      result.failed = true;
+    }
+    result.profile = profiles[i];
+    result.resident_before_bytes = resident_before_bytes;
+    result.resident_after_bytes = GetResidentMemoryBytes();
+    results.push_back(result);
+  }
+  RecreateFirestore(app, firestore, kSdkDefaultProfile, options.timeout_ms);
+  return results;
+}
+
+void LogSettingsProfileResults(
+    const std::vector<SettingsProfileResult>& results) {
+  LogMessage("  %-18s %15s %15s %15s %15s %12s", "profile",
+             "set p50/p99 ms", "update p50/p99", "get p50/p99",
+             "query p50/p99", "RSS delta KB");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const SettingsProfileResult& result = results[i];
+    char resident_delta[16] = "?";
+    if (result.resident_before_bytes >= 0 &&
+        result.resident_after_bytes >= 0) {
+      snprintf(resident_delta, sizeof(resident_delta), "%lld",
+               static_cast<long long>(  // NOLINT
+                   (result.resident_after_bytes -
+                    result.resident_before_bytes) / 1024));
+    }
+    LogMessage("  %-18s %7.1f/%-7.1f %7.1f/%-7.1f %7.1f/%-7.1f %7.1f/%-7.1f "
+               "%12s%s",
+               result.profile ? result.profile->name : "?",
+               result.set.p50_us / 1000.0, result.set.p99_us / 1000.0,
+               result.update.p50_us / 1000.0, result.update.p99_us / 1000.0,
+               result.get.p50_us / 1000.0, result.get.p99_us / 1000.0,
+               result.query.p50_us / 1000.0, result.query.p99_us / 1000.0,
+               resident_delta, result.failed ? " (failed)" : "");
+  }
+}
+
+}  // namespace firestore_testapp
@@ -0,0 +1,116 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_SETTINGS_PROFILE_H_  // NOLINT
+#define FIREBASE_TESTAPP_SETTINGS_PROFILE_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "firebase/app.h"
+#include "firebase/firestore.h"
+
+namespace firestore_testapp {
+
+// A named set of Firestore settings tuned for a class of device or workload.
+struct SettingsProfile {
+  const char* name;
+  bool persistence_enabled;
+  // Size at which the cache is garbage collected,
+  // Settings::kCacheSizeUnlimited to never collect it, or 0 to keep the
+  // SDK's default.
+  int64_t cache_size_bytes;
+};
+
+// Settings as the SDK creates them.
+extern const SettingsProfile kSdkDefaultProfile;
+// Persistence with the smallest cache the SDK accepts, 1 MB, for devices
+// with little memory and storage.
+extern const SettingsProfile kLowMemoryProfile;
+// Persistence with a cache that's never collected, so everything read once
+// is available offline.
+extern const SettingsProfile kOfflineFirstProfile;
+// No persistence: every read goes to the server, and the cache only holds
+// documents with active listeners.
+extern const SettingsProfile kServerHeavyProfile;
+
+// Every profile above, in the order they're declared.
+std::vector<const SettingsProfile*> GetSettingsProfiles();
+// Profile named `name`, or nullptr if there's none.
+const SettingsProfile* FindSettingsProfile(const char* name);
+
+// Change `settings` to use `profile`.
+void ApplySettingsProfile(const SettingsProfile& profile,
+                          firebase::firestore::Settings* settings);
+
+// Configuration of RunSettingsProfileBenchmark().
+struct SettingsProfileBenchmarkOptions {
+  SettingsProfileBenchmarkOptions()
+      : iterations(20), document_count(50), timeout_ms(10000) {}
+
+  // Times each operation of the suite is run per profile.
+  int iterations;
+  // Documents in the collection that's queried.
+  int document_count;
+  int timeout_ms;
+};
+
+// Median and 99th percentile latency of one operation.
+struct OperationLatency {
+  OperationLatency() : p50_us(0), p99_us(0) {}
+
+  int64_t p50_us;
+  int64_t p99_us;
+};
+
+// Measurements of one profile.
+struct SettingsProfileResult {
+  SettingsProfileResult()
+      : profile(nullptr),
+        failed(false),
+        resident_before_bytes(-1),
+        resident_after_bytes(-1) {}
+
+  const SettingsProfile* profile;
+  bool failed;
+  // Resident memory of the process before the Firestore instance was created
+  // and after the suite ran, -1 if it couldn't be read.
+  int64_t resident_before_bytes;
+  int64_t resident_after_bytes;
+  OperationLatency set;
+  OperationLatency update;
+  OperationLatency get;
+  OperationLatency query;
+};
+
+// For each profile: replace `*firestore` with a new instance using the
+// profile, since settings can't change once an instance is in use, and
+// time DocumentReference::Set(), Update(), Get() and a Query::Get() on
+// `collection_path`. `*firestore` is left using kSdkDefaultProfile, or null
+// if it couldn't be created.
+std::vector<SettingsProfileResult> RunSettingsProfileBenchmark(
+    firebase::App* app, firebase::firestore::Firestore** firestore,
+    const char* collection_path,
+    const std::vector<const SettingsProfile*>& profiles,
+    const SettingsProfileBenchmarkOptions& options);
+
+// Log a table of the results of RunSettingsProfileBenchmark().
+void LogSettingsProfileResults(
+    const std::vector<SettingsProfileResult>& results);
+
+}  // namespace firestore_testapp
+
+#endif  // FIREBASE_TESTAPP_SETTINGS_PROFILE_H_  // NOLINT
@@ -0,0 +1,251 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "snapshot_listener_benchmark.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "firebase/firestore.h"
+#include "firebase/future.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+using app_framework::WaitForAll;
+using app_framework::WaitForEvents;
+
+namespace firestore_testapp {
+
+const char kSequenceField[] = "seq";
+
+QuerySnapshotTimer::QuerySnapshotTimer(std::string name, int max_writes)
+    : TestEventListener<firebase::firestore::QuerySnapshot>(std::move(name)),
+      write_us_(max_writes),
+      seen_locally_(max_writes),
+      acknowledged_(max_writes),
+      last_snapshot_us_(0) {}
+
+void QuerySnapshotTimer::MarkWrite(int sequence) {
+  if (sequence < 0 || sequence >= static_cast<int>(write_us_.size())) return;
+  write_us_[sequence] = GetMonotonicTimeInMicroseconds();
+}
+
+void QuerySnapshotTimer::OnEvent(
+    const firebase::firestore::QuerySnapshot& snapshot,
+    const firebase::firestore::Error error) {
+  int64_t now_us = GetMonotonicTimeInMicroseconds();
+  if (error == firebase::firestore::kOk) {
+    std::vector<firebase::firestore::DocumentChange> changes =
+        snapshot.DocumentChanges(
+            firebase::firestore::MetadataChanges::kInclude);
+    for (size_t i = 0; i < changes.size(); ++i) {
+      if (changes[i].type() ==
+          firebase::firestore::DocumentChange::Type::kRemoved) {
+        continue;
+      }
+      firebase::firestore::DocumentSnapshot document = changes[i].document();
+      firebase::firestore::FieldValue sequence_value =
+          document.Get(kSequenceField);
+      if (sequence_value.type() !=
+          firebase::firestore::FieldValue::Type::kInteger) {
+        continue;
+      }
+      int64_t sequence = sequence_value.integer_value();
+      if (sequence < 0 || sequence >= static_cast<int64_t>(write_us_.size())) {
+        continue;
+      }
+      int64_t write_us = write_us_[sequence];
+      if (!write_us) continue;
+      if (document.metadata().has_pending_writes()) {
+        if (!seen_locally_[sequence].exchange(true)) {
+          local_latency_.Record(now_us - write_us);
+          local_writes_.Signal();
+        }
+      } else if (!acknowledged_[sequence].exchange(true)) {
+        // A write acknowledged before its local snapshot was delivered has
+        // been seen by the listener all the same.
+        if (!seen_locally_[sequence].exchange(true)) {
+          local_latency_.Record(now_us - write_us);
+          local_writes_.Signal();
+        }
+        acknowledged_latency_.Record(now_us - write_us);
+        acknowledged_writes_.Signal();
+      }
+    }
+  }
+  last_snapshot_us_ = now_us;
+  TestEventListener<firebase::firestore::QuerySnapshot>::OnEvent(snapshot,
+                                                                 error);
+}
+
+double SnapshotThroughputResult::snapshots_per_second() const {
+  return elapsed_us > 0 ? snapshots * 1000000.0 / elapsed_us : 0.0;
+}
+
+namespace {
+
+std::string DocumentId(int index) {
+  char id[16];
+  snprintf(id, sizeof(id), "s%04d", index);
+  return id;
+}
+
+firebase::Future<void> WriteSequence(
+    firebase::firestore::CollectionReference* collection, int document,
+    int sequence, QuerySnapshotTimer* timer) {
+  timer->MarkWrite(sequence);
+  return collection->Document(DocumentId(document))
+      .Set(firebase::firestore::MapFieldValue{
+          {kSequenceField,
+           firebase::firestore::FieldValue::Integer(sequence)}});
+}
+
+SnapshotThroughputResult RunLevel(
+    firebase::firestore::CollectionReference* collection, int rate,
+    const SnapshotListenerBenchmarkOptions& options) {
+  SnapshotThroughputResult result;
+  result.offered_rate = rate;
+  const int writes =
+      std::max(1, static_cast<int>(static_cast<int64_t>(rate) *
+                                   options.level_duration_ms / 1000));
+  QuerySnapshotTimer timer("SnapshotThroughput", writes);
+  firebase::firestore::ListenerRegistration registration = timer.AttachTo(
+      collection, firebase::firestore::MetadataChanges::kInclude);
+  WaitForEvents(timer.events(), 1, "SnapshotThroughput initial snapshot",
+                options.timeout_ms);
+  const int initial_snapshots = timer.event_count();
+
+  std::vector<firebase::FutureBase> futures;
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  for (int i = 0; i < writes; ++i) {
+    // Issue each write at its scheduled time rather than in a burst.
+    int64_t due_us = start_us + static_cast<int64_t>(i) * 1000000 / rate;
+    int64_t now_us = GetMonotonicTimeInMicroseconds();
+    if (now_us < due_us &&
+        app_framework::ProcessEvents(
+            std::max(1, static_cast<int>((due_us - now_us) / 1000)))) {
+      break;
+    }
+    futures.push_back(
+        WriteSequence(collection, i % options.document_count, i, &timer));
+  }
+  result.writes = static_cast<int>(futures.size());
+  timer.local_writes().WaitForCount(result.writes, options.timeout_ms);
+  WaitForAll(futures, options.timeout_ms);
+  registration.Remove();
+
+  result.seen = timer.local_writes().count();
+  result.snapshots = timer.event_count() - initial_snapshots;
+  result.elapsed_us = timer.last_snapshot_us() - start_us;
+  result.local_p50_us = timer.local_latency().Percentile(50.0);
+  result.local_p99_us = timer.local_latency().Percentile(99.0);
+  result.keeping_up =
+      result.writes > 0 && result.seen == result.writes &&
+      result.local_p99_us <= static_cast<int64_t>(options.max_lag_ms) * 1000;
+  return result;
+}
+
+}  // namespace
+
+SnapshotListenerBenchmarkResult RunSnapshotListenerBenchmark(
+    const firebase::firestore::CollectionReference& collection,
+    const SnapshotListenerBenchmarkOptions& options) {
+  SnapshotListenerBenchmarkResult result;
+  firebase::firestore::CollectionReference listened = collection;
+  SnapshotListenerBenchmarkOptions level_options = options;
+  level_options.document_count = std::max(1, options.document_count);
+
+  {
+    QuerySnapshotTimer timer("SnapshotLatency", options.latency_writes);
+    firebase::firestore::ListenerRegistration registration = timer.AttachTo(
+        &listened, firebase::firestore::MetadataChanges::kInclude);
+    WaitForEvents(timer.events(), 1, "SnapshotLatency initial snapshot",
+                  options.timeout_ms);
+    std::vector<firebase::FutureBase> futures;
+    for (int i = 0; i < options.latency_writes; ++i) {
+      futures.push_back(WriteSequence(
+          &listened, i % level_options.document_count, i, &timer));
+      if (!WaitForEvents(timer.acknowledged_writes(), i + 1,
+                         "SnapshotLatency acknowledged", options.timeout_ms)) {
+        break;
+      }
+    }
+    WaitForAll(futures, options.timeout_ms);
+    registration.Remove();
+    result.latency_writes = timer.acknowledged_writes().count();
+    result.local_p50_us = timer.local_latency().Percentile(50.0);
+    result.local_p99_us = timer.local_latency().Percentile(99.0);
+    result.acknowledged_p50_us = timer.acknowledged_latency().Percentile(50.0);
+    result.acknowledged_p99_us = timer.acknowledged_latency().Percentile(99.0);
+  }
+
+  for (size_t i = 0; i < options.write_rates.size(); ++i) {
+    if (options.write_rates[i] <= 0) continue;
+    result.levels.push_back(
+        RunLevel(&listened, options.write_rates[i], level_options));
+    if (result.levels.back().keeping_up) {
+      result.max_sustained_rate =
+          std::max(result.max_sustained_rate, options.write_rates[i]);
+    }
+  }
+
+  std::vector<firebase::FutureBase> deletes;
+  for (int i = 0; i < level_options.document_count; ++i) {
+    deletes.push_back(listened.Document(DocumentId(i)).Delete());
+  }
+  std::vector<app_framework::FutureWaitResult> delete_results =
+      WaitForAll(deletes, options.timeout_ms);
+  for (size_t i = 0; i < delete_results.size(); ++i) {
+    if (delete_results[i].result != app_framework::kWaitResultComplete ||
+        delete_results[i].error != firebase::firestore::kOk) {
+      LogMessage("ERROR: Failed to delete snapshot listener benchmark "
+                 "document %s.",
+                 DocumentId(static_cast<int>(i)).c_str());
+    }
+  }
+  return result;
+}
+
+void LogSnapshotListenerBenchmarkResult(
+    const SnapshotListenerBenchmarkResult& result) {
+  LogMessage("  %d writes: local p50 %.1f ms p99 %.1f ms, acknowledged p50 "
+             "%.1f ms p99 %.1f ms",
+             result.latency_writes, result.local_p50_us / 1000.0,
+             result.local_p99_us / 1000.0, result.acknowledged_p50_us / 1000.0,
+             result.acknowledged_p99_us / 1000.0);
+  LogMessage("  %8s %7s %7s %9s %11s %9s %9s", "writes/s", "writes", "seen",
+             "snapshots", "snapshots/s", "p50 ms", "p99 ms");
+  for (size_t i = 0; i < result.levels.size(); ++i) {
+    const SnapshotThroughputResult& level = result.levels[i];
+    LogMessage("  %8d %7d %7d %9d %11.0f %9.1f %9.1f%s", level.offered_rate,
+               level.writes, level.seen, level.snapshots,
+               level.snapshots_per_second(), level.local_p50_us / 1000.0,
+               level.local_p99_us / 1000.0,
+               level.keeping_up ? "" : " (falling behind)");
+  }
+  LogMessage("  Highest write rate the listener kept up with: %d/s",
+             result.max_sustained_rate);
+}
+
+}  // namespace firestore_testapp
@@ -0,0 +1,174 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_SNAPSHOT_LISTENER_BENCHMARK_H_  // NOLINT
+#define FIREBASE_TESTAPP_SNAPSHOT_LISTENER_BENCHMARK_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "firebase/firestore.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "test_event_listener.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+namespace firestore_testapp {
+
+// Field holding the sequence number of the write that last set a document.
+extern const char kSequenceField[];
+
+// A QuerySnapshot listener that times the delivery of writes tagged with
+// kSequenceField. Call MarkWrite() just before issuing each write, and
+// attach it with MetadataChanges::kInclude so that it also receives the
+// snapshot in which the server acknowledges a write.
+//
+// For each write the listener records two latencies: until the write first
+// appears in a snapshot with pending writes (latency compensation, the
+// local view), and until it appears without pending writes (the server
+// acknowledged it).
+class QuerySnapshotTimer
+    : public TestEventListener<firebase::firestore::QuerySnapshot> {
+ public:
+  // Writes are numbered 0 to `max_writes` - 1.
+  QuerySnapshotTimer(std::string name, int max_writes);
+
+  void MarkWrite(int sequence);
+
+  void OnEvent(const firebase::firestore::QuerySnapshot& snapshot,
+               const firebase::firestore::Error error) override;
+
+  // Signaled once for each write seen locally and each write acknowledged.
+  const app_framework::EventCounter& local_writes() const {
+    return local_writes_;
+  }
+  const app_framework::EventCounter& acknowledged_writes() const {
+    return acknowledged_writes_;
+  }
+  const app_framework::LatencyHistogram& local_latency() const {
+    return local_latency_;
+  }
+  const app_framework::LatencyHistogram& acknowledged_latency() const {
+    return acknowledged_latency_;
+  }
+  // Time the last snapshot was received.
+  int64_t last_snapshot_us() const { return last_snapshot_us_.load(); }
+
+ private:
+  std::vector<std::atomic<int64_t>> write_us_;
+  std::vector<std::atomic<bool>> seen_locally_;
+  std::vector<std::atomic<bool>> acknowledged_;
+  app_framework::EventCounter local_writes_;
+  app_framework::EventCounter acknowledged_writes_;
+  app_framework::LatencyHistogram local_latency_;
+  app_framework::LatencyHistogram acknowledged_latency_;
+  std::atomic<int64_t> last_snapshot_us_;
+};
+
+// Configuration of RunSnapshotListenerBenchmark().
+struct SnapshotListenerBenchmarkOptions {
+  SnapshotListenerBenchmarkOptions()
+      : document_count(20),
+        latency_writes(50),
+        level_duration_ms(2000),
+        max_lag_ms(100),
+        timeout_ms(10000) {
+    write_rates.push_back(50);
+    write_rates.push_back(100);
+    write_rates.push_back(200);
+    write_rates.push_back(400);
+    write_rates.push_back(800);
+  }
+
+  // Documents in the collection, written in turn.
+  int document_count;
+  // Writes issued one at a time, each after the previous was acknowledged,
+  // to measure latency without contention.
+  int latency_writes;
+  // Writes per second offered to the listener, each for level_duration_ms.
+  std::vector<int> write_rates;
+  int level_duration_ms;
+  // A listener keeps up with a rate if it sees every write locally with a
+  // 99th percentile latency of at most max_lag_ms.
+  int max_lag_ms;
+  // Time to wait for outstanding writes and snapshots.
+  int timeout_ms;
+};
+
+// Measurements of one write rate.
+struct SnapshotThroughputResult {
+  SnapshotThroughputResult()
+      : offered_rate(0),
+        writes(0),
+        seen(0),
+        snapshots(0),
+        elapsed_us(0),
+        local_p50_us(0),
+        local_p99_us(0),
+        keeping_up(false) {}
+
+  int offered_rate;
+  int writes;
+  // Writes that reached the listener. Snapshots may cover several writes.
+  int seen;
+  int snapshots;
+  // Time from the first write to the last snapshot.
+  int64_t elapsed_us;
+  int64_t local_p50_us;
+  int64_t local_p99_us;
+  bool keeping_up;
+
+  double snapshots_per_second() const;
+};
+
+// Measurements of RunSnapshotListenerBenchmark().
+struct SnapshotListenerBenchmarkResult {
+  SnapshotListenerBenchmarkResult()
+      : latency_writes(0),
+        local_p50_us(0),
+        local_p99_us(0),
+        acknowledged_p50_us(0),
+        acknowledged_p99_us(0),
+        max_sustained_rate(0) {}
+
+  // Writes acknowledged in the latency phase, and the time until each was
+  // seen locally and acknowledged.
+  int latency_writes;
+  int64_t local_p50_us;
+  int64_t local_p99_us;
+  int64_t acknowledged_p50_us;
+  int64_t acknowledged_p99_us;
+  std::vector<SnapshotThroughputResult> levels;
+  // Highest write rate the listener kept up with, 0 if none.
+  int max_sustained_rate;
+};
+
+// Listen to `collection` with a QuerySnapshotTimer while writing to it,
+// first one write at a time and then at each of options.write_rates, and
+// delete the documents written afterwards.
+SnapshotListenerBenchmarkResult RunSnapshotListenerBenchmark(
+    const firebase::firestore::CollectionReference& collection,
+    const SnapshotListenerBenchmarkOptions& options);
+
+// Log the results of RunSnapshotListenerBenchmark().
+void LogSnapshotListenerBenchmarkResult(
+    const SnapshotListenerBenchmarkResult& result);
+
+}  // namespace firestore_testapp
+
+#endif  // FIREBASE_TESTAPP_SNAPSHOT_LISTENER_BENCHMARK_H_  // NOLINT
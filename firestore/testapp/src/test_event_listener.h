@@ -0,0 +1,92 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_TEST_EVENT_LISTENER_H_  // NOLINT
+#define FIREBASE_TESTAPP_TEST_EVENT_LISTENER_H_  // NOLINT
+
+#include <string>
+#include <utility>
+
+#include "firebase/firestore.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+
+namespace firestore_testapp {
+
+class Countable {
+ public:
+  int event_count() const { return events_.count(); }
+  // Signaled each time an event is received.
+  const app_framework::EventCounter& events() const { return events_; }
+
+ protected:
+  app_framework::EventCounter events_;
+};
+
+template <typename T>
+class TestEventListener : public Countable,
+                          public firebase::firestore::EventListener<T> {
+ public:
+  explicit TestEventListener(std::string name) : name_(std::move(name)) {}
+
+  void OnEvent(const T& value,
+               const firebase::firestore::Error error) override {
+    if (error != firebase::firestore::kOk) {
+      app_framework::LogMessage("ERROR: EventListener %s got %d.",
+                                name_.c_str(), error);
+    }
+    events_.Signal();
+  }
+
+  // Hides the STLPort-related quirk that `AddSnapshotListener` has different
+  // signatures depending on whether `std::function` is available.
+  template <typename U>
+  firebase::firestore::ListenerRegistration AttachTo(U* ref) {
+#if !defined(STLPORT)
+    return ref->AddSnapshotListener(
+        [this](const T& result, firebase::firestore::Error error) {
+          OnEvent(result, error);
+        });
+#else
+    return ref->AddSnapshotListener(this);
+#endif
+  }
+
+  // As above, also delivering snapshots that only change metadata when
+  // `metadata_changes` is MetadataChanges::kInclude.
+  template <typename U>
+  firebase::firestore::ListenerRegistration AttachTo(
+      U* ref, firebase::firestore::MetadataChanges metadata_changes) {
+#if !defined(STLPORT)
+    return ref->AddSnapshotListener(
+        metadata_changes,
+        [this](const T& result, firebase::firestore::Error error) {
+          OnEvent(result, error);
+        });
+#else
+    return ref->AddSnapshotListener(metadata_changes, this);
+#endif
+  }
+
+  const std::string& name() const { return name_; }
+
+ private:
+  std::string name_;
+};
+
+}  // namespace firestore_testapp
+
+#endif  // FIREBASE_TESTAPP_TEST_EVENT_LISTENER_H_  // NOLINT
@@ -0,0 +1,355 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "transaction_runner.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "firebase/firestore.h"
+#include "firebase/future.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+using app_framework::RecordLatency;
+using app_framework::WaitForAll;
+using app_framework::WaitForCompletion;
+
+namespace firestore_testapp {
+
+double TransactionStats::abort_rate() const {
+  return attempts > 0
+             ? static_cast<double>(attempts - transactions_committed) /
+                   attempts
+             : 0.0;
+}
+
+double TransactionStats::retry_fraction() const {
+  return retry_us + work_us > 0
+             ? static_cast<double>(retry_us) / (retry_us + work_us)
+             : 0.0;
+}
+
+double TransactionStats::increments_per_second() const {
+  return elapsed_us > 0 ? increments_committed * 1000000.0 / elapsed_us
+                        : 0.0;
+}
+
+TransactionRunner::TransactionRunner(
+    firebase::firestore::Firestore* firestore,
+    const TransactionRunnerOptions& options)
+    : firestore_(firestore),
+      options_(options),
+      outstanding_increments_(0),
+      start_us_(0) {}
+
+TransactionRunner::~TransactionRunner() { Flush(); }
+
+void TransactionRunner::Run(TransactionFunction function) {
+  Start(std::move(function), 0, std::string());
+}
+
+void TransactionRunner::Increment(
+    const firebase::firestore::DocumentReference& document,
+    const std::string& field, int64_t delta) {
+  outstanding_increments_++;
+  if (!options_.coalesce_increments) {
+    StartIncrement(document, field, delta, 1, std::string());
+    return;
+  }
+  std::string key = document.path() + "#" + field;
+  HeldIncrements& held = held_[key];
+  if (held.in_flight) {
+    // Merged into the transaction started when this one completes.
+    held.delta += delta;
+    held.increments++;
+    return;
+  }
+  held.document = document;
+  held.field = field;
+  held.in_flight = true;
+  StartIncrement(document, field, delta, 1, key);
+}
+
+bool TransactionRunner::WaitForTransaction() {
+  if (in_flight_.empty()) return false;
+  std::vector<firebase::FutureBase> futures;
+  futures.reserve(in_flight_.size());
+  for (size_t i = 0; i < in_flight_.size(); ++i) {
+    futures.push_back(in_flight_[i].future);
+  }
+  int index = app_framework::WaitForAny(futures, options_.timeout_ms);
+  if (index < 0) return false;
+  InFlightTransaction transaction = in_flight_[index];
+  in_flight_.erase(in_flight_.begin() + index);
+  Complete(transaction);
+  return true;
+}
+
+bool TransactionRunner::Flush() {
+  while (WaitForTransaction()) {
+  }
+  if (!in_flight_.empty()) {
+    LogMessage("ERROR: %d transactions still running after %d ms.",
+               in_flight(), options_.timeout_ms);
+  }
+  return in_flight_.empty() && stats_.transactions_failed == 0;
+}
+
+void TransactionRunner::Start(TransactionFunction function, int increments,
+                              const std::string& coalesced_key) {
+  InFlightTransaction transaction;
+  transaction.attempts = std::make_shared<Attempts>();
+  transaction.increments = increments;
+  transaction.coalesced_key = coalesced_key;
+  transaction.issue_us = GetMonotonicTimeInMicroseconds();
+  if (!start_us_) start_us_ = transaction.issue_us;
+  std::shared_ptr<Attempts> attempts = transaction.attempts;
+  transaction.future = firestore_->RunTransaction(
+      [attempts, function](firebase::firestore::Transaction& firestore_txn,
+                           std::string& error_message)
+          -> firebase::firestore::Error {
+        attempts->last_start_us = GetMonotonicTimeInMicroseconds();
+        attempts->count++;
+        return function(firestore_txn, error_message);
+      });
+  in_flight_.push_back(transaction);
+}
+
+void TransactionRunner::StartIncrement(
+    const firebase::firestore::DocumentReference& document,
+    const std::string& field, int64_t delta, int increments,
+    const std::string& coalesced_key) {
+  Start(
+      [document, field, delta](firebase::firestore::Transaction& transaction,
+                               std::string& error_message)
+          -> firebase::firestore::Error {
+        firebase::firestore::Error error = firebase::firestore::kOk;
+        firebase::firestore::DocumentSnapshot snapshot =
+            transaction.Get(document, &error, &error_message);
+        if (error != firebase::firestore::kOk) return error;
+        firebase::firestore::FieldValue current = snapshot.Get(field);
+        int64_t value =
+            current.type() == firebase::firestore::FieldValue::Type::kInteger
+                ? current.integer_value()
+                : 0;
+        transaction.Set(document,
+                        firebase::firestore::MapFieldValue{
+                            {field, firebase::firestore::FieldValue::Integer(
+                                        value + delta)}},
+                        firebase::firestore::SetOptions::Merge());
+        return firebase::firestore::kOk;
+      },
+      increments, coalesced_key);
+}
+
+void TransactionRunner::Complete(const InFlightTransaction& transaction) {
+  int64_t now_us = GetMonotonicTimeInMicroseconds();
+  int64_t latency_us = now_us - transaction.issue_us;
+  int attempts = transaction.attempts->count.load();
+  bool committed = transaction.future.error() == firebase::firestore::kOk;
+  latency_.Record(latency_us);
+  RecordLatency("TransactionRunner transaction", latency_us);
+
+  stats_.attempts += attempts;
+  stats_.max_attempts = std::max(stats_.max_attempts, attempts);
+  if (stats_.attempts_per_transaction.size() <=
+      static_cast<size_t>(attempts)) {
+    stats_.attempts_per_transaction.resize(attempts + 1, 0);
+  }
+  stats_.attempts_per_transaction[attempts]++;
+  stats_.elapsed_us = now_us - start_us_;
+  outstanding_increments_ -= transaction.increments;
+  if (committed) {
+    stats_.transactions_committed++;
+    stats_.increments_committed += transaction.increments;
+    int64_t last_start_us = std::max(
+        transaction.issue_us, transaction.attempts->last_start_us.load());
+    stats_.retry_us += last_start_us - transaction.issue_us;
+    stats_.work_us += now_us - last_start_us;
+  } else {
+    stats_.transactions_failed++;
+    stats_.increments_failed += transaction.increments;
+    stats_.retry_us += latency_us;
+    LogMessage("ERROR: Transaction failed after %d attempts, error: %d (%s)",
+               attempts, transaction.future.error(),
+               transaction.future.error_message());
+  }
+
+  if (transaction.coalesced_key.empty()) return;
+  std::map<std::string, HeldIncrements>::iterator it =
+      held_.find(transaction.coalesced_key);
+  if (it == held_.end()) return;
+  HeldIncrements& held = it->second;
+  if (held.increments == 0) {
+    held_.erase(it);
+    return;
+  }
+  int64_t delta = held.delta;
+  int increments = held.increments;
+  held.delta = 0;
+  held.increments = 0;
+  StartIncrement(held.document, held.field, delta, increments,
+                 transaction.coalesced_key);
+}
+
+namespace {
+
+const char kCounterField[] = "count";
+
+std::string CounterId(int index) {
+  char id[16];
+  snprintf(id, sizeof(id), "c%02d", index);
+  return id;
+}
+
+bool ResetCounters(const firebase::firestore::CollectionReference& collection,
+                   int counter_count, int timeout_ms) {
+  firebase::firestore::CollectionReference counters = collection;
+  std::vector<firebase::FutureBase> futures;
+  for (int i = 0; i < counter_count; ++i) {
+    futures.push_back(counters.Document(CounterId(i))
+                          .Set(firebase::firestore::MapFieldValue{
+                              {kCounterField,
+                               firebase::firestore::FieldValue::Integer(0)}}));
+  }
+  std::vector<app_framework::FutureWaitResult> results =
+      WaitForAll(futures, timeout_ms);
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (results[i].result != app_framework::kWaitResultComplete ||
+        results[i].error != firebase::firestore::kOk) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Sum of the counters, -1 if any couldn't be read.
+int64_t SumCounters(const firebase::firestore::CollectionReference& collection,
+                    int counter_count, int timeout_ms) {
+  firebase::firestore::CollectionReference counters = collection;
+  int64_t sum = 0;
+  for (int i = 0; i < counter_count; ++i) {
+    firebase::Future<firebase::firestore::DocumentSnapshot> future =
+        counters.Document(CounterId(i))
+            .Get(firebase::firestore::Source::kServer);
+    if (!WaitForCompletion(future, "TransactionContention read counter",
+                           timeout_ms) ||
+        !future.result()) {
+      return -1;
+    }
+    sum += future.result()->Get(kCounterField).integer_value();
+  }
+  return sum;
+}
+
+TransactionContentionResult RunLevel(
+    firebase::firestore::Firestore* firestore,
+    const firebase::firestore::CollectionReference& collection, int clients,
+    bool coalesce, const TransactionContentionOptions& options) {
+  TransactionContentionResult result;
+  result.clients = clients;
+  result.coalesced = coalesce;
+  if (!ResetCounters(collection, options.counter_count, options.timeout_ms)) {
+    LogMessage("ERROR: Failed to reset transaction contention counters.");
+    return result;
+  }
+
+  firebase::firestore::CollectionReference counters = collection;
+  TransactionRunnerOptions runner_options;
+  runner_options.coalesce_increments = coalesce;
+  runner_options.timeout_ms = options.timeout_ms;
+  TransactionRunner runner(firestore, runner_options);
+  int issued = 0;
+  while (issued < options.increments_per_level) {
+    // Each client issues its next increment once its last one finished.
+    while (issued < options.increments_per_level &&
+           runner.outstanding_increments() < clients) {
+      runner.Increment(counters.Document(CounterId(issued %
+                                                   options.counter_count)),
+                       kCounterField, 1);
+      issued++;
+    }
+    if (!runner.WaitForTransaction()) break;
+  }
+  runner.Flush();
+
+  result.stats = runner.stats();
+  result.latency_p50_us = runner.latency().Percentile(50.0);
+  result.latency_p99_us = runner.latency().Percentile(99.0);
+  result.counters_match =
+      SumCounters(collection, options.counter_count, options.timeout_ms) ==
+      result.stats.increments_committed;
+  return result;
+}
+
+}  // namespace
+
+std::vector<TransactionContentionResult> RunTransactionContentionBenchmark(
+    firebase::firestore::Firestore* firestore,
+    const firebase::firestore::CollectionReference& collection,
+    const TransactionContentionOptions& options) {
+  std::vector<TransactionContentionResult> results;
+  TransactionContentionOptions level_options = options;
+  level_options.counter_count = std::max(1, options.counter_count);
+  for (size_t i = 0; i < options.client_levels.size(); ++i) {
+    int clients = options.client_levels[i];
+    if (clients <= 0) continue;
+    results.push_back(
+        RunLevel(firestore, collection, clients, false, level_options));
+    results.push_back(
+        RunLevel(firestore, collection, clients, true, level_options));
+  }
+
+  firebase::firestore::CollectionReference counters = collection;
+  std::vector<firebase::FutureBase> deletes;
+  for (int i = 0; i < level_options.counter_count; ++i) {
+    deletes.push_back(counters.Document(CounterId(i)).Delete());
+  }
+  WaitForAll(deletes, options.timeout_ms);
+  return results;
+}
+
+void LogTransactionContentionResults(
+    const std::vector<TransactionContentionResult>& results) {
+  LogMessage("  %7s %9s %12s %8s %8s %6s %7s %7s %8s %8s %8s", "clients",
+             "coalesced", "transactions", "attempts", "max", "failed",
+             "aborts", "retry", "incr/s", "p50 ms", "p99 ms");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const TransactionContentionResult& result = results[i];
+    const TransactionStats& stats = result.stats;
+    LogMessage("  %7d %9s %12d %8lld %8d %6d %6.1f%% %6.1f%% %8.1f %8.1f "
+               "%8.1f%s",
+               result.clients, result.coalesced ? "yes" : "no",
+               stats.transactions_committed + stats.transactions_failed,
+               static_cast<long long>(stats.attempts),  // NOLINT
+               stats.max_attempts, stats.transactions_failed,
+               stats.abort_rate() * 100.0, stats.retry_fraction() * 100.0,
+               stats.increments_per_second(), result.latency_p50_us / 1000.0,
+               result.latency_p99_us / 1000.0,
+               result.counters_match ? "" : " (counters don't match)");
+  }
+}
+
+}  // namespace firestore_testapp
@@ -0,0 +1,237 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_TRANSACTION_RUNNER_H_  // NOLINT
+#define FIREBASE_TESTAPP_TRANSACTION_RUNNER_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "firebase/firestore.h"
+#include "firebase/future.h"
+
+// Thin OS abstraction layer.
+#include "timing.h"  // NOLINT
+
+namespace firestore_testapp {
+
+// Function run by Firestore::RunTransaction(), once per attempt.
+typedef std::function<firebase::firestore::Error(
+    firebase::firestore::Transaction&, std::string&)>
+    TransactionFunction;
+
+// Configuration of a TransactionRunner.
+struct TransactionRunnerOptions {
+  TransactionRunnerOptions() : coalesce_increments(false), timeout_ms(60000) {}
+
+  // Merge increments of the same field of the same document into a single
+  // transaction, and run at most one transaction per field at a time.
+  bool coalesce_increments;
+  // Time to wait for any in-flight transaction to complete.
+  int timeout_ms;
+};
+
+// Counters of a TransactionRunner.
+struct TransactionStats {
+  TransactionStats()
+      : transactions_committed(0),
+        transactions_failed(0),
+        attempts(0),
+        max_attempts(0),
+        increments_committed(0),
+        increments_failed(0),
+        retry_us(0),
+        work_us(0),
+        elapsed_us(0) {}
+
+  int transactions_committed;
+  // Transactions that ran out of attempts or whose function failed.
+  int transactions_failed;
+  // Times a transaction function was run. Every attempt but the one that
+  // committed was aborted, usually because another client wrote a document
+  // the transaction read.
+  int64_t attempts;
+  int max_attempts;
+  // Entry n is the number of transactions that finished after n attempts.
+  std::vector<int> attempts_per_transaction;
+  int64_t increments_committed;
+  int64_t increments_failed;
+  // Time from issuing each transaction to starting its last attempt, which
+  // covers queueing and aborted attempts; the whole time of a transaction
+  // that failed.
+  int64_t retry_us;
+  // Time of the attempts that committed.
+  int64_t work_us;
+  // Time from the first transaction to the last completion.
+  int64_t elapsed_us;
+
+  // Fraction of attempts that didn't commit.
+  double abort_rate() const;
+  // Fraction of the time spent in transactions that went into retries.
+  double retry_fraction() const;
+  double increments_per_second() const;
+};
+
+// Runs Firestore transactions, counting the attempts of each and the time
+// spent retrying them.
+//
+// Firestore retries a transaction whose documents were changed by another
+// client between its reads and its commit, up to a limit, so under
+// contention the attempts of a transaction are the cost of running it.
+// Increment() adds to an integer field in a read-modify-write transaction.
+// With TransactionRunnerOptions::coalesce_increments, increments of a field
+// that's already being written are held and merged into the next
+// transaction, so a hot counter sees one transaction at a time from this
+// client rather than one per increment.
+//
+// All methods must be called from the same thread. Transaction functions
+// run on Firestore's threads.
+class TransactionRunner {
+ public:
+  TransactionRunner(firebase::firestore::Firestore* firestore,
+                    const TransactionRunnerOptions& options);
+  // Waits for every transaction.
+  ~TransactionRunner();
+
+  void Run(TransactionFunction function);
+  void Increment(const firebase::firestore::DocumentReference& document,
+                 const std::string& field, int64_t delta);
+
+  // Wait for any in-flight transaction to complete and start the held
+  // increments it unblocked. Returns false if none is in flight or none
+  // completed in time.
+  bool WaitForTransaction();
+  // Wait for every transaction, including held increments. Returns true if
+  // none has failed since the runner was created.
+  bool Flush();
+
+  int in_flight() const { return static_cast<int>(in_flight_.size()); }
+  // Increments requested and not yet committed or failed.
+  int64_t outstanding_increments() const { return outstanding_increments_; }
+  const TransactionStats& stats() const { return stats_; }
+  // Time from issuing each transaction to its completion.
+  const app_framework::LatencyHistogram& latency() const { return latency_; }
+
+ private:
+  // Written by the transaction function on Firestore's threads.
+  struct Attempts {
+    Attempts() : count(0), last_start_us(0) {}
+
+    std::atomic<int> count;
+    std::atomic<int64_t> last_start_us;
+  };
+
+  struct InFlightTransaction {
+    InFlightTransaction() : issue_us(0), increments(0) {}
+
+    firebase::Future<void> future;
+    std::shared_ptr<Attempts> attempts;
+    int64_t issue_us;
+    // Increments merged into the transaction, and the key of the field they
+    // write if they were coalesced.
+    int increments;
+    std::string coalesced_key;
+  };
+
+  // Increments of one field held while a transaction writes it.
+  struct HeldIncrements {
+    HeldIncrements() : delta(0), increments(0), in_flight(false) {}
+
+    firebase::firestore::DocumentReference document;
+    std::string field;
+    int64_t delta;
+    int increments;
+    bool in_flight;
+  };
+
+  TransactionRunner(const TransactionRunner&) = delete;
+  TransactionRunner& operator=(const TransactionRunner&) = delete;
+
+  void Start(TransactionFunction function, int increments,
+             const std::string& coalesced_key);
+  void StartIncrement(const firebase::firestore::DocumentReference& document,
+                      const std::string& field, int64_t delta, int increments,
+                      const std::string& coalesced_key);
+  void Complete(const InFlightTransaction& transaction);
+
+  firebase::firestore::Firestore* firestore_;
+  TransactionRunnerOptions options_;
+  std::vector<InFlightTransaction> in_flight_;
+  // Keyed by document path and field.
+  std::map<std::string, HeldIncrements> held_;
+  int64_t outstanding_increments_;
+  TransactionStats stats_;
+  app_framework::LatencyHistogram latency_;
+  int64_t start_us_;
+};
+
+// Configuration of RunTransactionContentionBenchmark().
+struct TransactionContentionOptions {
+  TransactionContentionOptions()
+      : counter_count(1), increments_per_level(60), timeout_ms(60000) {
+    client_levels.push_back(1);
+    client_levels.push_back(4);
+    client_levels.push_back(16);
+  }
+
+  // Counter documents the increments are spread over. Fewer counters means
+  // more contention.
+  int counter_count;
+  // Increments kept outstanding at the same time, as if by that many
+  // clients, at each level.
+  std::vector<int> client_levels;
+  int increments_per_level;
+  int timeout_ms;
+};
+
+// Measurements of one level, with or without coalescing.
+struct TransactionContentionResult {
+  TransactionContentionResult()
+      : clients(0),
+        coalesced(false),
+        latency_p50_us(0),
+        latency_p99_us(0),
+        counters_match(false) {}
+
+  int clients;
+  bool coalesced;
+  TransactionStats stats;
+  int64_t latency_p50_us;
+  int64_t latency_p99_us;
+  // Whether the counters add up to the increments committed.
+  bool counters_match;
+};
+
+// Increment options.counter_count counters in `collection` from each
+// options.client_levels entry of concurrent clients, first with a
+// transaction per increment and then coalescing them, resetting the
+// counters before each run and deleting them afterwards.
+std::vector<TransactionContentionResult> RunTransactionContentionBenchmark(
+    firebase::firestore::Firestore* firestore,
+    const firebase::firestore::CollectionReference& collection,
+    const TransactionContentionOptions& options);
+
+// Log a table of the results of RunTransactionContentionBenchmark().
+void LogTransactionContentionResults(
+    const std::vector<TransactionContentionResult>& results);
+
+}  // namespace firestore_testapp
+
+#endif  // FIREBASE_TESTAPP_TRANSACTION_RUNNER_H_  // NOLINT
@@ -19,8 +19,19 @@ const functions = require('firebase-functions');
 const admin = require('firebase-admin');
 admin.initializeApp(functions.config().firebase);
 
+// Whether a call is a warm-up from the testapp, {warmup: true}, sent only to
+// open a connection and start an instance ahead of its first real call.
+function isWarmup(data) {
+  return data !== null && typeof data === 'object' && data.warmup === true;
+}
+
 // Adds two numbers to each other.
 exports.addNumbers = functions.https.onCall((data) => {
+  // Return before doing any work for warm-up calls.
+  if (isWarmup(data)) {
+    return {warmup: true};
+  }
+
   // Numbers passed from the client.
   const firstNumber = data.firstNumber;
   const secondNumber = data.secondNumber;
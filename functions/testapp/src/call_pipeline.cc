@@ -0,0 +1,234 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "call_pipeline.h"  // NOLINT
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "firebase/functions.h"
+#include "firebase/future.h"
+#include "firebase/variant.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+using app_framework::RecordLatency;
+
+namespace functions_testapp {
+
+double CallPipelineStats::calls_per_second() const {
+  return elapsed_us > 0 ? (calls - failed) * 1000000.0 / elapsed_us : 0.0;
+}
+
+double CallPipelineStats::client_us_per_call() const {
+  return calls > 0 ? static_cast<double>(issue_us + completion_us) / calls
+                   : 0.0;
+}
+
+double CallPipelineStats::round_trip_us_per_call() const {
+  return calls > 0 ? static_cast<double>(round_trip_us) / calls : 0.0;
+}
+
+CallPipeline::CallPipeline(
+    const firebase::functions::HttpsCallableReference& callable,
+    int max_in_flight, int timeout_ms)
+    : callable_(callable),
+      max_in_flight_(std::max(1, max_in_flight)),
+      timeout_ms_(timeout_ms),
+      result_handler_(nullptr),
+      result_handler_data_(nullptr),
+      start_us_(0) {
+  in_flight_.reserve(max_in_flight_);
+}
+
+CallPipeline::~CallPipeline() { Flush(); }
+
+bool CallPipeline::Call(const firebase::Variant& request) {
+  while (in_flight() >= max_in_flight_) {
+    if (!WaitForCall()) {
+      LogMessage("ERROR: No call completed within %d ms, not issuing another.",
+                 timeout_ms_);
+      return false;
+    }
+  }
+  InFlightCall call;
+  call.request = &request;
+  int64_t issue_us = GetMonotonicTimeInMicroseconds();
+  if (!start_us_) start_us_ = issue_us;
+  call.future = callable_.Call(request);
+  call.sent_us = GetMonotonicTimeInMicroseconds();
+  stats_.issue_us += call.sent_us - issue_us;
+  stats_.calls++;
+  in_flight_.push_back(call);
+  return true;
+}
+
+bool CallPipeline::Flush() {
+  while (!in_flight_.empty()) {
+    if (!WaitForCall()) {
+      LogMessage("ERROR: %d calls still outstanding after %d ms.", in_flight(),
+                 timeout_ms_);
+      return false;
+    }
+  }
+  return stats_.failed == 0;
+}
+
+bool CallPipeline::WaitForCall() {
+  if (in_flight_.empty()) return false;
+  std::vector<firebase::FutureBase> futures;
+  futures.reserve(in_flight_.size());
+  for (size_t i = 0; i < in_flight_.size(); ++i) {
+    futures.push_back(in_flight_[i].future);
+  }
+  std::vector<app_framework::FutureWaitResult> results;
+  int64_t wait_start_us = GetMonotonicTimeInMicroseconds();
+  if (app_framework::WaitForAny(futures, timeout_ms_, &results) < 0) {
+    return false;
+  }
+  // Handle every call that completed, not just the first, so one wait
+  // frees as many slots as possible.
+  std::vector<InFlightCall> still_in_flight;
+  still_in_flight.reserve(in_flight_.size());
+  for (size_t i = 0; i < in_flight_.size(); ++i) {
+    const InFlightCall& call = in_flight_[i];
+    if (results[i].result != app_framework::kWaitResultComplete) {
+      still_in_flight.push_back(call);
+      continue;
+    }
+    // latency_us is when the call completed relative to the start of the
+    // wait, 0 if it had completed before the wait started.
+    int64_t round_trip_us = wait_start_us - call.sent_us +
+                            std::max<int64_t>(results[i].latency_us, 0);
+    stats_.round_trip_us += round_trip_us;
+    latency_.Record(round_trip_us);
+    RecordLatency("CallPipeline round trip", round_trip_us);
+    if (call.future.error() != firebase::functions::kErrorNone ||
+        !call.future.result()) {
+      stats_.failed++;
+      LogMessage("ERROR: Call failed, error %d: %s", call.future.error(),
+                 call.future.error_message());
+      continue;
+    }
+    int64_t completion_start_us = GetMonotonicTimeInMicroseconds();
+    if (result_handler_) {
+      result_handler_(*call.request, call.future.result()->data(),
+                      result_handler_data_);
+    }
+    stats_.completion_us +=
+        GetMonotonicTimeInMicroseconds() - completion_start_us;
+  }
+  in_flight_.swap(still_in_flight);
+  stats_.elapsed_us = GetMonotonicTimeInMicroseconds() - start_us_;
+  return true;
+}
+
+namespace {
+
+firebase::Variant BuildPayload(int index) {
+  std::map<std::string, firebase::Variant> data;
+  data["firstNumber"] = firebase::Variant(index);
+  data["secondNumber"] = firebase::Variant(index * 7 + 3);
+  return firebase::Variant(data);
+}
+
+// Read the integer `key` of the map `variant`. Returns false if there's none.
+bool GetInteger(const firebase::Variant& variant, const char* key,
+                int64_t* value) {
+  if (!variant.is_map()) return false;
+  std::map<firebase::Variant, firebase::Variant>::const_iterator it =
+      variant.map().find(firebase::Variant::FromMutableString(key));
+  if (it == variant.map().end() || !it->second.is_numeric()) return false;
+  *value = it->second.AsInt64().int64_value();
+  return true;
+}
+
+// Counts results whose sum doesn't match the request.
+void CheckSum(const firebase::Variant& request,
+              const firebase::Variant& result, void* user_data) {
+  int64_t first_number = 0;
+  int64_t second_number = 0;
+  int64_t sum = 0;
+  if (!GetInteger(request, "firstNumber", &first_number) ||
+      !GetInteger(request, "secondNumber", &second_number) ||
+      !GetInteger(result, "operationResult", &sum) ||
+      sum != first_number + second_number) {
+    (*static_cast<int*>(user_data))++;
+  }
+}
+
+}  // namespace
+
+CallPipelineBenchmarkResult RunCallPipelineBenchmark(
+    const firebase::functions::HttpsCallableReference& add_numbers,
+    const CallPipelineBenchmarkOptions& options) {
+  CallPipelineBenchmarkResult result;
+  const int payload_count = std::max(1, options.payload_count);
+
+  // Time building payloads, which is what each call would pay if it built
+  // its own.
+  std::vector<firebase::Variant> payloads;
+  payloads.reserve(payload_count);
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  for (int i = 0; i < payload_count; ++i) {
+    payloads.push_back(BuildPayload(i));
+  }
+  result.build_payload_ns =
+      (GetMonotonicTimeInMicroseconds() - start_us) * 1000.0 / payload_count;
+
+  for (size_t i = 0; i < options.in_flight_levels.size(); ++i) {
+    CallPipelineLevelResult level;
+    level.max_in_flight = std::max(1, options.in_flight_levels[i]);
+    CallPipeline pipeline(add_numbers, level.max_in_flight,
+                          options.timeout_ms);
+    pipeline.set_result_handler(CheckSum, &level.wrong_results);
+    for (int call = 0; call < options.calls_per_level; ++call) {
+      if (!pipeline.Call(payloads[call % payload_count])) break;
+    }
+    pipeline.Flush();
+    level.stats = pipeline.stats();
+    level.p50_us = pipeline.latency().Percentile(50.0);
+    level.p99_us = pipeline.latency().Percentile(99.0);
+    result.levels.push_back(level);
+  }
+  return result;
+}
+
+void LogCallPipelineBenchmarkResult(const CallPipelineBenchmarkResult& result) {
+  LogMessage("  Building a payload: %.0f ns", result.build_payload_ns);
+  LogMessage("  %9s %6s %6s %7s %9s %13s %8s %8s", "in flight", "calls",
+             "failed", "calls/s", "client us", "round trip ms", "p50 ms",
+             "p99 ms");
+  for (size_t i = 0; i < result.levels.size(); ++i) {
+    const CallPipelineLevelResult& level = result.levels[i];
+    LogMessage("  %9d %6d %6d %7.1f %9.1f %13.1f %8.1f %8.1f%s",
+               level.max_in_flight, level.stats.calls, level.stats.failed,
+               level.stats.calls_per_second(),
+               level.stats.client_us_per_call(),
+               level.stats.round_trip_us_per_call() / 1000.0,
+               level.p50_us / 1000.0, level.p99_us / 1000.0,
+               level.wrong_results ? " (wrong results)" : "");
+  }
+}
+
+}  // namespace functions_testapp
@@ -0,0 +1,181 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_CALL_PIPELINE_H_  // NOLINT
+#define FIREBASE_TESTAPP_CALL_PIPELINE_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "firebase/functions.h"
+#include "firebase/future.h"
+#include "firebase/variant.h"
+
+// Thin OS abstraction layer.
+#include "timing.h"  // NOLINT
+
+namespace functions_testapp {
+
+// Counters of a CallPipeline.
+struct CallPipelineStats {
+  CallPipelineStats()
+      : calls(0),
+        failed(0),
+        issue_us(0),
+        round_trip_us(0),
+        completion_us(0),
+        elapsed_us(0) {}
+
+  int calls;
+  int failed;
+  // Time spent in HttpsCallableReference::Call(), which encodes the request
+  // and hands it to the SDK.
+  int64_t issue_us;
+  // Time from Call() returning to the call completing: the network and the
+  // function itself, plus the SDK decoding the response.
+  int64_t round_trip_us;
+  // Time spent by the completion handler reading each result.
+  int64_t completion_us;
+  // Time from the first call to the last completion.
+  int64_t elapsed_us;
+
+  double calls_per_second() const;
+  // Mean time the calling thread spends on each call.
+  double client_us_per_call() const;
+  // Mean time each call spends outside the calling thread.
+  double round_trip_us_per_call() const;
+};
+
+// Invokes one HttpsCallableReference with up to `max_in_flight` calls
+// outstanding, timing the client-side work of each separately from the time
+// it spends on the network and the server.
+//
+// Request payloads are passed by reference, so callers can build each one
+// once and send it any number of times rather than building a Variant per
+// call.
+//
+// All methods must be called from the same thread.
+class CallPipeline {
+ public:
+  // Called with the result of each call that succeeded.
+  typedef void (*ResultHandler)(const firebase::Variant& request,
+                                const firebase::Variant& result,
+                                void* user_data);
+
+  CallPipeline(const firebase::functions::HttpsCallableReference& callable,
+               int max_in_flight, int timeout_ms);
+  // Waits for every call.
+  ~CallPipeline();
+
+  void set_result_handler(ResultHandler handler, void* user_data) {
+    result_handler_ = handler;
+    result_handler_data_ = user_data;
+  }
+
+  // Call the function with `request`, first waiting for an outstanding call
+  // to finish if max_in_flight are. `request` must remain valid until the
+  // call completes. Returns false, without calling the function, if no
+  // outstanding call finished within the timeout.
+  bool Call(const firebase::Variant& request);
+  // Wait for every outstanding call. Returns true if no call has failed
+  // since the pipeline was created.
+  bool Flush();
+
+  int in_flight() const { return static_cast<int>(in_flight_.size()); }
+  const CallPipelineStats& stats() const { return stats_; }
+  // Time from Call() returning to each call completing.
+  const app_framework::LatencyHistogram& latency() const { return latency_; }
+
+ private:
+  struct InFlightCall {
+    InFlightCall() : request(nullptr), sent_us(0) {}
+
+    firebase::Future<firebase::functions::HttpsCallableResult> future;
+    const firebase::Variant* request;
+    int64_t sent_us;
+  };
+
+  CallPipeline(const CallPipeline&) = delete;
+  CallPipeline& operator=(const CallPipeline&) = delete;
+
+  // Wait for any outstanding call to complete and handle its result.
+  bool WaitForCall();
+
+  firebase::functions::HttpsCallableReference callable_;
+  int max_in_flight_;
+  int timeout_ms_;
+  ResultHandler result_handler_;
+  void* result_handler_data_;
+  std::vector<InFlightCall> in_flight_;
+  CallPipelineStats stats_;
+  app_framework::LatencyHistogram latency_;
+  int64_t start_us_;
+};
+
+// Configuration of RunCallPipelineBenchmark().
+struct CallPipelineBenchmarkOptions {
+  CallPipelineBenchmarkOptions()
+      : calls_per_level(200), payload_count(16), timeout_ms(30000) {
+    in_flight_levels.push_back(1);
+    in_flight_levels.push_back(4);
+    in_flight_levels.push_back(16);
+    in_flight_levels.push_back(64);
+  }
+
+  int calls_per_level;
+  // Distinct request payloads, built once and reused for every call.
+  int payload_count;
+  // Values of max_in_flight to measure.
+  std::vector<int> in_flight_levels;
+  int timeout_ms;
+};
+
+// Measurements of one in-flight level.
+struct CallPipelineLevelResult {
+  CallPipelineLevelResult()
+      : max_in_flight(0), wrong_results(0), p50_us(0), p99_us(0) {}
+
+  int max_in_flight;
+  CallPipelineStats stats;
+  // Calls that returned a sum other than the one requested.
+  int wrong_results;
+  // Median and 99th percentile round trip.
+  int64_t p50_us;
+  int64_t p99_us;
+};
+
+// Measurements of RunCallPipelineBenchmark().
+struct CallPipelineBenchmarkResult {
+  CallPipelineBenchmarkResult() : build_payload_ns(0.0) {}
+
+  // Time to build a request payload, which each call that rebuilds its
+  // payload pays on top of CallPipelineStats::client_us_per_call().
+  double build_payload_ns;
+  std::vector<CallPipelineLevelResult> levels;
+};
+
+// Call `add_numbers`, the sample's addNumbers function, calls_per_level
+// times at each in_flight_levels entry through the same reference, checking
+// each sum.
+CallPipelineBenchmarkResult RunCallPipelineBenchmark(
+    const firebase::functions::HttpsCallableReference& add_numbers,
+    const CallPipelineBenchmarkOptions& options);
+
+// Log a table of the results of RunCallPipelineBenchmark().
+void LogCallPipelineBenchmarkResult(const CallPipelineBenchmarkResult& result);
+
+}  // namespace functions_testapp
+
+#endif  // FIREBASE_TESTAPP_CALL_PIPELINE_H_  // NOLINT
@@ -0,0 +1,81 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "callable_warmer.h"  // NOLINT
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "firebase/functions.h"
+#include "firebase/future.h"
+#include "firebase/variant.h"
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+#include "startup.h"  // NOLINT
+
+namespace functions_testapp {
+
+const firebase::Variant& WarmupRequest() {
+  static const firebase::Variant* request = [] {
+    std::map<std::string, firebase::Variant> data;
+    data["warmup"] = firebase::Variant(true);
+    return new firebase::Variant(data);
+  }();
+  return *request;
+}
+
+firebase::Future<firebase::functions::HttpsCallableResult> CallableWarmer::Warm(
+    firebase::functions::Functions* functions, const std::string& name) {
+  std::map<std::string, firebase::functions::HttpsCallableReference>::iterator
+      it = callables_.find(name);
+  if (it == callables_.end()) {
+    it = callables_
+             .insert(std::make_pair(
+                 name, functions->GetHttpsCallable(name.c_str())))
+             .first;
+  }
+  app_framework::LogMessage("Warming up %s.", name.c_str());
+  return it->second.Call(WarmupRequest());
+}
+
+std::vector<int> CallableWarmer::AddToStartup(
+    app_framework::StartupSequence* startup,
+    firebase::functions::Functions** functions,
+    const std::vector<std::string>& names,
+    const std::vector<int>& dependencies) {
+  std::vector<int> steps;
+  for (size_t i = 0; i < names.size(); ++i) {
+    std::string name = names[i];
+    steps.push_back(startup->AddStep(
+        ("Warm up " + name).c_str(),
+        [this, functions, name]() -> firebase::FutureBase {
+          return Warm(*functions, name);
+        },
+        dependencies));
+  }
+  return steps;
+}
+
+firebase::functions::HttpsCallableReference CallableWarmer::GetHttpsCallable(
+    const std::string& name) const {
+  std::map<std::string, firebase::functions::HttpsCallableReference>::
+      const_iterator it = callables_.find(name);
+  return it != callables_.end() ? it->second
+                                : firebase::functions::HttpsCallableReference();
+}
+
+}  // namespace functions_testapp
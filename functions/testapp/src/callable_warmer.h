@@ -0,0 +1,74 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_CALLABLE_WARMER_H_  // NOLINT
+#define FIREBASE_TESTAPP_CALLABLE_WARMER_H_  // NOLINT
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "firebase/functions.h"
+#include "firebase/future.h"
+#include "firebase/variant.h"
+
+// Thin OS abstraction layer.
+#include "startup.h"  // NOLINT
+
+namespace functions_testapp {
+
+// Request of a warm-up call, {"warmup": true}. The sample's functions return
+// as soon as they receive it, see functions/index.js.
+const firebase::Variant& WarmupRequest();
+
+// Gets the reference to each callable an app uses once, and warms each up
+// with a call that does no work, so the first call the app needs doesn't
+// also pay for DNS resolution, the TLS handshake and starting an instance
+// of the function.
+//
+// All methods must be called from the same thread.
+class CallableWarmer {
+ public:
+  CallableWarmer() {}
+
+  // Get the reference to `name` from `functions` and call it with
+  // WarmupRequest(). Returns the Future of the warm-up call.
+  firebase::Future<firebase::functions::HttpsCallableResult> Warm(
+      firebase::functions::Functions* functions, const std::string& name);
+
+  // Add a step to `startup` warming up each of `names` once the steps in
+  // `dependencies` have completed, which must include the step setting
+  // `*functions`. Warm-ups run alongside any other step, such as signing in.
+  // Returns the id of each step, in the order of `names`.
+  std::vector<int> AddToStartup(
+      app_framework::StartupSequence* startup,
+      firebase::functions::Functions** functions,
+      const std::vector<std::string>& names,
+      const std::vector<int>& dependencies);
+
+  // Reference to `name` obtained by Warm(), invalid if it wasn't warmed.
+  firebase::functions::HttpsCallableReference GetHttpsCallable(
+      const std::string& name) const;
+
+ private:
+  CallableWarmer(const CallableWarmer&) = delete;
+  CallableWarmer& operator=(const CallableWarmer&) = delete;
+
+  std::map<std::string, firebase::functions::HttpsCallableReference>
+      callables_;
+};
+
+}  // namespace functions_testapp
+
+#endif  // FIREBASE_TESTAPP_CALLABLE_WARMER_H_  // NOLINT
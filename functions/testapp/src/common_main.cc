@@ -20,6 +20,7 @@
 #include <ctime>
 #include <iostream>
 #include <sstream>
+#include <vector>
 #include "firebase/app.h"
 #include "firebase/auth.h"
 #include "firebase/functions.h"
@@ -28,63 +29,78 @@
 #include "firebase/util.h"
 
 // Thin OS abstraction layer.
+#include "benchmark.h"  // NOLINT
+#include "call_pipeline.h"  // NOLINT
+#include "callable_warmer.h"  // NOLINT
+#include "future_wait.h"  // NOLINT
+#include "id_token_cache.h"  // NOLINT
 #include "main.h"  // NOLINT
+#include "startup.h"  // NOLINT
+#include "timing.h"  // NOLINT
 
-// Wait for a Future to be completed. If the Future returns an error, it will
-// be logged.
-void WaitForCompletion(const firebase::FutureBase& future, const char* name) {
-  while (future.status() == firebase::kFutureStatusPending) {
-    ProcessEvents(100);
-  }
-}
-
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+using app_framework::ProcessEvents;
+using app_framework::WaitForCompletion;
 
 extern "C" int common_main(int argc, const char* argv[]) {
+  // Timeline of the startup, from App creation to the first request.
+  app_framework::StartupSequence startup;
   ::firebase::App* app;
 
 #if defined(__ANDROID__)
-  app = ::firebase::App::Create(GetJniEnv(), GetActivity());
+  app = ::firebase::App::Create(app_framework::GetJniEnv(),
+                                app_framework::GetActivity());
 #else
   app = ::firebase::App::Create();
 #endif  // defined(__ANDROID__)
+  startup.Mark("App::Create");
 
   LogMessage("Initialized Firebase App.");
 
   LogMessage("Initializing Firebase Auth and Cloud Functions.");
 
-  // Use ModuleInitializer to initialize both Auth and Functions, ensuring no
-  // dependencies are missing.
+  // Functions doesn't need Auth to initialize, only to make calls, so the
+  // sign-in step depends on Auth's initialization alone.
   ::firebase::functions::Functions* functions = nullptr;
   ::firebase::auth::Auth* auth = nullptr;
-  void* initialize_targets[] = {&auth, &functions};
 
-  const firebase::ModuleInitializer::InitializerFn initializers[] = {
-      [](::firebase::App* app, void* data) {
+  const int auth_step = startup.AddModule(
+      "Auth", app,
+      [](::firebase::App* app, void* target) {
         LogMessage("Attempt to initialize Firebase Auth.");
-        void** targets = reinterpret_cast<void**>(data);
         ::firebase::InitResult result;
-        *reinterpret_cast<::firebase::auth::Auth**>(targets[0]) =
+        *reinterpret_cast<::firebase::auth::Auth**>(target) =
             ::firebase::auth::Auth::GetAuth(app, &result);
         return result;
       },
-      [](::firebase::App* app, void* data) {
+      &auth);
+  const int functions_step = startup.AddModule(
+      "Cloud Functions", app,
+      [](::firebase::App* app, void* target) {
         LogMessage("Attempt to initialize Cloud Functions.");
-        void** targets = reinterpret_cast<void**>(data);
         ::firebase::InitResult result;
-        *reinterpret_cast<::firebase::functions::Functions**>(targets[1]) =
+        *reinterpret_cast<::firebase::functions::Functions**>(target) =
             ::firebase::functions::Functions::GetInstance(app, &result);
         return result;
-      }};
-
-  ::firebase::ModuleInitializer initializer;
-  initializer.Initialize(app, initialize_targets, initializers,
-                         sizeof(initializers) / sizeof(initializers[0]));
-
-  WaitForCompletion(initializer.InitializeLastResult(), "Initialize");
-
-  if (initializer.InitializeLastResult().error() != 0) {
-    LogMessage("Failed to initialize Firebase libraries: %s",
-               initializer.InitializeLastResult().error_message());
+      },
+      &functions);
+  // Optionally, sign in using Auth before accessing Functions.
+  const int sign_in_step = startup.AddStep(
+      "SignInAnonymously",
+      [&auth]() -> firebase::FutureBase { return auth->SignInAnonymously(); },
+      {auth_step});
+  // Warm up addNumbers as soon as Functions is ready, alongside signing in,
+  // so its first real call finds an open connection and a running instance.
+  // The warm-up call doesn't need the Auth token.
+  functions_testapp::CallableWarmer warmer;
+  const std::vector<int> warm_up_steps = warmer.AddToStartup(
+      &startup, &functions, {"addNumbers"}, {functions_step});
+
+  startup.Run();
+
+  if (!startup.succeeded(auth_step) || !startup.succeeded(functions_step)) {
+    LogMessage("Failed to initialize Firebase libraries.");
     ProcessEvents(2000);
     return 1;
   }
@@ -95,11 +111,8 @@ extern "C" int common_main(int argc, const char* argv[]) {
   // Or when running in an Android emulator:
   //   functions->UseFunctionsEmulator("http://10.0.2.2:5005");
 
-  // Optionally, sign in using Auth before accessing Functions.
   {
-    firebase::Future<firebase::auth::User*> sign_in_future =
-        auth->SignInAnonymously();
-    WaitForCompletion(sign_in_future, "SignInAnonymously");
+    const firebase::FutureBase& sign_in_future = startup.result(sign_in_step);
     if (sign_in_future.error() == firebase::auth::kAuthErrorNone) {
       LogMessage("Auth: Signed in anonymously.");
     } else {
@@ -114,13 +127,21 @@ extern "C" int common_main(int argc, const char* argv[]) {
     }
   }
 
+  // Keep the ID token fresh in the background, so the SDK never has to
+  // refresh it in the middle of a request when it expires.
+  app_framework::IdTokenCache* token_cache =
+      new app_framework::IdTokenCache(auth);
 
   // Create a callable.
   LogMessage("Calling addNumbers");
   firebase::functions::HttpsCallableReference addNumbers;
-  addNumbers = functions->GetHttpsCallable("addNumbers");
+  addNumbers = warmer.GetHttpsCallable("addNumbers");
+  if (!addNumbers.is_valid()) {
+    addNumbers = functions->GetHttpsCallable("addNumbers");
+  }
 
   firebase::Future<firebase::functions::HttpsCallableResult> future;
+  int64_t first_call_start_us = GetMonotonicTimeInMicroseconds();
   {
     std::map<std::string, firebase::Variant> data;
     data["firstNumber"] = firebase::Variant(5);
@@ -128,6 +149,18 @@ extern "C" int common_main(int argc, const char* argv[]) {
     future = addNumbers.Call(firebase::Variant(data));
   }
   WaitForCompletion(future, "Call");
+  int64_t first_call_us =
+      GetMonotonicTimeInMicroseconds() - first_call_start_us;
+  if (startup.succeeded(warm_up_steps[0])) {
+    LogMessage("First call took %.1f ms after a warm-up call of %.1f ms.",
+               first_call_us / 1000.0,
+               startup.duration_us(warm_up_steps[0]) / 1000.0);
+  } else {
+    LogMessage("First call took %.1f ms without a warm-up.",
+               first_call_us / 1000.0);
+  }
+  startup.Mark("First request");
+  startup.LogTimeline();
   if (future.error() != firebase::functions::kErrorNone) {
     LogMessage("FAILED!");
     LogMessage("  Error %d: %s", future.error(), future.error_message());
@@ -145,6 +178,42 @@ extern "C" int common_main(int argc, const char* argv[]) {
     }
   }
 
+  LogMessage("Testing call pipeline.");
+  functions_testapp::CallPipelineBenchmarkResult pipeline_result =
+      functions_testapp::RunCallPipelineBenchmark(
+          addNumbers, functions_testapp::CallPipelineBenchmarkOptions());
+  functions_testapp::LogCallPipelineBenchmarkResult(pipeline_result);
+  if (!pipeline_result.levels.empty()) {
+    LogMessage("First call: %.1f ms, steady state p50: %.1f ms.",
+               first_call_us / 1000.0,
+               pipeline_result.levels[0].p50_us / 1000.0);
+  }
+  for (size_t i = 0; i < pipeline_result.levels.size(); ++i) {
+    const functions_testapp::CallPipelineLevelResult& level =
+        pipeline_result.levels[i];
+    if (level.stats.failed || level.wrong_results) {
+      LogMessage("ERROR: %d calls failed and %d returned the wrong sum with "
+                 "%d in flight.",
+                 level.stats.failed, level.wrong_results, level.max_in_flight);
+    }
+  }
+  LogMessage("Tested call pipeline.");
+
+  app_framework::BenchmarkOptions benchmark_options;
+  if (app_framework::ParseBenchmarkOptions(argc, argv, &benchmark_options)) {
+    LogMessage("Running benchmarks.");
+    std::map<std::string, firebase::Variant> benchmark_data;
+    benchmark_data["firstNumber"] = firebase::Variant(5);
+    benchmark_data["secondNumber"] = firebase::Variant(7);
+    firebase::Variant benchmark_arguments(benchmark_data);
+    app_framework::BenchmarkSuite benchmarks("functions");
+    benchmarks.AddScenario("call_add_numbers", [&]() -> firebase::FutureBase {
+      return addNumbers.Call(benchmark_arguments);
+    });
+    app_framework::RunBenchmarks(&benchmarks, benchmark_options);
+    LogMessage("Ran benchmarks.");
+  }
+
   LogMessage("Shutting down the Functions library.");
   delete functions;
   functions = nullptr;
@@ -156,6 +225,10 @@ extern "C" int common_main(int argc, const char* argv[]) {
     LogMessage("ERROR: Reference is still valid after library shutdown.");
   }
 
+  token_cache->LogStats();
+  delete token_cache;
+  token_cache = nullptr;
+
   LogMessage("Signing out from anonymous account.");
   auth->SignOut();
   LogMessage("Shutting down the Auth library.");
@@ -12,13 +12,43 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <mutex>  // NOLINT
+#include <set>
+#include <string>
+
 #include "firebase/app.h"
 #include "firebase/future.h"
 #include "firebase/messaging.h"
 #include "firebase/util.h"
 
 // Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
 #include "main.h"  // NOLINT
+#include "message_pipeline.h"  // NOLINT
+#include "topic_subscriptions.h"  // NOLINT
+
+using app_framework::LogMessage;
+using app_framework::ProcessEvents;
+
+// Whether to hand received messages to a MessagePipeline, which handles them
+// on worker threads as soon as they arrive, rather than polling them from a
+// PollableListener on the main thread. Either way every field of each message
+// is logged.
+static const bool kUseMessagePipeline = true;
+// Threads handling messages in the pipeline.
+static const int kMessagePipelineWorkers = 2;
+// Held while logging a message, so the fields of messages handled by
+// different workers aren't interleaved.
+static std::mutex g_log_message_mutex;
+
+// Topics the testapp subscribes to, as an app would from its user's settings.
+static const char* kTopics[] = {
+    "TestTopic",       "TestTopic_news",   "TestTopic_sports",
+    "TestTopic_music", "TestTopic_movies", "TestTopic_weather",
+};
+// File in app_framework::PathForResource() holding the topics subscribed to
+// by previous runs of the testapp.
+static const char kTopicStateFile[] = "messaging_topics.txt";
 
 // Don't return until `future` is complete.
 // Print a message for whether the result mathes our expectations.
@@ -34,8 +64,9 @@ static bool WaitForFuture(const ::firebase::FutureBase& future, const char* fn,
 
   // Wait for future to complete.
   LogMessage("  %s...", fn);
-  while (future.status() == ::firebase::kFutureStatusPending) {
-    if (ProcessEvents(100)) return true;
+  if (app_framework::WaitForFuture(future) ==
+      app_framework::kWaitResultExitRequested) {
+    return true;
   }
 
   // Log error result.
@@ -58,13 +89,81 @@ static bool WaitForFuture(const ::firebase::FutureBase& future, const char* fn,
   return false;
 }
 
+// Log every field of `message`.
+static void LogReceivedMessage(const ::firebase::messaging::Message& message) {
+  LogMessage("Received a new message");
+  LogMessage("This message was %s by the user",
+             message.notification_opened ? "opened" : "not opened");
+  if (!message.from.empty()) LogMessage("from: %s", message.from.c_str());
+  if (!message.error.empty())
+    LogMessage("error: %s", message.error.c_str());
+  if (!message.message_id.empty()) {
+    LogMessage("message_id: %s", message.message_id.c_str());
+  }
+  if (!message.link.empty()) {
+    LogMessage("  link: %s", message.link.c_str());
+  }
+  if (!message.data.empty()) {
+    LogMessage("data:");
+    for (const auto& field : message.data) {
+      LogMessage("  %s: %s", field.first.c_str(), field.second.c_str());
+    }
+  }
+  if (message.notification) {
+    LogMessage("notification:");
+    if (message.notification->android) {
+      LogMessage("  android:");
+      LogMessage("    channel_id: %s",
+                 message.notification->android->channel_id.c_str());
+    }
+    if (!message.notification->title.empty()) {
+      LogMessage("  title: %s", message.notification->title.c_str());
+    }
+    if (!message.notification->body.empty()) {
+      LogMessage("  body: %s", message.notification->body.c_str());
+    }
+    if (!message.notification->icon.empty()) {
+      LogMessage("  icon: %s", message.notification->icon.c_str());
+    }
+    if (!message.notification->tag.empty()) {
+      LogMessage("  tag: %s", message.notification->tag.c_str());
+    }
+    if (!message.notification->color.empty()) {
+      LogMessage("  color: %s", message.notification->color.c_str());
+    }
+    if (!message.notification->sound.empty()) {
+      LogMessage("  sound: %s", message.notification->sound.c_str());
+    }
+    if (!message.notification->click_action.empty()) {
+      LogMessage("  click_action: %s",
+                 message.notification->click_action.c_str());
+    }
+  }
+}
+
+// Called by the MessagePipeline's workers with each message.
+static void HandleMessage(messaging_testapp::MessagePtr message) {
+  std::lock_guard<std::mutex> lock(g_log_message_mutex);
+  LogReceivedMessage(*message);
+}
+
 // Execute all methods of the C++ Firebase Cloud Messaging API.
 extern "C" int common_main(int argc, const char* argv[]) {
   ::firebase::App* app;
-  ::firebase::messaging::PollableListener listener;
+  ::firebase::messaging::PollableListener poll_listener;
+  messaging_testapp::MessagePipelineOptions pipeline_options;
+  pipeline_options.worker_count = kMessagePipelineWorkers;
+  messaging_testapp::MessagePipeline pipeline(pipeline_options, HandleMessage);
+  ::firebase::messaging::Listener* listener = &poll_listener;
+  if (kUseMessagePipeline) {
+    LogMessage("Handling messages with %d workers.", kMessagePipelineWorkers);
+    pipeline.Start();
+    listener = &pipeline;
+  }
 
 #if defined(__ANDROID__)
-  app = ::firebase::App::Create(GetJniEnv(), GetActivity());
+  app = ::firebase::App::Create(app_framework::GetJniEnv(),
+                                app_framework::GetActivity());
 #else
   app = ::firebase::App::Create();
 #endif  // defined(__ANDROID__)
@@ -75,10 +174,10 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
   ::firebase::ModuleInitializer initializer;
   initializer.Initialize(
-      app, &listener, [](::firebase::App* app, void* userdata) {
+      app, listener, [](::firebase::App* app, void* userdata) {
         LogMessage("Try to initialize Firebase Messaging");
-        ::firebase::messaging::PollableListener* listener =
-            static_cast<::firebase::messaging::PollableListener*>(userdata);
+        ::firebase::messaging::Listener* listener =
+            static_cast<::firebase::messaging::Listener*>(userdata);
         firebase::messaging::MessagingOptions options;
         // Prevent the app from requesting permission to show notifications
         // immediately upon starting up. Since it the prompt is being
@@ -89,9 +188,9 @@ extern "C" int common_main(int argc, const char* argv[]) {
         return ::firebase::messaging::Initialize(*app, listener, options);
       });
 
-  while (initializer.InitializeLastResult().status() !=
-         firebase::kFutureStatusComplete) {
-    if (ProcessEvents(100)) return 1;  // exit if requested
+  if (app_framework::WaitForFuture(initializer.InitializeLastResult()) ==
+      app_framework::kWaitResultExitRequested) {
+    return 1;  // exit if requested
   }
   if (initializer.InitializeLastResult().error() != 0) {
     LogMessage("Failed to initialize Firebase Messaging: %s",
@@ -108,9 +207,7 @@ extern "C" int common_main(int argc, const char* argv[]) {
   // changed in the OS settings).
   ::firebase::Future<void> result = ::firebase::messaging::RequestPermission();
   LogMessage("Display permission prompt if necessary.");
-  while (result.status() == ::firebase::kFutureStatusPending) {
-    ProcessEvents(100);
-  }
+  app_framework::WaitForFuture(result);
   if (result.error() ==
       ::firebase::messaging::kErrorFailedToRegisterForRemoteNotifications) {
     LogMessage("Error registering for remote notifications.");
@@ -118,10 +215,15 @@ extern "C" int common_main(int argc, const char* argv[]) {
     LogMessage("Finished checking for permission.");
   }
 
-  // Subscribe to topics.
-  WaitForFuture(::firebase::messaging::Subscribe("TestTopic"),
-                "::firebase::messaging::Subscribe(\"TestTopic\")",
-                ::firebase::messaging::kErrorNone);
+  // Subscribe to topics. Only topics that changed since the previous run are
+  // requested, concurrently.
+  LogMessage("Sync topic subscriptions.");
+  {
+    messaging_testapp::TopicSubscriptions subscriptions(kTopicStateFile);
+    std::set<std::string> desired(
+        kTopics, kTopics + sizeof(kTopics) / sizeof(kTopics[0]));
+    messaging_testapp::LogTopicSyncResult(subscriptions.Sync(desired));
+  }
   WaitForFuture(::firebase::messaging::Subscribe("!@#$%^&*()"),
                 "::firebase::messaging::Subscribe(\"!@#$%^&*()\")",
                 ::firebase::messaging::kErrorInvalidTopicName);
@@ -129,66 +231,24 @@ extern "C" int common_main(int argc, const char* argv[]) {
   bool done = false;
   while (!done) {
     std::string token;
-    if (listener.PollRegistrationToken(&token)) {
+    if (kUseMessagePipeline ? pipeline.PollRegistrationToken(&token)
+                            : poll_listener.PollRegistrationToken(&token)) {
       LogMessage("Received Registration Token: %s", token.c_str());
     }
 
     ::firebase::messaging::Message message;
-    while (listener.PollMessage(&message)) {
-      LogMessage("Received a new message");
-      LogMessage("This message was %s by the user",
-                 message.notification_opened ? "opened" : "not opened");
-      if (!message.from.empty()) LogMessage("from: %s", message.from.c_str());
-      if (!message.error.empty())
-        LogMessage("error: %s", message.error.c_str());
-      if (!message.message_id.empty()) {
-        LogMessage("message_id: %s", message.message_id.c_str());
-      }
-      if (!message.link.empty()) {
-        LogMessage("  link: %s", message.link.c_str());
-      }
-      if (!message.data.empty()) {
-        LogMessage("data:");
-        for (const auto& field : message.data) {
-          LogMessage("  %s: %s", field.first.c_str(), field.second.c_str());
-        }
-      }
-      if (message.notification) {
-        LogMessage("notification:");
-        if (message.notification->android) {
-          LogMessage("  android:");
-          LogMessage("    channel_id: %s",
-                     message.notification->android->channel_id.c_str());
-        }
-        if (!message.notification->title.empty()) {
-          LogMessage("  title: %s", message.notification->title.c_str());
-        }
-        if (!message.notification->body.empty()) {
-          LogMessage("  body: %s", message.notification->body.c_str());
-        }
-        if (!message.notification->icon.empty()) {
-          LogMessage("  icon: %s", message.notification->icon.c_str());
-        }
-        if (!message.notification->tag.empty()) {
-          LogMessage("  tag: %s", message.notification->tag.c_str());
-        }
-        if (!message.notification->color.empty()) {
-          LogMessage("  color: %s", message.notification->color.c_str());
-        }
-        if (!message.notification->sound.empty()) {
-          LogMessage("  sound: %s", message.notification->sound.c_str());
-        }
-        if (!message.notification->click_action.empty()) {
-          LogMessage("  click_action: %s",
-                     message.notification->click_action.c_str());
-        }
-      }
+    while (poll_listener.PollMessage(&message)) {
+      LogReceivedMessage(message);
     }
     // Process events so that the client doesn't hang.
     done = ProcessEvents(1000);
   }
 
   ::firebase::messaging::Terminate();
+  if (kUseMessagePipeline) {
+    pipeline.Stop();
+    pipeline.LogStats();
+  }
   delete app;
 
   return 0;
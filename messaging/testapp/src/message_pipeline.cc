@@ -0,0 +1,168 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "message_pipeline.h"  // NOLINT
+
+#include <stdint.h>
+
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+
+#include "firebase/messaging.h"
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+
+namespace messaging_testapp {
+
+MessagePipeline::MessagePipeline(const MessagePipelineOptions& options,
+                                 MessageHandler handler)
+    : options_(options),
+      handler_(std::move(handler)),
+      running_workers_(0),
+      stopping_(false),
+      has_token_(false),
+      first_received_us_(0),
+      last_handled_us_(0) {}
+
+MessagePipeline::~MessagePipeline() { Stop(); }
+
+void MessagePipeline::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_workers_ > 0) return;
+  stopping_ = false;
+  for (int i = 0; i < options_.worker_count; ++i) {
+    running_workers_++;
+    app_framework::RunOnBackgroundThread(RunThread, this);
+  }
+}
+
+void MessagePipeline::Stop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  stopping_ = true;
+  not_empty_.notify_all();
+  while (running_workers_ > 0) not_full_.wait(lock);
+}
+
+bool MessagePipeline::PollRegistrationToken(std::string* token) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!has_token_) return false;
+  *token = token_;
+  has_token_ = false;
+  return true;
+}
+
+MessagePipelineStats MessagePipeline::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  MessagePipelineStats stats = stats_;
+  int64_t elapsed_us = last_handled_us_ - first_received_us_;
+  if (stats.handled > 0 && elapsed_us > 0) {
+    stats.messages_per_second = stats.handled * 1000000.0 / elapsed_us;
+  }
+  return stats;
+}
+
+void MessagePipeline::LogStats() const {
+  MessagePipelineStats counters = stats();
+  LogMessage(
+      "Message pipeline: %llu received, %llu handled, %llu dropped, "
+      "%llu stalled, at most %llu queued.",
+      static_cast<unsigned long long>(counters.received),    // NOLINT
+      static_cast<unsigned long long>(counters.handled),     // NOLINT
+      static_cast<unsigned long long>(counters.dropped),     // NOLINT
+      static_cast<unsigned long long>(counters.stalls),      // NOLINT
+      static_cast<unsigned long long>(counters.max_depth));  // NOLINT
+  if (counters.handled == 0) return;
+  LogMessage("  %.1f messages/s", counters.messages_per_second);
+  LogMessage("  Received to handled p50 %.1f ms, p99 %.1f ms.",
+             handled_latency_.Percentile(50.0) / 1000.0,
+             handled_latency_.Percentile(99.0) / 1000.0);
+  if (delivery_latency_.count() > 0) {
+    LogMessage("  Sent to handled p50 %.1f ms, p99 %.1f ms.",
+               delivery_latency_.Percentile(50.0) / 1000.0,
+               delivery_latency_.Percentile(99.0) / 1000.0);
+  }
+}
+
+void MessagePipeline::OnMessage(const firebase::messaging::Message& message) {
+  // The only copy of the message, made before taking the lock.
+  QueuedMessage queued;
+  queued.message.reset(new firebase::messaging::Message(message));
+  queued.received_us = GetMonotonicTimeInMicroseconds();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!stopping_ && running_workers_ > 0 &&
+      queue_.size() >= options_.queue_capacity) {
+    stats_.stalls++;
+    not_full_.wait(lock, [this]() {
+      return queue_.size() < options_.queue_capacity || stopping_;
+    });
+  }
+  if (stopping_ || running_workers_ == 0) {
+    stats_.dropped++;
+    return;
+  }
+  if (stats_.received == 0) first_received_us_ = queued.received_us;
+  stats_.received++;
+  queue_.push_back(std::move(queued));
+  if (queue_.size() > stats_.max_depth) stats_.max_depth = queue_.size();
+  not_empty_.notify_one();
+}
+
+void MessagePipeline::OnTokenReceived(const char* token) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  token_ = token;
+  has_token_ = true;
+}
+
+void* MessagePipeline::RunThread(void* data) {
+  static_cast<MessagePipeline*>(data)->Run();
+  return nullptr;
+}
+
+void MessagePipeline::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    not_empty_.wait(lock, [this]() { return !queue_.empty() || stopping_; });
+    // Once stopping, exit only after the queue is drained.
+    if (queue_.empty()) break;
+    QueuedMessage queued = std::move(queue_.front());
+    queue_.pop_front();
+    // Wake both a stalled OnMessage() and Stop(), which share not_full_.
+    not_full_.notify_all();
+    lock.unlock();
+
+    int64_t sent_time_ms = queued.message->sent_time;
+    handler_(std::move(queued.message));
+    int64_t handled_us = GetMonotonicTimeInMicroseconds();
+    handled_latency_.Record(handled_us - queued.received_us);
+    if (sent_time_ms > 0) {
+      delivery_latency_.Record(app_framework::GetCurrentTimeInMicroseconds() -
+                               sent_time_ms * 1000);
+    }
+
+    lock.lock();
+    stats_.handled++;
+    last_handled_us_ = handled_us;
+  }
+  running_workers_--;
+  not_full_.notify_all();
+}
+
+}  // namespace messaging_testapp
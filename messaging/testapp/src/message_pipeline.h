@@ -0,0 +1,155 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_MESSAGE_PIPELINE_H_  // NOLINT
+#define FIREBASE_TESTAPP_MESSAGE_PIPELINE_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+
+#include "firebase/messaging.h"
+
+// Thin OS abstraction layer.
+#include "timing.h"  // NOLINT
+
+namespace messaging_testapp {
+
+// Messages are owned through a pointer from the moment they are received, so
+// handing one to a worker moves the pointer rather than copying its strings
+// and data map.
+typedef std::unique_ptr<firebase::messaging::Message> MessagePtr;
+
+// Called on a worker thread with each received message.
+typedef std::function<void(MessagePtr message)> MessageHandler;
+
+// Configuration of a MessagePipeline.
+struct MessagePipelineOptions {
+  MessagePipelineOptions() : worker_count(2), queue_capacity(256) {}
+
+  // Threads handling messages.
+  int worker_count;
+  // Most messages waiting for a worker. When the queue is full the SDK
+  // thread delivering messages waits for a worker to take one.
+  size_t queue_capacity;
+};
+
+// Counters of a MessagePipeline.
+struct MessagePipelineStats {
+  MessagePipelineStats()
+      : received(0),
+        handled(0),
+        dropped(0),
+        stalls(0),
+        max_depth(0),
+        messages_per_second(0.0) {}
+
+  uint64_t received;
+  uint64_t handled;
+  // Messages received after Stop().
+  uint64_t dropped;
+  // Messages that waited for room in the queue.
+  uint64_t stalls;
+  // Most messages waiting at once.
+  size_t max_depth;
+  // Messages handled per second, from the first message received to the last
+  // one handled.
+  double messages_per_second;
+};
+
+// A Listener that hands each message to a pool of worker threads through a
+// bounded queue as soon as the SDK delivers it, rather than leaving it in a
+// PollableListener until the main loop next polls. A burst of data messages,
+// such as after a topic broadcast, is then handled in parallel instead of
+// backing up on the main thread.
+//
+// Registration tokens are kept for the main loop to poll, as with
+// PollableListener.
+class MessagePipeline : public firebase::messaging::Listener {
+ public:
+  MessagePipeline(const MessagePipelineOptions& options,
+                  MessageHandler handler);
+  // Stops the workers.
+  ~MessagePipeline() override;
+
+  // Start the worker threads.
+  void Start();
+  // Wait for the workers to handle every queued message and exit. Call after
+  // messaging::Terminate(), so no more messages are delivered.
+  void Stop();
+
+  // Same as PollableListener::PollRegistrationToken().
+  bool PollRegistrationToken(std::string* token);
+
+  MessagePipelineStats stats() const;
+  // Time from OnMessage() until the handler returns.
+  const app_framework::LatencyHistogram& handled_latency() const {
+    return handled_latency_;
+  }
+  // Time from Message::sent_time until the handler returns. The sent time is
+  // from the server's clock, so this is only as accurate as the device's
+  // clock.
+  const app_framework::LatencyHistogram& delivery_latency() const {
+    return delivery_latency_;
+  }
+  // Log the counters and latencies.
+  void LogStats() const;
+
+  // firebase::messaging::Listener
+  void OnMessage(const firebase::messaging::Message& message) override;
+  void OnTokenReceived(const char* token) override;
+
+ private:
+  struct QueuedMessage {
+    MessagePtr message;
+    // When OnMessage() was called.
+    int64_t received_us;
+  };
+
+  MessagePipeline(const MessagePipeline&) = delete;
+  MessagePipeline& operator=(const MessagePipeline&) = delete;
+
+  static void* RunThread(void* data);
+  void Run();
+
+  MessagePipelineOptions options_;
+  MessageHandler handler_;
+
+  mutable std::mutex mutex_;
+  // Signaled when a message is queued, or the pipeline stops.
+  std::condition_variable not_empty_;
+  // Signaled when a worker takes a message, or exits.
+  std::condition_variable not_full_;
+  std::deque<QueuedMessage> queue_;
+  int running_workers_;
+  bool stopping_;
+  std::string token_;
+  bool has_token_;
+  MessagePipelineStats stats_;
+  int64_t first_received_us_;
+  int64_t last_handled_us_;
+
+  app_framework::LatencyHistogram handled_latency_;
+  app_framework::LatencyHistogram delivery_latency_;
+};
+
+}  // namespace messaging_testapp
+
+#endif  // FIREBASE_TESTAPP_MESSAGE_PIPELINE_H_  // NOLINT
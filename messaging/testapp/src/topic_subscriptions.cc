@@ -0,0 +1,194 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "topic_subscriptions.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "firebase/future.h"
+#include "firebase/messaging.h"
+
+// Thin OS abstraction layer.
+#include "file_util.h"  // NOLINT
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+
+namespace messaging = ::firebase::messaging;
+
+namespace messaging_testapp {
+
+namespace {
+
+// A Subscribe() or Unsubscribe() request.
+struct TopicRequest {
+  std::string topic;
+  bool subscribe;
+  firebase::Future<void> future;
+  int64_t start_us;
+};
+
+}  // namespace
+
+TopicSubscriptions::TopicSubscriptions(
+    const char* state_name, const TopicSubscriptionsOptions& options)
+    : state_path_(app_framework::PathForResource() + state_name),
+      options_(options) {
+  // Otherwise Sync() could never issue a request.
+  options_.max_concurrent_requests =
+      std::max(1, options_.max_concurrent_requests);
+  Load();
+}
+
+TopicSyncResult TopicSubscriptions::Sync(const std::set<std::string>& desired) {
+  TopicSyncResult result;
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+
+  std::vector<TopicRequest> requests;
+  for (std::set<std::string>::const_iterator it = desired.begin();
+       it != desired.end(); ++it) {
+    if (applied_.count(*it)) {
+      result.unchanged++;
+      continue;
+    }
+    TopicRequest request;
+    request.topic = *it;
+    request.subscribe = true;
+    requests.push_back(request);
+  }
+  for (std::set<std::string>::const_iterator it = applied_.begin();
+       it != applied_.end(); ++it) {
+    if (desired.count(*it)) continue;
+    TopicRequest request;
+    request.topic = *it;
+    request.subscribe = false;
+    requests.push_back(request);
+  }
+
+  // Keep up to max_concurrent_requests in flight, issuing the next request
+  // as soon as one completes.
+  size_t next = 0;
+  std::vector<size_t> in_flight;
+  bool changed = false;
+  while (next < requests.size() || !in_flight.empty()) {
+    while (next < requests.size() &&
+           in_flight.size() <
+               static_cast<size_t>(options_.max_concurrent_requests)) {
+      TopicRequest& request = requests[next];
+      request.start_us = GetMonotonicTimeInMicroseconds();
+      request.future = request.subscribe
+                           ? messaging::Subscribe(request.topic.c_str())
+                           : messaging::Unsubscribe(request.topic.c_str());
+      in_flight.push_back(next++);
+    }
+
+    int64_t remaining_ms =
+        options_.timeout_ms -
+        (GetMonotonicTimeInMicroseconds() - start_us) / 1000;
+    std::vector<firebase::FutureBase> futures;
+    for (size_t i = 0; i < in_flight.size(); ++i) {
+      futures.push_back(requests[in_flight[i]].future);
+    }
+    int64_t wait_start_us = GetMonotonicTimeInMicroseconds();
+    std::vector<app_framework::FutureWaitResult> results;
+    if (remaining_ms <= 0 ||
+        app_framework::WaitForAny(futures, static_cast<int>(remaining_ms),
+                                  &results) < 0) {
+      break;
+    }
+
+    // Several requests may have completed during the wait. Each is timed to
+    // when its Future completed rather than to when it's processed here.
+    std::vector<size_t> still_in_flight;
+    for (size_t i = 0; i < in_flight.size(); ++i) {
+      const TopicRequest& request = requests[in_flight[i]];
+      if (request.future.status() == firebase::kFutureStatusPending) {
+        still_in_flight.push_back(in_flight[i]);
+        continue;
+      }
+      app_framework::RecordLatency(
+          request.subscribe ? "Messaging Subscribe" : "Messaging Unsubscribe",
+          results[i].latency_us >= 0
+              ? wait_start_us - request.start_us + results[i].latency_us
+              : GetMonotonicTimeInMicroseconds() - request.start_us);
+      if (request.future.error() != messaging::kErrorNone) {
+        LogMessage("ERROR: %s(\"%s\") failed: %d, `%s`",
+                   request.subscribe ? "Subscribe" : "Unsubscribe",
+                   request.topic.c_str(), request.future.error(),
+                   request.future.error_message());
+        result.failed++;
+      } else if (request.subscribe) {
+        applied_.insert(request.topic);
+        result.subscribed++;
+        changed = true;
+      } else {
+        applied_.erase(request.topic);
+        result.unsubscribed++;
+        changed = true;
+      }
+    }
+    in_flight.swap(still_in_flight);
+  }
+  result.pending = static_cast<int>(requests.size() - next + in_flight.size());
+
+  if (changed && !Save()) {
+    LogMessage("ERROR: Failed to save topic subscriptions to %s",
+               state_path_.c_str());
+  }
+  result.duration_us = GetMonotonicTimeInMicroseconds() - start_us;
+  return result;
+}
+
+bool TopicSubscriptions::Load() {
+  FILE* file = fopen(state_path_.c_str(), "r");
+  if (!file) return false;
+  char line[1024];
+  while (fgets(line, sizeof(line), file)) {
+    std::string topic(line);
+    while (!topic.empty() && (topic.back() == '\n' || topic.back() == '\r')) {
+      topic.erase(topic.size() - 1);
+    }
+    if (!topic.empty()) applied_.insert(topic);
+  }
+  fclose(file);
+  return true;
+}
+
+bool TopicSubscriptions::Save() const {
+  std::string contents;
+  for (std::set<std::string>::const_iterator it = applied_.begin();
+       it != applied_.end(); ++it) {
+    contents += *it + "\n";
+  }
+  return app_framework::WriteFileReplacing(state_path_, contents);
+}
+
+void LogTopicSyncResult(const TopicSyncResult& result) {
+  LogMessage(
+      "Synced topics in %.1f ms: %d subscribed, %d unsubscribed, "
+      "%d unchanged, %d failed, %d pending.",
+      result.duration_us / 1000.0, result.subscribed, result.unsubscribed,
+      result.unchanged, result.failed, result.pending);
+}
+
+}  // namespace messaging_testapp
@@ -0,0 +1,103 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_TOPIC_SUBSCRIPTIONS_H_  // NOLINT
+#define FIREBASE_TESTAPP_TOPIC_SUBSCRIPTIONS_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <set>
+#include <string>
+
+namespace messaging_testapp {
+
+// Configuration of a TopicSubscriptions.
+struct TopicSubscriptionsOptions {
+  TopicSubscriptionsOptions()
+      : max_concurrent_requests(8), timeout_ms(30000) {}
+
+  // Most Subscribe() / Unsubscribe() requests in flight at once. Values below
+  // 1 are treated as 1.
+  int max_concurrent_requests;
+  // Time allowed for a whole Sync().
+  int timeout_ms;
+};
+
+// Outcome of TopicSubscriptions::Sync().
+struct TopicSyncResult {
+  TopicSyncResult()
+      : subscribed(0),
+        unsubscribed(0),
+        unchanged(0),
+        failed(0),
+        pending(0),
+        duration_us(0) {}
+
+  int subscribed;
+  int unsubscribed;
+  // Desired topics already subscribed to, for which no request was made.
+  int unchanged;
+  // Requests that completed with an error.
+  int failed;
+  // Requests not completed when the timeout expired or the app was asked to
+  // exit. They are retried by the next Sync().
+  int pending;
+  int64_t duration_us;
+};
+
+// Keeps the app's topic subscriptions in line with a desired set of topics.
+//
+// Sync() diffs the desired topics against those already applied, issues the
+// Subscribe() and Unsubscribe() requests for the difference concurrently, up
+// to max_concurrent_requests at a time, and saves the applied set to a file
+// in app_framework::PathForResource(). On the next launch only topics that
+// changed are requested again, rather than every topic, and a change of
+// settings costs as long as the slowest batch of requests rather than the sum
+// of their latencies.
+//
+// Failed requests are not recorded as applied, so they're retried by the next
+// Sync().
+class TopicSubscriptions {
+ public:
+  // Load the applied set from the file called `state_name` in
+  // PathForResource(), if there is one.
+  explicit TopicSubscriptions(const char* state_name,
+                              const TopicSubscriptionsOptions& options =
+                                  TopicSubscriptionsOptions());
+
+  // Subscribe to the topics in `desired` that aren't applied and unsubscribe
+  // from applied topics that aren't in `desired`, blocking until the requests
+  // complete. The applied set is saved when any request succeeds.
+  TopicSyncResult Sync(const std::set<std::string>& desired);
+
+  // Topics subscribed to by this or a previous run of the app.
+  const std::set<std::string>& applied() const { return applied_; }
+
+ private:
+  // Read and write the applied set, one topic per line. Returns false if the
+  // file couldn't be read or written.
+  bool Load();
+  bool Save() const;
+
+  std::string state_path_;
+  TopicSubscriptionsOptions options_;
+  std::set<std::string> applied_;
+};
+
+// Log the counts and duration of `result`.
+void LogTopicSyncResult(const TopicSyncResult& result);
+
+}  // namespace messaging_testapp
+
+#endif  // FIREBASE_TESTAPP_TOPIC_SUBSCRIPTIONS_H_  // NOLINT
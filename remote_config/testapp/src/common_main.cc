@@ -19,8 +19,16 @@
 #include "firebase/util.h"
 
 // Thin OS abstraction layer.
+#include "benchmark.h"  // NOLINT
+#include "config_snapshot.h"  // NOLINT
+#include "fetch_scheduler.h"  // NOLINT
+#include "future_wait.h"  // NOLINT
 #include "main.h"  // NOLINT
 
+using app_framework::LogMessage;
+using app_framework::ProcessEvents;
+using app_framework::WaitForFuture;
+
 // Convert remote_config::ValueSource to a string.
 const char* ValueSourceToString(firebase::remote_config::ValueSource source) {
   static const char* kSourceToString[] = {
@@ -31,6 +39,50 @@ const char* ValueSourceToString(firebase::remote_config::ValueSource source) {
   return kSourceToString[source];
 }
 
+// Time the testapp waits for the first background fetch.
+static const int kFetchTimeoutMs = 60000;
+
+// Number of frames of RunConfigLookupBenchmark().
+static const int kLookupBenchmarkFrames = 10000;
+
+// Cache expiration of the benchmarked fetches, long enough for them to be
+// served from the cache rather than throttled.
+static const uint64_t kBenchmarkCacheExpirationSeconds = 12 * 60 * 60;
+
+// Log the values of `snapshot`, read from the keys registered by
+// common_main().
+static void LogConfigSnapshot(
+    const remote_config_testapp::ConfigSnapshot& snapshot) {
+  const remote_config_testapp::ConfigSchema& schema = snapshot.schema();
+  LogMessage("Config snapshot %d:", static_cast<int>(snapshot.generation()));
+  for (remote_config_testapp::ConfigKey key = 0; key < schema.size(); ++key) {
+    const char* name = schema.name(key).c_str();
+    const char* source = ValueSourceToString(snapshot.source(key));
+    switch (schema.type(key)) {
+      case remote_config_testapp::kConfigValueBoolean:
+        LogMessage("  %s %d %s", name, snapshot.GetBoolean(key) ? 1 : 0,
+                   source);
+        break;
+      case remote_config_testapp::kConfigValueLong:
+        LogMessage("  %s %lld %s", name,
+                   static_cast<long long>(snapshot.GetLong(key)),  // NOLINT
+                   source);
+        break;
+      case remote_config_testapp::kConfigValueDouble:
+        LogMessage("  %s %f %s", name, snapshot.GetDouble(key), source);
+        break;
+      case remote_config_testapp::kConfigValueString:
+        LogMessage("  %s \"%s\" %s", name, snapshot.GetString(key).c_str(),
+                   source);
+        break;
+      case remote_config_testapp::kConfigValueData:
+        LogMessage("  %s %d bytes %s", name,
+                   static_cast<int>(snapshot.GetData(key).size()), source);
+        break;
+    }
+  }
+}
+
 // Execute all methods of the C++ Remote Config API.
 extern "C" int common_main(int argc, const char* argv[]) {
   namespace remote_config = ::firebase::remote_config;
@@ -40,7 +92,8 @@ extern "C" int common_main(int argc, const char* argv[]) {
 
   LogMessage("Initialize the Firebase Remote Config library");
 #if defined(__ANDROID__)
-  app = ::firebase::App::Create(GetJniEnv(), GetActivity());
+  app = ::firebase::App::Create(app_framework::GetJniEnv(),
+                                app_framework::GetActivity());
 #else
   app = ::firebase::App::Create();
 #endif  // defined(__ANDROID__)
@@ -53,9 +106,9 @@ extern "C" int common_main(int argc, const char* argv[]) {
     LogMessage("Try to initialize Remote Config");
     return ::firebase::remote_config::Initialize(*app);
   });
-  while (initializer.InitializeLastResult().status() !=
-         firebase::kFutureStatusComplete) {
-    if (ProcessEvents(100)) return 1;  // exit if requested
+  if (WaitForFuture(initializer.InitializeLastResult()) ==
+      app_framework::kWaitResultExitRequested) {
+    return 1;  // exit if requested
   }
   if (initializer.InitializeLastResult().error() != 0) {
     LogMessage("Failed to initialize Firebase Remote Config: %s",
@@ -81,6 +134,21 @@ extern "C" int common_main(int argc, const char* argv[]) {
   size_t default_count = sizeof(defaults) / sizeof(defaults[0]);
   remote_config::SetDefaults(defaults, default_count);
 
+  // Resolve the keys read on the hot path to handles once, and snapshot
+  // their values so reading them doesn't call into the SDK.
+  remote_config_testapp::ConfigSchema schema;
+  schema.AddKey("TestBoolean", remote_config_testapp::kConfigValueBoolean);
+  schema.AddKey("TestLong", remote_config_testapp::kConfigValueLong);
+  schema.AddKey("TestDouble", remote_config_testapp::kConfigValueDouble);
+  schema.AddKey("TestString", remote_config_testapp::kConfigValueString);
+  schema.AddKey("TestData", remote_config_testapp::kConfigValueData);
+  schema.AddKey("TestDefaultOnly", remote_config_testapp::kConfigValueString);
+  remote_config_testapp::ConfigSnapshotCache config_cache(schema);
+  {
+    remote_config_testapp::ConfigSnapshotCache::Reader config(config_cache);
+    LogConfigSnapshot(*config);
+  }
+
   // The return values may not be the set defaults, if a fetch was previously
   // completed for the app that set them.
   remote_config::ValueInfo value_info;
@@ -149,18 +217,29 @@ extern "C" int common_main(int argc, const char* argv[]) {
   }
 
   // Test Fetch...
+  // Fetch in the background, carrying on with the values activated by a
+  // previous run or the defaults. With developer mode enabled the cache
+  // expires immediately.
   LogMessage("Fetch...");
-  auto future_result = remote_config::Fetch(0);
-  while (future_result.status() == firebase::kFutureStatusPending) {
-    if (ProcessEvents(1000)) {
-      break;
-    }
-  }
+  remote_config_testapp::FetchSchedulerOptions fetch_options;
+  fetch_options.cache_expiration_seconds = 0;
+  remote_config_testapp::FetchScheduler fetch_scheduler(fetch_options);
+  fetch_scheduler.Start();
 
-  if (future_result.status() == firebase::kFutureStatusComplete) {
+  // An app would activate the fetched values at a point where they can
+  // safely change, such as between levels. The testapp waits for them.
+  if (fetch_scheduler.WaitForFetch(kFetchTimeoutMs)) {
     LogMessage("Fetch Complete");
-    bool activate_result = remote_config::ActivateFetched();
+    bool activate_result = fetch_scheduler.Activate();
     LogMessage("ActivateFetched %s", activate_result ? "succeeded" : "failed");
+    // Publish the activated values to readers of the snapshot.
+    config_cache.Update();
+    {
+      remote_config_testapp::ConfigSnapshotCache::Reader config(config_cache);
+      LogConfigSnapshot(*config);
+    }
+    remote_config_testapp::RunConfigLookupBenchmark(config_cache,
+                                                    kLookupBenchmarkFrames);
 
     const remote_config::ConfigInfo& info = remote_config::GetInfo();
     LogMessage(
@@ -228,10 +307,36 @@ extern "C" int common_main(int argc, const char* argv[]) {
   } else {
     LogMessage("Fetch Incomplete");
   }
-  // Release a handle to the future so we can shutdown the Remote Config API
-  // when exiting the app.  Alternatively we could have placed future_result
-  // in a scope different to our shutdown code below.
-  future_result.Release();
+  // Stop fetching, releasing the fetch thread's Future so we can shutdown
+  // the Remote Config API when exiting the app.
+  fetch_scheduler.Stop();
+  {
+    remote_config_testapp::FetchSchedulerStats stats = fetch_scheduler.stats();
+    LogMessage("Fetch scheduler: %d fetches, %d failed (%d throttled), "
+               "%d activations",
+               stats.fetches, stats.failures, stats.throttled,
+               stats.activations);
+  }
+
+  app_framework::BenchmarkOptions benchmark_options;
+  if (app_framework::ParseBenchmarkOptions(argc, argv, &benchmark_options)) {
+    LogMessage("Running benchmarks.");
+    app_framework::BenchmarkSuite benchmarks("remote_config");
+    benchmarks.AddScenario("fetch_cached", []() -> firebase::FutureBase {
+      return remote_config::Fetch(kBenchmarkCacheExpirationSeconds);
+    });
+    // Lookups complete synchronously, so they're reported with no Future.
+    benchmarks.AddScenario("get_string", []() -> firebase::FutureBase {
+      remote_config::GetString("TestString");
+      return firebase::FutureBase();
+    });
+    benchmarks.AddScenario("get_keys", []() -> firebase::FutureBase {
+      remote_config::GetKeys();
+      return firebase::FutureBase();
+    });
+    app_framework::RunBenchmarks(&benchmarks, benchmark_options);
+    LogMessage("Ran benchmarks.");
+  }
 
   // Wait until the user wants to quit the app.
   while (!ProcessEvents(1000)) {
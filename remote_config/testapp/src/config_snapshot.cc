@@ -0,0 +1,199 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "config_snapshot.h"  // NOLINT
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "firebase/remote_config.h"
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+
+namespace remote_config = ::firebase::remote_config;
+
+namespace remote_config_testapp {
+
+ConfigKey ConfigSchema::AddKey(const char* name, ConfigValueType type) {
+  names_.push_back(name);
+  types_.push_back(type);
+  return size() - 1;
+}
+
+ConfigSnapshot::ConfigSnapshot(const ConfigSchema& schema, uint64_t generation)
+    : schema_(schema), generation_(generation), values_(schema.size()) {
+  for (ConfigKey key = 0; key < schema.size(); ++key) {
+    const char* name = schema.name(key).c_str();
+    Value& value = values_[key];
+    remote_config::ValueInfo info;
+    switch (schema.type(key)) {
+      case kConfigValueBoolean:
+        value.boolean_value = remote_config::GetBoolean(name, &info);
+        break;
+      case kConfigValueLong:
+        value.long_value = remote_config::GetLong(name, &info);
+        break;
+      case kConfigValueDouble:
+        value.double_value = remote_config::GetDouble(name, &info);
+        break;
+      case kConfigValueString:
+        value.bytes_index = static_cast<int>(strings_.size());
+        strings_.push_back(remote_config::GetString(name, &info));
+        break;
+      case kConfigValueData:
+        value.bytes_index = static_cast<int>(data_.size());
+        data_.push_back(remote_config::GetData(name, &info));
+        break;
+    }
+    value.source = info.source;
+  }
+}
+
+const std::string& ConfigSnapshot::GetString(ConfigKey key) const {
+  static const std::string* kEmpty = new std::string();
+  const Value& value = values_[key];
+  return schema_.type(key) == kConfigValueString ? strings_[value.bytes_index]
+                                                 : *kEmpty;
+}
+
+const std::vector<unsigned char>& ConfigSnapshot::GetData(
+    ConfigKey key) const {
+  static const std::vector<unsigned char>* kEmpty =
+      new std::vector<unsigned char>();
+  const Value& value = values_[key];
+  return schema_.type(key) == kConfigValueData ? data_[value.bytes_index]
+                                               : *kEmpty;
+}
+
+ConfigSnapshotCache::Reader::Reader(const ConfigSnapshotCache& cache)
+    : cache_(cache) {
+  // Join the current epoch. If Update() flips it in between, leave and join
+  // the new one, so Update() never misses a reader that could see the
+  // snapshot it's about to free.
+  for (;;) {
+    epoch_ = cache_.epoch_.load();
+    cache_.readers_[epoch_].fetch_add(1);
+    if (cache_.epoch_.load() == epoch_) break;
+    cache_.readers_[epoch_].fetch_sub(1);
+  }
+  snapshot_ = cache_.current_.load();
+}
+
+ConfigSnapshotCache::Reader::~Reader() {
+  cache_.readers_[epoch_].fetch_sub(1, std::memory_order_release);
+}
+
+ConfigSnapshotCache::ConfigSnapshotCache(const ConfigSchema& schema)
+    : schema_(schema), current_(new ConfigSnapshot(schema, 0)), epoch_(0) {
+  readers_[0] = 0;
+  readers_[1] = 0;
+}
+
+ConfigSnapshotCache::~ConfigSnapshotCache() { delete current_.load(); }
+
+void ConfigSnapshotCache::Update() {
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  const ConfigSnapshot* previous = current_.load();
+  current_.store(new ConfigSnapshot(schema_, previous->generation() + 1));
+  // Readers that join the new epoch load the new snapshot, so only those of
+  // the previous epoch can still hold `previous`.
+  int previous_epoch = epoch_.load();
+  epoch_.store(1 - previous_epoch);
+  while (readers_[previous_epoch].load(std::memory_order_acquire) != 0) {
+    std::this_thread::yield();
+  }
+  delete previous;
+}
+
+uint64_t ConfigSnapshotCache::generation() const {
+  return current_.load()->generation() + 1;
+}
+
+void RunConfigLookupBenchmark(const ConfigSnapshotCache& cache, int frames) {
+  const ConfigSchema& schema = cache.schema();
+  if (schema.size() == 0 || frames <= 0) return;
+  const int lookups = frames * schema.size();
+
+  // Accumulate what's read so the lookups can't be optimized away.
+  int64_t checksum = 0;
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  for (int frame = 0; frame < frames; ++frame) {
+    ConfigSnapshotCache::Reader config(cache);
+    for (ConfigKey key = 0; key < schema.size(); ++key) {
+      switch (schema.type(key)) {
+        case kConfigValueBoolean:
+          checksum += config->GetBoolean(key);
+          break;
+        case kConfigValueLong:
+          checksum += config->GetLong(key);
+          break;
+        case kConfigValueDouble:
+          checksum += static_cast<int64_t>(config->GetDouble(key));
+          break;
+        case kConfigValueString:
+          checksum += config->GetString(key).size();
+          break;
+        case kConfigValueData:
+          checksum += config->GetData(key).size();
+          break;
+      }
+    }
+  }
+  int64_t snapshot_us = GetMonotonicTimeInMicroseconds() - start_us;
+
+  start_us = GetMonotonicTimeInMicroseconds();
+  for (int frame = 0; frame < frames; ++frame) {
+    for (ConfigKey key = 0; key < schema.size(); ++key) {
+      const char* name = schema.name(key).c_str();
+      switch (schema.type(key)) {
+        case kConfigValueBoolean:
+          checksum -= remote_config::GetBoolean(name);
+          break;
+        case kConfigValueLong:
+          checksum -= remote_config::GetLong(name);
+          break;
+        case kConfigValueDouble:
+          checksum -= static_cast<int64_t>(remote_config::GetDouble(name));
+          break;
+        case kConfigValueString:
+          checksum -= remote_config::GetString(name).size();
+          break;
+        case kConfigValueData:
+          checksum -= remote_config::GetData(name).size();
+          break;
+      }
+    }
+  }
+  int64_t sdk_us = GetMonotonicTimeInMicroseconds() - start_us;
+
+  LogMessage("Config lookups of %d keys over %d frames:", schema.size(),
+             frames);
+  LogMessage("  Snapshot: %.1f ns per lookup", snapshot_us * 1000.0 / lookups);
+  LogMessage("  SDK:      %.1f ns per lookup", sdk_us * 1000.0 / lookups);
+  if (checksum != 0) {
+    LogMessage("ERROR: The snapshot and the SDK returned different values.");
+  }
+}
+
+}  // namespace remote_config_testapp
@@ -0,0 +1,177 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_CONFIG_SNAPSHOT_H_  // NOLINT
+#define FIREBASE_TESTAPP_CONFIG_SNAPSHOT_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "firebase/remote_config.h"
+
+namespace remote_config_testapp {
+
+// Handle of a key registered with a ConfigSchema.
+typedef int ConfigKey;
+
+// Types a key can be read as.
+enum ConfigValueType {
+  kConfigValueBoolean = 0,
+  kConfigValueLong,
+  kConfigValueDouble,
+  kConfigValueString,
+  kConfigValueData,
+};
+
+// The keys an app reads and the type of each, resolved to handles once at
+// startup so lookups don't compare strings.
+class ConfigSchema {
+ public:
+  ConfigSchema() {}
+
+  // Register `name`, read as `type`. Returns its handle.
+  ConfigKey AddKey(const char* name, ConfigValueType type);
+
+  int size() const { return static_cast<int>(names_.size()); }
+  const std::string& name(ConfigKey key) const { return names_[key]; }
+  ConfigValueType type(ConfigKey key) const { return types_[key]; }
+
+ private:
+  std::vector<std::string> names_;
+  std::vector<ConfigValueType> types_;
+};
+
+// Immutable values of every key of a ConfigSchema, read from Remote Config
+// once. Values are stored in one array indexed by ConfigKey, so a lookup is
+// an array access, and strings and data are returned by reference rather
+// than copied.
+//
+// Reading a key as a type other than the one it was registered with returns
+// zero, false or an empty value.
+class ConfigSnapshot {
+ public:
+  // Read every key of `schema` from the active Remote Config values.
+  // `schema` must outlive the snapshot.
+  ConfigSnapshot(const ConfigSchema& schema, uint64_t generation);
+
+  bool GetBoolean(ConfigKey key) const { return values_[key].boolean_value; }
+  int64_t GetLong(ConfigKey key) const { return values_[key].long_value; }
+  double GetDouble(ConfigKey key) const { return values_[key].double_value; }
+  const std::string& GetString(ConfigKey key) const;
+  const std::vector<unsigned char>& GetData(ConfigKey key) const;
+  firebase::remote_config::ValueSource source(ConfigKey key) const {
+    return values_[key].source;
+  }
+
+  const ConfigSchema& schema() const { return schema_; }
+  // Number of the activation the snapshot was built after, starting from 0.
+  uint64_t generation() const { return generation_; }
+
+ private:
+  struct Value {
+    Value()
+        : long_value(0),
+          double_value(0.0),
+          bytes_index(-1),
+          boolean_value(false),
+          source(firebase::remote_config::kValueSourceStaticValue) {}
+
+    int64_t long_value;
+    double double_value;
+    // Index in strings_ or data_ of a string or data key.
+    int bytes_index;
+    bool boolean_value;
+    firebase::remote_config::ValueSource source;
+  };
+
+  ConfigSnapshot(const ConfigSnapshot&) = delete;
+  ConfigSnapshot& operator=(const ConfigSnapshot&) = delete;
+
+  const ConfigSchema& schema_;
+  uint64_t generation_;
+  std::vector<Value> values_;
+  std::vector<std::string> strings_;
+  std::vector<std::vector<unsigned char>> data_;
+};
+
+// Publishes a ConfigSnapshot per activation, read-copy-update style: readers
+// load the current snapshot without locks or allocations while Update()
+// builds its successor, then swaps it in and frees the old one once no
+// reader can still be using it.
+//
+// Readers on any thread pin the current snapshot with a Reader:
+//
+//   ConfigSnapshotCache::Reader config(cache);
+//   if (config->GetBoolean(kShowBanner)) ...
+//
+// A Reader should live for a short time, such as one frame, as Update()
+// waits for the Readers started before it to finish.
+class ConfigSnapshotCache {
+ public:
+  class Reader {
+   public:
+    explicit Reader(const ConfigSnapshotCache& cache);
+    ~Reader();
+
+    const ConfigSnapshot& operator*() const { return *snapshot_; }
+    const ConfigSnapshot* operator->() const { return snapshot_; }
+
+   private:
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    const ConfigSnapshotCache& cache_;
+    int epoch_;
+    const ConfigSnapshot* snapshot_;
+  };
+
+  // Builds the first snapshot from the values active now, which are the
+  // defaults until a fetch is activated. `schema` must outlive the cache.
+  explicit ConfigSnapshotCache(const ConfigSchema& schema);
+  ~ConfigSnapshotCache();
+
+  // Build a snapshot of the active values and publish it. Call after
+  // firebase::remote_config::ActivateFetched(). Updates are serialized.
+  void Update();
+
+  const ConfigSchema& schema() const { return schema_; }
+  // Number of snapshots published, including the first.
+  uint64_t generation() const;
+
+ private:
+  ConfigSnapshotCache(const ConfigSnapshotCache&) = delete;
+  ConfigSnapshotCache& operator=(const ConfigSnapshotCache&) = delete;
+
+  const ConfigSchema& schema_;
+  std::atomic<const ConfigSnapshot*> current_;
+  // Readers started in each epoch. Update() flips the epoch after
+  // publishing, then waits for the readers of the previous one, which may
+  // hold the previous snapshot.
+  mutable std::atomic<int> readers_[2];
+  std::atomic<int> epoch_;
+  std::mutex update_mutex_;
+};
+
+// Read every key of the schema of `cache` `frames` times, through the
+// current snapshot and from the SDK by name, and log the time per lookup of
+// each.
+void RunConfigLookupBenchmark(const ConfigSnapshotCache& cache, int frames);
+
+}  // namespace remote_config_testapp
+
+#endif  // FIREBASE_TESTAPP_CONFIG_SNAPSHOT_H_  // NOLINT
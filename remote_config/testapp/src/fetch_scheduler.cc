@@ -0,0 +1,185 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fetch_scheduler.h"  // NOLINT
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>  // NOLINT
+
+#include "firebase/future.h"
+#include "firebase/remote_config.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+
+namespace remote_config = ::firebase::remote_config;
+
+namespace remote_config_testapp {
+
+FetchScheduler::FetchScheduler(const FetchSchedulerOptions& options)
+    : options_(options),
+      running_(false),
+      stopping_(false),
+      fetched_(false),
+      backoff_ms_(options.initial_backoff_ms) {}
+
+FetchScheduler::~FetchScheduler() { Stop(); }
+
+void FetchScheduler::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_) return;
+  running_ = true;
+  stopping_ = false;
+  app_framework::RunOnBackgroundThread(RunThread, this);
+}
+
+void FetchScheduler::Stop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  stopping_ = true;
+  condition_.notify_all();
+  while (running_) condition_.wait(lock);
+}
+
+bool FetchScheduler::fetched() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return fetched_;
+}
+
+bool FetchScheduler::WaitForFetch(int timeout_ms) {
+  fetch_events_.WaitUntil([this]() { return fetched(); }, timeout_ms);
+  return fetched();
+}
+
+bool FetchScheduler::Activate() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!fetched_) return false;
+    fetched_ = false;
+  }
+  bool activated = remote_config::ActivateFetched();
+  if (activated) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.activations++;
+  }
+  return activated;
+}
+
+FetchSchedulerStats FetchScheduler::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void* FetchScheduler::RunThread(void* data) {
+  static_cast<FetchScheduler*>(data)->Run();
+  return nullptr;
+}
+
+void FetchScheduler::Run() {
+  // Respect throttling reported to a previous run of the app.
+  int64_t delay_ms = GetThrottledDelayMs(remote_config::GetInfo());
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    if (delay_ms > 0) {
+      condition_.wait_for(lock, std::chrono::milliseconds(delay_ms),
+                          [this]() { return stopping_; });
+      if (stopping_) break;
+    }
+    delay_ms = Fetch(&lock);
+  }
+  running_ = false;
+  condition_.notify_all();
+}
+
+int64_t FetchScheduler::Fetch(std::unique_lock<std::mutex>* lock) {
+  lock->unlock();
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  firebase::Future<void> future =
+      remote_config::Fetch(options_.cache_expiration_seconds);
+  // Registered without holding mutex_, as a Future that has already
+  // completed runs the callback immediately.
+  future.OnCompletion([this](const firebase::Future<void>&) {
+    std::lock_guard<std::mutex> callback_lock(mutex_);
+    condition_.notify_all();
+  });
+  lock->lock();
+  bool timed_out = !condition_.wait_until(
+      *lock,
+      std::chrono::steady_clock::now() +
+          std::chrono::milliseconds(options_.fetch_timeout_ms),
+      [this, &future]() {
+        return stopping_ ||
+               future.status() != firebase::kFutureStatusPending;
+      });
+  bool stopping = stopping_;
+  int64_t fetch_us = GetMonotonicTimeInMicroseconds() - start_us;
+
+  lock->unlock();
+  // An abandoned fetch may outlive this scheduler, so it mustn't call back.
+  future.OnCompletion([](const firebase::Future<void>&) {});
+  if (stopping) {
+    lock->lock();
+    return 0;
+  }
+  app_framework::RecordLatency("Remote Config fetch", fetch_us);
+  const remote_config::ConfigInfo info = remote_config::GetInfo();
+  lock->lock();
+
+  stats_.fetches++;
+  int64_t delay_ms;
+  if (!timed_out && future.error() == 0 &&
+      info.last_fetch_status == remote_config::kLastFetchStatusSuccess) {
+    fetched_ = true;
+    backoff_ms_ = options_.initial_backoff_ms;
+    delay_ms = options_.fetch_interval_ms;
+    LogMessage("Fetched Remote Config values in %.1f ms.", fetch_us / 1000.0);
+  } else {
+    stats_.failures++;
+    int64_t throttled_ms = GetThrottledDelayMs(info);
+    if (info.last_fetch_failure_reason ==
+            remote_config::kFetchFailureReasonThrottled ||
+        throttled_ms > 0) {
+      stats_.throttled++;
+      delay_ms = throttled_ms > 0 ? throttled_ms : backoff_ms_;
+      LogMessage("Remote Config fetch throttled, retrying in %lld s.",
+                 static_cast<long long>(delay_ms / 1000));  // NOLINT
+    } else {
+      delay_ms = backoff_ms_;
+      LogMessage("Remote Config fetch %s, retrying in %lld s.",
+                 timed_out ? "timed out" : "failed",
+                 static_cast<long long>(delay_ms / 1000));  // NOLINT
+    }
+    backoff_ms_ = std::min(backoff_ms_ * 2, options_.max_backoff_ms);
+  }
+  fetch_events_.Signal();
+  return delay_ms;
+}
+
+int64_t FetchScheduler::GetThrottledDelayMs(
+    const remote_config::ConfigInfo& info) {
+  // throttled_end_time is on the wall clock, in milliseconds.
+  int64_t now_ms = app_framework::GetCurrentTimeInMicroseconds() / 1000;
+  int64_t end_ms = static_cast<int64_t>(info.throttled_end_time);
+  return end_ms > now_ms ? end_ms - now_ms : 0;
+}
+
+}  // namespace remote_config_testapp
@@ -0,0 +1,123 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_FETCH_SCHEDULER_H_  // NOLINT
+#define FIREBASE_TESTAPP_FETCH_SCHEDULER_H_  // NOLINT
+
+#include <stdint.h>
+
+#include <condition_variable>  // NOLINT
+#include <mutex>  // NOLINT
+
+#include "firebase/remote_config.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+
+namespace remote_config_testapp {
+
+// Configuration of a FetchScheduler.
+struct FetchSchedulerOptions {
+  FetchSchedulerOptions()
+      : cache_expiration_seconds(12 * 60 * 60),
+        fetch_interval_ms(12 * 60 * 60 * 1000),
+        initial_backoff_ms(5000),
+        max_backoff_ms(30 * 60 * 1000),
+        fetch_timeout_ms(60000) {}
+
+  // Passed to remote_config::Fetch().
+  uint64_t cache_expiration_seconds;
+  // Time between successful fetches. Fetching sooner than the cache
+  // expiration returns the cached values.
+  int64_t fetch_interval_ms;
+  // Delay before retrying the first failed fetch, doubled after each
+  // consecutive failure up to max_backoff_ms.
+  int initial_backoff_ms;
+  int max_backoff_ms;
+  // Time after which a pending fetch counts as failed.
+  int fetch_timeout_ms;
+};
+
+// Counters of a FetchScheduler.
+struct FetchSchedulerStats {
+  FetchSchedulerStats()
+      : fetches(0), failures(0), throttled(0), activations(0) {}
+
+  int fetches;
+  int failures;
+  // Fetches that failed because the app was throttled.
+  int throttled;
+  int activations;
+};
+
+// Fetches Remote Config values on a background thread so the app can start
+// with the values activated by its previous run, or the defaults, rather
+// than waiting for the network.
+//
+// Fetches are spaced by fetch_interval_ms. When the SDK reports the
+// app is throttled the next fetch waits until ConfigInfo::throttled_end_time,
+// and other failures back off exponentially.
+//
+// Fetched values are only activated when the app calls Activate(), at a point
+// where a change of values is safe, such as between levels.
+class FetchScheduler {
+ public:
+  explicit FetchScheduler(const FetchSchedulerOptions& options);
+  // Stops the fetch thread.
+  ~FetchScheduler();
+
+  // Start fetching in the background.
+  void Start();
+  // Stop fetching, waiting for the fetch thread to exit. A pending fetch is
+  // abandoned. Must be called before remote_config::Terminate().
+  void Stop();
+
+  // Whether values were fetched since the last Activate().
+  bool fetched() const;
+  // Wait up to `timeout_ms` for fetched() to be true, processing platform
+  // events meanwhile. Returns fetched().
+  bool WaitForFetch(int timeout_ms);
+  // Activate the fetched values, if any. Returns true if values were
+  // activated.
+  bool Activate();
+
+  FetchSchedulerStats stats() const;
+
+ private:
+  FetchScheduler(const FetchScheduler&) = delete;
+  FetchScheduler& operator=(const FetchScheduler&) = delete;
+
+  static void* RunThread(void* data);
+  void Run();
+  // Fetch once. Returns the delay before the next fetch.
+  int64_t Fetch(std::unique_lock<std::mutex>* lock);
+  // Time until the SDK lifts throttling, 0 if it isn't throttled.
+  static int64_t GetThrottledDelayMs(
+      const firebase::remote_config::ConfigInfo& info);
+
+  FetchSchedulerOptions options_;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  bool running_;
+  bool stopping_;
+  bool fetched_;
+  int backoff_ms_;
+  FetchSchedulerStats stats_;
+  // Signaled after each fetch, to wake WaitForFetch().
+  app_framework::EventCounter fetch_events_;
+};
+
+}  // namespace remote_config_testapp
+
+#endif  // FIREBASE_TESTAPP_FETCH_SCHEDULER_H_  // NOLINT
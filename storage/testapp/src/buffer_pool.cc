@@ -0,0 +1,212 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "buffer_pool.h"  // NOLINT
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "firebase/future.h"
+#include "firebase/storage.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+
+using app_framework::WaitForCompletion;
+
+namespace storage_testapp {
+
+namespace {
+
+// Index of the smallest size class with a capacity of at least `size`.
+size_t SizeClass(size_t size) {
+  size_t size_class = 0;
+  while ((BufferPool::kMinBufferSize << size_class) < size) size_class++;
+  return size_class;
+}
+
+// Allocate `size` bytes aligned to BufferPool::kAlignment. The pointer
+// returned by malloc() is stored just before the aligned block.
+void* AllocateAligned(size_t size) {
+  void* block = malloc(size + BufferPool::kAlignment + sizeof(void*));
+  if (!block) return nullptr;
+  uintptr_t aligned = reinterpret_cast<uintptr_t>(block) + sizeof(void*);
+  aligned = (aligned + BufferPool::kAlignment - 1) &
+            ~static_cast<uintptr_t>(BufferPool::kAlignment - 1);
+  reinterpret_cast<void**>(aligned)[-1] = block;
+  return reinterpret_cast<void*>(aligned);
+}
+
+void FreeAligned(void* data) {
+  if (data) free(static_cast<void**>(data)[-1]);
+}
+
+}  // namespace
+
+const size_t BufferPool::kAlignment;
+const size_t BufferPool::kMinBufferSize;
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other)
+    : pool_(other.pool_),
+      data_(other.data_),
+      capacity_(other.capacity_),
+      size_(other.size_) {
+  other.pool_ = nullptr;
+  other.data_ = nullptr;
+  other.capacity_ = 0;
+  other.size_ = 0;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) {
+  if (this != &other) {
+    Release();
+    pool_ = other.pool_;
+    data_ = other.data_;
+    capacity_ = other.capacity_;
+    size_ = other.size_;
+    other.pool_ = nullptr;
+    other.data_ = nullptr;
+    other.capacity_ = 0;
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+void PooledBuffer::Release() {
+  if (pool_) pool_->Return(data_, capacity_);
+  pool_ = nullptr;
+  data_ = nullptr;
+  capacity_ = 0;
+  size_ = 0;
+}
+
+BufferPool::BufferPool(size_t max_cached_bytes)
+    : max_cached_bytes_(max_cached_bytes),
+      cached_bytes_(0),
+      allocated_(0),
+      reused_(0) {}
+
+BufferPool::~BufferPool() {
+  for (size_t i = 0; i < free_buffers_.size(); ++i) {
+    for (size_t j = 0; j < free_buffers_[i].size(); ++j) {
+      FreeAligned(free_buffers_[i][j]);
+    }
+  }
+}
+
+PooledBuffer BufferPool::Acquire(size_t size) {
+  size_t size_class = SizeClass(size);
+  PooledBuffer buffer;
+  buffer.capacity_ = kMinBufferSize << size_class;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size_class < free_buffers_.size() &&
+        !free_buffers_[size_class].empty()) {
+      buffer.data_ = free_buffers_[size_class].back();
+      free_buffers_[size_class].pop_back();
+      cached_bytes_ -= buffer.capacity_;
+      reused_++;
+    } else {
+      allocated_++;
+    }
+  }
+  if (!buffer.data_) buffer.data_ = AllocateAligned(buffer.capacity_);
+  if (buffer.data_) {
+    buffer.pool_ = this;
+  } else {
+    buffer.capacity_ = 0;
+  }
+  return buffer;
+}
+
+int BufferPool::allocated() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return allocated_;
+}
+
+int BufferPool::reused() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return reused_;
+}
+
+void BufferPool::Return(void* data, size_t capacity) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (cached_bytes_ + capacity <= max_cached_bytes_) {
+      size_t size_class = SizeClass(capacity);
+      if (size_class >= free_buffers_.size()) {
+        free_buffers_.resize(size_class + 1);
+      }
+      free_buffers_[size_class].push_back(data);
+      cached_bytes_ += capacity;
+      return;
+    }
+  }
+  FreeAligned(data);
+}
+
+bool GetBytesIntoPool(firebase::storage::StorageReference ref,
+                      BufferPool* pool, const char* name,
+                      PooledBuffer* buffer, MetadataCache* metadata_cache) {
+  buffer->Release();
+  std::string metadata_name = std::string(name) + " GetMetadata";
+  // Read the metadata again, bypassing the cache, if the object has grown
+  // since it was cached.
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    firebase::storage::Metadata metadata;
+    if (metadata_cache) {
+      if (!GetMetadataCached(ref, metadata_cache, metadata_name.c_str(),
+                             &metadata)) {
+        return false;
+      }
+    } else {
+      firebase::Future<firebase::storage::Metadata> future =
+          ref.GetMetadata();
+      if (!WaitForCompletion(future, metadata_name.c_str())) return false;
+      metadata = *future.result();
+    }
+    // One byte more than the object's size, so a read that fills the buffer
+    // shows that the object is larger than its metadata says and the data
+    // was truncated.
+    size_t size = static_cast<size_t>(metadata.size_bytes());
+    *buffer = pool->Acquire(size + 1);
+    if (!buffer->data()) {
+      app_framework::LogMessage("ERROR: Unable to allocate %d bytes for %s.",
+                                static_cast<int>(size + 1), name);
+      return false;
+    }
+    firebase::Future<size_t> future =
+        ref.GetBytes(buffer->data(), buffer->capacity());
+    if (!WaitForCompletion(future, name)) {
+      buffer->Release();
+      return false;
+    }
+    if (*future.result() < buffer->capacity()) {
+      buffer->set_size(*future.result());
+      return true;
+    }
+    buffer->Release();
+    if (metadata_cache) metadata_cache->Invalidate(ref.full_path());
+  }
+  app_framework::LogMessage(
+      "ERROR: %s is larger than its metadata, the read was truncated.", name);
+  return false;
+}
+
+}  // namespace storage_testapp
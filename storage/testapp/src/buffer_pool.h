@@ -0,0 +1,121 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_BUFFER_POOL_H_  // NOLINT
+#define FIREBASE_TESTAPP_BUFFER_POOL_H_  // NOLINT
+
+#include <stddef.h>
+
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "firebase/storage.h"
+#include "metadata_cache.h"  // NOLINT
+
+namespace storage_testapp {
+
+class BufferPool;
+
+// A buffer checked out of a BufferPool. The buffer is returned to the pool
+// when the PooledBuffer is destroyed or Release() is called, so a consumer
+// holds on to the PooledBuffer for as long as it uses the data.
+class PooledBuffer {
+ public:
+  PooledBuffer() : pool_(nullptr), data_(nullptr), capacity_(0), size_(0) {}
+  PooledBuffer(PooledBuffer&& other);
+  PooledBuffer& operator=(PooledBuffer&& other);
+  ~PooledBuffer() { Release(); }
+
+  // Aligned to BufferPool::kAlignment, null if the buffer is empty.
+  void* data() const { return data_; }
+  // Number of bytes that can be written to data().
+  size_t capacity() const { return capacity_; }
+  // Number of bytes of data() that are in use.
+  size_t size() const { return size_; }
+  void set_size(size_t size) { size_ = size; }
+
+  // Return the buffer to its pool.
+  void Release();
+
+ private:
+  friend class BufferPool;
+
+  PooledBuffer(const PooledBuffer&) = delete;
+  PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+  BufferPool* pool_;
+  void* data_;
+  size_t capacity_;
+  size_t size_;
+};
+
+// Pool of aligned buffers grouped into power-of-two size classes. Buffers
+// released to the pool are handed out again by later Acquire() calls of the
+// same size class rather than being freed, so a steady stream of downloads
+// doesn't allocate or free memory once the pool is warm.
+//
+// The pool can be used from any thread and must outlive its buffers.
+class BufferPool {
+ public:
+  // Alignment of every buffer.
+  static const size_t kAlignment = 64;
+  // Capacity of the smallest size class.
+  static const size_t kMinBufferSize = 4096;
+
+  // `max_cached_bytes` limits the memory held by released buffers, buffers
+  // released beyond that are freed.
+  explicit BufferPool(size_t max_cached_bytes = 64 * 1024 * 1024);
+  ~BufferPool();
+
+  // Check out a buffer with a capacity of at least `size` bytes.
+  PooledBuffer Acquire(size_t size);
+
+  // Number of Acquire() calls that allocated a new buffer or reused one.
+  int allocated() const;
+  int reused() const;
+
+ private:
+  friend class PooledBuffer;
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  void Return(void* data, size_t capacity);
+
+  const size_t max_cached_bytes_;
+  mutable std::mutex mutex_;
+  // Released buffers indexed by size class.
+  std::vector<std::vector<void*>> free_buffers_;
+  size_t cached_bytes_;
+  int allocated_;
+  int reused_;
+};
+
+// Read the object at `ref` into a buffer from `pool`, sized from the object's
+// metadata. GetBytes() writes straight into the pooled buffer, so the data
+// isn't copied. If `metadata_cache` is non-null the metadata is read from it
+// when possible rather than with GetMetadata(). If the object has grown
+// since its metadata was read, the metadata is read again, dropping the
+// cached entry, and the read is retried once, failing rather than returning
+// truncated data. `name` identifies the operation in the log and latency
+// histograms.
+// Returns true and the object's content in `buffer` if the read succeeded.
+bool GetBytesIntoPool(firebase::storage::StorageReference ref,
+                      BufferPool* pool, const char* name,
+                      PooledBuffer* buffer,
+                      MetadataCache* metadata_cache = nullptr);
+
+}  // namespace storage_testapp
+
+#endif  // FIREBASE_TESTAPP_BUFFER_POOL_H_  // NOLINT
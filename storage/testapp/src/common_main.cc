@@ -19,6 +19,8 @@
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <string>
+#include <vector>
 
 #include "firebase/app.h"
 #include "firebase/auth.h"
@@ -28,34 +30,47 @@
 #include "firebase/util.h"
 
 // Thin OS abstraction layer.
+#include "benchmark.h"  // NOLINT
+#include "buffer_pool.h"  // NOLINT
+#include "future_wait.h"  // NOLINT
+#include "id_token_cache.h"  // NOLINT
 #include "main.h"  // NOLINT
+#include "metadata_cache.h"  // NOLINT
+#include "resumable_transfer.h"  // NOLINT
+#include "startup.h"  // NOLINT
+#include "streaming_transfer.h"  // NOLINT
+#include "transfer_engine.h"  // NOLINT
 
 using app_framework::GetCurrentTimeInMicroseconds;
 using app_framework::LogMessage;
 using app_framework::ProcessEvents;
+using app_framework::WaitForCompletion;
 
 const char* kPutFileTestFile = "PutFileTest.txt";
 const char* kGetFileTestFile = "GetFileTest.txt";
 
+// Local files and checkpoints of the resumable transfer, created in
+// app_framework::PathForResource().
+const char* kResumableUploadFile = "ResumableUploadTest.bin";
+const char* kResumableDownloadFile = "ResumableDownloadTest.bin";
+const char* kResumableUploadCheckpoint = "ResumableUpload.checkpoint";
+const char* kResumableDownloadCheckpoint = "ResumableDownload.checkpoint";
+const uint64_t kResumableFileSize = 8 * 1024 * 1024;
+const size_t kResumablePartSize = 1024 * 1024;
+
 // Optionally set this to your Cloud Storage URL (gs://...) to test
 // in a specific Cloud Storage bucket.
 const char* kStorageUrl = nullptr;
 
-// Wait for a Future to be completed. If the Future returns an error, it will
-// be logged.
-void WaitForCompletion(const firebase::FutureBase& future, const char* name) {
-  while (future.status() == firebase::kFutureStatusPending) {
-    ProcessEvents(100);
-  }
-  if (future.status() != firebase::kFutureStatusComplete) {
-    LogMessage("ERROR: %s returned an invalid result.", name);
-  } else if (future.error() != 0) {
-    LogMessage("ERROR: %s returned error %d: %s", name, future.error(),
-               future.error_message());
-  }
-}
+// Number and size of the objects transferred by the concurrency sweep, and
+// the in-flight windows it measures.
+const int kTransferObjectCount = 64;
+const size_t kTransferObjectSize = 16 * 1024;
+const int kTransferWindows[] = {1, 4, 16, 64};
 
 extern "C" int common_main(int argc, const char* argv[]) {
+  // Timeline of the startup, from App creation to the first request.
+  app_framework::StartupSequence startup;
   ::firebase::App* app;
 
 #if defined(__ANDROID__)
@@ -64,61 +79,61 @@ extern "C" int common_main(int argc, const char* argv[]) {
 #else
   app = ::firebase::App::Create();
 #endif  // defined(__ANDROID__)
+  startup.Mark("App::Create");
 
   LogMessage("Initialized Firebase App.");
 
   LogMessage("Initialize Firebase Auth and Cloud Storage.");
 
-  // Use ModuleInitializer to initialize both Auth and Storage, ensuring no
-  // dependencies are missing.
+  // Initialize Auth and Storage as separate startup steps. Sign-in waits for
+  // Auth alone, so it isn't delayed if Storage's dependencies need to be
+  // fixed first.
   ::firebase::storage::Storage* storage = nullptr;
   ::firebase::auth::Auth* auth = nullptr;
-  void* initialize_targets[] = {&auth, &storage};
 
-  const firebase::ModuleInitializer::InitializerFn initializers[] = {
-      [](::firebase::App* app, void* data) {
+  const int auth_step = startup.AddModule(
+      "Auth", app,
+      [](::firebase::App* app, void* target) {
         LogMessage("Attempt to initialize Firebase Auth.");
-        void** targets = reinterpret_cast<void**>(data);
         ::firebase::InitResult result;
-        *reinterpret_cast<::firebase::auth::Auth**>(targets[0]) =
+        *reinterpret_cast<::firebase::auth::Auth**>(target) =
             ::firebase::auth::Auth::GetAuth(app, &result);
         return result;
       },
-      [](::firebase::App* app, void* data) {
+      &auth);
+  const int storage_step = startup.AddModule(
+      "Cloud Storage", app,
+      [](::firebase::App* app, void* target) {
         LogMessage("Attempt to initialize Cloud Storage.");
-        void** targets = reinterpret_cast<void**>(data);
         ::firebase::InitResult result;
         firebase::storage::Storage* storage =
             firebase::storage::Storage::GetInstance(app, kStorageUrl, &result);
-        *reinterpret_cast<::firebase::storage::Storage**>(targets[1]) = storage;
+        *reinterpret_cast<::firebase::storage::Storage**>(target) = storage;
         LogMessage("Initialized storage with URL %s, %s",
                    kStorageUrl ? kStorageUrl : "(null)",
                    storage->url().c_str());
         return result;
-      }};
-
-  ::firebase::ModuleInitializer initializer;
-  initializer.Initialize(app, initialize_targets, initializers,
-                         sizeof(initializers) / sizeof(initializers[0]));
+      },
+      &storage);
+  // The default Storage permissions allow anonymous users access. This will
+  // work as long as your project's Authentication permissions allow anonymous
+  // signin.
+  const int sign_in_step = startup.AddStep(
+      "SignInAnonymously",
+      [&auth]() -> firebase::FutureBase { return auth->SignInAnonymously(); },
+      {auth_step});
 
-  WaitForCompletion(initializer.InitializeLastResult(), "Initialize");
+  startup.Run();
 
-  if (initializer.InitializeLastResult().error() != 0) {
-    LogMessage("Failed to initialize Firebase libraries: %s",
-               initializer.InitializeLastResult().error_message());
+  if (!startup.succeeded(auth_step) || !startup.succeeded(storage_step)) {
+    LogMessage("Failed to initialize Firebase libraries.");
     ProcessEvents(2000);
     return 1;
   }
   LogMessage("Successfully initialized Firebase Auth and Cloud Storage.");
 
-  // Sign in using Auth before accessing Storage.
-  // The default Storage permissions allow anonymous users access. This will
-  // work as long as your project's Authentication permissions allow anonymous
-  // signin.
   {
-    firebase::Future<firebase::auth::User*> sign_in_future =
-        auth->SignInAnonymously();
-    WaitForCompletion(sign_in_future, "SignInAnonymously");
+    const firebase::FutureBase& sign_in_future = startup.result(sign_in_step);
     if (sign_in_future.error() == firebase::auth::kAuthErrorNone) {
       LogMessage("Auth: Signed in anonymously.");
     } else {
@@ -133,6 +148,11 @@ extern "C" int common_main(int argc, const char* argv[]) {
     }
   }
 
+  // Keep the ID token fresh in the background, so the SDK never has to
+  // refresh it in the middle of a request when it expires.
+  app_framework::IdTokenCache* token_cache =
+      new app_framework::IdTokenCache(auth);
+
   // Generate a folder for the test data based on the time in milliseconds.
   int64_t time_in_microseconds = GetCurrentTimeInMicroseconds();
 
@@ -148,6 +168,12 @@ extern "C" int common_main(int argc, const char* argv[]) {
   LogMessage("Storage URL: gs://%s%s", ref.bucket().c_str(),
              ref.full_path().c_str());
 
+  // Buffers that downloads are read into, reused from one read to the next.
+  storage_testapp::BufferPool buffer_pool;
+  // Metadata of the objects written by the testapp, so reading it back doesn't
+  // need another round trip.
+  storage_testapp::MetadataCache metadata_cache;
+
   // Read and write from memory. This will save a small file and then read it
   // back from the storage to confirm that it was uploaded. Then it will remove
   // the file.
@@ -173,6 +199,10 @@ extern "C" int common_main(int argc, const char* argv[]) {
               .Child("SampleFile.txt")
               .PutBytes(&kSimpleTestFile[0], kSimpleTestFile.size(), metadata);
       WaitForCompletion(future, "Write");
+      startup.Mark("First request");
+      startup.LogTimeline();
+      metadata_cache.InsertResult(
+          ref.Child("TestFile").Child("SampleFile.txt").full_path(), future);
       if (future.error() == 0) {
         if (future.result()->size_bytes() != kSimpleTestFile.size()) {
           LogMessage("ERROR: Incorrect number of bytes uploaded.");
@@ -181,20 +211,50 @@ extern "C" int common_main(int argc, const char* argv[]) {
     }
 
     {
-      LogMessage("Read back the sample file.");
+      LogMessage("Update the sample file's metadata.");
+
+      firebase::storage::Metadata metadata;
+      (*metadata.custom_metadata())["updatedkey"] = "updated value";
+      firebase::Future<firebase::storage::Metadata> future =
+          ref.Child("TestFile").Child("SampleFile.txt").UpdateMetadata(
+              metadata);
+      WaitForCompletion(future, "UpdateMetadata");
+      metadata_cache.InsertResult(
+          ref.Child("TestFile").Child("SampleFile.txt").full_path(), future);
+    }
 
-      const size_t kBufferSize = 1024;
-      char buffer[kBufferSize];
+    {
+      LogMessage("Check the sample file's metadata.");
 
-      firebase::Future<size_t> future = ref.Child("TestFile")
-                                            .Child("SampleFile.txt")
-                                            .GetBytes(buffer, kBufferSize);
-      WaitForCompletion(future, "Read");
-      if (future.error() == 0) {
-        if (*future.result() != kSimpleTestFile.size()) {
-          LogMessage("ERROR: Incorrect number of bytes uploaded.");
+      firebase::storage::Metadata metadata;
+      if (storage_testapp::GetMetadataCached(
+              ref.Child("TestFile").Child("SampleFile.txt"), &metadata_cache,
+              "GetMetadata", &metadata)) {
+        if (metadata.size_bytes() != kSimpleTestFile.size()) {
+          LogMessage("ERROR: Incorrect size in metadata.");
+        }
+        if (strcmp(metadata.content_type(), "test/plain") != 0) {
+          LogMessage("ERROR: Incorrect content type \"%s\" in metadata.",
+                     metadata.content_type());
         }
-        if (memcmp(&kSimpleTestFile[0], buffer, kSimpleTestFile.size()) != 0) {
+        if ((*metadata.custom_metadata())["specialkey"] != "secret value" ||
+            (*metadata.custom_metadata())["updatedkey"] != "updated value") {
+          LogMessage("ERROR: Incorrect custom metadata.");
+        }
+      }
+    }
+
+    {
+      LogMessage("Read back the sample file.");
+
+      storage_testapp::PooledBuffer buffer;
+      if (storage_testapp::GetBytesIntoPool(
+              ref.Child("TestFile").Child("SampleFile.txt"), &buffer_pool,
+              "Read", &buffer, &metadata_cache)) {
+        if (buffer.size() != kSimpleTestFile.size()) {
+          LogMessage("ERROR: Incorrect number of bytes uploaded.");
+        } else if (memcmp(&kSimpleTestFile[0], buffer.data(),
+                          kSimpleTestFile.size()) != 0) {
           LogMessage("ERROR: file contents did not match.");
         }
       }
@@ -202,16 +262,200 @@ extern "C" int common_main(int argc, const char* argv[]) {
     {
       LogMessage("Delete the sample file.");
 
-      firebase::Future<void> future =
-          ref.Child("TestFile").Child("SampleFile.txt").Delete();
-      WaitForCompletion(future, "Delete");
+      storage_testapp::DeleteCached(
+          ref.Child("TestFile").Child("SampleFile.txt"), &metadata_cache,
+          "Delete");
     }
+    LogMessage("  Metadata cache: %d hits, %d misses.", metadata_cache.hits(),
+               metadata_cache.misses());
+  }
+
+  // Stream a large file to and from local storage. Only a single chunk of the
+  // file is held in memory at a time, and the downloaded copy is verified with
+  // a checksum computed while the file is read back.
+  {
+    LogMessage("Stream a large file.");
+    storage_testapp::StreamingTransferOptions options;
+    if (!storage_testapp::RunStreamingTransfer(
+            ref.Child("TestFile").Child("StreamingFile.bin"), kPutFileTestFile,
+            kGetFileTestFile, options)) {
+      LogMessage("ERROR: Streaming transfer failed.");
+    }
+  }
+
+  // Upload and download a file in parts, saving a checkpoint after each part
+  // so that a transfer interrupted by a crash or an exit request continues
+  // from where it stopped the next time the testapp runs.
+  {
+    LogMessage("Resumable transfer of a large file.");
+    const std::string upload_path =
+        app_framework::PathForResource() + kResumableUploadFile;
+    const std::string download_path =
+        app_framework::PathForResource() + kResumableDownloadFile;
+    firebase::storage::StorageReference resumable_ref =
+        storage_testapp::ResumableReference(storage, kResumableUploadCheckpoint,
+                                            ref.Child("ResumableFile"));
+    resumable_ref = storage_testapp::ResumableReference(
+        storage, kResumableDownloadCheckpoint, resumable_ref);
+    // The file's content is deterministic, so regenerating it lets an
+    // interrupted upload continue.
+    uint32_t checksum;
+    storage_testapp::ResumableTransferResult result =
+        storage_testapp::kResumableTransferFailed;
+    if (storage_testapp::WriteTestFile(upload_path, kResumableFileSize,
+                                       kResumablePartSize, &checksum)) {
+      result = storage_testapp::ResumableUpload(resumable_ref, upload_path,
+                                                kResumableUploadCheckpoint,
+                                                kResumablePartSize);
+    }
+    if (result == storage_testapp::kResumableTransferComplete) {
+      result = storage_testapp::ResumableDownload(
+          resumable_ref, download_path, kResumableDownloadCheckpoint);
+    }
+    remove(upload_path.c_str());
+    if (result == storage_testapp::kResumableTransferComplete) {
+      storage_testapp::DeleteResumableObject(resumable_ref);
+      remove(download_path.c_str());
+    } else if (result == storage_testapp::kResumableTransferInterrupted) {
+      LogMessage("  Transfer interrupted, it will resume on the next run.");
+    } else {
+      LogMessage("ERROR: Resumable transfer failed.");
+    }
+  }
+
+  // Upload, download and delete many small objects with a range of in-flight
+  // windows, to find the concurrency that gives the best throughput against
+  // this bucket.
+  {
+    LogMessage("Transfer %d objects with a range of concurrency limits.",
+               kTransferObjectCount);
+    std::string payload(kTransferObjectSize, '\0');
+    for (size_t i = 0; i < payload.size(); ++i) {
+      payload[i] = static_cast<char>('a' + i % 26);
+    }
+    std::vector<storage_testapp::PooledBuffer> buffers(kTransferObjectCount);
+    firebase::storage::StorageReference directory =
+        ref.Child("TransferEngine");
+    for (size_t w = 0;
+         w < sizeof(kTransferWindows) / sizeof(kTransferWindows[0]); ++w) {
+      storage_testapp::TransferEngineOptions options;
+      options.max_in_flight = kTransferWindows[w];
+      storage_testapp::TransferEngine engine(directory, options);
+      char object_name[32];
+      char run_name[32];
+
+      for (int i = 0; i < kTransferObjectCount; ++i) {
+        snprintf(object_name, sizeof(object_name), "object%d", i);
+        engine.QueuePut(object_name, payload.data(), payload.size());
+      }
+      snprintf(run_name, sizeof(run_name), "PutBytes x%d",
+               options.max_in_flight);
+      storage_testapp::LogTransferStats(run_name, engine.Run(run_name));
+
+      for (int i = 0; i < kTransferObjectCount; ++i) {
+        snprintf(object_name, sizeof(object_name), "object%d", i);
+        buffers[i] = buffer_pool.Acquire(kTransferObjectSize);
+        engine.QueueGet(object_name, buffers[i].data(),
+                        buffers[i].capacity());
+      }
+      snprintf(run_name, sizeof(run_name), "GetBytes x%d",
+               options.max_in_flight);
+      storage_testapp::LogTransferStats(run_name, engine.Run(run_name));
+      for (int i = 0; i < kTransferObjectCount; ++i) {
+        if (memcmp(buffers[i].data(), payload.data(), payload.size()) != 0) {
+          LogMessage("ERROR: object%d contents did not match.", i);
+        }
+        buffers[i].Release();
+      }
+
+      for (int i = 0; i < kTransferObjectCount; ++i) {
+        snprintf(object_name, sizeof(object_name), "object%d", i);
+        engine.QueueDelete(object_name);
+      }
+      snprintf(run_name, sizeof(run_name), "Delete x%d", options.max_in_flight);
+      storage_testapp::LogTransferStats(run_name, engine.Run(run_name));
+    }
+    LogMessage("  Buffer pool: %d buffers allocated, %d reused.",
+               buffer_pool.allocated(), buffer_pool.reused());
+  }
+
+  app_framework::BenchmarkOptions benchmark_options;
+  if (app_framework::ParseBenchmarkOptions(argc, argv, &benchmark_options)) {
+    LogMessage("Running benchmarks.");
+    std::string payload(kTransferObjectSize, '\0');
+    for (size_t i = 0; i < payload.size(); ++i) {
+      payload[i] = static_cast<char>('a' + i % 26);
+    }
+    firebase::storage::StorageReference object_ref =
+        ref.Child("Benchmark").Child("object");
+    // Upload the object read by get_bytes and get_metadata up front, so they
+    // don't depend on put_bytes and can be selected on their own with
+    // --benchmark_filter.
+    WaitForCompletion(object_ref.PutBytes(payload.data(), payload.size()),
+                      "PutBytes benchmark object");
+    // One download buffer per operation the harness may have in flight, each
+    // reused once its GetBytes() completes, so the scenario's memory doesn't
+    // grow with the number of iterations.
+    struct GetBytesSlot {
+      storage_testapp::PooledBuffer buffer;
+      firebase::storage::Controller controller;
+      firebase::Future<size_t> future;
+    };
+    std::vector<GetBytesSlot> get_bytes_slots(
+        std::max(1, benchmark_options.concurrency));
+    app_framework::BenchmarkSuite benchmarks("storage");
+    benchmarks.AddScenario("put_bytes", [&]() -> firebase::FutureBase {
+      return object_ref.PutBytes(payload.data(), payload.size());
+    });
+    benchmarks.AddScenario("get_bytes", [&]() -> firebase::FutureBase {
+      // The harness only starts an operation once fewer than `concurrency`
+      // are in flight, so one of the slots is idle.
+      GetBytesSlot* slot = &get_bytes_slots[0];
+      for (size_t i = 0; i < get_bytes_slots.size(); ++i) {
+        if (get_bytes_slots[i].future.status() !=
+            firebase::kFutureStatusPending) {
+          slot = &get_bytes_slots[i];
+          break;
+        }
+      }
+      if (!slot->buffer.data()) {
+        slot->buffer = buffer_pool.Acquire(kTransferObjectSize);
+      }
+      slot->controller = firebase::storage::Controller();
+      slot->future =
+          object_ref.GetBytes(slot->buffer.data(), slot->buffer.capacity(),
+                              nullptr, &slot->controller);
+      return slot->future;
+    });
+    benchmarks.AddScenario("get_metadata", [&]() -> firebase::FutureBase {
+      return object_ref.GetMetadata();
+    });
+    app_framework::RunBenchmarks(&benchmarks, benchmark_options);
+    // A scenario that timed out leaves its operations in flight, so cancel
+    // the downloads still writing to the buffers and wait for them to stop
+    // before the buffers are released.
+    std::vector<firebase::FutureBase> pending_gets;
+    for (size_t i = 0; i < get_bytes_slots.size(); ++i) {
+      GetBytesSlot& slot = get_bytes_slots[i];
+      if (slot.future.status() == firebase::kFutureStatusPending) {
+        slot.controller.Cancel();
+        pending_gets.push_back(slot.future);
+      }
+    }
+    app_framework::WaitForAll(pending_gets);
+    get_bytes_slots.clear();
+    WaitForCompletion(object_ref.Delete(), "Delete");
+    LogMessage("Ran benchmarks.");
   }
 
   LogMessage("Shutdown the Storage library.");
   delete storage;
   storage = nullptr;
 
+  token_cache->LogStats();
+  delete token_cache;
+  token_cache = nullptr;
+
   LogMessage("Signing out from anonymous account.");
   auth->SignOut();
 
@@ -0,0 +1,127 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metadata_cache.h"  // NOLINT
+
+#include <algorithm>
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+
+#include "firebase/future.h"
+#include "firebase/storage.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+
+using app_framework::WaitForCompletion;
+
+namespace storage_testapp {
+
+MetadataCache::MetadataCache(size_t capacity)
+    : capacity_(std::max(capacity, static_cast<size_t>(1))),
+      hits_(0),
+      misses_(0) {}
+
+bool MetadataCache::Lookup(const std::string& full_path,
+                           firebase::storage::Metadata* metadata) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  EntryIndex::iterator it = index_.find(full_path);
+  if (it == index_.end()) {
+    misses_++;
+    return false;
+  }
+  entries_.splice(entries_.begin(), entries_, it->second);
+  *metadata = it->second->second;
+  hits_++;
+  return true;
+}
+
+void MetadataCache::Insert(const std::string& full_path,
+                           const firebase::storage::Metadata& metadata) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  EntryIndex::iterator it = index_.find(full_path);
+  if (it != index_.end()) {
+    it->second->second = metadata;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return;
+  }
+  if (entries_.size() >= capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  entries_.push_front(std::make_pair(full_path, metadata));
+  index_[full_path] = entries_.begin();
+}
+
+void MetadataCache::InsertResult(
+    const std::string& full_path,
+    const firebase::Future<firebase::storage::Metadata>& future) {
+  if (future.status() == firebase::kFutureStatusComplete &&
+      future.error() == 0 && future.result()) {
+    Insert(full_path, *future.result());
+  }
+}
+
+void MetadataCache::Invalidate(const std::string& full_path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  EntryIndex::iterator it = index_.find(full_path);
+  if (it == index_.end()) return;
+  entries_.erase(it->second);
+  index_.erase(it);
+}
+
+void MetadataCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  index_.clear();
+}
+
+size_t MetadataCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+int MetadataCache::hits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+int MetadataCache::misses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+bool GetMetadataCached(firebase::storage::StorageReference ref,
+                       MetadataCache* cache, const char* name,
+                       firebase::storage::Metadata* metadata) {
+  const std::string full_path = ref.full_path();
+  if (cache->Lookup(full_path, metadata)) return true;
+  firebase::Future<firebase::storage::Metadata> future = ref.GetMetadata();
+  if (!WaitForCompletion(future, name)) return false;
+  cache->InsertResult(full_path, future);
+  *metadata = *future.result();
+  return true;
+}
+
+bool DeleteCached(firebase::storage::StorageReference ref,
+                  MetadataCache* cache, const char* name) {
+  const std::string full_path = ref.full_path();
+  // Invalidate before the request is sent, so the entry can't be used while
+  // the delete is in progress.
+  cache->Invalidate(full_path);
+  return WaitForCompletion(ref.Delete(), name);
+}
+
+}  // namespace storage_testapp
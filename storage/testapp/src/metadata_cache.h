@@ -0,0 +1,102 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_METADATA_CACHE_H_  // NOLINT
+#define FIREBASE_TESTAPP_METADATA_CACHE_H_  // NOLINT
+
+#include <stddef.h>
+
+#include <list>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "firebase/future.h"
+#include "firebase/storage.h"
+
+namespace storage_testapp {
+
+// Least recently used cache of object Metadata keyed by
+// StorageReference::full_path().
+//
+// The cache is filled from the results of operations that return an object's
+// metadata (PutBytes(), PutFile(), UpdateMetadata() and GetMetadata()) and an
+// entry is invalidated when its object is deleted, so size, content type and
+// custom metadata lookups of objects this process wrote don't need a network
+// round trip. Changes made by other clients aren't seen until an entry is
+// evicted or invalidated.
+//
+// The cache can be used from any thread.
+class MetadataCache {
+ public:
+  explicit MetadataCache(size_t capacity = 256);
+
+  // Copy the cached metadata of `full_path` to `metadata`, marking it as
+  // most recently used. Returns false if it isn't cached.
+  bool Lookup(const std::string& full_path,
+              firebase::storage::Metadata* metadata);
+
+  // Add or replace the metadata of `full_path`, evicting the least recently
+  // used entry if the cache is full.
+  void Insert(const std::string& full_path,
+              const firebase::storage::Metadata& metadata);
+
+  // Cache the result of `future` for `full_path` if it completed without an
+  // error. Call once the Future has completed, completion callbacks can't be
+  // used as waiting on a Future replaces them.
+  void InsertResult(
+      const std::string& full_path,
+      const firebase::Future<firebase::storage::Metadata>& future);
+
+  // Remove the entry of `full_path`, e.g after the object was deleted.
+  void Invalidate(const std::string& full_path);
+
+  void Clear();
+
+  size_t size() const;
+  // Number of Lookup() calls that found or didn't find an entry.
+  int hits() const;
+  int misses() const;
+
+ private:
+  typedef std::list<std::pair<std::string, firebase::storage::Metadata>>
+      EntryList;
+  typedef std::unordered_map<std::string, EntryList::iterator> EntryIndex;
+
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  // Entries ordered from most to least recently used.
+  EntryList entries_;
+  EntryIndex index_;
+  int hits_;
+  int misses_;
+};
+
+// Get the metadata of `ref` from `cache`, or with GetMetadata() if it isn't
+// cached, in which case the result is added to the cache. `name` identifies
+// the operation in the log and latency histograms.
+// Returns false if the metadata couldn't be retrieved.
+bool GetMetadataCached(firebase::storage::StorageReference ref,
+                       MetadataCache* cache, const char* name,
+                       firebase::storage::Metadata* metadata);
+
+// Delete the object at `ref` and invalidate its entry in `cache`.
+// Returns true if the object was deleted.
+bool DeleteCached(firebase::storage::StorageReference ref,
+                  MetadataCache* cache, const char* name);
+
+}  // namespace storage_testapp
+
+#endif  // FIREBASE_TESTAPP_METADATA_CACHE_H_  // NOLINT
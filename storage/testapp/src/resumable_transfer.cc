@@ -0,0 +1,409 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "resumable_transfer.h"  // NOLINT
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "firebase/future.h"
+#include "firebase/storage.h"
+
+// Thin OS abstraction layer.
+#include "file_util.h"  // NOLINT
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+#include "streaming_transfer.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+using app_framework::RecordLatency;
+using app_framework::WaitForFuture;
+
+namespace storage_testapp {
+
+namespace {
+
+// Name of the object that describes a resumable object.
+const char kManifestName[] = "manifest";
+
+const double kBytesPerMegabyte = 1024.0 * 1024.0;
+
+std::string PartName(uint32_t part) {
+  char name[16];
+  snprintf(name, sizeof(name), "part%05u", part);
+  return name;
+}
+
+// Size of an open file, which may be larger than 2 GB.
+bool GetFileSize(FILE* file, uint64_t* size) {
+#if defined(_WIN32)
+  if (_fseeki64(file, 0, SEEK_END) != 0) return false;
+  int64_t end = _ftelli64(file);
+#else
+  if (fseeko(file, 0, SEEK_END) != 0) return false;
+  int64_t end = ftello(file);
+#endif  // defined(_WIN32)
+  rewind(file);
+  if (end < 0) return false;
+  *size = static_cast<uint64_t>(end);
+  return true;
+}
+
+// Read the first `length` bytes of `file` through `buffer`, adding them to
+// `crc`. Leaves the file positioned at the end of the prefix.
+bool ReadPrefix(FILE* file, uint64_t length, std::vector<uint8_t>* buffer,
+                Crc32* crc) {
+  while (length) {
+    size_t bytes = static_cast<size_t>(
+        std::min(length, static_cast<uint64_t>(buffer->size())));
+    if (fread(buffer->data(), 1, bytes, file) != bytes) return false;
+    crc->Update(buffer->data(), bytes);
+    length -= bytes;
+  }
+  return true;
+}
+
+// Wait for the operation on a single part, cancelling it through
+// `controller` if the application is asked to exit. Only returns once the
+// operation has finished, so the caller's buffer can then be freed.
+ResumableTransferResult WaitForPart(const firebase::FutureBase& future,
+                                    firebase::storage::Controller* controller,
+                                    const char* name) {
+  int64_t start_us = GetMonotonicTimeInMicroseconds();
+  if (WaitForFuture(future) == app_framework::kWaitResultExitRequested) {
+    controller->Cancel();
+    app_framework::WaitForAll({future});
+    return kResumableTransferInterrupted;
+  }
+  if (future.status() != firebase::kFutureStatusComplete) {
+    LogMessage("ERROR: %s returned an invalid result.", name);
+    return kResumableTransferFailed;
+  } else if (future.error() != 0) {
+    LogMessage("ERROR: %s returned error %d: %s", name, future.error(),
+               future.error_message());
+    return kResumableTransferFailed;
+  }
+  RecordLatency(name, GetMonotonicTimeInMicroseconds() - start_us);
+  return kResumableTransferComplete;
+}
+
+// Read the size, part size and CRC-32 of a resumable object.
+ResumableTransferResult ReadManifest(firebase::storage::StorageReference ref,
+                                     TransferCheckpoint* manifest) {
+  char text[128];
+  firebase::storage::Controller controller;
+  firebase::Future<size_t> future = ref.Child(kManifestName).GetBytes(
+      text, sizeof(text) - 1, nullptr, &controller);
+  ResumableTransferResult result =
+      WaitForPart(future, &controller, "GetBytes manifest");
+  if (result != kResumableTransferComplete) return result;
+  text[*future.result()] = '\0';
+  unsigned long long total_size;  // NOLINT
+  unsigned long long part_size;  // NOLINT
+  unsigned int crc32;
+  if (sscanf(text, "size=%llu part_size=%llu crc32=%x", &total_size,
+             &part_size, &crc32) != 3 ||
+      part_size == 0) {
+    LogMessage("ERROR: Invalid manifest \"%s\"", text);
+    return kResumableTransferFailed;
+  }
+  manifest->remote_path = ref.full_path();
+  manifest->total_size = total_size;
+  manifest->part_size = part_size;
+  manifest->crc32 = crc32;
+  return kResumableTransferComplete;
+}
+
+void LogProgress(const char* operation, const TransferCheckpoint& checkpoint) {
+  LogMessage("  %s part %u (%.1f / %.1f MB)", operation,
+             checkpoint.next_part - 1, checkpoint.offset / kBytesPerMegabyte,
+             checkpoint.total_size / kBytesPerMegabyte);
+}
+
+}  // namespace
+
+std::string CheckpointPath(const char* name) {
+  return app_framework::PathForResource() + name;
+}
+
+bool LoadCheckpoint(const std::string& path, TransferCheckpoint* checkpoint) {
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file) return false;
+  TransferCheckpoint loaded;
+  int fields = 0;
+  char line[1024];
+  while (fgets(line, sizeof(line), file)) {
+    std::string text(line);
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) {
+      text.erase(text.size() - 1);
+    }
+    size_t separator = text.find(' ');
+    if (separator == std::string::npos) continue;
+    std::string key = text.substr(0, separator);
+    const char* value = text.c_str() + separator + 1;
+    unsigned long long number;  // NOLINT
+    if (key == "remote_path") {
+      loaded.remote_path = value;
+      fields++;
+    } else if (sscanf(value, key == "crc32" ? "%llx" : "%llu", &number) != 1) {
+      continue;
+    } else if (key == "total_size") {
+      loaded.total_size = number;
+      fields++;
+    } else if (key == "part_size") {
+      loaded.part_size = number;
+      fields++;
+    } else if (key == "next_part") {
+      loaded.next_part = static_cast<uint32_t>(number);
+      fields++;
+    } else if (key == "offset") {
+      loaded.offset = number;
+      fields++;
+    } else if (key == "crc32") {
+      loaded.crc32 = static_cast<uint32_t>(number);
+      fields++;
+    }
+  }
+  fclose(file);
+  if (fields != 6 || loaded.part_size == 0 ||
+      loaded.offset > loaded.total_size ||
+      (loaded.offset != loaded.next_part * loaded.part_size &&
+       loaded.offset != loaded.total_size)) {
+    return false;
+  }
+  *checkpoint = loaded;
+  return true;
+}
+
+bool SaveCheckpoint(const std::string& path,
+                    const TransferCheckpoint& checkpoint) {
+  char fields[256];
+  snprintf(fields, sizeof(fields),
+           "total_size %" PRIu64 "\n"
+           "part_size %" PRIu64 "\n"
+           "next_part %u\n"
+           "offset %" PRIu64 "\n"
+           "crc32 %08x\n",
+           checkpoint.total_size, checkpoint.part_size, checkpoint.next_part,
+           checkpoint.offset, checkpoint.crc32);
+  return app_framework::WriteFileReplacing(
+      path, "remote_path " + checkpoint.remote_path + "\n" + fields);
+}
+
+firebase::storage::StorageReference ResumableReference(
+    firebase::storage::Storage* storage, const char* checkpoint_name,
+    const firebase::storage::StorageReference& default_ref) {
+  TransferCheckpoint checkpoint;
+  if (!LoadCheckpoint(CheckpointPath(checkpoint_name), &checkpoint)) {
+    return default_ref;
+  }
+  LogMessage("  Found checkpoint %s for %s", checkpoint_name,
+             checkpoint.remote_path.c_str());
+  return storage->GetReference(checkpoint.remote_path.c_str());
+}
+
+ResumableTransferResult ResumableUpload(
+    firebase::storage::StorageReference ref, const std::string& local_path,
+    const char* checkpoint_name, size_t part_size) {
+  FILE* file = fopen(local_path.c_str(), "rb");
+  uint64_t file_size;
+  if (!file || !GetFileSize(file, &file_size)) {
+    LogMessage("ERROR: Unable to read %s", local_path.c_str());
+    if (file) fclose(file);
+    return kResumableTransferFailed;
+  }
+
+  const std::string checkpoint_path = CheckpointPath(checkpoint_name);
+  std::vector<uint8_t> part(part_size);
+  TransferCheckpoint checkpoint;
+  Crc32 crc;
+  if (LoadCheckpoint(checkpoint_path, &checkpoint) &&
+      checkpoint.remote_path == ref.full_path() &&
+      checkpoint.total_size == file_size &&
+      checkpoint.part_size == part_size &&
+      ReadPrefix(file, checkpoint.offset, &part, &crc) &&
+      crc.value() == checkpoint.crc32) {
+    LogMessage("  Resuming upload at part %u (%.1f MB)", checkpoint.next_part,
+               checkpoint.offset / kBytesPerMegabyte);
+  } else {
+    rewind(file);
+    crc = Crc32();
+    checkpoint = TransferCheckpoint();
+    checkpoint.remote_path = ref.full_path();
+    checkpoint.total_size = file_size;
+    checkpoint.part_size = part_size;
+  }
+
+  ResumableTransferResult result = kResumableTransferComplete;
+  while (checkpoint.offset < checkpoint.total_size) {
+    size_t bytes = static_cast<size_t>(std::min(
+        checkpoint.total_size - checkpoint.offset, checkpoint.part_size));
+    if (fread(part.data(), 1, bytes, file) != bytes) {
+      LogMessage("ERROR: Failed to read %s", local_path.c_str());
+      result = kResumableTransferFailed;
+      break;
+    }
+    firebase::storage::Controller controller;
+    firebase::Future<firebase::storage::Metadata> future =
+        ref.Child(PartName(checkpoint.next_part))
+            .PutBytes(part.data(), bytes, nullptr, &controller);
+    result = WaitForPart(future, &controller, "PutBytes part");
+    if (result != kResumableTransferComplete) break;
+    crc.Update(part.data(), bytes);
+    checkpoint.offset += bytes;
+    checkpoint.next_part++;
+    checkpoint.crc32 = crc.value();
+    if (!SaveCheckpoint(checkpoint_path, checkpoint)) {
+      LogMessage("WARNING: Unable to save checkpoint %s",
+                 checkpoint_path.c_str());
+    }
+    LogProgress("Uploaded", checkpoint);
+  }
+  fclose(file);
+  if (result != kResumableTransferComplete) return result;
+
+  char manifest[128];
+  snprintf(manifest, sizeof(manifest),
+           "size=%" PRIu64 " part_size=%" PRIu64 " crc32=%08x",
+           checkpoint.total_size, checkpoint.part_size, checkpoint.crc32);
+  firebase::storage::Controller controller;
+  firebase::Future<firebase::storage::Metadata> future =
+      ref.Child(kManifestName)
+          .PutBytes(manifest, strlen(manifest), nullptr, &controller);
+  result = WaitForPart(future, &controller, "PutBytes manifest");
+  if (result == kResumableTransferComplete) remove(checkpoint_path.c_str());
+  return result;
+}
+
+ResumableTransferResult ResumableDownload(
+    firebase::storage::StorageReference ref, const std::string& local_path,
+    const char* checkpoint_name) {
+  TransferCheckpoint manifest;
+  ResumableTransferResult result = ReadManifest(ref, &manifest);
+  if (result != kResumableTransferComplete) return result;
+
+  const std::string checkpoint_path = CheckpointPath(checkpoint_name);
+  std::vector<uint8_t> part(static_cast<size_t>(manifest.part_size));
+  TransferCheckpoint checkpoint;
+  Crc32 crc;
+  FILE* file = nullptr;
+  if (LoadCheckpoint(checkpoint_path, &checkpoint) &&
+      checkpoint.remote_path == manifest.remote_path &&
+      checkpoint.total_size == manifest.total_size &&
+      checkpoint.part_size == manifest.part_size &&
+      (file = fopen(local_path.c_str(), "r+b")) != nullptr &&
+      ReadPrefix(file, checkpoint.offset, &part, &crc) &&
+      crc.value() == checkpoint.crc32) {
+    LogMessage("  Resuming download at part %u (%.1f MB)",
+               checkpoint.next_part, checkpoint.offset / kBytesPerMegabyte);
+    // Required when switching from reading to writing a stream.
+    fseek(file, 0, SEEK_CUR);
+  } else {
+    if (file) fclose(file);
+    file = fopen(local_path.c_str(), "w+b");
+    if (!file) {
+      LogMessage("ERROR: Unable to create %s", local_path.c_str());
+      return kResumableTransferFailed;
+    }
+    crc = Crc32();
+    checkpoint = manifest;
+    checkpoint.offset = 0;
+    checkpoint.next_part = 0;
+    checkpoint.crc32 = crc.value();
+  }
+
+  while (checkpoint.offset < checkpoint.total_size) {
+    size_t bytes = static_cast<size_t>(std::min(
+        checkpoint.total_size - checkpoint.offset, checkpoint.part_size));
+    firebase::storage::Controller controller;
+    firebase::Future<size_t> future =
+        ref.Child(PartName(checkpoint.next_part))
+            .GetBytes(part.data(), part.size(), nullptr, &controller);
+    result = WaitForPart(future, &controller, "GetBytes part");
+    if (result != kResumableTransferComplete) break;
+    if (*future.result() != bytes) {
+      LogMessage("ERROR: Part %u is %d bytes, expected %d.",
+                 checkpoint.next_part, static_cast<int>(*future.result()),
+                 static_cast<int>(bytes));
+      result = kResumableTransferFailed;
+      break;
+    }
+    // Flush the data before saving the checkpoint that refers to it.
+    if (fwrite(part.data(), 1, bytes, file) != bytes || fflush(file) != 0) {
+      LogMessage("ERROR: Failed to write %s", local_path.c_str());
+      result = kResumableTransferFailed;
+      break;
+    }
+    crc.Update(part.data(), bytes);
+    checkpoint.offset += bytes;
+    checkpoint.next_part++;
+    checkpoint.crc32 = crc.value();
+    if (!SaveCheckpoint(checkpoint_path, checkpoint)) {
+      LogMessage("WARNING: Unable to save checkpoint %s",
+                 checkpoint_path.c_str());
+    }
+    LogProgress("Downloaded", checkpoint);
+  }
+  fclose(file);
+  if (result != kResumableTransferComplete) return result;
+
+  // The download is finished whether or not it matches, so a later attempt
+  // starts again from the beginning.
+  remove(checkpoint_path.c_str());
+  if (checkpoint.crc32 != manifest.crc32) {
+    LogMessage("ERROR: Downloaded file has crc32 %08x, expected %08x.",
+               checkpoint.crc32, manifest.crc32);
+    return kResumableTransferFailed;
+  }
+  return kResumableTransferComplete;
+}
+
+bool DeleteResumableObject(firebase::storage::StorageReference ref) {
+  TransferCheckpoint manifest;
+  if (ReadManifest(ref, &manifest) != kResumableTransferComplete) {
+    return false;
+  }
+  uint64_t part_count =
+      (manifest.total_size + manifest.part_size - 1) / manifest.part_size;
+  std::vector<firebase::FutureBase> futures;
+  for (uint32_t part = 0; part < part_count; ++part) {
+    futures.push_back(ref.Child(PartName(part)).Delete());
+  }
+  futures.push_back(ref.Child(kManifestName).Delete());
+  std::vector<app_framework::FutureWaitResult> results =
+      app_framework::WaitForAll(futures);
+  int failed = 0;
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (results[i].result != app_framework::kWaitResultComplete ||
+        results[i].error != 0) {
+      failed++;
+    }
+  }
+  if (failed) {
+    LogMessage("ERROR: Failed to delete %d of %d objects of %s", failed,
+               static_cast<int>(results.size()), ref.full_path().c_str());
+  }
+  return failed == 0;
+}
+
+}  // namespace storage_testapp
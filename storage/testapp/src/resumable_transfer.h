@@ -0,0 +1,113 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_RESUMABLE_TRANSFER_H_  // NOLINT
+#define FIREBASE_TESTAPP_RESUMABLE_TRANSFER_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "firebase/storage.h"
+
+// Resumable transfers of large files.
+//
+// The storage SDK doesn't expose the session of an in-progress upload or a way
+// to download part of an object, so a transfer can't be continued by a new
+// process. Instead, a resumable object is stored as a directory of fixed-size
+// part objects and a small "manifest" object holding the size and CRC-32 of
+// the whole file. Progress is saved to a checkpoint file in
+// app_framework::PathForResource() each time a part completes, so after a
+// crash or an exit request a transfer restarts from the first incomplete part
+// rather than from the beginning of the file.
+
+namespace storage_testapp {
+
+// Progress of a resumable transfer, stored in a checkpoint file.
+struct TransferCheckpoint {
+  TransferCheckpoint()
+      : total_size(0), part_size(0), next_part(0), offset(0), crc32(0) {}
+
+  // StorageReference::full_path() of the resumable object.
+  std::string remote_path;
+  // Size of the whole file.
+  uint64_t total_size;
+  // Size of each part, except the last which may be smaller.
+  uint64_t part_size;
+  // Index of the first part that hasn't been transferred.
+  uint32_t next_part;
+  // Number of bytes transferred, the start of next_part.
+  uint64_t offset;
+  // CRC-32 of the first `offset` bytes of the file, used both to check that
+  // the local file hasn't changed since the checkpoint was saved and to
+  // verify the whole file once the transfer completes.
+  uint32_t crc32;
+};
+
+// Outcome of ResumableUpload() and ResumableDownload().
+enum ResumableTransferResult {
+  // The whole file was transferred and verified.
+  kResumableTransferComplete = 0,
+  // The application was asked to exit. The part in progress was cancelled
+  // and the checkpoint of the completed parts has been saved.
+  kResumableTransferInterrupted,
+  // An operation failed. The checkpoint of the completed parts has been
+  // saved, so the transfer can be attempted again.
+  kResumableTransferFailed,
+};
+
+// Path of the checkpoint file called `name` in PathForResource().
+std::string CheckpointPath(const char* name);
+
+// Read a checkpoint file. Returns false if it doesn't exist or is invalid.
+bool LoadCheckpoint(const std::string& path, TransferCheckpoint* checkpoint);
+
+// Write a checkpoint file, replacing the previous version only once the new
+// one has been written completely. Returns false if it couldn't be written.
+bool SaveCheckpoint(const std::string& path,
+                    const TransferCheckpoint& checkpoint);
+
+// Reference of the object an interrupted transfer with the checkpoint file
+// `checkpoint_name` was sending to or receiving from, or `default_ref` if
+// there is no checkpoint. Used to continue a transfer started by a previous
+// run of the application.
+firebase::storage::StorageReference ResumableReference(
+    firebase::storage::Storage* storage, const char* checkpoint_name,
+    const firebase::storage::StorageReference& default_ref);
+
+// Upload the file at `local_path` to the resumable object `ref` in parts of
+// `part_size` bytes, continuing from the checkpoint `checkpoint_name` if it
+// describes the same object and file. The checkpoint is removed once the
+// upload completes.
+ResumableTransferResult ResumableUpload(
+    firebase::storage::StorageReference ref, const std::string& local_path,
+    const char* checkpoint_name, size_t part_size);
+
+// Download the resumable object `ref` to `local_path`, continuing from the
+// checkpoint `checkpoint_name` if it describes the same object and the local
+// file still holds the data transferred so far. The downloaded file is
+// verified against the CRC-32 in the object's manifest and the checkpoint is
+// removed once the download completes.
+ResumableTransferResult ResumableDownload(
+    firebase::storage::StorageReference ref, const std::string& local_path,
+    const char* checkpoint_name);
+
+// Delete the parts and manifest of the resumable object `ref`.
+// Returns true if every object was deleted.
+bool DeleteResumableObject(firebase::storage::StorageReference ref);
+
+}  // namespace storage_testapp
+
+#endif  // FIREBASE_TESTAPP_RESUMABLE_TRANSFER_H_  // NOLINT
@@ -0,0 +1,272 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "streaming_transfer.h"  // NOLINT
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "firebase/future.h"
+#include "firebase/storage.h"
+
+// Thin OS abstraction layer.
+#include "future_wait.h"  // NOLINT
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LogMessage;
+using app_framework::WaitForCompletion;
+
+namespace storage_testapp {
+
+const char kFileUriScheme[] = "file://";
+
+namespace {
+
+const double kBytesPerMegabyte = 1024.0 * 1024.0;
+
+// Lookup table for the reflected CRC-32 polynomial 0xEDB88320.
+struct Crc32Table {
+  Crc32Table() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+      }
+      entries[i] = crc;
+    }
+  }
+
+  uint32_t entries[256];
+};
+
+const Crc32Table& GetCrc32Table() {
+  static const Crc32Table table;
+  return table;
+}
+
+// Generates the content of test files. A fixed seed produces the same content
+// for a given file size on every run and platform.
+class TestContentGenerator {
+ public:
+  TestContentGenerator() : state_(0x9E3779B97F4A7C15ULL) {}
+
+  void Fill(uint8_t* buffer, size_t size) {
+    while (size) {
+      // xorshift64
+      state_ ^= state_ << 13;
+      state_ ^= state_ >> 7;
+      state_ ^= state_ << 17;
+      size_t bytes = std::min(size, sizeof(state_));
+      memcpy(buffer, &state_, bytes);
+      buffer += bytes;
+      size -= bytes;
+    }
+  }
+
+ private:
+  uint64_t state_;
+};
+
+double ThroughputInMegabytesPerSecond(int64_t bytes, int64_t elapsed_us) {
+  return elapsed_us > 0 ? static_cast<double>(bytes) / kBytesPerMegabyte /
+                              (static_cast<double>(elapsed_us) / 1000000.0)
+                        : 0.0;
+}
+
+}  // namespace
+
+void Crc32::Update(const void* data, size_t size) {
+  const uint32_t* table = GetCrc32Table().entries;
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint32_t crc = crc_;
+  for (size_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  }
+  crc_ = crc;
+}
+
+ThroughputListener::ThroughputListener(const char* operation, int interval_ms)
+    : operation_(operation),
+      interval_us_(interval_ms * 1000LL),
+      start_us_(GetMonotonicTimeInMicroseconds()),
+      last_log_us_(start_us_) {}
+
+void ThroughputListener::OnProgress(firebase::storage::Controller* controller) {
+  int64_t now_us = GetMonotonicTimeInMicroseconds();
+  if (now_us - last_log_us_ < interval_us_) return;
+  last_log_us_ = now_us;
+  int64_t transferred = controller->bytes_transferred();
+  LogMessage("  %s: %.1f / %.1f MB (%.1f MB/s)", operation_,
+             transferred / kBytesPerMegabyte,
+             controller->total_byte_count() / kBytesPerMegabyte,
+             ThroughputInMegabytesPerSecond(transferred, now_us - start_us_));
+}
+
+void ThroughputListener::OnPaused(firebase::storage::Controller* controller) {
+  LogMessage("  %s: paused after %.1f MB", operation_,
+             controller->bytes_transferred() / kBytesPerMegabyte);
+}
+
+void ThroughputListener::LogSummary(int64_t bytes_transferred) const {
+  int64_t elapsed_us = GetMonotonicTimeInMicroseconds() - start_us_;
+  LogMessage("  %s: %.1f MB in %.2f s (%.1f MB/s)", operation_,
+             bytes_transferred / kBytesPerMegabyte, elapsed_us / 1000000.0,
+             ThroughputInMegabytesPerSecond(bytes_transferred, elapsed_us));
+}
+
+bool WriteTestFile(const std::string& path, uint64_t size, size_t chunk_size,
+                   uint32_t* checksum) {
+  if (chunk_size == 0) {
+    LogMessage("ERROR: Unable to write %s in chunks of 0 bytes", path.c_str());
+    return false;
+  }
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) {
+    LogMessage("ERROR: Unable to create %s", path.c_str());
+    return false;
+  }
+  std::vector<uint8_t> chunk(chunk_size);
+  TestContentGenerator generator;
+  Crc32 crc;
+  bool succeeded = true;
+  for (uint64_t remaining = size; remaining && succeeded;) {
+    size_t bytes = static_cast<size_t>(
+        std::min(remaining, static_cast<uint64_t>(chunk_size)));
+    generator.Fill(chunk.data(), bytes);
+    crc.Update(chunk.data(), bytes);
+    succeeded = fwrite(chunk.data(), 1, bytes, file) == bytes;
+    remaining -= bytes;
+  }
+  succeeded = fclose(file) == 0 && succeeded;
+  if (!succeeded) {
+    LogMessage("ERROR: Failed to write %s", path.c_str());
+    return false;
+  }
+  *checksum = crc.value();
+  return true;
+}
+
+bool ChecksumFile(const std::string& path, size_t chunk_size, uint64_t* size,
+                  uint32_t* checksum) {
+  if (chunk_size == 0) {
+    LogMessage("ERROR: Unable to read %s in chunks of 0 bytes", path.c_str());
+    return false;
+  }
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    LogMessage("ERROR: Unable to open %s", path.c_str());
+    return false;
+  }
+  std::vector<uint8_t> chunk(chunk_size);
+  Crc32 crc;
+  uint64_t total = 0;
+  size_t bytes;
+  while ((bytes = fread(chunk.data(), 1, chunk_size, file)) > 0) {
+    crc.Update(chunk.data(), bytes);
+    total += bytes;
+  }
+  bool succeeded = !ferror(file);
+  fclose(file);
+  if (!succeeded) {
+    LogMessage("ERROR: Failed to read %s", path.c_str());
+    return false;
+  }
+  *size = total;
+  *checksum = crc.value();
+  return true;
+}
+
+bool RunStreamingTransfer(firebase::storage::StorageReference ref,
+                          const char* put_file_name, const char* get_file_name,
+                          const StreamingTransferOptions& options) {
+  if (options.chunk_size == 0) {
+    LogMessage("ERROR: StreamingTransferOptions::chunk_size must be non-zero");
+    return false;
+  }
+  const std::string directory = app_framework::PathForResource();
+  const std::string put_path = directory + put_file_name;
+  const std::string get_path = directory + get_file_name;
+  const int64_t file_size = static_cast<int64_t>(options.file_size);
+
+  uint32_t expected_checksum;
+  if (!WriteTestFile(put_path, options.file_size, options.chunk_size,
+                     &expected_checksum)) {
+    return false;
+  }
+  LogMessage("  Generated %.1f MB test file %s (crc32 %08x)",
+             file_size / kBytesPerMegabyte, put_path.c_str(),
+             expected_checksum);
+
+  bool succeeded = false;
+  {
+    firebase::storage::Metadata metadata;
+    metadata.set_content_type("application/octet-stream");
+    ThroughputListener listener("PutFile", 1000);
+    firebase::storage::Controller controller;
+    firebase::Future<firebase::storage::Metadata> future =
+        ref.PutFile((kFileUriScheme + put_path).c_str(), metadata, &listener,
+                    &controller);
+    if (WaitForCompletion(future, "PutFile")) {
+      listener.LogSummary(file_size);
+      succeeded = future.result()->size_bytes() == file_size;
+      if (!succeeded) {
+        LogMessage("ERROR: Uploaded %lld bytes, expected %lld.",
+                   static_cast<long long>(  // NOLINT
+                       future.result()->size_bytes()),
+                   static_cast<long long>(file_size));  // NOLINT
+      }
+    }
+  }
+  remove(put_path.c_str());
+
+  if (succeeded) {
+    ThroughputListener listener("GetFile", 1000);
+    firebase::storage::Controller controller;
+    firebase::Future<size_t> future = ref.GetFile(
+        (kFileUriScheme + get_path).c_str(), &listener, &controller);
+    succeeded = WaitForCompletion(future, "GetFile");
+    if (succeeded) listener.LogSummary(file_size);
+  }
+
+  if (succeeded) {
+    uint64_t downloaded_size;
+    uint32_t downloaded_checksum;
+    succeeded = ChecksumFile(get_path, options.chunk_size, &downloaded_size,
+                             &downloaded_checksum);
+    if (succeeded && (downloaded_size != options.file_size ||
+                      downloaded_checksum != expected_checksum)) {
+      LogMessage(
+          "ERROR: Downloaded file doesn't match, %llu bytes (crc32 %08x) "
+          "expected %llu bytes (crc32 %08x).",
+          static_cast<unsigned long long>(downloaded_size),  // NOLINT
+          downloaded_checksum,
+          static_cast<unsigned long long>(options.file_size),  // NOLINT
+          expected_checksum);
+      succeeded = false;
+    }
+  }
+  remove(get_path.c_str());
+
+  WaitForCompletion(ref.Delete(), "DeleteStreamingFile");
+  return succeeded;
+}
+
+}  // namespace storage_testapp
@@ -0,0 +1,101 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_STREAMING_TRANSFER_H_  // NOLINT
+#define FIREBASE_TESTAPP_STREAMING_TRANSFER_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "firebase/storage.h"
+
+namespace storage_testapp {
+
+// URI scheme of local file paths passed to PutFile() and GetFile().
+extern const char kFileUriScheme[];
+
+// Incremental CRC-32 (the polynomial used by zlib and gzip), so that the
+// content of a file can be verified one chunk at a time.
+class Crc32 {
+ public:
+  Crc32() : crc_(0xFFFFFFFFu) {}
+
+  void Update(const void* data, size_t size);
+  uint32_t value() const { return crc_ ^ 0xFFFFFFFFu; }
+
+ private:
+  uint32_t crc_;
+};
+
+// Logs the progress and throughput of a transfer at most once per
+// `interval_ms`, and the sustained throughput when the transfer completes.
+class ThroughputListener : public firebase::storage::Listener {
+ public:
+  ThroughputListener(const char* operation, int interval_ms);
+
+  void OnProgress(firebase::storage::Controller* controller) override;
+  void OnPaused(firebase::storage::Controller* controller) override;
+
+  // Log the total number of bytes transferred and the throughput from the
+  // start of the transfer.
+  void LogSummary(int64_t bytes_transferred) const;
+
+ private:
+  const char* operation_;
+  int64_t interval_us_;
+  int64_t start_us_;
+  int64_t last_log_us_;
+};
+
+// Configuration of RunStreamingTransfer().
+struct StreamingTransferOptions {
+  StreamingTransferOptions()
+      : file_size(16 * 1024 * 1024), chunk_size(1024 * 1024) {}
+
+  // Size of the file to upload and download.
+  uint64_t file_size;
+  // Size of the buffer used to generate and verify the local files. This is
+  // the only memory used for file content, regardless of file_size. Must be
+  // non-zero.
+  size_t chunk_size;
+};
+
+// Write `size` bytes of deterministic pseudo-random content to `path`,
+// `chunk_size` bytes at a time, and return the content's CRC-32 in
+// `checksum`. Returns false if the file couldn't be written or `chunk_size`
+// is 0.
+bool WriteTestFile(const std::string& path, uint64_t size, size_t chunk_size,
+                   uint32_t* checksum);
+
+// Read the file at `path`, `chunk_size` bytes at a time, and return its size
+// and CRC-32. Returns false if the file couldn't be read or `chunk_size` is
+// 0.
+bool ChecksumFile(const std::string& path, size_t chunk_size, uint64_t* size,
+                  uint32_t* checksum);
+
+// Upload a generated file of options.file_size bytes to `ref` with PutFile(),
+// download it again with GetFile() and verify the downloaded copy, reporting
+// the throughput of each direction. The local files are created in
+// app_framework::PathForResource() named `put_file_name` and `get_file_name`.
+// The uploaded object is deleted afterwards.
+// Returns true if the round trip succeeded and the content matched.
+bool RunStreamingTransfer(firebase::storage::StorageReference ref,
+                          const char* put_file_name, const char* get_file_name,
+                          const StreamingTransferOptions& options);
+
+}  // namespace storage_testapp
+
+#endif  // FIREBASE_TESTAPP_STREAMING_TRANSFER_H_  // NOLINT
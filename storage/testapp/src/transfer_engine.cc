@@ -0,0 +1,282 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "transfer_engine.h"  // NOLINT
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "firebase/future.h"
+#include "firebase/storage.h"
+
+// Thin OS abstraction layer.
+#include "main.h"  // NOLINT
+#include "timing.h"  // NOLINT
+
+using app_framework::GetMonotonicTimeInMicroseconds;
+using app_framework::LatencyHistogram;
+using app_framework::LogMessage;
+using app_framework::ProcessEvents;
+using app_framework::RecordLatency;
+using app_framework::WakeProcessEvents;
+
+namespace storage_testapp {
+
+namespace {
+
+// Upper bound on the time spent in a single ProcessEvents() call while
+// operations are running, see future_wait.cc.
+const int kMaxEventWaitMs = 100;
+
+// Operations that completed, but haven't been handled by Run() yet. Shared
+// with the completion callbacks, which run on the SDK's threads.
+struct CompletionQueue {
+  std::mutex mutex;
+  // Window slot and completion time of each completed operation.
+  std::vector<std::pair<int, int64_t>> completed;
+};
+
+// user_data of an operation's completion callback.
+struct CompletionEntry {
+  std::shared_ptr<CompletionQueue> queue;
+  int slot;
+};
+
+void OnTransferCompletion(const firebase::FutureBase& /*future*/,
+                          void* user_data) {
+  CompletionEntry* entry = static_cast<CompletionEntry*>(user_data);
+  int64_t now_us = GetMonotonicTimeInMicroseconds();
+  {
+    std::lock_guard<std::mutex> lock(entry->queue->mutex);
+    entry->queue->completed.push_back(std::make_pair(entry->slot, now_us));
+  }
+  WakeProcessEvents();
+  delete entry;
+}
+
+// Whether an operation that failed with `error` may succeed if it's retried.
+bool IsRetryableError(int error) {
+  switch (error) {
+    case firebase::storage::kErrorUnknown:
+    case firebase::storage::kErrorQuotaExceeded:
+    case firebase::storage::kErrorRetryLimitExceeded:
+    case firebase::storage::kErrorNonMatchingChecksum:
+      return true;
+    default:
+      return false;
+  }
+}
+
+const char* OperationName(int operation) {
+  static const char* kNames[] = {"PutBytes", "GetBytes", "Delete"};
+  return kNames[operation];
+}
+
+}  // namespace
+
+double TransferStats::objects_per_second() const {
+  return elapsed_us > 0 ? static_cast<double>(succeeded) * 1000000.0 /
+                              static_cast<double>(elapsed_us)
+                        : 0.0;
+}
+
+TransferEngine::TransferEngine(
+    const firebase::storage::StorageReference& directory,
+    const TransferEngineOptions& options)
+    : directory_(directory), options_(options) {
+  options_.max_in_flight = std::max(options_.max_in_flight, 1);
+  options_.max_attempts = std::max(options_.max_attempts, 1);
+}
+
+void TransferEngine::QueuePut(const std::string& name, const void* data,
+                              size_t size,
+                              const firebase::storage::Metadata& metadata) {
+  Task task = {kOperationPut, name, data, size, metadata, 0, 0};
+  queue_.push_back(task);
+}
+
+void TransferEngine::QueueGet(const std::string& name, void* buffer,
+                              size_t buffer_size) {
+  Task task = {kOperationGet, name, buffer, buffer_size,
+               firebase::storage::Metadata(), 0, 0};
+  queue_.push_back(task);
+}
+
+void TransferEngine::QueueDelete(const std::string& name) {
+  Task task = {kOperationDelete, name, nullptr, 0,
+               firebase::storage::Metadata(), 0, 0};
+  queue_.push_back(task);
+}
+
+firebase::FutureBase TransferEngine::Start(const Task& task) {
+  firebase::storage::StorageReference ref = directory_.Child(task.name);
+  switch (task.operation) {
+    case kOperationPut:
+      return ref.PutBytes(task.data, task.size, task.metadata);
+    case kOperationGet:
+      return ref.GetBytes(const_cast<void*>(task.data), task.size);
+    case kOperationDelete:
+      return ref.Delete();
+  }
+  return firebase::FutureBase();
+}
+
+TransferStats TransferEngine::Run(const char* name) {
+  struct InFlight {
+    Task task;
+    firebase::FutureBase future;
+    int64_t start_us;
+  };
+
+  TransferStats stats;
+  LatencyHistogram latencies;
+  std::shared_ptr<CompletionQueue> completions(new CompletionQueue);
+  std::vector<InFlight> slots(options_.max_in_flight);
+  std::vector<int> free_slots;
+  for (int i = options_.max_in_flight - 1; i >= 0; --i) free_slots.push_back(i);
+  // Failed tasks waiting for their retry delay to expire.
+  std::vector<Task> retries;
+  std::vector<std::pair<int, int64_t>> completed;
+  bool exit_requested = false;
+  const int64_t start_us = GetMonotonicTimeInMicroseconds();
+
+  while (true) {
+    // Fill the window, starting with retries that are due.
+    int64_t now_us = GetMonotonicTimeInMicroseconds();
+    while (!exit_requested && !free_slots.empty()) {
+      std::vector<Task>::iterator retry = std::find_if(
+          retries.begin(), retries.end(),
+          [now_us](const Task& task) { return task.not_before_us <= now_us; });
+      InFlight& in_flight = slots[free_slots.back()];
+      if (retry != retries.end()) {
+        in_flight.task = *retry;
+        retries.erase(retry);
+      } else if (!queue_.empty()) {
+        in_flight.task = queue_.front();
+        queue_.pop_front();
+      } else {
+        break;
+      }
+      in_flight.task.attempts++;
+      in_flight.start_us = now_us;
+      in_flight.future = Start(in_flight.task);
+      CompletionEntry* entry = new CompletionEntry;
+      entry->queue = completions;
+      entry->slot = free_slots.back();
+      free_slots.pop_back();
+      if (in_flight.future.status() == firebase::kFutureStatusInvalid) {
+        OnTransferCompletion(in_flight.future, entry);
+      } else {
+        in_flight.future.OnCompletion(OnTransferCompletion, entry);
+      }
+    }
+
+    bool idle = free_slots.size() == slots.size();
+    if (idle && (exit_requested || (queue_.empty() && retries.empty()))) {
+      break;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(completions->mutex);
+      completed.swap(completions->completed);
+    }
+    if (completed.empty()) {
+      int wait_ms = kMaxEventWaitMs;
+      if (idle) {
+        // Only retries are left, sleep until the first is due.
+        int64_t next_us = retries[0].not_before_us;
+        for (size_t i = 1; i < retries.size(); ++i) {
+          next_us = std::min(next_us, retries[i].not_before_us);
+        }
+        wait_ms = static_cast<int>(std::min(
+            static_cast<int64_t>(wait_ms),
+            std::max(static_cast<int64_t>(0), (next_us - now_us) / 1000)));
+      }
+      if (ProcessEvents(wait_ms)) exit_requested = true;
+      continue;
+    }
+
+    for (size_t i = 0; i < completed.size(); ++i) {
+      int slot = completed[i].first;
+      InFlight& in_flight = slots[slot];
+      const firebase::FutureBase& future = in_flight.future;
+      int error = future.status() == firebase::kFutureStatusComplete
+                      ? future.error()
+                      : firebase::storage::kErrorUnknown;
+      if (error == 0) {
+        int64_t latency_us = completed[i].second - in_flight.start_us;
+        latencies.Record(latency_us);
+        RecordLatency(name, latency_us);
+        stats.succeeded++;
+        if (in_flight.task.operation == kOperationPut) {
+          stats.bytes += in_flight.task.size;
+        } else if (in_flight.task.operation == kOperationGet) {
+          stats.bytes += *static_cast<const size_t*>(future.result_void());
+        }
+      } else if (IsRetryableError(error) &&
+                 in_flight.task.attempts < options_.max_attempts) {
+        in_flight.task.not_before_us =
+            completed[i].second +
+            (static_cast<int64_t>(options_.retry_delay_ms) * 1000
+             << (in_flight.task.attempts - 1));
+        retries.push_back(in_flight.task);
+        stats.retries++;
+      } else {
+        LogMessage("ERROR: %s %s failed after %d attempt(s), error %d: %s",
+                   OperationName(in_flight.task.operation),
+                   in_flight.task.name.c_str(), in_flight.task.attempts, error,
+                   future.error_message() ? future.error_message() : "");
+        stats.failed++;
+      }
+      in_flight.future = firebase::FutureBase();
+      free_slots.push_back(slot);
+    }
+    completed.clear();
+  }
+
+  stats.skipped = static_cast<int>(queue_.size() + retries.size());
+  queue_.clear();
+  stats.elapsed_us = GetMonotonicTimeInMicroseconds() - start_us;
+  stats.latency_p50_us = latencies.Percentile(50.0);
+  stats.latency_p99_us = latencies.Percentile(99.0);
+  stats.latency_max_us = latencies.max();
+  return stats;
+}
+
+void LogTransferStats(const char* name, const TransferStats& stats) {
+  LogMessage(
+      "  %s: %d objects in %.2f s (%.1f objects/s, %.1f KB/s), %d failed, "
+      "%d retries",
+      name, stats.succeeded, stats.elapsed_us / 1000000.0,
+      stats.objects_per_second(),
+      stats.elapsed_us > 0
+          ? static_cast<double>(stats.bytes) / 1024.0 /
+                (static_cast<double>(stats.elapsed_us) / 1000000.0)
+          : 0.0,
+      stats.failed, stats.retries);
+  LogMessage("  %s: latency p50=%.1f p99=%.1f max=%.1f ms", name,
+             stats.latency_p50_us / 1000.0, stats.latency_p99_us / 1000.0,
+             stats.latency_max_us / 1000.0);
+  if (stats.skipped) {
+    LogMessage("  %s: %d objects skipped", name, stats.skipped);
+  }
+}
+
+}  // namespace storage_testapp
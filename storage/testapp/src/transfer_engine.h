@@ -0,0 +1,138 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FIREBASE_TESTAPP_TRANSFER_ENGINE_H_  // NOLINT
+#define FIREBASE_TESTAPP_TRANSFER_ENGINE_H_  // NOLINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+
+#include "firebase/storage.h"
+
+namespace storage_testapp {
+
+// Configuration of a TransferEngine.
+struct TransferEngineOptions {
+  TransferEngineOptions()
+      : max_in_flight(8), max_attempts(3), retry_delay_ms(200) {}
+
+  // Maximum number of operations running at the same time.
+  int max_in_flight;
+  // Number of times an operation is attempted before it's reported as failed.
+  // Only errors that may succeed when retried are retried.
+  int max_attempts;
+  // Delay before the first retry of an operation, doubled for each further
+  // retry.
+  int retry_delay_ms;
+};
+
+// Outcome of TransferEngine::Run().
+struct TransferStats {
+  TransferStats()
+      : succeeded(0),
+        failed(0),
+        skipped(0),
+        retries(0),
+        bytes(0),
+        elapsed_us(0),
+        latency_p50_us(0),
+        latency_p99_us(0),
+        latency_max_us(0) {}
+
+  // Number of objects each operation completed on, with and without errors.
+  int succeeded;
+  int failed;
+  // Objects left in the queue because the application was asked to exit.
+  int skipped;
+  // Number of attempts that failed and were retried.
+  int retries;
+  // Number of bytes uploaded and downloaded.
+  uint64_t bytes;
+  // Time taken to run the whole queue.
+  int64_t elapsed_us;
+  // Latency of the successful attempt of each object.
+  int64_t latency_p50_us;
+  int64_t latency_p99_us;
+  int64_t latency_max_us;
+
+  double objects_per_second() const;
+};
+
+// Runs a queue of PutBytes(), GetBytes() and Delete() operations on children
+// of a StorageReference, keeping up to TransferEngineOptions::max_in_flight
+// of them running at a time. As soon as an operation completes the next one
+// in the queue is started, so the engine keeps the window full rather than
+// waiting for a whole batch to finish.
+//
+// Failed operations are retried with exponential backoff when the error
+// may be transient. All methods must be called from the same thread, and
+// completions are handled on that thread from Run().
+class TransferEngine {
+ public:
+  TransferEngine(const firebase::storage::StorageReference& directory,
+                 const TransferEngineOptions& options);
+
+  // Queue an upload of `size` bytes of `data` to the child `name`. `data`
+  // must remain valid until Run() returns.
+  void QueuePut(const std::string& name, const void* data, size_t size,
+                const firebase::storage::Metadata& metadata =
+                    firebase::storage::Metadata());
+  // Queue a download of the child `name` into `buffer`, which must remain
+  // valid until Run() returns.
+  void QueueGet(const std::string& name, void* buffer, size_t buffer_size);
+  // Queue the deletion of the child `name`.
+  void QueueDelete(const std::string& name);
+
+  // Number of operations waiting to run.
+  size_t queued() const { return queue_.size(); }
+
+  // Run all queued operations. The latency of each successful operation is
+  // also recorded in the latency histogram `name`, see timing.h. If the
+  // application is asked to exit no further operations are started, and
+  // Run() returns once the running ones complete.
+  TransferStats Run(const char* name);
+
+ private:
+  enum Operation { kOperationPut, kOperationGet, kOperationDelete };
+
+  struct Task {
+    Operation operation;
+    std::string name;
+    // Source of a put or destination of a get.
+    const void* data;
+    size_t size;
+    firebase::storage::Metadata metadata;
+    // Number of times the task has been started.
+    int attempts;
+    // Time before which a retried task mustn't start again.
+    int64_t not_before_us;
+  };
+
+  // Start the operation described by `task`.
+  firebase::FutureBase Start(const Task& task);
+
+  firebase::storage::StorageReference directory_;
+  TransferEngineOptions options_;
+  std::deque<Task> queue_;
+};
+
+// Log the throughput and latency of a TransferEngine::Run().
+void LogTransferStats(const char* name, const TransferStats& stats);
+
+}  // namespace storage_testapp
+
+#endif  // FIREBASE_TESTAPP_TRANSFER_ENGINE_H_  // NOLINT